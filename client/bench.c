@@ -0,0 +1,710 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <glib.h>
+#include <dbus/dbus.h>
+
+#include <res-conn.h>
+#include <res-hist.h>
+
+#include "bench.h"
+#include "time-stat.h"
+
+typedef enum {
+    PHASE_SETUP = 0,            /* registering the sets */
+    PHASE_RUN,                  /* the measured part */
+    PHASE_DRAIN,                /* waiting for the operations in flight */
+    PHASE_TEARDOWN,             /* unregistering the sets */
+} phase_t;
+
+typedef struct {
+    uint32_t         id;
+    resset_t        *rset;
+    int              busy;
+    bench_op_t       op;        /* operation in flight */
+    uint64_t         sent;
+    int              reregister;
+} bset_t;
+
+typedef struct {
+    uint32_t         count;
+    uint32_t         failed;
+    reshist_t        hist;
+} opstat_t;
+
+static void      manager_up(resconn_t *);
+static void      notify_cb(resmsg_t *, resset_t *, void *);
+static void      status_cb(resset_t *, resmsg_t *);
+static gboolean  duration_cb(gpointer);
+static gboolean  reregister_cb(gpointer);
+
+static int       register_sets(void);
+static void      start_run(void);
+static void      stop_run(void);
+static void      kick(void);
+static int       send_op(bset_t *, bench_op_t);
+static bench_op_t pick_op(void);
+static void      free_set(bset_t *);
+static bset_t   *take_set(void);
+static void      teardown(void);
+
+static void      report(void);
+static void      report_text(double);
+static void      report_csv(double);
+static void      report_json(double);
+
+static const char *op_names[BENCH_OP_MAX] = {
+    [BENCH_REGISTER  ] = "register",
+    [BENCH_UNREGISTER] = "unregister",
+    [BENCH_UPDATE    ] = "update",
+    [BENCH_AUDIO     ] = "audio",
+    [BENCH_ACQUIRE   ] = "acquire",
+    [BENCH_RELEASE   ] = "release",
+};
+
+static bench_conf_t  *conf;
+static GMainLoop     *loop;         /* owned by the caller */
+static resconn_t     *rconn;
+static bset_t        *sets;
+static bset_t       **freeq;        /* ring of idle sets */
+static int            freehead;
+static int            freecnt;
+static phase_t        phase;
+static int            pending;      /* sets being (un)registered */
+static int            inflight;
+static uint32_t       issued;
+static uint32_t       weight;       /* sum of the mix */
+static uint32_t       reqno;
+static uint32_t       notified;
+static unsigned int   seed = 1;
+static uint64_t       start;
+static uint64_t       end;
+static opstat_t       stats[BENCH_OP_MAX];
+
+
+int bench_parse_mix(const char *str, uint32_t *mix)
+{
+    char        buf[256];
+    char       *p, *e, *v, *end;
+    int         i;
+    unsigned long w;
+
+    memset(mix, 0, sizeof(uint32_t) * BENCH_OP_MAX);
+
+    strncpy(buf, str, sizeof(buf));
+    buf[sizeof(buf)-1] = '\0';
+
+    for (p = buf;  p != NULL;  p = e) {
+        if ((e = strchr(p, ',')) != NULL)
+            *e++ = '\0';
+
+        if ((v = strchr(p, '=')) == NULL)
+            w = 1;
+        else {
+            *v++ = '\0';
+            w = strtoul(v, &end, 10);
+
+            if (end == v || *end || w > 1000)
+                return FALSE;
+        }
+
+        for (i = 0;  i < BENCH_OP_MAX;  i++) {
+            if (i != BENCH_UNREGISTER && !strcmp(p, op_names[i]))
+                break;
+        }
+
+        if (i >= BENCH_OP_MAX)
+            return FALSE;
+
+        mix[i] = w;
+    }
+
+    for (i = 0, w = 0;  i < BENCH_OP_MAX;  i++)
+        w += mix[i];
+
+    return w > 0;
+}
+
+int bench_parse_format(const char *str, bench_format_t *format)
+{
+    if (!strcmp(str, "text"))
+        *format = BENCH_FORMAT_TEXT;
+    else if (!strcmp(str, "csv"))
+        *format = BENCH_FORMAT_CSV;
+    else if (!strcmp(str, "json"))
+        *format = BENCH_FORMAT_JSON;
+    else
+        return FALSE;
+
+    return TRUE;
+}
+
+/*
+ * Registers the sets, runs the operation mix on
+ * them keeping at most 'outstanding' operations in flight, unregisters
+ * the sets and prints the results. Every operation is timed from sending
+ * the request to receiving its status.
+ */
+int bench_run(DBusConnection *dconn, GMainLoop *ml, bench_conf_t *cfg)
+{
+    int i;
+
+    conf = cfg;
+    loop = ml;
+
+    for (i = 0, weight = 0;  i < BENCH_OP_MAX;  i++)
+        weight += conf->mix[i];
+
+    for (i = 0;  i < BENCH_OP_MAX;  i++)
+        reshist_reset(&stats[i].hist);
+
+    sets  = calloc(conf->sets, sizeof(bset_t));
+    freeq = calloc(conf->sets, sizeof(bset_t *));
+
+    if (!sets || !freeq) {
+        fprintf(stderr, "benchmark: out of memory\n");
+        return ENOMEM;
+    }
+
+    rconn = resproto_init(RESPROTO_ROLE_CLIENT, RESPROTO_TRANSPORT_DBUS,
+                          manager_up, dconn);
+
+    if (rconn == NULL) {
+        fprintf(stderr, "benchmark: can't initiate resproto\n");
+        return EIO;
+    }
+
+    resproto_set_handler(rconn, RESMSG_UNREGISTER, notify_cb);
+    resproto_set_handler(rconn, RESMSG_GRANT     , notify_cb);
+    resproto_set_handler(rconn, RESMSG_ADVICE    , notify_cb);
+    resproto_set_handler(rconn, RESMSG_RELEASE   , notify_cb);
+
+    if (!register_sets()) {
+        resproto_destroy(rconn);
+        return EIO;
+    }
+
+    g_main_loop_run(loop);
+
+    if (phase < PHASE_DRAIN) {  /* interrupted */
+        end = time_stat_ns();
+
+        if (!start)
+            start = end;
+    }
+
+    report();
+
+    resproto_destroy(rconn);
+    free(freeq);
+    free(sets);
+
+    for (i = 0;  i < BENCH_OP_MAX;  i++) {
+        if (stats[i].failed)
+            return EIO;
+    }
+
+    return 0;
+}
+
+
+static void manager_up(resconn_t *rc)
+{
+    (void)rc;
+}
+
+static void notify_cb(resmsg_t *msg, resset_t *rset, void *data)
+{
+    (void)msg;
+    (void)rset;
+    (void)data;
+
+    notified++;
+}
+
+static void status_cb(resset_t *rset, resmsg_t *msg)
+{
+    bset_t   *set = rset->userdata;
+    opstat_t *st;
+    uint64_t  now = time_stat_ns();
+    int       failed;
+
+    if (set == NULL || !set->busy)
+        return;
+
+    set->busy = FALSE;
+    failed    = msg->status.errcod != 0;
+
+    switch (phase) {
+
+    case PHASE_SETUP:
+        if (failed) {
+            fprintf(stderr, "benchmark: registering set %u failed (%d): %s\n",
+                    set->id, msg->status.errcod, msg->status.errmsg);
+            rset->userdata = NULL;
+            set->rset = NULL;
+        }
+        else {
+            free_set(set);
+        }
+        if (--pending == 0)
+            start_run();
+        return;
+
+    case PHASE_TEARDOWN:
+        rset->userdata = NULL;
+        set->rset = NULL;
+        if (--pending == 0)
+            g_main_loop_quit(loop);
+        return;
+
+    default:
+        break;
+    }
+
+    st = stats + set->op;
+    st->count++;
+
+    if (failed)
+        st->failed++;
+
+    reshist_add(&st->hist, now - set->sent);
+
+    inflight--;
+
+    if (set->op == BENCH_UNREGISTER && !failed) {
+        rset->userdata = NULL;
+        set->rset = NULL;
+
+        if (set->reregister) {
+            /*
+             * the old set is destroyed only after we return, so
+             * registering the same id must wait until then
+             */
+            set->reregister = FALSE;
+            set->busy = TRUE;
+            inflight++;
+
+            g_idle_add(reregister_cb, set);
+            return;
+        }
+    }
+    else {
+        set->reregister = FALSE;
+        free_set(set);
+    }
+
+    if (phase == PHASE_RUN)
+        kick();
+    else if (phase == PHASE_DRAIN && inflight == 0)
+        teardown();
+}
+
+static gboolean duration_cb(gpointer data)
+{
+    (void)data;
+
+    if (phase == PHASE_RUN)
+        stop_run();
+
+    return FALSE;
+}
+
+static gboolean reregister_cb(gpointer data)
+{
+    bset_t *set = data;
+
+    set->busy = FALSE;
+    inflight--;
+
+    if (phase == PHASE_RUN && send_op(set, BENCH_REGISTER))
+        return FALSE;
+
+    if (phase == PHASE_RUN)
+        kick();
+    else if (phase == PHASE_DRAIN && inflight == 0)
+        teardown();
+
+    return FALSE;
+}
+
+static int register_sets(void)
+{
+    resmsg_t  msg;
+    bset_t   *set;
+    int       i;
+
+    for (i = 0;  i < conf->sets;  i++) {
+        set = sets + i;
+        set->id = conf->id + i;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.record.type  = RESMSG_REGISTER;
+        msg.record.id    = set->id;
+        msg.record.reqno = ++reqno;
+        msg.record.rset.all   = conf->rset.all;
+        msg.record.rset.opt   = conf->rset.opt;
+        msg.record.rset.share = conf->rset.share;
+        msg.record.rset.mask  = conf->rset.mask;
+        msg.record.app_id     = "bench";
+        msg.record.klass      = conf->klass;
+        msg.record.mode       = conf->mode;
+
+        if ((set->rset = resconn_connect(rconn, &msg, status_cb)) == NULL) {
+            fprintf(stderr, "benchmark: failed to register set %u\n",
+                    set->id);
+            return FALSE;
+        }
+
+        set->rset->userdata = set;
+        set->busy = TRUE;
+        set->op   = BENCH_REGISTER;
+        pending++;
+    }
+
+    return TRUE;
+}
+
+static void start_run(void)
+{
+    if (freecnt == 0) {
+        fprintf(stderr, "benchmark: no resource set could be registered\n");
+        g_main_loop_quit(loop);
+        return;
+    }
+
+    phase = PHASE_RUN;
+    start = time_stat_ns();
+
+    if (conf->duration)
+        g_timeout_add(conf->duration * 1000, duration_cb, NULL);
+
+    kick();
+}
+
+static void stop_run(void)
+{
+    end   = time_stat_ns();
+    phase = PHASE_DRAIN;
+
+    if (inflight == 0)
+        teardown();
+}
+
+static void kick(void)
+{
+    bset_t *set;
+
+    while (phase == PHASE_RUN && inflight < conf->outstanding) {
+        if (conf->count && issued >= conf->count) {
+            if (inflight == 0)
+                stop_run();
+            break;
+        }
+
+        if ((set = take_set()) == NULL)
+            break;
+
+        if (!send_op(set, pick_op())) {
+            /* don't spin on a broken connection */
+            stop_run();
+            break;
+        }
+    }
+}
+
+static int send_op(bset_t *set, bench_op_t op)
+{
+    resmsg_t  msg;
+    int       success;
+
+    memset(&msg, 0, sizeof(msg));
+
+    msg.any.id    = set->id;
+    msg.any.reqno = ++reqno;
+
+    set->op   = op;
+    set->busy = TRUE;
+    set->sent = time_stat_ns();
+
+    switch (op) {
+
+    case BENCH_REGISTER:
+        if (set->rset != NULL) {
+            /* a register cycle starts with unregistering the set */
+            set->reregister = TRUE;
+            set->op = op = BENCH_UNREGISTER;
+            msg.possess.type = RESMSG_UNREGISTER;
+            success = resconn_disconnect(set->rset, &msg, status_cb);
+        }
+        else {
+            msg.record.type       = RESMSG_REGISTER;
+            msg.record.rset.all   = conf->rset.all;
+            msg.record.rset.opt   = conf->rset.opt;
+            msg.record.rset.share = conf->rset.share;
+            msg.record.rset.mask  = conf->rset.mask;
+            msg.record.app_id     = "bench";
+            msg.record.klass      = conf->klass;
+            msg.record.mode       = conf->mode;
+
+            set->rset = resconn_connect(rconn, &msg, status_cb);
+
+            if ((success = (set->rset != NULL)))
+                set->rset->userdata = set;
+        }
+        break;
+
+    case BENCH_UPDATE:
+        msg.record.type       = RESMSG_UPDATE;
+        msg.record.rset.all   = conf->rset.all;
+        msg.record.rset.opt   = conf->rset.opt;
+        msg.record.rset.share = conf->rset.share;
+        msg.record.rset.mask  = conf->rset.mask;
+        msg.record.app_id     = "bench";
+        msg.record.klass      = conf->klass;
+        msg.record.mode       = conf->mode;
+        success = resproto_send_message(set->rset, &msg, status_cb);
+        break;
+
+    case BENCH_AUDIO:
+        msg.audio.type   = RESMSG_AUDIO;
+        msg.audio.group  = conf->klass;
+        msg.audio.app_id = "bench";
+        msg.audio.property.name          = "media.name";
+        msg.audio.property.match.method  = resmsg_method_equals;
+        msg.audio.property.match.pattern = "bench";
+        success = resproto_send_message(set->rset, &msg, status_cb);
+        break;
+
+    case BENCH_ACQUIRE:
+        msg.possess.type = RESMSG_ACQUIRE;
+        success = resproto_send_message(set->rset, &msg, status_cb);
+        break;
+
+    case BENCH_RELEASE:
+        msg.possess.type = RESMSG_RELEASE;
+        success = resproto_send_message(set->rset, &msg, status_cb);
+        break;
+
+    default:
+        success = FALSE;
+        break;
+    }
+
+    if (!success) {
+        set->busy = FALSE;
+        stats[op].failed++;
+
+        if (set->rset != NULL)
+            free_set(set);
+
+        return FALSE;
+    }
+
+    inflight++;
+
+    if (op != BENCH_REGISTER)   /* the 2nd half of a cycle is not counted */
+        issued++;
+
+    return TRUE;
+}
+
+static bench_op_t pick_op(void)
+{
+    uint32_t r = rand_r(&seed) % weight;
+    int      i;
+
+    for (i = 0;  i < BENCH_OP_MAX - 1;  i++) {
+        if (r < conf->mix[i])
+            break;
+        r -= conf->mix[i];
+    }
+
+    return i;
+}
+
+static void free_set(bset_t *set)
+{
+    freeq[(freehead + freecnt++) % conf->sets] = set;
+}
+
+static bset_t *take_set(void)
+{
+    bset_t *set;
+
+    if (freecnt == 0)
+        return NULL;
+
+    set = freeq[freehead];
+    freehead = (freehead + 1) % conf->sets;
+    freecnt--;
+
+    return set;
+}
+
+static void teardown(void)
+{
+    resmsg_t  msg;
+    bset_t   *set;
+    int       i;
+
+    phase = PHASE_TEARDOWN;
+
+    for (i = 0;  i < conf->sets;  i++) {
+        set = sets + i;
+
+        if (set->rset == NULL)
+            continue;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.possess.type  = RESMSG_UNREGISTER;
+        msg.possess.id    = set->id;
+        msg.possess.reqno = ++reqno;
+
+        if (resconn_disconnect(set->rset, &msg, status_cb)) {
+            set->busy = TRUE;
+            pending++;
+        }
+    }
+
+    if (pending == 0)
+        g_main_loop_quit(loop);
+}
+
+
+static void report(void)
+{
+    double secs = (double)(end - start) / 1000000000.0;
+
+    switch (conf->format) {
+    case BENCH_FORMAT_CSV:   report_csv(secs);    break;
+    case BENCH_FORMAT_JSON:  report_json(secs);   break;
+    default:                 report_text(secs);   break;
+    }
+}
+
+#define USEC(h, p)  ((double)reshist_percentile(h, p) / 1000.0)
+#define RATE(n, s)  ((s) > 0.0 ? (double)(n) / (s) : 0.0)
+
+static void report_text(double secs)
+{
+    opstat_t *st;
+    uint32_t  total;
+    uint32_t  failed;
+    int       i;
+
+    for (i = 0, total = failed = 0;  i < BENCH_OP_MAX;  i++) {
+        total  += stats[i].count;
+        failed += stats[i].failed;
+    }
+
+    printf("%d sets, %d outstanding: %u operations (%u failed) "
+           "in %.3f s, %.1f ops/s, %u notifications\n",
+           conf->sets, conf->outstanding, total, failed, secs,
+           RATE(total, secs), notified);
+
+    printf("   %-10s %9s %7s %10s %10s %10s %10s %10s\n", "operation",
+           "count", "failed", "ops/s", "p50 usec", "p90 usec", "p99 usec",
+           "max usec");
+
+    for (i = 0;  i < BENCH_OP_MAX;  i++) {
+        st = stats + i;
+
+        if (st->count == 0 && st->failed == 0)
+            continue;
+
+        printf("   %-10s %9u %7u %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+               op_names[i], st->count, st->failed, RATE(st->count, secs),
+               USEC(&st->hist, 50.0), USEC(&st->hist, 90.0),
+               USEC(&st->hist, 99.0), st->hist.max / 1000.0);
+    }
+}
+
+static void report_csv(double secs)
+{
+    opstat_t *st;
+    int       i;
+
+    printf("operation,count,failed,seconds,ops_per_sec,"
+           "p50_usec,p90_usec,p99_usec,max_usec\n");
+
+    for (i = 0;  i < BENCH_OP_MAX;  i++) {
+        st = stats + i;
+
+        if (st->count == 0 && st->failed == 0)
+            continue;
+
+        printf("%s,%u,%u,%.6f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+               op_names[i], st->count, st->failed, secs,
+               RATE(st->count, secs), USEC(&st->hist, 50.0),
+               USEC(&st->hist, 90.0), USEC(&st->hist, 99.0),
+               st->hist.max / 1000.0);
+    }
+}
+
+static void report_json(double secs)
+{
+    opstat_t *st;
+    uint32_t  total;
+    int       i;
+    int       n;
+
+    for (i = 0, total = 0;  i < BENCH_OP_MAX;  i++)
+        total += stats[i].count;
+
+    printf("{\"sets\":%d,\"outstanding\":%d,\"seconds\":%.6f,"
+           "\"operations\":%u,\"ops_per_sec\":%.1f,\"notifications\":%u,"
+           "\"results\":{",
+           conf->sets, conf->outstanding, secs, total, RATE(total, secs),
+           notified);
+
+    for (i = 0, n = 0;  i < BENCH_OP_MAX;  i++) {
+        st = stats + i;
+
+        if (st->count == 0 && st->failed == 0)
+            continue;
+
+        printf("%s\"%s\":{\"count\":%u,\"failed\":%u,\"ops_per_sec\":%.1f,"
+               "\"p50_usec\":%.1f,\"p90_usec\":%.1f,\"p99_usec\":%.1f,"
+               "\"max_usec\":%.1f}",
+               n++ ? "," : "", op_names[i], st->count, st->failed,
+               RATE(st->count, secs), USEC(&st->hist, 50.0),
+               USEC(&st->hist, 90.0), USEC(&st->hist, 99.0),
+               st->hist.max / 1000.0);
+    }
+
+    printf("}}\n");
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,73 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __RESOURCE_CLIENT_BENCH_H__
+#define __RESOURCE_CLIENT_BENCH_H__
+
+#include <stdint.h>
+#include <glib.h>
+
+#include <res-conn.h>
+
+typedef enum {
+    BENCH_REGISTER = 0,         /* in the mix: unregister + register */
+    BENCH_UNREGISTER,
+    BENCH_UPDATE,
+    BENCH_AUDIO,
+    BENCH_ACQUIRE,
+    BENCH_RELEASE,
+    BENCH_OP_MAX
+} bench_op_t;
+
+typedef enum {
+    BENCH_FORMAT_TEXT = 0,
+    BENCH_FORMAT_CSV,
+    BENCH_FORMAT_JSON
+} bench_format_t;
+
+typedef struct {
+    int              sets;          /* number of resource sets */
+    int              outstanding;   /* max. operations in flight */
+    uint32_t         count;         /* stop after this many operations */
+    uint32_t         duration;      /* or after this many seconds */
+    uint32_t         mix[BENCH_OP_MAX];   /* relative weights */
+    bench_format_t   format;
+    uint32_t         id;            /* id of the first set */
+    char            *klass;
+    uint32_t         mode;
+    resmsg_rset_t    rset;
+} bench_conf_t;
+
+int  bench_parse_mix(const char *, uint32_t *);
+int  bench_parse_format(const char *, bench_format_t *);
+int  bench_run(DBusConnection *, GMainLoop *, bench_conf_t *);
+
+#endif /* __RESOURCE_CLIENT_BENCH_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
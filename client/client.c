@@ -37,8 +37,12 @@ USA.
 #include <dbus-gmain/dbus-gmain.h>
 
 #include <res-conn.h>
+#include <res-trace.h>
+#include <res-hist.h>
+#include <res-registry.h>
 
 #include "time-stat.h"
+#include "bench.h"
 
 #define REQHASH_BITS     6
 #define REQHASH_DIM      (1 << REQHASH_BITS)
@@ -56,10 +60,12 @@ typedef struct {
     DBusBusType     bustype;
     int             allow_unknown;
     char           *prefix;
+    int             bench;
+    bench_conf_t    bench_conf;
 } conf_t;
 
 typedef struct {
-    uint32_t        value;
+    uint64_t        value;
     const char     *name;
 } rdef_t;
 
@@ -103,16 +109,20 @@ static void         manager_status(resset_t *, resmsg_t *);
 static void         manager_receive_message(resmsg_t *, resset_t *, void *);
 static void         manager_send_message(resmsg_t *);
 
+static void         dump_trace(int);
+static void         dump_latency(void);
+
 static void         print_error(char *, ...);
 static void         print_message(char *fmt, ...);
 
 static void         usage(int);
 static void         parse_options(int, char **);
 static char        *parse_class_string(char *);
-static uint32_t     parse_resource_list(char *, int);
+static uint64_t     parse_resource_list(char *, int);
 static uint32_t     parse_mode_values(char *, int);
 static char        *parse_prefix(char *, int);
 static DBusBusType  parse_bustype(char *, int);
+static int          parse_number(char *, int, int);
 
 static char            *exe_name = "";
 static conf_t           config;
@@ -130,9 +140,23 @@ static int              active_timer = 0;
 
 int main(int argc, char **argv)
 {
+    int status;
+
     parse_options(argc, argv);
     install_signal_handlers();
 
+    if (config.bench) {
+        create_mainloop();
+        create_dbus();
+
+        status = bench_run(dconn, main_loop, &config.bench_conf);
+
+        destroy_dbus();
+        destroy_mainloop();
+
+        return status;
+    }
+
     create_mainloop();
     create_input();
     create_dbus();
@@ -306,7 +330,7 @@ static void parse_input(void)
     char     *str = input.buf;
     char     *p;
     char     *rs;
-    uint32_t  res[4];
+    uint64_t  res[4];
     char     *audiogr;
     char     *app_id;
     uint32_t  pid;
@@ -328,7 +352,9 @@ static void parse_input(void)
             "   video pid\n"
             "   disconnect\n"
             "   flood count\n"
-            "   stop"
+            "   stop\n"
+            "   dump [count] to list the last protocol events\n"
+            "   latency to show request round trip times"
         );
     }
     else if (!strncmp(str, "acquire", 7)) {
@@ -460,6 +486,28 @@ static void parse_input(void)
             manager_send_message(&msg);
         }
     }
+    else if (!strncmp(str, "dump", 4)) {
+        str = skip_whitespaces(str + 4);
+
+        if (!*str)
+            dump_trace(RESTRACE_RING_SIZE);
+        else {
+            i = strtoul(str, &e, 10);
+
+            if (e == str || (*e && *e != ' ' && *e != '\t') ||
+                i < 1 || i > RESTRACE_RING_SIZE)
+                print_message("invalid count: range is 1-%d",
+                              RESTRACE_RING_SIZE);
+            else
+                dump_trace(i);
+
+            str = skip_whitespaces(e);
+        }
+    }
+    else if (!strncmp(str, "latency", 7)) {
+        str = skip_whitespaces(str + 7);
+        dump_latency();
+    }
     else if (!strncmp(str, "stop", 4)) {
         str = skip_whitespaces(str + 4);
         flood = count = 0;
@@ -564,7 +612,8 @@ static void create_dbus(void)
 
     dbus_gmain_set_up_connection(dconn, NULL);
 
-    print_message("using D-Bus %s bus", busname);
+    if (!config.bench || config.verbose) /* keep the report parseable */
+        print_message("using D-Bus %s bus", busname);
 }
 
 static void destroy_dbus(void)
@@ -813,6 +862,49 @@ static void manager_send_message(resmsg_t *msg)
 
 
 
+static void dump_trace(int count)
+{
+    restrace_event_t *events;
+    struct timespec   ts;
+    uint64_t          now;
+    char              buf[256];
+    int               n;
+    int               i;
+
+    if ((events = malloc(sizeof(restrace_event_t) * count)) == NULL) {
+        print_message("failed to allocate memory for %d events", count);
+        return;
+    }
+
+    n = restrace_snapshot(events, count);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    print_message("last %d protocol events (time relative to now):", n);
+
+    for (i = 0;  i < n;  i++)
+        printf("   %s\n", restrace_event_str(events + i, now, buf, sizeof(buf)));
+
+    free(events);
+}
+
+static void dump_latency(void)
+{
+    reshist_t     hist;
+    resmsg_type_t type;
+    char          buf[256];
+
+    print_message("request round trip times (usec):");
+
+    for (type = 0;  type < RESMSG_MAX;  type++) {
+        if (reshist_get_roundtrip(type, &hist) && hist.count > 0) {
+            printf("   %s\n", reshist_dump(&hist, resmsg_type_str(type),
+                                           buf, sizeof(buf)));
+        }
+    }
+}
+
 static void print_error(char *fmt, ...)
 {
     va_list  ap;
@@ -863,8 +955,13 @@ static void print_message(char *fmt, ...)
 
 static void usage(int exit_code)
 {
+    const char *name;
+    int         bit;
+
     printf("usage: %s [-h] [-t] [-v] [-u] [-d bus-type] [-f mode-values]"
            "[-o optional-resources] [-s shared-resources -m shared-mask] "
+           "[-b [-x operation-mix] [-c sets] [-k outstanding] "
+           "[-n count | -T seconds] [-F format]] "
            "class all-resources\n",
            exe_name);
     printf("\toptions:\n");
@@ -881,6 +978,19 @@ static void usage(int exit_code)
            "syntax of\n\t\t<shared-resources>\n");
     printf("\t  m\tshared resource mask. See 'resources' below for the "
            "syntax of\n\t\t<shared-mask>\n");
+    printf("\t  b\tbenchmark mode. Register a number of resource sets, "
+           "run\n\t\tthe operation mix on them and print the throughput "
+           "and\n\t\tthe latency percentiles of each operation\n");
+    printf("\t  x\toperation mix. Comma separated list of "
+           "<operation>=<weight>\n\t\twhere operation is register, "
+           "update, audio, acquire or\n\t\trelease. Default is "
+           "'acquire=1,release=1'\n");
+    printf("\t  c\tnumber of resource sets (default 1)\n");
+    printf("\t  k\tmaximum number of outstanding operations, "
+           "at most one\n\t\tper resource set (default 1)\n");
+    printf("\t  n\tstop after this many operations (default 1000)\n");
+    printf("\t  T\tstop after this many seconds\n");
+    printf("\t  F\toutput format. Either 'text', 'csv' or 'json'\n");
     printf("\tclass:\n");
     printf("\t\tproclaimer - for always audible announcements\n");
     printf("\t\tnavigator  - for mapping applications\n");
@@ -895,20 +1005,11 @@ static void usage(int exit_code)
     printf("\t\tbackground - for thumbnailing etc\n");
     printf("\tresources:\n");
     printf("\t  comma separated list of the following resources\n");
-    printf("\t\tAudioPlayback\n");
-    printf("\t\tVideoPlayback\n");
-    printf("\t\tAudioRecording\n");
-    printf("\t\tVideoRecording\n");
-    printf("\t\tVibra\n");
-    printf("\t\tLeds\n");
-    printf("\t\tBacklight\n");
-    printf("\t\tSystemButton\n");
-    printf("\t\tLockButton\n");
-    printf("\t\tScaleButton\n");
-    printf("\t\tSnapButton\n");
-    printf("\t\tLensCover\n");
-    printf("\t\tHeadsetButtons\n");
-    printf("\t\tRearFlashlight\n");
+    for (bit = 0;  bit < RESOURCE_MASK_BITS;  bit++) {
+        if ((name = resreg_name(bit)) != NULL)
+            printf("\t\t%s\n", name);
+    }
+    printf("\t\tResource<N> - any resource by its bit number (0-63)\n");
     printf("\t  no whitespace allowed in the resource list.\n");
     printf("\tmodes:\n");
     printf("\t  comma separated list of the following modes\n");
@@ -929,7 +1030,13 @@ static void parse_options(int argc, char **argv)
     config.bustype = DBUS_BUS_SYSTEM;
     config.prefix = NULL;
 
-    while ((option = getopt(argc, argv, "htvud:f:s:o:m:p:")) != -1) {
+    bench_parse_mix("acquire,release", config.bench_conf.mix);
+    config.bench_conf.sets        = 1;
+    config.bench_conf.outstanding = 1;
+    config.bench_conf.format      = BENCH_FORMAT_TEXT;
+
+    while ((option = getopt(argc, argv,
+                             "htvud:f:s:o:m:p:bx:c:k:n:T:F:")) != -1) {
 
         switch (option) {
             
@@ -943,6 +1050,24 @@ static void parse_options(int argc, char **argv)
         case 'm': config.rset.mask     = parse_resource_list(optarg, 1); break;
         case 'u': config.allow_unknown = TRUE;                           break;
         case 'p': config.prefix        = parse_prefix(optarg, 1);        break;
+        case 'b': config.bench         = TRUE;                           break;
+        case 'c': config.bench_conf.sets     = parse_number(optarg,1,1); break;
+        case 'k': config.bench_conf.outstanding = parse_number(optarg,1,1);
+                                                                         break;
+        case 'n': config.bench_conf.count    = parse_number(optarg,1,1); break;
+        case 'T': config.bench_conf.duration = parse_number(optarg,1,1); break;
+        case 'x':
+            if (!bench_parse_mix(optarg, config.bench_conf.mix)) {
+                errno = EINVAL;
+                print_error("invalid operation mix '%s'", optarg);
+            }
+            break;
+        case 'F':
+            if (!bench_parse_format(optarg, &config.bench_conf.format)) {
+                errno = EINVAL;
+                print_error("invalid output format '%s'", optarg);
+            }
+            break;
         default:  usage(EINVAL);                                         break;
         
         }
@@ -966,6 +1091,14 @@ static void parse_options(int argc, char **argv)
     if ((config.rset.mask | config.rset.share) != config.rset.mask) {
         print_error("shared resource values are not subset of shared mask ");
     }
+
+    if (!config.bench_conf.count && !config.bench_conf.duration)
+        config.bench_conf.count = 1000;
+
+    config.bench_conf.id    = config.id;
+    config.bench_conf.klass = config.klass;
+    config.bench_conf.mode  = config.mode;
+    config.bench_conf.rset  = config.rset;
 }
 
 static char *parse_class_string(char *str)
@@ -1010,31 +1143,14 @@ static char * parse_prefix(char *rlist_str, int exit_if_error)
     return buf;
 }
 
-static uint32_t parse_resource_list(char *rlist_str, int exit_if_error)
+static uint64_t parse_resource_list(char *rlist_str, int exit_if_error)
 {
-    static rdef_t  rdef[] = {
-        { RESMSG_AUDIO_PLAYBACK ,  "AudioPlayback"  },
-        { RESMSG_VIDEO_PLAYBACK ,  "VideoPlayback"  },
-        { RESMSG_AUDIO_RECORDING,  "AudioRecording" },
-        { RESMSG_VIDEO_RECORDING,  "VideoRecording" },
-        { RESMSG_VIBRA          ,  "Vibra"          },
-        { RESMSG_LEDS           ,  "Leds"           },
-        { RESMSG_BACKLIGHT      ,  "Backlight"      },
-        { RESMSG_SYSTEM_BUTTON  ,  "SystemButton"   },
-        { RESMSG_LOCK_BUTTON    ,  "LockButton"     },
-        { RESMSG_SCALE_BUTTON   ,  "ScaleButton"    },
-        { RESMSG_SNAP_BUTTON    ,  "SnapButton"     },
-        { RESMSG_LENS_COVER     ,  "LensCover"      },
-        { RESMSG_HEADSET_BUTTONS,  "HeadsetButtons" },
-        { RESMSG_REAR_FLASHLIGHT,  "RearFlashlight" },
-        {           0           ,       NULL        }
-    };
-
-    uint32_t  rlist = 0;
+    uint64_t  rlist = 0;
     char      buf[256];
-    rdef_t   *rd;
     char     *p;
     char     *e;
+    char     *end;
+    int       bit;
 
     if (rlist_str == NULL)
         print_message("missing resource list");
@@ -1048,18 +1164,21 @@ static uint32_t parse_resource_list(char *rlist_str, int exit_if_error)
             if ((e = strchr(p, ',')) != NULL)
                 *e++ = '\0';
 
-            for (rd = rdef;  rd->name != NULL;  rd++) {
-                if (!strcmp(p, rd->name))
-                    break;
+            /* resources without a name are given by their bit number */
+            if ((bit = resreg_bit(p)) < 0 && !strncmp(p, "Resource", 8)) {
+                bit = strtol(p + 8, &end, 10);
+
+                if (end == p + 8 || *end || bit >= RESOURCE_MASK_BITS)
+                    bit = -1;
             }
 
-            if (!rd->value) {
+            if (bit < 0) {
                 print_message("invalid resource list '%s'", rlist_str);
                 rlist = 0;
                 break;
             }
 
-            rlist |= rd->value;
+            rlist |= RESOURCE_BIT(bit);
 
         } while((p = e) != NULL);
     }
@@ -1118,6 +1237,25 @@ static uint32_t parse_mode_values(char *mval_str, int exit_if_error)
     return mode;
 }
 
+static int parse_number(char *str, int min, int exit_if_error)
+{
+    char *e;
+    long  n;
+
+    n = strtol(str, &e, 10);
+
+    if (e == str || *e || n < min || n > 1000000) {
+        print_message("invalid number '%s'", str);
+
+        if (exit_if_error)
+            exit(EINVAL);
+
+        n = min;
+    }
+
+    return (int)n;
+}
+
 static DBusBusType parse_bustype(char *bustype_str, int exit_if_error)
 {
     DBusBusType bustype = DBUS_BUS_SYSTEM;
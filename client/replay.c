@@ -0,0 +1,709 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+
+#include <glib.h>
+#include <dbus/dbus.h>
+#include <dbus-gmain/dbus-gmain.h>
+
+#include <res-conn.h>
+#include <res-hist.h>
+#include <res-record.h>
+
+#define INTERNAL_PREFIX  "replay-"
+
+typedef struct {
+    DBusBusType     bustype;
+    int             internal;
+    int             fast;
+    int             verbose;
+    char           *path;
+} conf_t;
+
+typedef struct {
+    char           *name;       /* peer name in the log */
+    DBusConnection *dcon;       /* own bus connection (D-Bus only) */
+    resconn_t      *rcon;
+} peer_t;
+
+typedef struct {
+    peer_t         *peer;
+    uint32_t        id;
+    resset_t       *rset;
+    int             busy;       /* request sent, status not received */
+    resmsg_type_t   type;       /* of the request being waited for */
+    uint64_t        sent;       /* when it was sent */
+} set_t;
+
+typedef struct {
+    resrecord_t   **steps;      /* records to replay */
+    int             nstep;
+    int             next;       /* index of the next step */
+    uint64_t        first;      /* stamp of the first step */
+    uint64_t        start;      /* when the replay started */
+    uint64_t        end;
+    set_t          *blocked;    /* waiting for the status of this set */
+    int             waiting;    /* number of busy sets */
+    guint           timer;
+} replay_t;
+
+typedef struct {
+    int             sent;
+    int             failed;
+    int             skipped;
+    int             notified;
+    reshist_t       latency[RESMSG_MAX];
+} result_t;
+
+static void         create_replay(void);
+static void         destroy_replay(void);
+static int          replayable(resrecord_t *, int);
+
+static void         create_manager(void);
+static void         manager_handler(resmsg_t *, resset_t *, void *);
+static void        *timer_add(uint32_t, resconn_timercb_t, void *);
+static void         timer_del(void *);
+
+static peer_t      *find_peer(const char *);
+static set_t       *find_set(peer_t *, uint32_t);
+static void         manager_up(resconn_t *);
+static void         client_handler(resmsg_t *, resset_t *, void *);
+static void         status_cb(resset_t *, resmsg_t *);
+
+static gboolean     run_cb(gpointer);
+static void         run(void);
+static void         send_step(set_t *, resmsg_t *);
+static void         finish(void);
+static void         report(void);
+
+static uint64_t     now_ns(void);
+
+static void         print_error(char *, ...);
+static void         print_message(char *, ...);
+static void         usage(int);
+static void         parse_options(int, char **);
+static DBusBusType  parse_bustype(char *);
+
+static char            *exe_name = "";
+static conf_t           config;
+static GMainLoop       *main_loop;
+static resrecord_log_t *record_log;
+static GHashTable      *peers;
+static GHashTable      *sets;
+static resconn_t       *manager;
+static uint32_t         reqno;
+static replay_t         replay;
+static result_t         result;
+
+
+int main(int argc, char **argv)
+{
+    resmsg_type_t type;
+
+    parse_options(argc, argv);
+
+    if ((main_loop = g_main_loop_new(NULL, FALSE)) == NULL)
+        print_error("Can't create G-MainLoop");
+
+    create_replay();
+
+    for (type = 0;  type < RESMSG_MAX;  type++)
+        reshist_reset(&result.latency[type]);
+
+    if (config.internal)
+        create_manager();
+
+    print_message("replaying %d messages %s", replay.nstep,
+                  config.fast ? "as fast as possible" : "at original pace");
+
+    replay.start = now_ns();
+    g_idle_add(run_cb, NULL);
+
+    g_main_loop_run(main_loop);
+
+    report();
+
+    destroy_replay();
+    g_main_loop_unref(main_loop);
+
+    return result.failed ? 1 : 0;
+}
+
+
+static void create_replay(void)
+{
+    resrecord_t *rec;
+    int          from_client;
+    int          size;
+
+    if ((record_log = resrecord_open(config.path)) == NULL)
+        print_error("can't open log '%s'", config.path);
+
+    /*
+     * Use what the clients sent if the log has it. Otherwise the log was
+     * recorded on the manager side: use what the manager received.
+     */
+    for (from_client = FALSE, rec = NULL;
+         (rec = resrecord_next(record_log, rec)) != NULL;  )
+    {
+        if (rec->role == RESPROTO_ROLE_CLIENT && rec->dir == RESRECORD_SEND) {
+            from_client = TRUE;
+            break;
+        }
+    }
+
+    for (size = 0, rec = NULL;  (rec = resrecord_next(record_log, rec)); ) {
+        if (!replayable(rec, from_client))
+            continue;
+
+        if (replay.nstep >= size) {
+            size = size ? size * 2 : 1024;
+            replay.steps = realloc(replay.steps, size * sizeof(rec));
+
+            if (replay.steps == NULL)
+                print_error("out of memory");
+        }
+
+        replay.steps[replay.nstep++] = rec;
+    }
+
+    if (replay.nstep == 0)
+        print_error("nothing to replay in '%s'", config.path);
+
+    replay.first = replay.steps[0]->stamp;
+
+    peers = g_hash_table_new(g_str_hash, g_str_equal);
+    sets  = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static void destroy_replay(void)
+{
+    GHashTableIter  iter;
+    peer_t         *peer;
+
+    g_hash_table_destroy(sets);
+
+    g_hash_table_iter_init(&iter, peers);
+
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&peer)) {
+        resproto_destroy(peer->rcon);
+
+        if (peer->dcon != NULL) {
+            dbus_connection_close(peer->dcon);
+            dbus_connection_unref(peer->dcon);
+        }
+
+        free(peer->name);
+        free(peer);
+    }
+
+    g_hash_table_destroy(peers);
+
+    if (manager != NULL)
+        resproto_destroy(manager);
+
+    free(replay.steps);
+    resrecord_close(record_log);
+}
+
+static int replayable(resrecord_t *rec, int from_client)
+{
+    if (from_client) {
+        if (rec->role != RESPROTO_ROLE_CLIENT || rec->dir != RESRECORD_SEND)
+            return FALSE;
+    }
+    else {
+        if (rec->role != RESPROTO_ROLE_MANAGER || rec->dir != RESRECORD_RECEIVE)
+            return FALSE;
+    }
+
+    switch (rec->type) {
+    case RESMSG_REGISTER:
+    case RESMSG_UNREGISTER:
+    case RESMSG_UPDATE:
+    case RESMSG_ACQUIRE:
+    case RESMSG_RELEASE:
+    case RESMSG_AUDIO:
+    case RESMSG_VIDEO:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+
+/*
+ * With the internal transport there is no one else to talk to, so an
+ * in-process manager grants whatever is acquired.
+ */
+static void create_manager(void)
+{
+    resmsg_type_t type;
+
+    manager = resproto_init(RESPROTO_ROLE_MANAGER, RESPROTO_TRANSPORT_INTERNAL,
+                            timer_add, timer_del);
+
+    if (manager == NULL)
+        print_error("Can't initiate the internal manager");
+
+    for (type = RESMSG_REGISTER;  type <= RESMSG_VIDEO;  type++)
+        resproto_set_handler(manager, type, manager_handler);
+}
+
+static void manager_handler(resmsg_t *msg, resset_t *rset, void *protodata)
+{
+    resmsg_t grant;
+
+    resproto_reply_message(rset, msg, protodata, 0, "OK");
+
+    if (msg->type == RESMSG_ACQUIRE || msg->type == RESMSG_RELEASE) {
+        memset(&grant, 0, sizeof(grant));
+        grant.notify.type  = RESMSG_GRANT;
+        grant.notify.id    = rset->id;
+        grant.notify.reqno = msg->any.reqno;
+        grant.notify.resrc = msg->type == RESMSG_ACQUIRE ? rset->flags.all : 0;
+
+        resproto_send_message(rset, &grant, NULL);
+    }
+}
+
+static void *timer_add(uint32_t delay, resconn_timercb_t cb, void *data)
+{
+    return GUINT_TO_POINTER(g_timeout_add(delay, cb, data));
+}
+
+static void timer_del(void *timer)
+{
+    g_source_remove(GPOINTER_TO_UINT(timer));
+}
+
+
+static peer_t *find_peer(const char *name)
+{
+    peer_t    *peer;
+    DBusError  err;
+    char       buf[64];
+
+    if ((peer = g_hash_table_lookup(peers, name)) != NULL)
+        return peer;
+
+    if ((peer = calloc(1, sizeof(peer_t))) == NULL)
+        print_error("out of memory");
+
+    peer->name = strdup(name);
+
+    if (config.internal) {
+        snprintf(buf, sizeof(buf), INTERNAL_PREFIX "%u",
+                 g_hash_table_size(peers) + 1);
+
+        peer->rcon = resproto_init(RESPROTO_ROLE_CLIENT,
+                                   RESPROTO_TRANSPORT_INTERNAL,
+                                   manager_up, buf, timer_add, timer_del);
+    }
+    else {
+        /* every peer of the log needs a bus name of its own */
+        dbus_error_init(&err);
+
+        if ((peer->dcon = dbus_bus_get_private(config.bustype, &err)) == NULL)
+            print_error("Can't connect to D-Bus: %s", err.message);
+
+        dbus_connection_set_exit_on_disconnect(peer->dcon, FALSE);
+        dbus_gmain_set_up_connection(peer->dcon, NULL);
+
+        peer->rcon = resproto_init(RESPROTO_ROLE_CLIENT,
+                                   RESPROTO_TRANSPORT_DBUS,
+                                   manager_up, peer->dcon);
+    }
+
+    if (peer->rcon == NULL)
+        print_error("Can't initiate resproto for peer '%s'", name);
+
+    resproto_set_handler(peer->rcon, RESMSG_UNREGISTER, client_handler);
+    resproto_set_handler(peer->rcon, RESMSG_GRANT     , client_handler);
+    resproto_set_handler(peer->rcon, RESMSG_ADVICE    , client_handler);
+    resproto_set_handler(peer->rcon, RESMSG_RELEASE   , client_handler);
+
+    g_hash_table_insert(peers, peer->name, peer);
+
+    if (config.verbose)
+        print_message("peer '%s' created", name);
+
+    return peer;
+}
+
+static set_t *find_set(peer_t *peer, uint32_t id)
+{
+    set_t *set;
+    char  *key;
+
+    key = g_strdup_printf("%s/%u", peer->name, id);
+
+    if ((set = g_hash_table_lookup(sets, key)) != NULL)
+        g_free(key);
+    else {
+        set = g_new0(set_t, 1);
+        set->peer = peer;
+        set->id   = id;
+
+        g_hash_table_insert(sets, key, set);
+    }
+
+    return set;
+}
+
+static void manager_up(resconn_t *rcon)
+{
+    (void)rcon;
+
+    if (config.verbose)
+        print_message("manager is up");
+}
+
+static void client_handler(resmsg_t *msg, resset_t *rset, void *data)
+{
+    resmsg_t reply;
+
+    (void)data;
+
+    result.notified++;
+
+    /* the manager asks us to release: do it like a well behaving client */
+    if (msg->type == RESMSG_RELEASE) {
+        memset(&reply, 0, sizeof(reply));
+        reply.possess.type  = RESMSG_RELEASE;
+        reply.possess.reqno = ++reqno;
+
+        resproto_send_message(rset, &reply, NULL);
+    }
+}
+
+static void status_cb(resset_t *rset, resmsg_t *msg)
+{
+    set_t    *set = rset->userdata;
+    uint64_t  elapsed;
+
+    if (set == NULL || !set->busy)
+        return;
+
+    elapsed = now_ns() - set->sent;
+
+    reshist_add(&result.latency[set->type], elapsed);
+
+    if (msg->status.errcod) {
+        result.failed++;
+
+        if (config.verbose) {
+            print_message("%s of set %u of '%s' failed (%d): %s",
+                          resmsg_type_str(set->type), set->id,
+                          set->peer->name, msg->status.errcod,
+                          msg->status.errmsg ? msg->status.errmsg : "");
+        }
+    }
+
+    if (set->type == RESMSG_UNREGISTER) {
+        rset->userdata = NULL;
+        set->rset = NULL;
+    }
+
+    set->busy = FALSE;
+    replay.waiting--;
+
+    if (replay.blocked == set) {
+        replay.blocked = NULL;
+        g_idle_add(run_cb, NULL);
+    }
+    else if (replay.next >= replay.nstep && replay.waiting == 0)
+        finish();
+}
+
+
+static gboolean run_cb(gpointer data)
+{
+    (void)data;
+
+    replay.timer = 0;
+
+    run();
+
+    return FALSE;
+}
+
+/*
+ * Sends the steps that are due. Steps of a resource set are sent in
+ * order, each only after the status of the previous one has arrived.
+ * A set still waiting for its status blocks the whole replay until then,
+ * so the order of the log is kept across the sets as well.
+ */
+static void run(void)
+{
+    resrecord_t *rec;
+    set_t       *set;
+    uint64_t     due;
+    uint64_t     now;
+    const char  *name;
+    resmsg_t     msg;
+
+    while (replay.next < replay.nstep) {
+        rec = replay.steps[replay.next];
+
+        if (!config.fast) {
+            due = replay.start + (rec->stamp - replay.first);
+            now = now_ns();
+
+            if (due > now) {
+                replay.timer = g_timeout_add((due - now) / 1000000ULL,
+                                             run_cb, NULL);
+                return;
+            }
+        }
+
+        if ((name = resrecord_decode(rec, &msg)) == NULL) {
+            result.skipped++;
+            replay.next++;
+            continue;
+        }
+
+        set = find_set(find_peer(name), rec->id);
+
+        if (set->busy) {
+            replay.blocked = set;
+            return;
+        }
+
+        send_step(set, &msg);
+
+        replay.next++;
+    }
+
+    if (replay.waiting == 0)
+        finish();
+}
+
+static void send_step(set_t *set, resmsg_t *msg)
+{
+    int success;
+
+    msg->any.reqno = ++reqno;
+
+    switch (msg->type) {
+
+    case RESMSG_REGISTER:
+        if (set->rset != NULL)
+            success = FALSE;
+        else {
+            set->rset = resconn_connect(set->peer->rcon, msg, status_cb);
+            success = (set->rset != NULL);
+
+            if (success)
+                set->rset->userdata = set;
+        }
+        break;
+
+    case RESMSG_UNREGISTER:
+        if (set->rset == NULL)
+            success = FALSE;
+        else
+            success = resconn_disconnect(set->rset, msg, status_cb);
+        break;
+
+    default:
+        if (set->rset == NULL)
+            success = FALSE;
+        else
+            success = resproto_send_message(set->rset, msg, status_cb);
+        break;
+    }
+
+    if (!success) {
+        if (set->rset == NULL && msg->type != RESMSG_REGISTER)
+            result.skipped++;   /* registered before the log started */
+        else
+            result.failed++;
+
+        if (config.verbose) {
+            print_message("failed to send %s of set %u of '%s'",
+                          resmsg_type_str(msg->type), set->id,
+                          set->peer->name);
+        }
+    }
+    else {
+        result.sent++;
+
+        set->busy = TRUE;
+        set->type = msg->type;
+        set->sent = now_ns();
+
+        replay.waiting++;
+    }
+}
+
+static void finish(void)
+{
+    replay.end = now_ns();
+
+    g_main_loop_quit(main_loop);
+}
+
+static void report(void)
+{
+    double         secs;
+    resmsg_type_t  type;
+    char           buf[256];
+
+    secs = (double)(replay.end - replay.start) / 1000000000.0;
+
+    print_message("%d messages sent, %d failed, %d skipped, "
+                  "%d notifications received",
+                  result.sent, result.failed, result.skipped,
+                  result.notified);
+
+    print_message("%.3f seconds, %.1f messages/s", secs,
+                  secs > 0.0 ? result.sent / secs : 0.0);
+
+    print_message("request round trip times (usec):");
+
+    for (type = 0;  type < RESMSG_MAX;  type++) {
+        if (result.latency[type].count > 0) {
+            printf("   %s\n", reshist_dump(&result.latency[type],
+                                           resmsg_type_str(type),
+                                           buf, sizeof(buf)));
+        }
+    }
+}
+
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void print_error(char *fmt, ...)
+{
+    va_list  ap;
+    char     fmtbuf[512];
+
+    snprintf(fmtbuf, sizeof(fmtbuf), "%s: %s\n", exe_name, fmt);
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmtbuf, ap);
+    va_end(ap);
+
+    exit(errno ? errno : EINVAL);
+}
+
+static void print_message(char *fmt, ...)
+{
+    va_list  ap;
+    char     fmtbuf[512];
+
+    if (config.verbose)
+        snprintf(fmtbuf, sizeof(fmtbuf), "%s: %s\n", exe_name, fmt);
+    else
+        snprintf(fmtbuf, sizeof(fmtbuf), "%s\n", fmt);
+
+    va_start(ap, fmt);
+    vprintf(fmtbuf, ap);
+    va_end(ap);
+}
+
+static void usage(int exit_code)
+{
+    printf("usage: %s [-h] [-v] [-f] [-i | -d bus-type] log-file\n",
+           exe_name);
+    printf("\toptions:\n");
+    printf("\t  h\tprint this help message and exit\n");
+    printf("\t  v\tverbose printouts\n");
+    printf("\t  f\treplay as fast as possible instead of the original "
+           "pace\n");
+    printf("\t  i\treplay over the internal transport against a built-in "
+           "manager\n\t\tthat grants everything\n");
+    printf("\t  d\tbus-type. Either 'system' or 'session'\n");
+    printf("\tlog-file:\n");
+    printf("\t  recorded by running a client or the manager with "
+           "LIBRESOURCE_RECORD=<log-file>\n");
+
+    exit(exit_code);
+}
+
+static void parse_options(int argc, char **argv)
+{
+    int option;
+
+    exe_name = strdup(basename(argv[0]));
+
+    config.bustype = DBUS_BUS_SYSTEM;
+
+    while ((option = getopt(argc, argv, "hvfid:")) != -1) {
+
+        switch (option) {
+
+        case 'h': usage(0);                                   break;
+        case 'v': config.verbose  = TRUE;                     break;
+        case 'f': config.fast     = TRUE;                     break;
+        case 'i': config.internal = TRUE;                     break;
+        case 'd': config.bustype  = parse_bustype(optarg);    break;
+        default:  usage(EINVAL);                              break;
+
+        }
+    }
+
+    if (optind != argc - 1)
+        usage(EINVAL);
+
+    config.path = argv[optind];
+}
+
+static DBusBusType parse_bustype(char *bustype_str)
+{
+    DBusBusType bustype = DBUS_BUS_SYSTEM;
+
+    if (!strcmp(bustype_str, "session"))
+        bustype = DBUS_BUS_SESSION;
+    else if (strcmp(bustype_str, "system")) {
+        print_message("invalid D-Bus type '%s'", bustype_str);
+        exit(EINVAL);
+    }
+
+    return bustype;
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -6,7 +6,7 @@ static struct timespec start_time;
 int start_timer(void)
 {
     int r;
-    r = clock_gettime(CLOCK_REALTIME, &start_time);
+    r = clock_gettime(CLOCK_MONOTONIC, &start_time);
 
     if (r == 0)
         return 1;
@@ -20,7 +20,7 @@ long int stop_timer(void)
     int r;
     double milliseconds = 0.0;
 
-    r = clock_gettime(CLOCK_REALTIME, &end_time);
+    r = clock_gettime(CLOCK_MONOTONIC, &end_time);
 
     if (r == 0) {
         milliseconds = 1000.0 * (end_time.tv_sec - start_time.tv_sec) +
@@ -32,3 +32,11 @@ long int stop_timer(void)
     return lround(milliseconds);
 }
 
+uint64_t time_stat_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
@@ -1,6 +1,7 @@
 #ifndef TIME_STAT_H
 #define TIME_STAT_H
 #include <time.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -8,6 +9,8 @@ extern "C" {
 int start_timer(void);
 
 long int stop_timer(void);
+
+uint64_t time_stat_ns(void);
 #ifdef __cplusplus
 }
 #endif
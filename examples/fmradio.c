@@ -35,8 +35,8 @@ static void create_mainloop (void);
 static void destroy_mainloop (void);
 static void run_mainloop (void);
 
-static void grant_callback (resource_set_t *, uint32_t, void *);
-static void advice_callback (resource_set_t *, uint32_t, void *);
+static void grant_callback (resource_set_t *, uint64_t, void *);
+static void advice_callback (resource_set_t *, uint64_t, void *);
 
 static void schedule_destruction (resource_set_t *, guint);
 static gboolean destructor (void *);
@@ -83,7 +83,7 @@ static void run_mainloop (void)
 }
 
 static void grant_callback (resource_set_t *resource_set,
-                            uint32_t        resources,
+                            uint64_t        resources,
                             void           *userdata)
 {
     char buf[512];
@@ -96,7 +96,7 @@ static void grant_callback (resource_set_t *resource_set,
 }
 
 static void advice_callback (resource_set_t *resource_set,
-                             uint32_t        resources,
+                             uint64_t        resources,
                              void           *userdata)
 {
     char buf[512];
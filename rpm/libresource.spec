@@ -9,7 +9,7 @@ Source0:    %{name}-%{version}.tar.gz
 Requires(post): /sbin/ldconfig
 Requires(postun): /sbin/ldconfig
 BuildRequires:  pkgconfig(glib-2.0) >= 2.40
-BuildRequires:  pkgconfig(dbus-1) >= 1.8
+BuildRequires:  pkgconfig(dbus-1) >= 1.11.16
 BuildRequires:  pkgconfig(check)
 
 %description
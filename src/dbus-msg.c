@@ -26,6 +26,28 @@ USA.
 #include "res-msg.h"
 #include "dbus-msg.h"
 
+/*
+ * Resource masks are sent as UINT32 whenever they fit, which is all
+ * that peers predating 64-bit masks can parse, and as UINT64 otherwise.
+ * All masks of a message have the same width. Register requests and
+ * status replies carry the capabilities of the sender, grants and
+ * advices their sequence number as an extra trailing argument that
+ * older peers do not look at. So do the further properties of an audio
+ * message, as an array of (name, method, pattern) structures; the
+ * array lives as long as the D-Bus message, like the strings do.
+ */
+#define CAPS_ARG_REGISTER   10  /* index of the capabilities in register */
+#define CAPS_ARG_STATUS     5   /* index of the capabilities in a status */
+#define SEQNO_ARG_NOTIFY    4   /* index of the sequence in grant/advice */
+#define EXTRA_ARG_AUDIO     8   /* index of the further audio properties */
+
+static int   mask_type(uint64_t);
+static int   mask_arg_type(DBusMessage *, int);
+static dbus_uint32_t uint32_arg(DBusMessage *, int);
+static void *mask_ptr(int, uint64_t *, dbus_uint32_t *);
+static int   append_extra(DBusMessage *, resmsg_audio_t *);
+static int   parse_extra(DBusMessage *, resmsg_audio_t *);
+
 DBusMessage *resmsg_dbus_compose_message(const char *dest,
                                          const char *path,
                                          const char *interface,
@@ -41,6 +63,10 @@ DBusMessage *resmsg_dbus_compose_message(const char *dest,
     resmsg_audio_t    *audio;
     resmsg_video_t    *video;
     resmsg_property_t *property;
+    resmsg_rset_t     *rset;
+    dbus_uint32_t      narrow[4];
+    dbus_uint32_t      caps = RESMSG_CAP_ALL;
+    int                mtype;
     int                success;
 
     if (!dest || !path || !interface || !method || !resmsg)
@@ -60,20 +86,32 @@ DBusMessage *resmsg_dbus_compose_message(const char *dest,
     case RESMSG_REGISTER:
     case RESMSG_UPDATE:
         record  = &resmsg->record;
+        rset    = &record->rset;
+        mtype   = mask_type(rset->all | rset->opt | rset->share | rset->mask);
+        narrow[0] = rset->all;
+        narrow[1] = rset->opt;
+        narrow[2] = rset->share;
+        narrow[3] = rset->mask;
         success = dbus_message_append_args(dbusmsg,
                                  DBUS_TYPE_INT32 , &record->type,
                                  DBUS_TYPE_UINT32, &record->id,
                                  DBUS_TYPE_UINT32, &record->reqno,
-                                 DBUS_TYPE_UINT32, &record->rset.all,
-                                 DBUS_TYPE_UINT32, &record->rset.opt,
-                                 DBUS_TYPE_UINT32, &record->rset.share,
-                                 DBUS_TYPE_UINT32, &record->rset.mask,
+                                 mtype, mask_ptr(mtype, &rset->all  , narrow+0),
+                                 mtype, mask_ptr(mtype, &rset->opt  , narrow+1),
+                                 mtype, mask_ptr(mtype, &rset->share, narrow+2),
+                                 mtype, mask_ptr(mtype, &rset->mask , narrow+3),
                                  DBUS_TYPE_STRING,  record->app_id ?
                                                    &record->app_id : &empty_str,
                                  DBUS_TYPE_STRING,  record->klass ?
                                                    &record->klass : &empty_str,
                                  DBUS_TYPE_UINT32, &record->mode,
                                  DBUS_TYPE_INVALID);
+
+        if (success && record->type == RESMSG_REGISTER) {
+            success = dbus_message_append_args(dbusmsg,
+                                               DBUS_TYPE_UINT32, &caps,
+                                               DBUS_TYPE_INVALID);
+        }
         break;
 
     case RESMSG_UNREGISTER:
@@ -89,13 +127,16 @@ DBusMessage *resmsg_dbus_compose_message(const char *dest,
 
     case RESMSG_GRANT:
     case RESMSG_ADVICE:
-        notify  = &resmsg->notify;
+        notify    = &resmsg->notify;
+        mtype     = mask_type(notify->resrc);
+        narrow[0] = notify->resrc;
         success = dbus_message_append_args(dbusmsg,
-                                           DBUS_TYPE_INT32 , &notify->type,
-                                           DBUS_TYPE_UINT32, &notify->id,
-                                           DBUS_TYPE_UINT32, &notify->reqno,
-                                           DBUS_TYPE_UINT32, &notify->resrc,
-                                           DBUS_TYPE_INVALID);
+                        DBUS_TYPE_INT32 , &notify->type,
+                        DBUS_TYPE_UINT32, &notify->id,
+                        DBUS_TYPE_UINT32, &notify->reqno,
+                        mtype, mask_ptr(mtype, &notify->resrc, narrow),
+                        DBUS_TYPE_UINT32, &notify->seqno,
+                        DBUS_TYPE_INVALID);
         break;
 
     case RESMSG_AUDIO:
@@ -115,6 +156,9 @@ DBusMessage *resmsg_dbus_compose_message(const char *dest,
                        DBUS_TYPE_STRING,  property->match.pattern ?
                                          &property->match.pattern : &empty_str,
                        DBUS_TYPE_INVALID);
+
+        if (success && audio->nextra > 0)
+            success = append_extra(dbusmsg, audio);
         break;
 
     case RESMSG_VIDEO:
@@ -146,6 +190,7 @@ DBusMessage *resmsg_dbus_reply_message(DBusMessage *dbusmsg,resmsg_t *resreply)
 
     DBusMessage       *dbusreply;
     resmsg_status_t   *status;
+    dbus_uint32_t      caps = RESMSG_CAP_ALL;
     int                success;
 
     if (!dbusmsg || !resreply || resreply->type != RESMSG_STATUS)
@@ -153,7 +198,10 @@ DBusMessage *resmsg_dbus_reply_message(DBusMessage *dbusmsg,resmsg_t *resreply)
     
 
     status    = &resreply->status;
-    dbusreply = dbus_message_new_method_return(dbusmsg);
+
+    if ((dbusreply = dbus_message_new_method_return(dbusmsg)) == NULL)
+        return NULL;
+
     success   = dbus_message_append_args(dbusreply,
                                          DBUS_TYPE_INT32 , &status->type,
                                          DBUS_TYPE_UINT32, &status->id,
@@ -161,6 +209,7 @@ DBusMessage *resmsg_dbus_reply_message(DBusMessage *dbusmsg,resmsg_t *resreply)
                                          DBUS_TYPE_INT32 , &status->errcod,
                                          DBUS_TYPE_STRING,  status->errmsg ?
                                                  &status->errmsg : &empty_str,
+                                         DBUS_TYPE_UINT32, &caps,
                                          DBUS_TYPE_INVALID);
     if (!success) {
         dbus_message_unref(dbusreply);
@@ -181,6 +230,9 @@ resmsg_t *resmsg_dbus_parse_message(DBusMessage *dbusmsg, resmsg_t *resmsg)
     resmsg_status_t   *status;
     resmsg_property_t *property;
     resmsg_match_t    *match;
+    resmsg_rset_t     *rset;
+    dbus_uint32_t      narrow[4];
+    int                mtype;
     int                free_resmsg;
     int                success;
     
@@ -228,18 +280,27 @@ resmsg_t *resmsg_dbus_parse_message(DBusMessage *dbusmsg, resmsg_t *resmsg)
     case RESMSG_REGISTER:
     case RESMSG_UPDATE:
         record  = &resmsg->record;
+        rset    = &record->rset;
+        mtype   = mask_arg_type(dbusmsg, 3);
         success = dbus_message_get_args(dbusmsg, NULL,
-                                        DBUS_TYPE_INT32 , &record->type,
-                                        DBUS_TYPE_UINT32, &record->id,
-                                        DBUS_TYPE_UINT32, &record->reqno,
-                                        DBUS_TYPE_UINT32, &record->rset.all,
-                                        DBUS_TYPE_UINT32, &record->rset.opt,
-                                        DBUS_TYPE_UINT32, &record->rset.share,
-                                        DBUS_TYPE_UINT32, &record->rset.mask,
-                                        DBUS_TYPE_STRING, &record->app_id,
-                                        DBUS_TYPE_STRING, &record->klass,
-                                        DBUS_TYPE_UINT32, &record->mode,
-                                        DBUS_TYPE_INVALID);
+                                 DBUS_TYPE_INT32 , &record->type,
+                                 DBUS_TYPE_UINT32, &record->id,
+                                 DBUS_TYPE_UINT32, &record->reqno,
+                                 mtype, mask_ptr(mtype, &rset->all  , narrow+0),
+                                 mtype, mask_ptr(mtype, &rset->opt  , narrow+1),
+                                 mtype, mask_ptr(mtype, &rset->share, narrow+2),
+                                 mtype, mask_ptr(mtype, &rset->mask , narrow+3),
+                                 DBUS_TYPE_STRING, &record->app_id,
+                                 DBUS_TYPE_STRING, &record->klass,
+                                 DBUS_TYPE_UINT32, &record->mode,
+                                 DBUS_TYPE_INVALID);
+
+        if (success && mtype == DBUS_TYPE_UINT32) {
+            rset->all   = narrow[0];
+            rset->opt   = narrow[1];
+            rset->share = narrow[2];
+            rset->mask  = narrow[3];
+        }
         break;
 
     case RESMSG_UNREGISTER:
@@ -257,12 +318,18 @@ resmsg_t *resmsg_dbus_parse_message(DBusMessage *dbusmsg, resmsg_t *resmsg)
     case RESMSG_GRANT:
     case RESMSG_ADVICE:
         notify  = &resmsg->notify;
+        mtype   = mask_arg_type(dbusmsg, 3);
         success = dbus_message_get_args(dbusmsg, NULL,
-                                        DBUS_TYPE_INT32 , &notify->type,
-                                        DBUS_TYPE_UINT32, &notify->id,
-                                        DBUS_TYPE_UINT32, &notify->reqno,
-                                        DBUS_TYPE_UINT32, &notify->resrc,
-                                        DBUS_TYPE_INVALID);
+                        DBUS_TYPE_INT32 , &notify->type,
+                        DBUS_TYPE_UINT32, &notify->id,
+                        DBUS_TYPE_UINT32, &notify->reqno,
+                        mtype, mask_ptr(mtype, &notify->resrc, narrow),
+                        DBUS_TYPE_INVALID);
+
+        if (success && mtype == DBUS_TYPE_UINT32)
+            notify->resrc = narrow[0];
+
+        notify->seqno = uint32_arg(dbusmsg, SEQNO_ARG_NOTIFY);
         break;
 
     case RESMSG_AUDIO:
@@ -279,6 +346,9 @@ resmsg_t *resmsg_dbus_parse_message(DBusMessage *dbusmsg, resmsg_t *resmsg)
                                         DBUS_TYPE_INT32 , &match->method,
                                         DBUS_TYPE_STRING, &match->pattern,
                                         DBUS_TYPE_INVALID);
+
+        if (success)
+            success = parse_extra(dbusmsg, audio);
         break;
 
     case RESMSG_VIDEO:
@@ -317,8 +387,217 @@ resmsg_t *resmsg_dbus_parse_message(DBusMessage *dbusmsg, resmsg_t *resmsg)
     return NULL;
 }
 
+uint32_t resmsg_dbus_parse_caps(DBusMessage *dbusmsg)
+{
+    DBusMessageIter  iter;
+    dbus_int32_t     type;
+
+    if (dbusmsg == NULL || !dbus_message_iter_init(dbusmsg, &iter) ||
+        dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_INT32)
+        return 0;
+
+    dbus_message_iter_get_basic(&iter, &type);
+
+    switch (type) {
+    case RESMSG_STATUS:    return uint32_arg(dbusmsg, CAPS_ARG_STATUS);
+    case RESMSG_REGISTER:  return uint32_arg(dbusmsg, CAPS_ARG_REGISTER);
+    default:               return 0;
+    }
+}
+
+int resmsg_dbus_is_wide(resmsg_t *resmsg)
+{
+    resmsg_rset_t *rset;
+
+    switch (resmsg->type) {
+
+    case RESMSG_REGISTER:
+    case RESMSG_UPDATE:
+        rset = &resmsg->record.rset;
+        return mask_type(rset->all | rset->opt | rset->share | rset->mask) ==
+               DBUS_TYPE_UINT64;
+
+    case RESMSG_GRANT:
+    case RESMSG_ADVICE:
+        return mask_type(resmsg->notify.resrc) == DBUS_TYPE_UINT64;
+
+    default:
+        return FALSE;
+    }
+}
+
+
+static int mask_type(uint64_t masks)
+{
+    return (masks >> RESOURCE_NARROW_BITS) ? DBUS_TYPE_UINT64 :
+                                             DBUS_TYPE_UINT32;
+}
+
+static int mask_arg_type(DBusMessage *dbusmsg, int idx)
+{
+    DBusMessageIter iter;
+
+    if (!dbus_message_iter_init(dbusmsg, &iter))
+        return DBUS_TYPE_UINT32;
+
+    while (idx-- > 0) {
+        if (!dbus_message_iter_next(&iter))
+            return DBUS_TYPE_UINT32;
+    }
+
+    /* anything else makes the parsing fail as it always did */
+    if (dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_UINT64)
+        return DBUS_TYPE_UINT64;
+
+    return DBUS_TYPE_UINT32;
+}
+
+/* an optional trailing argument, 0 if it is not there */
+static dbus_uint32_t uint32_arg(DBusMessage *dbusmsg, int idx)
+{
+    DBusMessageIter iter;
+    dbus_uint32_t   value;
+
+    if (!dbus_message_iter_init(dbusmsg, &iter))
+        return 0;
 
+    while (idx-- > 0) {
+        if (!dbus_message_iter_next(&iter))
+            return 0;
+    }
 
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_UINT32)
+        return 0;
+
+    dbus_message_iter_get_basic(&iter, &value);
+
+    return value;
+}
+
+static void *mask_ptr(int type, uint64_t *wide, dbus_uint32_t *narrow)
+{
+    return type == DBUS_TYPE_UINT64 ? (void *)wide : (void *)narrow;
+}
+
+static int append_extra(DBusMessage *dbusmsg, resmsg_audio_t *audio)
+{
+    static char       *empty_str = "";
+
+    DBusMessageIter    iter;
+    DBusMessageIter    array;
+    DBusMessageIter    prop = DBUS_MESSAGE_ITER_INIT_CLOSED;
+    resmsg_property_t *extra;
+    dbus_int32_t       method;
+    char             **name;
+    char             **pattern;
+    uint32_t           i;
+
+    if (audio->nextra > RESMSG_AUDIO_EXTRA_MAX || audio->extra == NULL)
+        return FALSE;
+
+    dbus_message_iter_init_append(dbusmsg, &iter);
+
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+                                          "(sis)", &array))
+        return FALSE;
+
+    for (i = 0;  i < audio->nextra;  i++) {
+        extra   = audio->extra + i;
+        name    = extra->name ? &extra->name : &empty_str;
+        pattern = extra->match.pattern ? &extra->match.pattern : &empty_str;
+        method  = extra->match.method;
+
+        if (!dbus_message_iter_open_container(&array, DBUS_TYPE_STRUCT,
+                                              NULL, &prop)                 ||
+            !dbus_message_iter_append_basic(&prop, DBUS_TYPE_STRING, name) ||
+            !dbus_message_iter_append_basic(&prop, DBUS_TYPE_INT32,&method)||
+            !dbus_message_iter_append_basic(&prop,DBUS_TYPE_STRING,pattern)||
+            !dbus_message_iter_close_container(&array, &prop)                )
+        {
+            dbus_message_iter_abandon_container_if_open(&array, &prop);
+            dbus_message_iter_abandon_container(&iter, &array);
+            return FALSE;
+        }
+    }
+
+    return dbus_message_iter_close_container(&iter, &array);
+}
+
+static int parse_extra(DBusMessage *dbusmsg, resmsg_audio_t *audio)
+{
+    static dbus_int32_t  slot = -1;
+
+    DBusMessageIter      iter;
+    DBusMessageIter      array;
+    DBusMessageIter      prop;
+    resmsg_property_t    buf[RESMSG_AUDIO_EXTRA_MAX];
+    resmsg_property_t   *extra;
+    dbus_int32_t         method;
+    uint32_t             n;
+    int                  i;
+
+    audio->nextra = 0;
+    audio->extra  = NULL;
+
+    if (!dbus_message_iter_init(dbusmsg, &iter))
+        return TRUE;
+
+    for (i = 0;  i < EXTRA_ARG_AUDIO;  i++) {
+        if (!dbus_message_iter_next(&iter))
+            return TRUE;
+    }
+
+    /* not there, or something of a later version */
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY ||
+        dbus_message_iter_get_element_type(&iter) != DBUS_TYPE_STRUCT)
+        return TRUE;
+
+    dbus_message_iter_recurse(&iter, &array);
+
+    for (n = 0;  dbus_message_iter_get_arg_type(&array) != DBUS_TYPE_INVALID;
+         n++, dbus_message_iter_next(&array))
+    {
+        if (n >= RESMSG_AUDIO_EXTRA_MAX)
+            return FALSE;
+
+        dbus_message_iter_recurse(&array, &prop);
+
+        if (dbus_message_iter_get_arg_type(&prop) != DBUS_TYPE_STRING)
+            return FALSE;
+        dbus_message_iter_get_basic(&prop, &buf[n].name);
+        dbus_message_iter_next(&prop);
+
+        if (dbus_message_iter_get_arg_type(&prop) != DBUS_TYPE_INT32)
+            return FALSE;
+        dbus_message_iter_get_basic(&prop, &method);
+        dbus_message_iter_next(&prop);
+
+        if (dbus_message_iter_get_arg_type(&prop) != DBUS_TYPE_STRING)
+            return FALSE;
+        dbus_message_iter_get_basic(&prop, &buf[n].match.pattern);
+
+        buf[n].match.method = method;
+    }
+
+    if (n == 0)
+        return TRUE;
+
+    if ((slot < 0 && !dbus_message_allocate_data_slot(&slot)) ||
+        (extra = malloc(n * sizeof(resmsg_property_t))) == NULL)
+        return FALSE;
+
+    memcpy(extra, buf, n * sizeof(resmsg_property_t));
+
+    if (!dbus_message_set_data(dbusmsg, slot, extra, free)) {
+        free(extra);
+        return FALSE;
+    }
+
+    audio->nextra = n;
+    audio->extra  = extra;
+
+    return TRUE;
+}
 
 
 /* 
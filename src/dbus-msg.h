@@ -33,6 +33,8 @@ DBusMessage    *resmsg_dbus_compose_message(const char *, const char *,
 					    union resmsg_u *);
 DBusMessage    *resmsg_dbus_reply_message(DBusMessage *, union resmsg_u *);
 union resmsg_u *resmsg_dbus_parse_message(DBusMessage *, union resmsg_u *);
+uint32_t        resmsg_dbus_parse_caps(DBusMessage *);
+int             resmsg_dbus_is_wide(union resmsg_u *);
 
 #endif /* __RES_DBUS_MESSAGE_H__ */
 
@@ -27,10 +27,24 @@ USA.
 
 #include "res-conn-private.h"
 #include "res-set-private.h"
+#include "res-trace-private.h"
+#include "res-record-private.h"
+#include "res-probe.h"
+#include "res-hist.h"
 #include "dbus-proto.h"
 #include "dbus-msg.h"
 
 
+#define RESPROTO_DBUS_NAME_HAS_OWNER_METHOD  "NameHasOwner"
+
+/*
+ * a pending NameHasOwner query about a newly seen client
+ */
+typedef struct {
+    DBusConnection  *conn;      /* the connection the query was sent on */
+    char            *name;      /* unique D-Bus name of the client */
+} client_check_t;
+
 /* 
  * local function prototypes
  */
@@ -45,6 +59,9 @@ static resconn_t *find_resproto(DBusConnection *);
 
 static int watch_manager(resconn_dbus_t *, int);
 static int watch_client(resconn_dbus_t *, const char *, int);
+static int check_client(resconn_dbus_t *, const char *);
+static void client_checked(DBusPendingCall *, void *);
+static void client_check_free(void *);
 static int remove_filter(resconn_dbus_t *, char *);
 static int add_filter(resconn_dbus_t *, char *);
 static int request_name(resconn_dbus_t *, char *);
@@ -58,8 +75,16 @@ static DBusHandlerResult manager_name_changed(DBusConnection *,
                                               DBusMessage *, void *);
 static DBusHandlerResult manager_method(DBusConnection *,DBusMessage *,void *);
 static DBusHandlerResult client_method(DBusConnection *,DBusMessage *,void *);
+static void acknowledge(resset_t *, resmsg_t *, DBusMessage *);
 static char *method_name(resmsg_type_t);
 
+static DBusHandlerResult stats_method(resconn_dbus_t *, DBusMessage *);
+static int append_message_stats(DBusMessageIter *, resproto_stats_t *);
+static int append_totals(DBusMessageIter *, resproto_stats_t *);
+static int append_peers(DBusMessageIter *, resconn_dbus_t *);
+static int append_histograms(DBusMessageIter *);
+static int compare_peers(const void *, const void *);
+
 /* 
  * local storage
  */
@@ -120,6 +145,30 @@ int resproto_dbus_client_init(resconn_dbus_t *rcon, va_list args)
     return success;
 }
 
+void resproto_dbus_destroy(resconn_dbus_t *rcon)
+{
+    DBusConnection *dcon = rcon->conn;
+
+    if (rcon->role == RESPROTO_ROLE_MANAGER) {
+        dbus_connection_remove_filter(dcon, manager_name_changed, NULL);
+        dbus_connection_unregister_object_path(dcon,
+                                               RESPROTO_DBUS_MANAGER_PATH);
+        dbus_bus_release_name(dcon, RESPROTO_DBUS_MANAGER_NAME, NULL);
+    }
+    else {
+        watch_manager(rcon, FALSE);
+        dbus_connection_remove_filter(dcon, client_name_changed, NULL);
+    }
+}
+
+int resproto_dbus_release(resconn_dbus_t *rcon)
+{
+    free(rcon->dbusid);
+    free(rcon->path);
+
+    return TRUE;
+}
+
 static resset_t *connect_to_manager(resconn_t *rcon, resmsg_t *resmsg)
 {
     char          *name  =  RESPROTO_DBUS_MANAGER_NAME;
@@ -171,6 +220,7 @@ static int send_message(resset_t *rset,resmsg_t *rmsg,resproto_status_t status)
     DBusPendingCall *pend;
     int              need_reply;
     resconn_reply_t *reply;
+    int              encodable;
     int              success;
 
     if (!rset || !rmsg)
@@ -198,7 +248,20 @@ static int send_message(resset_t *rset,resmsg_t *rmsg,resproto_status_t status)
 
     success = FALSE;
 
-    if ((dest = rset->peer) && (method  = method_name(rmsg->type)) &&
+    /*
+     * 64-bit masks can't go to peers known to lack them. A client
+     * learns the capabilities of the manager from the reply to its
+     * register request, so that request itself is sent regardless.
+     */
+    encodable = !resmsg_dbus_is_wide(rmsg)                 ||
+                (rset->caps & RESMSG_CAP_WIDE_MASKS)       ||
+                (rcon->role == RESPROTO_ROLE_CLIENT &&
+                 rmsg->type == RESMSG_REGISTER        );
+
+    RESPROBE(msg_compose, rmsg->type, rmsg->any.id, rmsg->any.reqno, 0);
+
+    if (encodable && (dest = rset->peer) &&
+        (method = method_name(rmsg->type)) &&
         (dmsg = resmsg_dbus_compose_message(dest,path,iface,method,rmsg)))
     {
         if (rcon->role != RESPROTO_ROLE_CLIENT)
@@ -234,9 +297,19 @@ static int send_message(resset_t *rset,resmsg_t *rmsg,resproto_status_t status)
                 resset_ref(rset);
         }
 
+        RESPROBE(msg_send, rmsg->type, rmsg->any.id, rmsg->any.reqno,
+                 dbus_message_get_serial(dmsg));
 
         dbus_message_unref(dmsg);
+
+        restrace_record(RESTRACE_SEND, rset, rmsg->type, rmsg->any.id,
+                        rmsg->any.reqno, success ? 0 : -1);
+
+        if (success)
+            resrecord_message(RESRECORD_SEND, rset, rmsg);
     }
+
+    resconn_stats_sent(rset->resconn, rmsg, success);
     
     return success;
 }
@@ -251,9 +324,15 @@ static int send_error(resset_t *rset, resmsg_t *resreply, void *data)
     DBusMessage    *dbusreply;
 
     if (!noreply) {
+        restrace_record(RESTRACE_SEND, rset, RESMSG_STATUS, resreply->any.id,
+                        resreply->any.reqno, resreply->status.errcod);
+
         if ((dbusreply = resmsg_dbus_reply_message(dbusmsg, resreply))) {
             dbus_connection_send(dcon, dbusreply, &serial);
             dbus_message_unref(dbusreply);
+
+            RESPROBE(msg_send, RESMSG_STATUS, resreply->any.id,
+                     resreply->any.reqno, serial);
         }
     }
 
@@ -270,8 +349,11 @@ static void status_method(DBusPendingCall *pend, void *data)
     resconn_t       *rcon;
     resmsg_t         resmsg;
     const char      *errmsg;
+    restrace_type_t  event;
 
     if (reply && dbusmsg){
+        event = RESTRACE_STATUS;
+
         rset = reply->rset;
         rcon = rset->resconn;
         
@@ -279,6 +361,9 @@ static void status_method(DBusPendingCall *pend, void *data)
             errmsg = dbus_message_get_error_name(dbusmsg);
 
             if (errmsg != NULL) {
+                if (!strcmp(errmsg, DBUS_ERROR_NO_REPLY))
+                    event = RESTRACE_TIMEOUT;
+
                 if (!strncmp(errmsg, "org.freedesktop.", 16))
                     errmsg += 16;
                 else if (!strncmp(errmsg, "com.nokia.", 10))
@@ -314,12 +399,19 @@ static void status_method(DBusPendingCall *pend, void *data)
             }
         }
 
+        restrace_record(event, rset, reply->type, rset->id, reply->reqno,
+                        resmsg.status.errcod);
+        resconn_reply_complete(reply, resmsg.status.errcod,
+                               event == RESTRACE_TIMEOUT);
+
         if (rcon->any.role == RESPROTO_ROLE_CLIENT) {
             switch (reply->type) {
 
             case RESMSG_REGISTER:
-                if (!resmsg.status.errcod)
+                if (!resmsg.status.errcod) {
                     rset->state = RESPROTO_RSET_STATE_CONNECTED;
+                    rset->caps  = resmsg_dbus_parse_caps(dbusmsg);
+                }
                 else
                     rset->state = RESPROTO_RSET_STATE_KILLED;
                 break;
@@ -353,6 +445,8 @@ static resconn_t *find_resproto(DBusConnection *dcon)
 {
     resconn_t *rcon = NULL;
 
+    resconn_list_lock();
+
     while ((rcon = resconn_list_iterate(rcon)) != NULL) {
         if (rcon->any.transp == RESPROTO_TRANSPORT_DBUS &&
             rcon->dbus.conn  == dcon                      )
@@ -360,6 +454,8 @@ static resconn_t *find_resproto(DBusConnection *dcon)
             break;
         }
     }
+
+    resconn_list_unlock();
     
     return rcon;
 }
@@ -409,6 +505,95 @@ static int watch_client(resconn_dbus_t *rcon, const char *dbusid, int watchit)
 }
 
 
+/*
+ * Ask the bus, without blocking, whether dbusid is still around. The
+ * query goes out after the match added by watch_client() so a client
+ * that is gone by then is caught by one or the other.
+ */
+static int check_client(resconn_dbus_t *rcon, const char *dbusid)
+{
+    DBusMessage     *dmsg;
+    DBusPendingCall *pend;
+    client_check_t  *check;
+    int              success;
+
+    dmsg = dbus_message_new_method_call(RESPROTO_DBUS_ADMIN_NAME,
+                                        RESPROTO_DBUS_ADMIN_PATH,
+                                        RESPROTO_DBUS_ADMIN_INTERFACE,
+                                        RESPROTO_DBUS_NAME_HAS_OWNER_METHOD);
+    if (dmsg == NULL)
+        return FALSE;
+
+    success = FALSE;
+    pend    = NULL;
+
+    if (dbus_message_append_args(dmsg, DBUS_TYPE_STRING, &dbusid,
+                                 DBUS_TYPE_INVALID)                      &&
+        dbus_connection_send_with_reply(rcon->conn, dmsg, &pend, timeout) &&
+        pend != NULL                                                        )
+    {
+        if ((check = malloc(sizeof(client_check_t))) != NULL) {
+            check->conn = rcon->conn;
+
+            if ((check->name = strdup(dbusid)) != NULL)
+                success = dbus_pending_call_set_notify(pend, client_checked,
+                                                       check,
+                                                       client_check_free);
+            if (!success)
+                client_check_free(check);
+        }
+
+        if (!success) {
+            dbus_pending_call_cancel(pend);
+            dbus_pending_call_unref(pend);
+        }
+    }
+
+    dbus_message_unref(dmsg);
+
+    return success;
+}
+
+static void client_checked(DBusPendingCall *pend, void *data)
+{
+    client_check_t *check   = (client_check_t *)data;
+    DBusMessage    *dbusmsg = dbus_pending_call_steal_reply(pend);
+    dbus_bool_t     owned   = TRUE;
+    resconn_t      *rcon;
+
+    /* on errors the client is taken to be alive */
+    if (dbusmsg != NULL) {
+        if (dbus_message_get_type(dbusmsg) == DBUS_MESSAGE_TYPE_METHOD_RETURN &&
+            !dbus_message_get_args(dbusmsg, NULL,
+                                   DBUS_TYPE_BOOLEAN, &owned,
+                                   DBUS_TYPE_INVALID))
+        {
+            owned = TRUE;
+        }
+
+        dbus_message_unref(dbusmsg);
+    }
+
+    if (!owned && (rcon = find_resproto(check->conn)) != NULL &&
+        !rcon->any.killed && rcon->any.link != NULL             )
+    {
+        if (rcon->any.link(rcon, check->name, RESPROTO_LINK_DOWN))
+            watch_client(&rcon->dbus, check->name, FALSE);
+    }
+
+    dbus_pending_call_unref(pend);
+}
+
+static void client_check_free(void *data)
+{
+    client_check_t *check = (client_check_t *)data;
+
+    if (check != NULL) {
+        free(check->name);
+        free(check);
+    }
+}
+
 static int add_filter(resconn_dbus_t *rcon, char *filter)
 {
     DBusError  err;
@@ -613,6 +798,18 @@ static DBusHandlerResult manager_method(DBusConnection *dcon,
     char       *method;
 
 
+    if (interface && !strcmp(interface, RESPROTO_DBUS_STATS_INTERFACE)) {
+        if (type == DBUS_MESSAGE_TYPE_METHOD_CALL              &&
+            !strcmp(member, RESPROTO_DBUS_GET_STATS_METHOD)    &&
+            (rcon = find_resproto(dcon)) != NULL               &&
+            rcon->dbus.exported                                  )
+        {
+            return stats_method(&rcon->dbus, dbusmsg);
+        }
+
+        return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
     if (!strcmp(interface, RESPROTO_DBUS_MANAGER_INTERFACE) &&
         type == DBUS_MESSAGE_TYPE_METHOD_CALL               &&
         resmsg_dbus_parse_message(dbusmsg, &resmsg) != NULL   )
@@ -624,6 +821,12 @@ static DBusHandlerResult manager_method(DBusConnection *dcon,
 
                 if (!strcmp(sender, rset->peer) && resmsg.any.id == rset->id) {
                     if (resmsg.type != RESMSG_REGISTER) {
+                        restrace_record(RESTRACE_RECEIVE, rset, resmsg.type,
+                                        resmsg.any.id, resmsg.any.reqno, 0);
+                        resrecord_message(RESRECORD_RECEIVE, rset, &resmsg);
+                        RESPROBE(msg_receive, resmsg.type, resmsg.any.id,
+                                 resmsg.any.reqno,
+                                 dbus_message_get_serial(dbusmsg));
                         dbus_message_ref(dbusmsg);
                         rcon->dbus.receive(&resmsg, rset, dbusmsg);
                     }
@@ -687,14 +890,28 @@ static DBusHandlerResult manager_method(DBusConnection *dcon,
                                      resmsg.record.rset.share,
                                      resmsg.record.rset.mask);
 
+                if (rset != NULL)
+                    rset->caps = resmsg_dbus_parse_caps(dbusmsg);
+
                 if (rset != NULL && (found || watch_client(&rcon->dbus, sender, TRUE))) {
 
                     /* we either were already following the client or
                      * otherwise we set up a D-Bus match string
                      * successfully. */
 
+                    restrace_record(RESTRACE_RECEIVE, rset, resmsg.type,
+                                    resmsg.any.id, resmsg.any.reqno, 0);
+                    resrecord_message(RESRECORD_RECEIVE, rset, &resmsg);
+                    RESPROBE(msg_receive, resmsg.type, resmsg.any.id,
+                             resmsg.any.reqno,
+                             dbus_message_get_serial(dbusmsg));
                     dbus_message_ref(dbusmsg);
                     rcon->dbus.receive(&resmsg, rset, dbusmsg);
+
+                    /* a client that died before the match was added
+                     * never gets a NameOwnerChanged to us */
+                    if (!found)
+                        check_client(&rcon->dbus, sender);
                 }
 
                 return DBUS_HANDLER_RESULT_HANDLED;
@@ -729,6 +946,15 @@ static DBusHandlerResult client_method(DBusConnection *dcon,
         if (method && !strcmp(method,member) && (rcon = find_resproto(dcon))) {
             for (rset = rcon->any.rsets;   rset;   rset = rset->next) {
                 if (!strcmp(name, rset->peer) && resmsg.any.id == rset->id) {
+                    restrace_record(RESTRACE_RECEIVE, rset, resmsg.type,
+                                    resmsg.any.id, resmsg.any.reqno, 0);
+                    resrecord_message(RESRECORD_RECEIVE, rset, &resmsg);
+                    RESPROBE(msg_receive, resmsg.type, resmsg.any.id,
+                             resmsg.any.reqno,
+                             dbus_message_get_serial(dbusmsg));
+                    if (resmsg.type == RESMSG_GRANT ||
+                        resmsg.type == RESMSG_ADVICE  )
+                        acknowledge(rset, &resmsg, dbusmsg);
                     dbus_message_ref(dbusmsg);
                     rcon->dbus.receive(&resmsg, rset, dbusmsg);
                     dbus_message_unref(dbusmsg);
@@ -741,6 +967,27 @@ static DBusHandlerResult client_method(DBusConnection *dcon,
     return DBUS_HANDLER_RESULT_HANDLED;
 }
 
+/*
+ * GRANT and ADVICE are acknowledged as soon as they arrive, so that a
+ * coalescing manager can send the next one while this is dispatched.
+ */
+static void acknowledge(resset_t *rset, resmsg_t *resmsg, DBusMessage *dbusmsg)
+{
+    resmsg_t reply;
+
+    if (!dbus_message_get_no_reply(dbusmsg)) {
+        memset(&reply, 0, sizeof(reply));
+        reply.status.type   = RESMSG_STATUS;
+        reply.status.id     = resmsg->any.id;
+        reply.status.reqno  = resmsg->any.reqno;
+        reply.status.errcod = 0;
+        reply.status.errmsg = "OK";
+
+        dbus_message_ref(dbusmsg);
+        send_error(rset, &reply, dbusmsg);
+    }
+}
+
 static char *method_name(resmsg_type_t msg_type)
 {
     static char *method[RESMSG_MAX] = {
@@ -765,6 +1012,248 @@ static char *method_name(resmsg_type_t msg_type)
 }
 
 
+/*
+ * The snapshot is built in one go in the dispatching thread. The only
+ * part depending on the number of resource sets is the per peer count,
+ * which is done by sorting the peer names instead of searching for them,
+ * so even tens of thousands of sets take just a few milliseconds.
+ */
+static DBusHandlerResult stats_method(resconn_dbus_t *rcon,
+                                      DBusMessage    *dbusmsg)
+{
+    resproto_stats_t *stats = &rcon->stats;
+    DBusMessage      *reply;
+    DBusMessageIter   iter;
+    int               success;
+
+    if ((reply = dbus_message_new_method_return(dbusmsg)) == NULL)
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+    dbus_message_iter_init_append(reply, &iter);
+
+    success = append_message_stats(&iter, stats) &&
+              append_totals(&iter, stats)        &&
+              append_peers(&iter, rcon)          &&
+              append_histograms(&iter);
+
+    if (!success) {
+        dbus_message_unref(reply);
+        reply = dbus_message_new_error(dbusmsg, DBUS_ERROR_NO_MEMORY, NULL);
+    }
+
+    if (reply != NULL) {
+        dbus_connection_send(rcon->conn, reply, NULL);
+        dbus_message_unref(reply);
+    }
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static int append_message_stats(DBusMessageIter  *iter,
+                                resproto_stats_t *stats)
+{
+    DBusMessageIter      array;
+    DBusMessageIter      entry = DBUS_MESSAGE_ITER_INIT_CLOSED;
+    resproto_msgstats_t *msg;
+    const char          *name;
+    int                  i;
+
+    if (!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+                                          "(suuuuu)", &array))
+        return FALSE;
+
+    for (i = 0;   i < RESMSG_MAX;   i++) {
+        msg  = stats->msg + i;
+        name = resmsg_type_str(i);
+
+        if (!dbus_message_iter_open_container(&array, DBUS_TYPE_STRUCT,
+                                              NULL, &entry)              ||
+            !dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING,
+                                            &name)                       ||
+            !dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT32,
+                                            &msg->sent)                  ||
+            !dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT32,
+                                            &msg->received)              ||
+            !dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT32,
+                                            &msg->replied)               ||
+            !dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT32,
+                                            &msg->failed)                ||
+            !dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT32,
+                                            &msg->timedout)              ||
+            !dbus_message_iter_close_container(&array, &entry)             )
+        {
+            dbus_message_iter_abandon_container_if_open(&array, &entry);
+            dbus_message_iter_abandon_container(iter, &array);
+            return FALSE;
+        }
+    }
+
+    return dbus_message_iter_close_container(iter, &array);
+}
+
+static int append_totals(DBusMessageIter *iter, resproto_stats_t *stats)
+{
+    DBusMessageIter totals;
+
+    if (!dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT,
+                                          NULL, &totals))
+        return FALSE;
+
+    if (!dbus_message_iter_append_basic(&totals, DBUS_TYPE_UINT64,
+                                        &stats->bytes_sent)        ||
+        !dbus_message_iter_append_basic(&totals, DBUS_TYPE_UINT64,
+                                        &stats->bytes_received)    ||
+        !dbus_message_iter_append_basic(&totals, DBUS_TYPE_UINT32,
+                                        &stats->pending)           ||
+        !dbus_message_iter_append_basic(&totals, DBUS_TYPE_UINT32,
+                                        &stats->pending_peak)      ||
+        !dbus_message_iter_append_basic(&totals, DBUS_TYPE_UINT32,
+                                        &stats->rsets)             ||
+        !dbus_message_iter_append_basic(&totals, DBUS_TYPE_UINT32,
+                                        &stats->rsets_peak)        ||
+        !dbus_message_iter_append_basic(&totals, DBUS_TYPE_UINT64,
+                                        &stats->dispatch_ns)         )
+    {
+        dbus_message_iter_abandon_container(iter, &totals);
+        return FALSE;
+    }
+
+    return dbus_message_iter_close_container(iter, &totals);
+}
+
+static int append_peers(DBusMessageIter *iter, resconn_dbus_t *rcon)
+{
+    DBusMessageIter   array = DBUS_MESSAGE_ITER_INIT_CLOSED;
+    DBusMessageIter   entry = DBUS_MESSAGE_ITER_INIT_CLOSED;
+    resset_t         *rset;
+    const char      **peers;
+    uint32_t          count;
+    int               n, i, j;
+    int               success;
+
+    for (n = 0, rset = rcon->rsets;   rset != NULL;   rset = rset->next)
+        n++;
+
+    if (n == 0)
+        peers = NULL;
+    else {
+        if ((peers = malloc(n * sizeof(peers[0]))) == NULL)
+            return FALSE;
+
+        for (i = 0, rset = rcon->rsets;   rset != NULL;   rset = rset->next)
+            peers[i++] = rset->peer;
+
+        qsort(peers, n, sizeof(peers[0]), compare_peers);
+    }
+
+    success = dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+                                               "{su}", &array);
+
+    for (i = 0;   success && i < n;   i = j) {
+        for (j = i + 1;   j < n && !strcmp(peers[i], peers[j]);   j++)
+            ;
+
+        count = j - i;
+
+        success = dbus_message_iter_open_container(&array,
+                                                   DBUS_TYPE_DICT_ENTRY,
+                                                   NULL, &entry)        &&
+                  dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING,
+                                                 &peers[i])             &&
+                  dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT32,
+                                                 &count)                &&
+                  dbus_message_iter_close_container(&array, &entry);
+    }
+
+    if (success)
+        success = dbus_message_iter_close_container(iter, &array);
+    else {
+        dbus_message_iter_abandon_container_if_open(&array, &entry);
+        dbus_message_iter_abandon_container_if_open(iter, &array);
+    }
+
+    free(peers);
+
+    return success;
+}
+
+static int append_histograms(DBusMessageIter *iter)
+{
+    DBusMessageIter  array;
+    DBusMessageIter  entry   = DBUS_MESSAGE_ITER_INIT_CLOSED;
+    DBusMessageIter  buckets = DBUS_MESSAGE_ITER_INIT_CLOSED;
+    DBusMessageIter  bucket  = DBUS_MESSAGE_ITER_INIT_CLOSED;
+    reshist_t        hist;
+    const char      *name;
+    uint16_t         idx;
+    int              i, j;
+    int              success;
+
+    if (!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+                                          "(stttta(qu))", &array))
+        return FALSE;
+
+    for (i = 0, success = TRUE;   success && i < RESMSG_MAX;   i++) {
+        if (!reshist_get_roundtrip(i, &hist) || hist.count == 0)
+            continue;
+
+        name = resmsg_type_str(i);
+
+        success = dbus_message_iter_open_container(&array, DBUS_TYPE_STRUCT,
+                                                   NULL, &entry)         &&
+                  dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING,
+                                                 &name)                  &&
+                  dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64,
+                                                 &hist.count)            &&
+                  dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64,
+                                                 &hist.sum)              &&
+                  dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64,
+                                                 &hist.min)              &&
+                  dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64,
+                                                 &hist.max)              &&
+                  dbus_message_iter_open_container(&entry, DBUS_TYPE_ARRAY,
+                                                   "(qu)", &buckets);
+
+        for (j = 0;   success && j < RESHIST_BUCKETS;   j++) {
+            if (hist.bucket[j] == 0)
+                continue;
+
+            idx = j;
+
+            success = dbus_message_iter_open_container(&buckets,
+                                                       DBUS_TYPE_STRUCT,
+                                                       NULL, &bucket)    &&
+                      dbus_message_iter_append_basic(&bucket,
+                                                     DBUS_TYPE_UINT16,
+                                                     &idx)               &&
+                      dbus_message_iter_append_basic(&bucket,
+                                                     DBUS_TYPE_UINT32,
+                                                     &hist.bucket[j])    &&
+                      dbus_message_iter_close_container(&buckets, &bucket);
+        }
+
+        if (success) {
+            success = dbus_message_iter_close_container(&entry, &buckets) &&
+                      dbus_message_iter_close_container(&array, &entry);
+        }
+    }
+
+    if (!success) {
+        dbus_message_iter_abandon_container_if_open(&buckets, &bucket);
+        dbus_message_iter_abandon_container_if_open(&entry, &buckets);
+        dbus_message_iter_abandon_container_if_open(&array, &entry);
+        dbus_message_iter_abandon_container(iter, &array);
+        return FALSE;
+    }
+
+    return dbus_message_iter_close_container(iter, &array);
+}
+
+static int compare_peers(const void *a, const void *b)
+{
+    return strcmp(*(const char **)a, *(const char **)b);
+}
+
 
 /* 
  * Local Variables:
@@ -39,6 +39,7 @@ USA.
 #define RESPROTO_DBUS_ADMIN_INTERFACE            "org.freedesktop.DBus"
 #define RESPROTO_DBUS_MANAGER_INTERFACE          "org.maemo.resource.manager"
 #define RESPROTO_DBUS_CLIENT_INTERFACE           "org.maemo.resource.client"
+#define RESPROTO_DBUS_STATS_INTERFACE            "org.maemo.resource.stats"
 
 /* D-Bus methods */
 #define RESPROTO_DBUS_NAME_OWNER_CHANGED_SIGNAL  "NameOwnerChanged"
@@ -51,9 +52,27 @@ USA.
 #define RESPROTO_DBUS_ADVICE_METHOD              "advice"
 #define RESPROTO_DBUS_AUDIO_METHOD               "audio"
 #define RESPROTO_DBUS_VIDEO_METHOD               "video"
+#define RESPROTO_DBUS_GET_STATS_METHOD           "get_stats"
+
+/*
+ * org.maemo.resource.stats.get_stats() on RESPROTO_DBUS_MANAGER_PATH,
+ * offered if enabled with resproto_export_stats(). Returns
+ *
+ *   a(suuuuu)       per message type: type name, sent, received, replied,
+ *                   failed and timed out counters
+ *   (ttuuuut)       bytes sent and received, pending replies and their
+ *                   peak, resource sets and their peak, nsec spent in
+ *                   message handlers
+ *   a{su}           number of resource sets per peer
+ *   a(stttta(qu))   non-empty round trip histograms: message type name,
+ *                   count, sum, min, max in nsec and the non-empty
+ *                   buckets as (index, count); see reshist_bucket_low()
+ */
 
 int resproto_dbus_manager_init(resconn_dbus_t *, va_list);
 int resproto_dbus_client_init(resconn_dbus_t *, va_list);
+void resproto_dbus_destroy(resconn_dbus_t *);
+int  resproto_dbus_release(resconn_dbus_t *);
 
 
 #endif /* __RES_DBUS_PROTO_H__ */
@@ -0,0 +1,141 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Generates res-registry-hash.h, a perfect hash of the built-in
+ * resource names of res-registry-private.h. Runs on the build host
+ * only when the built-ins change ('make regen-registry'); the output
+ * is kept in the source tree.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "res-types.h"
+#include "res-registry-private.h"
+
+#define MAX_SEEDS   (1U << 24)
+
+#define BUILTIN_ENTRY(n, b)  { n, b, #b },
+
+typedef struct {
+    const char  *name;
+    int          bit;
+    const char  *bit_name;
+} entry_t;
+
+static entry_t  builtins[] = {
+    RESREG_BUILTINS(BUILTIN_ENTRY)
+};
+
+#define NBUILTIN  (int)(sizeof(builtins) / sizeof(builtins[0]))
+
+static int  try_seed(uint32_t, uint32_t, int *);
+static void print_table(uint32_t, uint32_t, int *);
+
+
+int main(void)
+{
+    int      *slot;
+    uint32_t  size;
+    uint32_t  seed;
+
+    for (size = 1;  size < NBUILTIN;  size <<= 1)
+        ;
+
+    for (;;) {
+        if ((slot = malloc(size * sizeof(int))) == NULL) {
+            fprintf(stderr, "gen-registry: out of memory\n");
+            return 1;
+        }
+
+        for (seed = 0;  seed < MAX_SEEDS;  seed++) {
+            if (try_seed(seed, size, slot)) {
+                print_table(seed, size, slot);
+                free(slot);
+                return 0;
+            }
+        }
+
+        free(slot);
+        size <<= 1;
+    }
+}
+
+
+static int try_seed(uint32_t seed, uint32_t size, int *slot)
+{
+    uint32_t i;
+    int      j;
+
+    for (i = 0;  i < size;  i++)
+        slot[i] = -1;
+
+    for (j = 0;  j < NBUILTIN;  j++) {
+        i = resreg_hash(builtins[j].name, seed) & (size - 1);
+
+        if (slot[i] >= 0)
+            return 0;
+
+        slot[i] = j;
+    }
+
+    return 1;
+}
+
+static void print_table(uint32_t seed, uint32_t size, int *slot)
+{
+    entry_t  *e;
+    uint32_t  i;
+
+    printf("/*\n"
+           " * Generated by gen-registry from res-registry-private.h,"
+           " do not edit.\n"
+           " */\n\n");
+
+    printf("#define RESREG_HASH_SEED  0x%08xU\n", seed);
+    printf("#define RESREG_HASH_SIZE  %u\n\n", size);
+
+    printf("static const resreg_builtin_t "
+           "builtin_hash[RESREG_HASH_SIZE] = {\n");
+
+    for (i = 0;  i < size;  i++) {
+        if (slot[i] < 0)
+            printf("    [%2u] = { NULL, -1 },\n", i);
+        else {
+            e = builtins + slot[i];
+            printf("    [%2u] = { \"%s\", %s },\n", i, e->name, e->bit_name);
+        }
+    }
+
+    printf("};\n");
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
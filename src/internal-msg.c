@@ -25,6 +25,11 @@ USA.
 
 #include "res-msg.h"
 #include "internal-msg.h"
+#include "res-alloc-private.h"
+
+static char *copy_string(const char *);
+static resmsg_property_t *copy_extra(resmsg_audio_t *);
+static void destroy_extra(resmsg_audio_t *);
 
 resmsg_t *resmsg_internal_copy_message(resmsg_t *src)
 {
@@ -32,7 +37,7 @@ resmsg_t *resmsg_internal_copy_message(resmsg_t *src)
     resmsg_property_t *src_prop, *dst_prop;
     resmsg_match_t    *src_match, *dst_match;
 
-    if (src != NULL && (dst = malloc(sizeof(resmsg_t))) != NULL) {
+    if (src != NULL && (dst = RESALLOC_MALLOC(MESSAGE, sizeof(resmsg_t))) != NULL) {
         memset(dst, 0, sizeof(resmsg_t));
         
         switch (src->type) {
@@ -40,8 +45,8 @@ resmsg_t *resmsg_internal_copy_message(resmsg_t *src)
         case RESMSG_REGISTER:
         case RESMSG_UPDATE:
             dst->record = src->record;
-            dst->record.app_id = strdup(src->record.app_id);
-            dst->record.klass = strdup(src->record.klass);
+            dst->record.app_id = copy_string(src->record.app_id);
+            dst->record.klass = copy_string(src->record.klass);
             break;
 
         case RESMSG_UNREGISTER:
@@ -62,9 +67,12 @@ resmsg_t *resmsg_internal_copy_message(resmsg_t *src)
             dst_match = &dst_prop->match;
 
             dst->audio         = src->audio;
-            dst->audio.group   = strdup(src->audio.group);
-            dst_prop->name     = strdup(src_prop->name);
-            dst_match->pattern = strdup(src_match->pattern);
+            dst->audio.group   = copy_string(src->audio.group);
+            dst->audio.app_id  = copy_string(src->audio.app_id);
+            dst_prop->name     = copy_string(src_prop->name);
+            dst_match->pattern = copy_string(src_match->pattern);
+            dst->audio.extra   = copy_extra(&src->audio);
+            dst->audio.nextra  = dst->audio.extra ? src->audio.nextra : 0;
             break;
 
         case RESMSG_VIDEO:
@@ -73,11 +81,11 @@ resmsg_t *resmsg_internal_copy_message(resmsg_t *src)
 
         case RESMSG_STATUS:
             dst->status = src->status;
-            dst->status.errmsg = strdup(src->status.errmsg);
+            dst->status.errmsg = copy_string(src->status.errmsg);
             break;
 
         default:
-            free(dst);
+            RESALLOC_FREE(MESSAGE, dst);
             dst = NULL;
             break;
         }
@@ -96,30 +104,76 @@ void resmsg_internal_destroy_message(resmsg_t *msg)
 
         case RESMSG_REGISTER:
         case RESMSG_UPDATE:
-            free(msg->record.app_id);
-            free(msg->record.klass);
+            RESALLOC_FREE(STRING, msg->record.app_id);
+            RESALLOC_FREE(STRING, msg->record.klass);
             break;
 
         case RESMSG_AUDIO:
             prop  = &msg->audio.property;
             match = &prop->match;
-            free(msg->audio.group);
-            free(prop->name);
-            free(match->pattern);
+            RESALLOC_FREE(STRING, msg->audio.group);
+            RESALLOC_FREE(STRING, msg->audio.app_id);
+            RESALLOC_FREE(STRING, prop->name);
+            RESALLOC_FREE(STRING, match->pattern);
+            destroy_extra(&msg->audio);
             break;
 
         case RESMSG_VIDEO:
             break;
 
         case RESMSG_STATUS:
-            free((void *)msg->status.errmsg);
+            RESALLOC_FREE(STRING, (void *)msg->status.errmsg);
             break;
 
         default:
             break;
         }
 
-        free(msg);
+        RESALLOC_FREE(MESSAGE, msg);
+    }
+}
+
+static char *copy_string(const char *str)
+{
+    /* optional strings are NULL in messages composed in-process */
+    return str ? RESALLOC_STRDUP(str) : NULL;
+}
+
+static resmsg_property_t *copy_extra(resmsg_audio_t *audio)
+{
+    resmsg_property_t *extra;
+    resmsg_property_t *src;
+    uint32_t           i;
+
+    if (!audio->nextra || !audio->extra)
+        return NULL;
+
+    extra = RESALLOC_MALLOC(MESSAGE, audio->nextra * sizeof(resmsg_property_t));
+
+    if (extra != NULL) {
+        for (i = 0;  i < audio->nextra;  i++) {
+            src = audio->extra + i;
+
+            extra[i].name          = copy_string(src->name);
+            extra[i].match.method  = src->match.method;
+            extra[i].match.pattern = copy_string(src->match.pattern);
+        }
+    }
+
+    return extra;
+}
+
+static void destroy_extra(resmsg_audio_t *audio)
+{
+    uint32_t i;
+
+    if (audio->extra != NULL) {
+        for (i = 0;  i < audio->nextra;  i++) {
+            RESALLOC_FREE(STRING, audio->extra[i].name);
+            RESALLOC_FREE(STRING, audio->extra[i].match.pattern);
+        }
+
+        RESALLOC_FREE(MESSAGE, audio->extra);
     }
 }
 
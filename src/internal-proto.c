@@ -27,6 +27,10 @@ USA.
 
 #include "res-conn-private.h"
 #include "res-set-private.h"
+#include "res-trace-private.h"
+#include "res-record-private.h"
+#include "res-alloc-private.h"
+#include "res-probe.h"
 #include "internal-msg.h"
 #include "internal-proto.h"
 
@@ -111,12 +115,31 @@ int resproto_internal_client_init(resconn_internal_t *rcon, va_list args)
     return success;
 }
 
+void resproto_internal_destroy(resconn_internal_t *rcon)
+{
+    if (rcon == resproto_manager)
+        resproto_manager = NULL;
+}
+
+int resproto_internal_release(resconn_internal_t *rcon)
+{
+    /* every queued message has its own dequeue timer referring to rcon */
+    if (!queue_is_empty(&rcon->queue.head))
+        return FALSE;
+
+    free(rcon->name);
+
+    return TRUE;
+}
+
 static int notify_clients_about_manager_up(void *dummy)
 {
     resconn_t  *rc = NULL;
 
     (void)dummy;
 
+    resconn_list_lock();
+
     while ((rc = resconn_list_iterate(rc)) != NULL) {
         if (rc->any.role   == RESPROTO_ROLE_CLIENT &&
             rc->any.transp == RESPROTO_TRANSPORT_INTERNAL)
@@ -126,6 +149,8 @@ static int notify_clients_about_manager_up(void *dummy)
         }
     }
 
+    resconn_list_unlock();
+
     return FALSE;
 }
 
@@ -193,6 +218,9 @@ static int send_message(resset_t          *rset,
     else {
         success = TRUE;
 
+        RESPROBE(msg_compose, resmsg->type, resmsg->any.id,
+                 resmsg->any.reqno, 0);
+
         if (rcon->role != RESPROTO_ROLE_CLIENT)
             need_reply = status ? TRUE : FALSE;
         else {
@@ -211,7 +239,7 @@ static int send_message(resset_t          *rset,
             reqno  = resmsg->any.reqno;
             reply  = resconn_reply_create(type, serial, reqno, rset, status);
 
-            if ((std = malloc(sizeof(statuscb_data_t))) != NULL) {
+            if ((std = RESALLOC_MALLOC(REPLY, sizeof(statuscb_data_t))) != NULL) {
                 memset(std, 0, sizeof(statuscb_data_t));
                 strncpy(std->name, rcon->name, sizeof(std->name)-1);
                 strncpy(std->errmsg, "Internal.NoReply",sizeof(std->errmsg)-1);
@@ -227,10 +255,19 @@ static int send_message(resset_t          *rset,
 
         rcon->busy = TRUE;
 
+        RESPROBE(msg_send, resmsg->type, resmsg->any.id, resmsg->any.reqno,
+                 serial);
+        resrecord_message(RESRECORD_SEND, rset, resmsg);
+
         receive_message_init(receiver, rcon->name, serial, resmsg);
 
         rcon->busy = FALSE;
     }
+
+    restrace_record(RESTRACE_SEND, rset, resmsg->type, resmsg->any.id,
+                    resmsg->any.reqno, success ? 0 : -1);
+
+    resconn_stats_sent(rset->resconn, resmsg, success);
     
     return success;
 }
@@ -241,7 +278,7 @@ static int send_error_init(resset_t *rset, resmsg_t *resreply, void *data)
     statuscb_data_t    *std;
     int                 success;
 
-    if ((std = malloc(sizeof(statuscb_data_t))) == NULL)
+    if ((std = RESALLOC_MALLOC(REPLY, sizeof(statuscb_data_t))) == NULL)
         success = FALSE;
     else {
         memset(std, 0, sizeof(statuscb_data_t));
@@ -254,6 +291,11 @@ static int send_error_init(resset_t *rset, resmsg_t *resreply, void *data)
 
         rcon->timer.add(0, send_error_complete, std);
 
+        restrace_record(RESTRACE_SEND, rset, RESMSG_STATUS, resreply->any.id,
+                        resreply->any.reqno, resreply->status.errcod);
+        RESPROBE(msg_send, RESMSG_STATUS, resreply->any.id,
+                 resreply->any.reqno, std->serial);
+
         success = TRUE;
     }
 
@@ -268,6 +310,8 @@ static int send_error_complete(void *data)
     resset_t        *rset;
     resmsg_t         resmsg;
     
+    resconn_list_lock();
+
     while ((rcon = resconn_list_iterate(rcon)) != NULL) {
         if (rcon->any.transp == RESPROTO_TRANSPORT_INTERNAL &&
             !strcmp(rcon->internal.name, std->name)            )
@@ -275,10 +319,17 @@ static int send_error_complete(void *data)
             if ((reply = resconn_reply_find(rcon, std->serial)) != NULL) {
                 rset = reply->rset;
 
+                restrace_record(reply->data == data ? RESTRACE_TIMEOUT :
+                                                      RESTRACE_STATUS,
+                                rset, reply->type, rset->id, reply->reqno,
+                                std->errcod);
+                resconn_reply_complete(reply, std->errcod,
+                                       reply->data == data);
+
                 if (reply->timer && reply->data != data) {
                     rcon->internal.timer.del(reply->timer);
                     reply->timer = NULL;
-                    free(reply->data);
+                    RESALLOC_FREE(REPLY, reply->data);
                 }
 
                 if (rcon->any.role == RESPROTO_ROLE_CLIENT) {
@@ -320,7 +371,9 @@ static int send_error_complete(void *data)
         }
     }
 
-    free(std);
+    resconn_list_unlock();
+
+    RESALLOC_FREE(REPLY, std);
 
     return FALSE;
 }
@@ -336,6 +389,7 @@ static void receive_message_init(resconn_internal_t *rcon,
     resconn_qitem_t  buf;
     resconn_qitem_t *item;
     resmsg_rset_t   *flags;
+    resset_t        *rset;
     const char      *app_id;
     const char      *klass;
     uint32_t         mode;
@@ -351,23 +405,30 @@ static void receive_message_init(resconn_internal_t *rcon,
         mode  =  msg->record.mode;
         flags = &msg->record.rset;
 
-        if ((resset_find((resconn_t *)rcon, peer, msg->any.id)) == NULL) {
-            resset_create((resconn_t *)rcon, peer, msg->any.id,
-                          RESPROTO_RSET_STATE_CONNECTED,
-                          app_id, klass, mode, flags->all, flags->opt,
-                          flags->share, flags->mask);
+        if ((rset = resset_find((resconn_t *)rcon, peer, msg->any.id)) == NULL) {
+            rset = resset_create((resconn_t *)rcon, peer, msg->any.id,
+                                 RESPROTO_RSET_STATE_CONNECTED,
+                                 app_id, klass, mode, flags->all, flags->opt,
+                                 flags->share, flags->mask);
         }
+
+        /* both ends are the same library */
+        if (rset != NULL)
+            rset->caps = RESMSG_CAP_ALL;
     }
 
     if (rcon->busy || !queue_was_empty) {
-        if ((item = malloc(sizeof(resconn_qitem_t))) != NULL) {
+        if ((item = RESALLOC_MALLOC(REQUEST, sizeof(resconn_qitem_t))) != NULL) {
             memset(item, 0, sizeof(resconn_qitem_t));
-            item->peer = strdup(peer);
+            item->peer = RESALLOC_STRDUP(peer);
             item->data = data;
             item->msg = resmsg_internal_copy_message(msg);
 
             queue_append_item(&rcon->queue.head, item);
 
+            RESPROBE(queue_enqueue, msg->type, msg->any.id, msg->any.reqno,
+                     serial);
+
             rcon->queue.timer = rcon->timer.add(0,
                                                 receive_message_dequeue,
                                                 rcon);
@@ -391,14 +452,18 @@ static int receive_message_dequeue(void *data)
     resconn_qitem_t    *item;
 
     if ((item = queue_pop_item(&rcon->queue.head)) != NULL) {
+        RESPROBE(queue_dequeue, item->msg->type, item->msg->any.id,
+                 item->msg->any.reqno, (uint32_t)(uintptr_t)item->data);
 
         receive_message_complete(rcon, item);
 
-        free(item->peer);
+        RESALLOC_FREE(STRING, item->peer);
         resmsg_internal_destroy_message(item->msg);
-        free(item);
+        RESALLOC_FREE(REQUEST, item);
     }
 
+    resconn_release((resconn_t *)rcon);
+
     return FALSE;
 }
 
@@ -407,8 +472,28 @@ static void receive_message_complete(resconn_internal_t *rcon,
 {
     resmsg_t *msg  = item->msg;
     resset_t *rset = resset_find((resconn_t *)rcon, item->peer, msg->any.id);
+    resmsg_t  ack;
     
     if (rset != NULL){
+        restrace_record(RESTRACE_RECEIVE, rset, msg->type, msg->any.id,
+                        msg->any.reqno, 0);
+        resrecord_message(RESRECORD_RECEIVE, rset, msg);
+        RESPROBE(msg_receive, msg->type, msg->any.id, msg->any.reqno,
+                 (uint32_t)(uintptr_t)item->data);
+
+        if (rcon->role == RESPROTO_ROLE_CLIENT && item->data != NULL &&
+            (msg->type == RESMSG_GRANT || msg->type == RESMSG_ADVICE))
+        {
+            memset(&ack, 0, sizeof(ack));
+            ack.status.type   = RESMSG_STATUS;
+            ack.status.id     = msg->any.id;
+            ack.status.reqno  = msg->any.reqno;
+            ack.status.errcod = 0;
+            ack.status.errmsg = "OK";
+
+            send_error_init(rset, &ack, item->data);
+        }
+
         rcon->receive(msg, rset, item->data);
     }    
 }
@@ -418,6 +503,8 @@ static resconn_internal_t *find_resconn_client(resset_t *rset)
 {
     resconn_t *rcon = NULL;
 
+    resconn_list_lock();
+
     while ((rcon = resconn_list_iterate(rcon)) != NULL) {
         if (rcon->any.role   == RESPROTO_ROLE_CLIENT        &&
             rcon->any.transp == RESPROTO_TRANSPORT_INTERNAL &&
@@ -426,6 +513,8 @@ static resconn_internal_t *find_resconn_client(resset_t *rset)
             break;
         }
     }
+
+    resconn_list_unlock();
     
     return &rcon->internal;
 }
@@ -39,6 +39,8 @@ typedef struct {
 
 int  resproto_internal_manager_init(resconn_internal_t *, va_list);
 int  resproto_internal_client_init(resconn_internal_t *, va_list);
+void resproto_internal_destroy(resconn_internal_t *);
+int  resproto_internal_release(resconn_internal_t *);
 
 
 
@@ -0,0 +1,63 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __RES_ALLOC_PRIVATE_H__
+#define __RES_ALLOC_PRIVATE_H__
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <res-alloc.h>
+
+/*
+ * Every allocation the accounting covers must be freed with
+ * RESALLOC_FREE of the same class and vice versa.
+ */
+
+#ifdef ENABLE_ALLOC_STATS
+
+void *resalloc_malloc(resalloc_class_t, size_t);
+char *resalloc_strdup(resalloc_class_t, const char *);
+void  resalloc_free(resalloc_class_t, void *);
+
+#define RESALLOC_MALLOC(cls, size)  resalloc_malloc(RESALLOC_##cls, size)
+#define RESALLOC_STRDUP(str)        resalloc_strdup(RESALLOC_STRING, str)
+#define RESALLOC_FREE(cls, ptr)     resalloc_free(RESALLOC_##cls, ptr)
+
+#else  /* !ENABLE_ALLOC_STATS */
+
+#define RESALLOC_MALLOC(cls, size)  malloc(size)
+#define RESALLOC_STRDUP(str)        strdup(str)
+#define RESALLOC_FREE(cls, ptr)     free(ptr)
+
+#endif /* ENABLE_ALLOC_STATS */
+
+#endif /* __RES_ALLOC_PRIVATE_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
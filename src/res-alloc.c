@@ -0,0 +1,151 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ENABLE_ALLOC_STATS
+#include <malloc.h>
+#endif
+
+#include "res-alloc-private.h"
+#include "visibility.h"
+
+#ifndef TRUE
+#define FALSE 0
+#define TRUE  1
+#endif
+
+static const char *class_names[RESALLOC_CLASS_MAX] = {
+    [RESALLOC_RSET   ] = "rset",
+    [RESALLOC_REPLY  ] = "reply",
+    [RESALLOC_REQUEST] = "request",
+    [RESALLOC_MESSAGE] = "message",
+    [RESALLOC_STRING ] = "string",
+};
+
+#ifdef ENABLE_ALLOC_STATS
+static resalloc_stats_t  stats[RESALLOC_CLASS_MAX];
+#endif
+
+
+EXPORT int resalloc_enabled(void)
+{
+#ifdef ENABLE_ALLOC_STATS
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+EXPORT int resalloc_get_stats(resalloc_class_t cls, resalloc_stats_t *st)
+{
+#ifdef ENABLE_ALLOC_STATS
+    resalloc_stats_t *s;
+
+    if (cls < 0 || cls >= RESALLOC_CLASS_MAX || st == NULL)
+        return FALSE;
+
+    s = stats + cls;
+
+    st->allocs    = __atomic_load_n(&s->allocs   , __ATOMIC_RELAXED);
+    st->frees     = __atomic_load_n(&s->frees    , __ATOMIC_RELAXED);
+    st->allocated = __atomic_load_n(&s->allocated, __ATOMIC_RELAXED);
+    st->freed     = __atomic_load_n(&s->freed    , __ATOMIC_RELAXED);
+
+    return TRUE;
+#else
+    (void)cls;
+    (void)st;
+
+    return FALSE;
+#endif
+}
+
+EXPORT const char *resalloc_class_str(resalloc_class_t cls)
+{
+    if (cls < 0 || cls >= RESALLOC_CLASS_MAX)
+        return "<unknown>";
+
+    return class_names[cls];
+}
+
+
+#ifdef ENABLE_ALLOC_STATS
+
+static void account(resalloc_class_t cls, void *ptr, int alloc)
+{
+    resalloc_stats_t *s = stats + cls;
+    uint64_t          size;
+
+    if (ptr == NULL)
+        return;
+
+    size = malloc_usable_size(ptr);
+
+    if (alloc) {
+        __atomic_fetch_add(&s->allocs   , 1   , __ATOMIC_RELAXED);
+        __atomic_fetch_add(&s->allocated, size, __ATOMIC_RELAXED);
+    }
+    else {
+        __atomic_fetch_add(&s->frees    , 1   , __ATOMIC_RELAXED);
+        __atomic_fetch_add(&s->freed    , size, __ATOMIC_RELAXED);
+    }
+}
+
+/* these are exported for libresource-glib and libresource-epoll */
+
+EXPORT void *resalloc_malloc(resalloc_class_t cls, size_t size)
+{
+    void *ptr = malloc(size);
+
+    account(cls, ptr, TRUE);
+
+    return ptr;
+}
+
+EXPORT char *resalloc_strdup(resalloc_class_t cls, const char *str)
+{
+    char *ptr = strdup(str);
+
+    account(cls, ptr, TRUE);
+
+    return ptr;
+}
+
+EXPORT void resalloc_free(resalloc_class_t cls, void *ptr)
+{
+    account(cls, ptr, FALSE);
+
+    free(ptr);
+}
+
+#endif /* ENABLE_ALLOC_STATS */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,73 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __RES_ALLOC_H__
+#define __RES_ALLOC_H__
+
+#include <stdint.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Allocation accounting of the library, compiled in with
+ * --enable-alloc-stats. Allocations are counted by what they are for;
+ * bytes are what malloc actually reserved (malloc_usable_size), so
+ * they include the allocator's rounding but not its headers. The
+ * counters are updated atomically and can be read at any time.
+ */
+
+typedef enum {
+    RESALLOC_RSET = 0,          /* resource sets */
+    RESALLOC_REPLY,             /* pending replies and their status data */
+    RESALLOC_REQUEST,           /* queued requests and commands */
+    RESALLOC_MESSAGE,           /* message copies */
+    RESALLOC_STRING,            /* names, ids and classes */
+    RESALLOC_CLASS_MAX
+} resalloc_class_t;
+
+typedef struct {
+    uint64_t   allocs;          /* number of allocations */
+    uint64_t   frees;           /* number of frees */
+    uint64_t   allocated;       /* bytes ever allocated */
+    uint64_t   freed;           /* bytes ever freed */
+} resalloc_stats_t;
+
+int         resalloc_enabled(void);
+int         resalloc_get_stats(resalloc_class_t, resalloc_stats_t *);
+const char *resalloc_class_str(resalloc_class_t);
+
+#ifdef	__cplusplus
+};
+#endif
+
+#endif /* __RES_ALLOC_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,275 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "res-coalesce-private.h"
+#include "res-alloc-private.h"
+#include "visibility.h"
+
+#ifndef TRUE
+#define FALSE 0
+#define TRUE  1
+#endif
+
+/*
+ * Every set has a slot for GRANT and one for ADVICE. A slot is busy
+ * while its last message waits for the acknowledgement or the window
+ * timer runs; meanwhile the latest message is queued in the slot.
+ */
+typedef struct {
+    resset_t          *rset;
+    int                inflight;    /* sent and not yet acknowledged */
+    resproto_status_t  status;      /* callback of the message in flight */
+    void              *timer;       /* window timer, if running */
+    int                queued;      /* 'msg' waits to be sent */
+    resmsg_notify_t    msg;
+    resproto_status_t  msgstatus;   /* callback of 'msg' */
+} slot_t;
+
+typedef struct {
+    slot_t             grant;
+    slot_t             advice;
+} coalesce_t;
+
+static int   send_slot(slot_t *, resmsg_notify_t *, resproto_status_t);
+static void  flush_slot(slot_t *);
+static void  complete(resset_t *, resmsg_notify_t *, resproto_status_t,
+                      int32_t, const char *);
+static void  acked(slot_t *, resmsg_t *);
+static void  grant_acked(resset_t *, resmsg_t *);
+static void  advice_acked(resset_t *, resmsg_t *);
+static int   window_end(void *);
+
+
+EXPORT int resconn_set_coalescing(resconn_t           *rcon,
+                                  int                  enable,
+                                  uint32_t             window,
+                                  resconn_timer_add_t  add,
+                                  resconn_timer_del_t  del)
+{
+    if (rcon == NULL || rcon->any.role != RESPROTO_ROLE_MANAGER)
+        return FALSE;
+
+    if (!enable) {
+        rcon->any.coalesce.enabled = FALSE;
+        return TRUE;
+    }
+
+    if (window && (!add || !del)) {
+        if (rcon->any.transp != RESPROTO_TRANSPORT_INTERNAL)
+            return FALSE;
+
+        add = rcon->internal.timer.add;
+        del = rcon->internal.timer.del;
+    }
+
+    /* timers still running keep using the functions they were set by */
+    if (add && del) {
+        rcon->any.coalesce.add = add;
+        rcon->any.coalesce.del = del;
+    }
+
+    rcon->any.coalesce.enabled = TRUE;
+    rcon->any.coalesce.window  = window;
+
+    return TRUE;
+}
+
+
+int rescoal_send(resset_t *rset, resmsg_t *resmsg, resproto_status_t status)
+{
+    coalesce_t *coal;
+    slot_t     *slot;
+
+    if ((coal = rset->coalesce) == NULL) {
+        if ((coal = RESALLOC_MALLOC(RSET, sizeof(coalesce_t))) == NULL)
+            return rset->resconn->any.send(rset, resmsg, status);
+
+        memset(coal, 0, sizeof(coalesce_t));
+        coal->grant.rset  = rset;
+        coal->advice.rset = rset;
+
+        rset->coalesce = coal;
+    }
+
+    slot = resmsg->type == RESMSG_GRANT ? &coal->grant : &coal->advice;
+
+    if (!slot->inflight && !slot->timer)
+        return send_slot(slot, &resmsg->notify, status);
+
+    if (slot->queued) {
+        rset->resconn->any.stats.coalesced++;
+        complete(rset, &slot->msg, slot->msgstatus, ECANCELED, "superseded");
+    }
+
+    slot->msg       = resmsg->notify;
+    slot->msgstatus = status;
+    slot->queued    = TRUE;
+
+    return TRUE;
+}
+
+void rescoal_release(resset_t *rset)
+{
+    coalesce_t *coal = rset->coalesce;
+    resconn_t  *rcon = rset->resconn;
+
+    if (coal != NULL) {
+        if (coal->grant.timer)
+            rcon->any.coalesce.del(coal->grant.timer);
+        if (coal->advice.timer)
+            rcon->any.coalesce.del(coal->advice.timer);
+
+        /* a message held back only by the timer was never sent */
+        if (coal->grant.queued) {
+            complete(rset, &coal->grant.msg, coal->grant.msgstatus,
+                     ECONNRESET, "set is gone");
+        }
+        if (coal->advice.queued) {
+            complete(rset, &coal->advice.msg, coal->advice.msgstatus,
+                     ECONNRESET, "set is gone");
+        }
+
+        RESALLOC_FREE(RSET, coal);
+        rset->coalesce = NULL;
+    }
+}
+
+
+static int send_slot(slot_t            *slot,
+                     resmsg_notify_t   *notify,
+                     resproto_status_t  status)
+{
+    resset_t          *rset = slot->rset;
+    resconn_t         *rcon = rset->resconn;
+    resproto_status_t  ack  = NULL;
+    resmsg_t           msg;
+    int                success;
+
+    if (rset->caps & RESMSG_CAP_NOTIFY_ACK)
+        ack = notify->type == RESMSG_GRANT ? grant_acked : advice_acked;
+
+    msg.notify = *notify;
+    success = rcon->any.send(rset, &msg, ack ? ack : status);
+
+    if (success) {
+        if (ack) {
+            slot->inflight = TRUE;
+            slot->status   = status;
+        }
+
+        if (rcon->any.coalesce.window) {
+            slot->timer = rcon->any.coalesce.add(rcon->any.coalesce.window,
+                                                 window_end, slot);
+        }
+    }
+
+    return success;
+}
+
+static void flush_slot(slot_t *slot)
+{
+    resset_t          *rset = slot->rset;
+    resmsg_notify_t    msg;
+    resproto_status_t  status;
+
+    if (!slot->queued || slot->inflight || slot->timer)
+        return;
+
+    msg    = slot->msg;
+    status = slot->msgstatus;
+
+    slot->queued    = FALSE;
+    slot->msgstatus = NULL;
+
+    if (rset->state != RESPROTO_RSET_STATE_CONNECTED)
+        complete(rset, &msg, status, ECONNRESET, "set is gone");
+    else if (!send_slot(slot, &msg, status))
+        complete(rset, &msg, status, EIO, "send failed");
+}
+
+/* status callback for a message that was not sent */
+static void complete(resset_t          *rset,
+                     resmsg_notify_t   *notify,
+                     resproto_status_t  status,
+                     int32_t            errcod,
+                     const char        *errmsg)
+{
+    resmsg_t reply;
+
+    if (status != NULL) {
+        memset(&reply, 0, sizeof(reply));
+        reply.status.type   = RESMSG_STATUS;
+        reply.status.id     = notify->id;
+        reply.status.reqno  = notify->reqno;
+        reply.status.errcod = errcod;
+        reply.status.errmsg = errmsg;
+
+        status(rset, &reply);
+    }
+}
+
+static void acked(slot_t *slot, resmsg_t *reply)
+{
+    resproto_status_t status = slot->status;
+
+    slot->inflight = FALSE;
+    slot->status   = NULL;
+
+    if (status != NULL)
+        status(slot->rset, reply);
+
+    flush_slot(slot);
+}
+
+static void grant_acked(resset_t *rset, resmsg_t *reply)
+{
+    acked(&((coalesce_t *)rset->coalesce)->grant, reply);
+}
+
+static void advice_acked(resset_t *rset, resmsg_t *reply)
+{
+    acked(&((coalesce_t *)rset->coalesce)->advice, reply);
+}
+
+static int window_end(void *data)
+{
+    slot_t *slot = data;
+
+    slot->timer = NULL;
+
+    flush_slot(slot);
+
+    return FALSE;
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -26,13 +26,24 @@ USA.
 #include <res-conn.h>
 
 resconn_t *resconn_init(resproto_role_t, resproto_transport_t, va_list);
+void       resconn_destroy(resconn_t *);
+void       resconn_release(resconn_t *);
 
 resconn_reply_t *resconn_reply_create(resmsg_type_t, uint32_t, uint32_t,
                                       resset_t *, resproto_status_t);
 void             resconn_reply_destroy(void *);
 resconn_reply_t *resconn_reply_find(resconn_t *, uint32_t);
+void             resconn_reply_complete(resconn_reply_t *, int32_t, int);
 
 
+void       resconn_stats_sent(resconn_t *, resmsg_t *, int);
+void       resconn_stats_received(resconn_t *, resmsg_t *, uint64_t);
+void       resconn_stats_status(resconn_t *, resmsg_type_t, int32_t, int);
+uint64_t   resconn_stats_clock(void);
+
+
+void       resconn_list_lock(void);
+void       resconn_list_unlock(void);
 resconn_t *resconn_list_iterate(resconn_t *);
 
 #endif /* __RES_CONN_PRIVATE_H__ */
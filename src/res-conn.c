@@ -24,14 +24,21 @@ USA.
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "res-conn-private.h"
 #include "res-set-private.h"
+#include "res-hist-private.h"
+#include "res-alloc-private.h"
+#include "res-probe.h"
 #include "dbus-proto.h"
 #include "internal-proto.h"
 #include "visibility.h"
 
-static resconn_t     *resconn_list;
+static resconn_t       *resconn_list;
+static pthread_mutex_t  resconn_lock;
+static pthread_once_t   resconn_once = PTHREAD_ONCE_INIT;
 
 #define VALID   1
 #define INVALID 0
@@ -66,7 +73,11 @@ static int client_valid_message[RESMSG_MAX] = {
 static int manager_link_handler(resconn_t *, char *, resproto_linkst_t);
 static int client_link_handler(resconn_t *, char *, resproto_linkst_t);
 
+static uint32_t message_size(resmsg_t *);
+
+static void resconn_list_init(void);
 static void resconn_list_add(resconn_t *);
+static void resconn_list_remove(resconn_t *);
 
 
 resconn_t *resconn_init(resproto_role_t       role,
@@ -81,7 +92,11 @@ resconn_t *resconn_init(resproto_role_t       role,
     if ((rcon = malloc(sizeof(resconn_t))) != NULL) {
 
         memset(rcon, 0, sizeof(resconn_t));
+
+        resconn_list_lock();
         rcon->any.id      = ++id;
+        resconn_list_unlock();
+
         rcon->any.role    = role;
         rcon->any.transp  = transp;
 
@@ -139,6 +154,67 @@ resconn_t *resconn_init(resproto_role_t       role,
     return NULL;
 }
 
+/*
+ * The transport is detached right away, so nothing calls into the
+ * connection any more. Pending replies, sets and queued messages may
+ * still refer to it; then it is freed by resconn_release() when the
+ * last of them goes away.
+ */
+void resconn_destroy(resconn_t *rcon)
+{
+    resset_t *rset;
+    resset_t *next;
+
+    if (rcon->any.killed)
+        return;
+
+    for (rset = rcon->any.rsets;  rset != NULL;  rset = next) {
+        next = rset->next;
+        rcon->any.disconn(rset);
+    }
+
+    rcon->any.killed = TRUE;
+
+    switch (rcon->any.transp) {
+    case RESPROTO_TRANSPORT_DBUS:
+        resproto_dbus_destroy(&rcon->dbus);
+        break;
+    case RESPROTO_TRANSPORT_INTERNAL:
+        resproto_internal_destroy(&rcon->internal);
+        break;
+    default:
+        break;
+    }
+
+    resconn_release(rcon);
+}
+
+void resconn_release(resconn_t *rcon)
+{
+    int idle;
+
+    if (rcon == NULL || !rcon->any.killed ||
+        rcon->any.rsets != NULL || rcon->any.replies != NULL)
+        return;
+
+    switch (rcon->any.transp) {
+    case RESPROTO_TRANSPORT_DBUS:
+        idle = resproto_dbus_release(&rcon->dbus);
+        break;
+    case RESPROTO_TRANSPORT_INTERNAL:
+        idle = resproto_internal_release(&rcon->internal);
+        break;
+    default:
+        idle = TRUE;
+        break;
+    }
+
+    if (idle) {
+        resconn_list_remove(rcon);
+        free(rcon);
+    }
+}
+
 
 EXPORT resset_t *resconn_connect(resconn_t         *rcon,
                                  resmsg_t          *resmsg,
@@ -154,6 +230,13 @@ EXPORT resset_t *resconn_connect(resconn_t         *rcon,
     }
     else {
         rset = rcon->any.connect(rcon, resmsg);
+
+        /* the manager numbers the notifications of a new set from 1 */
+        if (rset != NULL) {
+            rset->seqno.grant  = 0;
+            rset->seqno.advice = 0;
+        }
+
         rcon->any.send(rset, resmsg, status);
     }
 
@@ -195,16 +278,22 @@ resconn_reply_t *resconn_reply_create(resmsg_type_t       type,
     for (last = (void *)&rcon->replies;   last->next;   last = last->next)
         ;
 
-    if ((reply = malloc(sizeof(resconn_reply_t))) != NULL) {
+    if ((reply = RESALLOC_MALLOC(REPLY, sizeof(resconn_reply_t))) != NULL) {
         memset(reply, 0, sizeof(resconn_reply_t));
         reply->type     = type;
         reply->serial   = serial;
         reply->reqno    = reqno;
         reply->callback = status;
         reply->rset     = rset;
+        reply->stamp    = resconn_stats_clock();
         resset_ref(rset);
                 
         last->next = reply;
+
+        RESPROBE(reply_create, type, rset->id, reqno, serial);
+
+        if (++rcon->stats.pending > rcon->stats.pending_peak)
+            rcon->stats.pending_peak = rcon->stats.pending;
     }
 
     return reply;
@@ -227,7 +316,8 @@ void resconn_reply_destroy(void *ptr)
             {
                 if (prev->next == reply) {
                     prev->next = reply->next;
-                    free(reply);
+                    rcon->any.stats.pending--;
+                    RESALLOC_FREE(REPLY, reply);
                     break;
                 }
             }
@@ -248,6 +338,80 @@ resconn_reply_t *resconn_reply_find(resconn_t *rcon, uint32_t serial)
     return reply;
 }
 
+/*
+ * Called when the status of a sent message arrived or it timed out.
+ */
+void resconn_reply_complete(resconn_reply_t *reply,
+                            int32_t          errcod,
+                            int              timedout)
+{
+    uint64_t elapsed;
+
+    RESPROBE_EXT(reply_complete, reply->type, reply->rset->id, reply->reqno,
+                 reply->serial, errcod, timedout);
+
+    resconn_stats_status(reply->rset->resconn, reply->type, errcod, timedout);
+
+    if (!timedout) {
+        elapsed = resconn_stats_clock() - reply->stamp;
+        reshist_add_roundtrip(reply->type, elapsed);
+    }
+}
+
+
+void resconn_stats_sent(resconn_t *rcon, resmsg_t *msg, int success)
+{
+    resproto_stats_t *stats = &rcon->any.stats;
+
+    if (!success) {
+        if (msg->type >= 0 && msg->type < RESMSG_MAX)
+            stats->msg[msg->type].failed++;
+    }
+    else {
+        if (msg->type >= 0 && msg->type < RESMSG_MAX)
+            stats->msg[msg->type].sent++;
+
+        stats->bytes_sent += message_size(msg);
+    }
+}
+
+void resconn_stats_received(resconn_t *rcon, resmsg_t *msg, uint64_t ns)
+{
+    resproto_stats_t *stats = &rcon->any.stats;
+
+    stats->msg[msg->type].received++;
+    stats->bytes_received += message_size(msg);
+    stats->dispatch_ns    += ns;
+}
+
+void resconn_stats_status(resconn_t     *rcon,
+                          resmsg_type_t  type,
+                          int32_t        errcod,
+                          int            timedout)
+{
+    resproto_msgstats_t *stats;
+
+    if (type >= 0 && type < RESMSG_MAX) {
+        stats = rcon->any.stats.msg + type;
+
+        if (timedout)
+            stats->timedout++;
+        else if (errcod)
+            stats->failed++;
+        else
+            stats->replied++;
+    }
+}
+
+uint64_t resconn_stats_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 
 static int manager_link_handler(resconn_t         *rcon,
                                 char              *peer,
@@ -262,6 +426,8 @@ static int manager_link_handler(resconn_t         *rcon,
 
     (void)state;                /* supposed to be always RESPROTO_LINK_DOWN */
 
+    RESPROBE_LINK(link_down, peer, rcon->any.role);
+
     found   = FALSE;
     handler = rcon->any.handler[RESMSG_UNREGISTER];
 
@@ -297,11 +463,15 @@ static int client_link_handler(resconn_t         *rcon,
     switch (state) {
 
     case RESPROTO_LINK_UP:
+        RESPROBE_LINK(link_up, peer, rcon->any.role);
+
         if (rcon->any.mgrup)
             rcon->any.mgrup(rcon);
         break;
 
     case RESPROTO_LINK_DOWN:
+        RESPROBE_LINK(link_down, peer, rcon->any.role);
+
         handler = rcon->any.handler[RESMSG_UNREGISTER];
 
         memset(&resmsg, 0, sizeof(resmsg));
@@ -327,12 +497,58 @@ static int client_link_handler(resconn_t         *rcon,
 }
 
 
+/*
+ * Connections can be created and destroyed from any thread (e.g. the
+ * client library runs each context in the thread of its main loop),
+ * so the list is protected by a lock. Iterators have to hold it and
+ * it is recursive since they call back to the protocol handlers.
+ */
+void resconn_list_lock(void)
+{
+    pthread_once(&resconn_once, resconn_list_init);
+    pthread_mutex_lock(&resconn_lock);
+}
+
+void resconn_list_unlock(void)
+{
+    pthread_mutex_unlock(&resconn_lock);
+}
+
+static void resconn_list_init(void)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&resconn_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
 static void resconn_list_add(resconn_t *rcon)
 {
     if (rcon != NULL) {
+        resconn_list_lock();
         rcon->any.next  = resconn_list;
         resconn_list = rcon;
+        resconn_list_unlock();
+    }
+}
+
+static void resconn_list_remove(resconn_t *rcon)
+{
+    resconn_t *prev;
+
+    resconn_list_lock();
+
+    for (prev = (resconn_t *)&resconn_list;  prev->any.next;  ) {
+        if (prev->any.next == rcon) {
+            prev->any.next = rcon->any.next;
+            break;
+        }
+        prev = prev->any.next;
     }
+
+    resconn_list_unlock();
 }
 
 resconn_t *resconn_list_iterate(resconn_t *rcon)
@@ -343,6 +559,63 @@ resconn_t *resconn_list_iterate(resconn_t *rcon)
     return rcon->any.next;
 }
 
+#define STRSIZ(s)   (sizeof(uint32_t) + ((s) ? strlen(s) : 0) + 1)
+#define MASKSIZ(m)  (((m) >> RESOURCE_NARROW_BITS) ? sizeof(uint64_t) : \
+                                                     sizeof(uint32_t))
+
+/*
+ * Size of the message payload as it goes to the wire, ie. fixed size
+ * fields, masks as narrow as they fit and length prefixed, zero
+ * terminated strings, with the optional trailing arguments.
+ */
+static uint32_t message_size(resmsg_t *msg)
+{
+    uint32_t           size = 3 * sizeof(uint32_t);
+    resmsg_rset_t     *rset;
+    resmsg_property_t *prop;
+    uint32_t           i;
+
+    switch (msg->type) {
+    case RESMSG_REGISTER:
+    case RESMSG_UPDATE:
+        rset  = &msg->record.rset;
+        size += 4 * MASKSIZ(rset->all | rset->opt | rset->share | rset->mask) +
+                sizeof(uint32_t) +
+                STRSIZ(msg->record.app_id) + STRSIZ(msg->record.klass);
+        if (msg->type == RESMSG_REGISTER)
+            size += sizeof(uint32_t);           /* capabilities */
+        break;
+    case RESMSG_GRANT:
+    case RESMSG_ADVICE:
+        size += MASKSIZ(msg->notify.resrc) + sizeof(uint32_t);
+        break;
+    case RESMSG_AUDIO:
+        size += STRSIZ(msg->audio.group) + STRSIZ(msg->audio.app_id) +
+                STRSIZ(msg->audio.property.name) + sizeof(uint32_t) +
+                STRSIZ(msg->audio.property.match.pattern);
+        for (i = 0;  msg->audio.extra && i < msg->audio.nextra;  i++) {
+            prop  = msg->audio.extra + i;
+            size += STRSIZ(prop->name) + sizeof(uint32_t) +
+                    STRSIZ(prop->match.pattern);
+        }
+        break;
+    case RESMSG_VIDEO:
+        size += sizeof(uint32_t);
+        break;
+    case RESMSG_STATUS:
+        size += sizeof(int32_t) + STRSIZ(msg->status.errmsg) +
+                sizeof(uint32_t);               /* capabilities */
+        break;
+    default:
+        break;
+    }
+
+    return size;
+}
+
+#undef STRSIZ
+#undef MASKSIZ
+
 /* 
  * Local Variables:
  * c-basic-offset: 4
@@ -47,6 +47,13 @@ typedef int         (*resconn_timercb_t)  (void *);
 typedef void       *(*resconn_timer_add_t)(uint32_t,resconn_timercb_t,void*);
 typedef void        (*resconn_timer_del_t)(void *);
 
+typedef struct {
+    int                      enabled;
+    uint32_t                 window;    /* in msec, 0 if none */
+    resconn_timer_add_t      add;
+    resconn_timer_del_t      del;
+} resconn_coalesce_t;
+
 typedef struct resconn_reply_s {
     struct resconn_reply_s  *next;
     uint32_t                 serial;    /* msg sequence number, if applies */
@@ -56,6 +63,7 @@ typedef struct resconn_reply_s {
     resset_t                *rset;
     void                    *timer;     /* timer, if applies */
     void                    *data;      /* timer data, if applies */
+    uint64_t                 stamp;     /* when the message was sent */
 } resconn_reply_t;             
 
 #define RESCONN_QUEUE_LINK        \
@@ -89,7 +97,9 @@ typedef struct {
     int                     *valid;                    \
     resproto_handler_t       handler[RESMSG_MAX];      \
     resconn_linkup_t         mgrup;                    \
-    int                      killed
+    int                      killed;                   \
+    resconn_coalesce_t       coalesce;                 \
+    resproto_stats_t         stats
 
 
 typedef struct {
@@ -101,6 +111,7 @@ typedef struct {
     DBusConnection       *conn;
     char                 *dbusid;
     char                 *path;
+    int                   exported; /* offers the stats interface */
 } resconn_dbus_t;
 
 typedef struct {
@@ -127,6 +138,19 @@ typedef union resconn_u {
 resset_t  *resconn_connect(resconn_t *, resmsg_t *, resproto_status_t);
 int        resconn_disconnect(resset_t *, resmsg_t *, resproto_status_t);
 
+/*
+ * Coalescing of the GRANT and ADVICE messages a manager sends. While
+ * a notification of a set is waiting for the client to acknowledge it,
+ * or for 'window' msec after it was sent, later ones of the same type
+ * are held back and only the latest of them is sent when that is over.
+ * The status callbacks of the superseded ones are called with
+ * ECANCELED. Only clients with RESMSG_CAP_NOTIFY_ACK acknowledge; with
+ * older ones only the window applies. The timer functions are needed
+ * for a window; the internal transport defaults to its own.
+ */
+int        resconn_set_coalescing(resconn_t *, int, uint32_t,
+                                  resconn_timer_add_t, resconn_timer_del_t);
+
 
 
 #ifdef	__cplusplus
@@ -0,0 +1,212 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "res-hist-private.h"
+
+#include "visibility.h"
+
+#ifndef TRUE
+#define FALSE 0
+#define TRUE  1
+#endif
+
+#define SUB_BUCKETS  (1 << RESHIST_SUB_BITS)
+#define VALUE_MAX    ((1ULL << RESHIST_MAX_BITS) - 1)
+
+static reshist_t       roundtrip[RESMSG_MAX];
+static pthread_once_t  roundtrip_once = PTHREAD_ONCE_INIT;
+
+static int  bucket_index(uint64_t);
+static void roundtrip_init(void);
+
+
+EXPORT void reshist_reset(reshist_t *hist)
+{
+    memset(hist, 0, sizeof(reshist_t));
+    hist->min = UINT64_MAX;
+}
+
+EXPORT void reshist_add(reshist_t *hist, uint64_t value)
+{
+    uint64_t cur;
+
+    __atomic_fetch_add(&hist->bucket[bucket_index(value)],1,__ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum, value, __ATOMIC_RELAXED);
+
+    cur = __atomic_load_n(&hist->min, __ATOMIC_RELAXED);
+    while (value < cur &&
+           !__atomic_compare_exchange_n(&hist->min, &cur, value, TRUE,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+
+    cur = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    while (value > cur &&
+           !__atomic_compare_exchange_n(&hist->max, &cur, value, TRUE,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+
+    __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Returns the upper bound of the bucket containing the given percentile
+ * (0 - 100), clamped to the observed range.
+ */
+EXPORT uint64_t reshist_percentile(reshist_t *hist, double percentile)
+{
+    uint64_t count = __atomic_load_n(&hist->count, __ATOMIC_ACQUIRE);
+    uint64_t rank;
+    uint64_t sum;
+    uint64_t value;
+    int      i;
+
+    if (count == 0)
+        return 0;
+
+    rank = (uint64_t)(percentile / 100.0 * count + 0.999999);
+
+    if (rank < 1)
+        rank = 1;
+    if (rank > count)
+        rank = count;
+
+    for (i = 0, sum = 0;  i < RESHIST_BUCKETS - 1;  i++) {
+        if ((sum += hist->bucket[i]) >= rank)
+            break;
+    }
+
+    value = reshist_bucket_high(i);
+
+    if (value > hist->max)
+        value = hist->max;
+    if (value < hist->min)
+        value = hist->min;
+
+    return value;
+}
+
+EXPORT uint64_t reshist_bucket_low(int idx)
+{
+    int exp;
+    int sub;
+
+    if (idx < SUB_BUCKETS)
+        return idx;
+
+    exp = (idx >> RESHIST_SUB_BITS) + RESHIST_SUB_BITS - 1;
+    sub = idx & (SUB_BUCKETS - 1);
+
+    return (uint64_t)(SUB_BUCKETS + sub) << (exp - RESHIST_SUB_BITS);
+}
+
+EXPORT uint64_t reshist_bucket_high(int idx)
+{
+    return reshist_bucket_low(idx + 1) - 1;
+}
+
+/*
+ * One line summary, times in microseconds:
+ *
+ *   <name>: count <n> min <t> p50 <t> p90 <t> p99 <t> p999 <t> max <t>
+ */
+EXPORT char *reshist_dump(reshist_t *hist, const char *name, char *buf,int len)
+{
+    uint64_t count;
+
+    if (!buf || len < 1)
+        return "";
+
+    if ((count = hist->count) == 0)
+        snprintf(buf, len, "%s: count 0", name);
+    else {
+        snprintf(buf, len, "%s: count %llu min %.1f p50 %.1f p90 %.1f "
+                 "p99 %.1f p999 %.1f max %.1f", name,
+                 (unsigned long long)count,
+                 (double)hist->min / 1000.0,
+                 (double)reshist_percentile(hist, 50.0)  / 1000.0,
+                 (double)reshist_percentile(hist, 90.0)  / 1000.0,
+                 (double)reshist_percentile(hist, 99.0)  / 1000.0,
+                 (double)reshist_percentile(hist, 99.9)  / 1000.0,
+                 (double)hist->max / 1000.0);
+    }
+
+    return buf;
+}
+
+EXPORT int reshist_get_roundtrip(resmsg_type_t type, reshist_t *hist)
+{
+    if (type < 0 || type >= RESMSG_MAX || hist == NULL)
+        return FALSE;
+
+    pthread_once(&roundtrip_once, roundtrip_init);
+
+    memcpy(hist, roundtrip + type, sizeof(reshist_t));
+
+    return TRUE;
+}
+
+void reshist_add_roundtrip(resmsg_type_t type, uint64_t value)
+{
+    if (type >= 0 && type < RESMSG_MAX) {
+        pthread_once(&roundtrip_once, roundtrip_init);
+        reshist_add(roundtrip + type, value);
+    }
+}
+
+
+static int bucket_index(uint64_t value)
+{
+    int exp;
+
+    if (value > VALUE_MAX)
+        value = VALUE_MAX;
+
+    if (value < SUB_BUCKETS)
+        return value;
+
+    exp = 63 - __builtin_clzll(value);
+
+    return ((exp - RESHIST_SUB_BITS + 1) << RESHIST_SUB_BITS) +
+           ((value >> (exp - RESHIST_SUB_BITS)) & (SUB_BUCKETS - 1));
+}
+
+static void roundtrip_init(void)
+{
+    int i;
+
+    for (i = 0;  i < RESMSG_MAX;  i++)
+        reshist_reset(roundtrip + i);
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,77 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __RES_HIST_H__
+#define __RES_HIST_H__
+
+#include <stdint.h>
+
+#include <res-msg.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Log-bucketed latency histogram of nanosecond values. Every power of
+ * two is split into 1 << RESHIST_SUB_BITS buckets, so any percentile is
+ * accurate within 12.5%. Values beyond about 73 minutes go to the last
+ * bucket. Adding a value is lock-free and can be done from any thread.
+ */
+
+#define RESHIST_SUB_BITS   3
+#define RESHIST_MAX_BITS   42
+#define RESHIST_BUCKETS    ((RESHIST_MAX_BITS - RESHIST_SUB_BITS + 1) << \
+                            RESHIST_SUB_BITS)
+
+typedef struct {
+    uint64_t   count;
+    uint64_t   sum;
+    uint64_t   min;
+    uint64_t   max;
+    uint32_t   bucket[RESHIST_BUCKETS];
+} reshist_t;
+
+void      reshist_reset(reshist_t *);
+void      reshist_add(reshist_t *, uint64_t);
+uint64_t  reshist_percentile(reshist_t *, double);
+uint64_t  reshist_bucket_low(int);
+uint64_t  reshist_bucket_high(int);
+char     *reshist_dump(reshist_t *, const char *, char *, int);
+
+/* request -> status round trips of all connections of the process */
+int       reshist_get_roundtrip(resmsg_type_t, reshist_t *);
+
+#ifdef	__cplusplus
+};
+#endif
+
+#endif /* __RES_HIST_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,566 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <regex.h>
+
+#include "res-match.h"
+#include "res-registry-private.h"
+#include "visibility.h"
+
+#ifndef TRUE
+#define FALSE 0
+#define TRUE  1
+#endif
+
+#define EQUALS_MIN_SIZE  16
+
+typedef struct cond_s   cond_t;
+typedef struct node_s   node_t;
+typedef struct regexp_s regexp_t;
+typedef struct prop_s   prop_t;
+
+/* one property of a rule, linked to where its pattern is indexed */
+struct cond_s {
+    cond_t            *next;
+    cond_t           **prev;
+    resmatch_rule_t   *rule;
+    prop_t            *prop;
+    resmsg_match_method_t method;
+    union {
+        char          *value;       /* equals */
+        node_t        *node;        /* startswith */
+        regexp_t      *regexp;      /* matches */
+    }                  at;
+    uint32_t           stamp;       /* stream it was last found in */
+};
+
+struct resmatch_rule_s {
+    resmatch_rule_t   *next;
+    resmatch_rule_t  **prev;
+    void              *data;
+    uint32_t           stamp;       /* stream 'hits' counts for */
+    uint32_t           hits;
+    uint32_t           ncond;
+    cond_t             cond[];
+};
+
+/* prefix trie node; the conditions are the ones ending here */
+struct node_s {
+    node_t            *parent;
+    node_t            *child;
+    node_t            *sibling;
+    cond_t            *conds;
+    unsigned char      c;
+};
+
+struct regexp_s {
+    regexp_t          *next;
+    regexp_t         **prev;
+    char              *pattern;
+    regex_t            regex;
+    cond_t            *conds;
+};
+
+struct prop_s {
+    prop_t            *next;
+    char              *name;
+    cond_t           **equals;      /* hash chains by value */
+    uint32_t           size;
+    uint32_t           count;
+    node_t             root;
+    regexp_t          *regexps;
+};
+
+struct resmatch_s {
+    prop_t            *props;
+    resmatch_rule_t   *rules;
+    uint32_t           stamp;
+};
+
+static prop_t   *find_prop(resmatch_t *, const char *);
+static prop_t   *get_prop(resmatch_t *, const char *);
+static void      free_prop(prop_t *);
+static int       add_cond(prop_t *, cond_t *, const char *);
+static void      remove_cond(cond_t *);
+static int       add_equals(prop_t *, cond_t *, const char *);
+static int       grow_equals(prop_t *);
+static int       add_prefix(prop_t *, cond_t *, const char *);
+static void      prune_node(node_t *);
+static void      free_nodes(node_t *);
+static int       add_regexp(prop_t *, cond_t *, const char *);
+static void      free_regexp(regexp_t *);
+static void      link_cond(cond_t **, cond_t *);
+static int       match_prop(prop_t *, const char *, uint32_t,
+                            resmatch_found_t, void *);
+static int       found_cond(cond_t *, uint32_t, resmatch_found_t, void *);
+
+
+EXPORT resmatch_t *resmatch_create(void)
+{
+    return calloc(1, sizeof(resmatch_t));
+}
+
+EXPORT void resmatch_destroy(resmatch_t *rm)
+{
+    prop_t *prop;
+
+    if (rm != NULL) {
+        while (rm->rules != NULL)
+            resmatch_remove(rm, rm->rules);
+
+        while ((prop = rm->props) != NULL) {
+            rm->props = prop->next;
+            free_prop(prop);
+        }
+
+        free(rm);
+    }
+}
+
+
+EXPORT resmatch_rule_t *resmatch_add(resmatch_t     *rm,
+                                     resmsg_audio_t *audio,
+                                     void           *data)
+{
+    resmatch_rule_t   *rule;
+    resmsg_property_t *property;
+    prop_t            *prop;
+    uint32_t           ncond;
+    uint32_t           i;
+
+    if (rm == NULL || audio == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    ncond = 1 + (audio->extra ? audio->nextra : 0);
+
+    if ((rule = calloc(1, sizeof(*rule) + ncond * sizeof(cond_t))) == NULL)
+        return NULL;
+
+    rule->data = data;
+
+    if ((rule->next = rm->rules) != NULL)
+        rule->next->prev = &rule->next;
+    rule->prev = &rm->rules;
+    rm->rules  = rule;
+
+    for (i = 0;  i < ncond;  i++) {
+        property = i ? audio->extra + (i-1) : &audio->property;
+
+        rule->cond[i].rule   = rule;
+        rule->cond[i].method = property->match.method;
+
+        if ((prop = get_prop(rm, property->name ? property->name : "")) == NULL ||
+            !add_cond(prop, rule->cond + i, property->match.pattern ?
+                                            property->match.pattern : ""))
+        {
+            resmatch_remove(rm, rule);
+            return NULL;
+        }
+
+        rule->ncond = i + 1;
+    }
+
+    return rule;
+}
+
+EXPORT void resmatch_remove(resmatch_t *rm, resmatch_rule_t *rule)
+{
+    uint32_t i;
+
+    (void)rm;
+
+    if (rule != NULL) {
+        for (i = 0;  i < rule->ncond;  i++)
+            remove_cond(rule->cond + i);
+
+        if ((*rule->prev = rule->next) != NULL)
+            rule->next->prev = rule->prev;
+
+        free(rule);
+    }
+}
+
+
+EXPORT int resmatch_stream(resmatch_t       *rm,
+                           resmatch_prop_t  *props,
+                           int               nprop,
+                           resmatch_found_t  found,
+                           void             *user_data)
+{
+    prop_t   *prop;
+    uint32_t  stamp;
+    int       count = 0;
+    int       i;
+
+    if (rm == NULL || (props == NULL && nprop > 0))
+        return 0;
+
+    /* zero is the stamp of the conditions never found */
+    if ((stamp = ++rm->stamp) == 0)
+        stamp = rm->stamp = 1;
+
+    for (i = 0;  i < nprop;  i++) {
+        if (props[i].name && (prop = find_prop(rm, props[i].name)) != NULL) {
+            count += match_prop(prop, props[i].value ? props[i].value : "",
+                                stamp, found, user_data);
+        }
+    }
+
+    return count;
+}
+
+
+static prop_t *find_prop(resmatch_t *rm, const char *name)
+{
+    prop_t *prop;
+
+    for (prop = rm->props;  prop != NULL;  prop = prop->next) {
+        if (!strcmp(prop->name, name))
+            break;
+    }
+
+    return prop;
+}
+
+static prop_t *get_prop(resmatch_t *rm, const char *name)
+{
+    prop_t *prop;
+
+    if ((prop = find_prop(rm, name)) == NULL) {
+        if ((prop = calloc(1, sizeof(prop_t))) == NULL)
+            return NULL;
+
+        if ((prop->name = strdup(name)) == NULL) {
+            free(prop);
+            return NULL;
+        }
+
+        prop->next = rm->props;
+        rm->props  = prop;
+    }
+
+    return prop;
+}
+
+static void free_prop(prop_t *prop)
+{
+    regexp_t *regexp;
+
+    while ((regexp = prop->regexps) != NULL)
+        free_regexp(regexp);
+
+    free_nodes(prop->root.child);
+    free(prop->equals);
+    free(prop->name);
+    free(prop);
+}
+
+
+static int add_cond(prop_t *prop, cond_t *cond, const char *pattern)
+{
+    cond->prop = prop;
+
+    switch (cond->method) {
+    case resmsg_method_equals:     return add_equals(prop, cond, pattern);
+    case resmsg_method_startswith: return add_prefix(prop, cond, pattern);
+    case resmsg_method_matches:    return add_regexp(prop, cond, pattern);
+    default:                       errno = EINVAL;   return FALSE;
+    }
+}
+
+static void remove_cond(cond_t *cond)
+{
+    regexp_t *regexp;
+
+    if ((*cond->prev = cond->next) != NULL)
+        cond->next->prev = cond->prev;
+
+    switch (cond->method) {
+
+    case resmsg_method_equals:
+        cond->prop->count--;
+        free(cond->at.value);
+        break;
+
+    case resmsg_method_startswith:
+        prune_node(cond->at.node);
+        break;
+
+    case resmsg_method_matches:
+        if ((regexp = cond->at.regexp)->conds == NULL)
+            free_regexp(regexp);
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+static int add_equals(prop_t *prop, cond_t *cond, const char *value)
+{
+    uint32_t idx;
+
+    if (prop->count >= prop->size && !grow_equals(prop))
+        return FALSE;
+
+    if ((cond->at.value = strdup(value)) == NULL)
+        return FALSE;
+
+    idx = resreg_hash(value, 0) & (prop->size - 1);
+
+    link_cond(prop->equals + idx, cond);
+    prop->count++;
+
+    return TRUE;
+}
+
+static int grow_equals(prop_t *prop)
+{
+    cond_t   **equals;
+    cond_t    *cond;
+    uint32_t   size;
+    uint32_t   i;
+    uint32_t   idx;
+
+    size = prop->size ? prop->size * 2 : EQUALS_MIN_SIZE;
+
+    if ((equals = calloc(size, sizeof(cond_t *))) == NULL)
+        return FALSE;
+
+    for (i = 0;  i < prop->size;  i++) {
+        while ((cond = prop->equals[i]) != NULL) {
+            prop->equals[i] = cond->next;
+
+            idx = resreg_hash(cond->at.value, 0) & (size - 1);
+            link_cond(equals + idx, cond);
+        }
+    }
+
+    free(prop->equals);
+
+    prop->equals = equals;
+    prop->size   = size;
+
+    return TRUE;
+}
+
+static int add_prefix(prop_t *prop, cond_t *cond, const char *prefix)
+{
+    const unsigned char *p;
+    node_t              *node;
+    node_t              *child;
+
+    for (node = &prop->root, p = (const unsigned char *)prefix;  *p;  p++) {
+        for (child = node->child;  child != NULL;  child = child->sibling) {
+            if (child->c == *p)
+                break;
+        }
+
+        if (child == NULL) {
+            if ((child = calloc(1, sizeof(node_t))) == NULL) {
+                prune_node(node);
+                return FALSE;
+            }
+
+            child->parent  = node;
+            child->c       = *p;
+            child->sibling = node->child;
+            node->child    = child;
+        }
+
+        node = child;
+    }
+
+    cond->at.node = node;
+    link_cond(&node->conds, cond);
+
+    return TRUE;
+}
+
+/* free the nodes no prefix ends at or below */
+static void prune_node(node_t *node)
+{
+    node_t  *parent;
+    node_t **link;
+
+    while ((parent = node->parent) != NULL && !node->conds && !node->child) {
+        for (link = &parent->child;  *link != node;  link = &(*link)->sibling)
+            ;
+
+        *link = node->sibling;
+        free(node);
+
+        node = parent;
+    }
+}
+
+static void free_nodes(node_t *node)
+{
+    node_t *sibling;
+
+    for (;  node != NULL;  node = sibling) {
+        sibling = node->sibling;
+        free_nodes(node->child);
+        free(node);
+    }
+}
+
+static int add_regexp(prop_t *prop, cond_t *cond, const char *pattern)
+{
+    regexp_t *regexp;
+
+    for (regexp = prop->regexps;  regexp != NULL;  regexp = regexp->next) {
+        if (!strcmp(regexp->pattern, pattern))
+            break;
+    }
+
+    if (regexp == NULL) {
+        if ((regexp = calloc(1, sizeof(regexp_t))) == NULL)
+            return FALSE;
+
+        if ((regexp->pattern = strdup(pattern)) == NULL) {
+            free(regexp);
+            return FALSE;
+        }
+
+        if (regcomp(&regexp->regex, pattern, REG_EXTENDED | REG_NOSUB)) {
+            free(regexp->pattern);
+            free(regexp);
+            errno = EINVAL;
+            return FALSE;
+        }
+
+        if ((regexp->next = prop->regexps) != NULL)
+            regexp->next->prev = &regexp->next;
+        regexp->prev  = &prop->regexps;
+        prop->regexps = regexp;
+    }
+
+    cond->at.regexp = regexp;
+    link_cond(&regexp->conds, cond);
+
+    return TRUE;
+}
+
+static void free_regexp(regexp_t *regexp)
+{
+    if ((*regexp->prev = regexp->next) != NULL)
+        regexp->next->prev = regexp->prev;
+
+    regfree(&regexp->regex);
+    free(regexp->pattern);
+    free(regexp);
+}
+
+static void link_cond(cond_t **head, cond_t *cond)
+{
+    if ((cond->next = *head) != NULL)
+        cond->next->prev = &cond->next;
+
+    cond->prev = head;
+    *head = cond;
+}
+
+
+static int match_prop(prop_t           *prop,
+                      const char       *value,
+                      uint32_t          stamp,
+                      resmatch_found_t  found,
+                      void             *user_data)
+{
+    const unsigned char *p;
+    node_t              *node;
+    regexp_t            *regexp;
+    cond_t              *cond;
+    int                  count = 0;
+
+    if (prop->count > 0) {
+        cond = prop->equals[resreg_hash(value, 0) & (prop->size - 1)];
+
+        for (;  cond != NULL;  cond = cond->next) {
+            if (!strcmp(cond->at.value, value))
+                count += found_cond(cond, stamp, found, user_data);
+        }
+    }
+
+    for (node = &prop->root, p = (const unsigned char *)value;  node;  p++) {
+        for (cond = node->conds;  cond != NULL;  cond = cond->next)
+            count += found_cond(cond, stamp, found, user_data);
+
+        if (!*p)
+            break;
+
+        for (node = node->child;  node && node->c != *p;  node = node->sibling)
+            ;
+    }
+
+    for (regexp = prop->regexps;  regexp != NULL;  regexp = regexp->next) {
+        if (regexp->conds && !regexec(&regexp->regex, value, 0, NULL, 0)) {
+            for (cond = regexp->conds;  cond != NULL;  cond = cond->next)
+                count += found_cond(cond, stamp, found, user_data);
+        }
+    }
+
+    return count;
+}
+
+static int found_cond(cond_t           *cond,
+                      uint32_t          stamp,
+                      resmatch_found_t  found,
+                      void             *user_data)
+{
+    resmatch_rule_t *rule = cond->rule;
+
+    /* a stream may have the same property more than once */
+    if (cond->stamp == stamp)
+        return 0;
+
+    cond->stamp = stamp;
+
+    if (rule->stamp != stamp) {
+        rule->stamp = stamp;
+        rule->hits  = 0;
+    }
+
+    if (++rule->hits < rule->ncond)
+        return 0;
+
+    if (found != NULL)
+        found(rule->data, user_data);
+
+    return 1;
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
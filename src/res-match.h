@@ -0,0 +1,91 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __RES_MATCH_H__
+#define __RES_MATCH_H__
+
+#include <res-msg.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Matching of audio streams against the properties of resource sets,
+ * for managers. The properties of a set are compiled into a rule once,
+ * when its AUDIO message arrives: equals patterns go to a hash table
+ * and startswith patterns to a prefix trie per property name, matches
+ * patterns are compiled as POSIX extended regular expressions, each
+ * distinct one only once. A stream is matched by looking up its
+ * properties, so the cost depends on the number of rules that match,
+ * not on the number of rules there are; only the distinct regular
+ * expressions of a property are tried one by one.
+ *
+ * A rule matches when every one of its properties does. Matchers are
+ * not thread-safe.
+ */
+
+typedef struct resmatch_s       resmatch_t;
+typedef struct resmatch_rule_s  resmatch_rule_t;
+
+typedef struct {
+    const char  *name;
+    const char  *value;
+} resmatch_prop_t;
+
+/* called with the data of every matching rule */
+typedef void (*resmatch_found_t)(void *data, void *user_data);
+
+resmatch_t      *resmatch_create(void);
+void             resmatch_destroy(resmatch_t *);
+
+/*
+ * Compile the properties of 'audio' into a rule for 'data'. Returns
+ * NULL with errno set to EINVAL (bad method or regular expression) or
+ * ENOMEM.
+ */
+resmatch_rule_t *resmatch_add(resmatch_t *, resmsg_audio_t *audio,
+                              void *data);
+void             resmatch_remove(resmatch_t *, resmatch_rule_t *);
+
+/*
+ * Match a stream with 'nprop' properties. 'found' may not add or
+ * remove rules. Returns the number of matching rules.
+ */
+int              resmatch_stream(resmatch_t *, resmatch_prop_t *props,
+                                 int nprop, resmatch_found_t found,
+                                 void *user_data);
+
+#ifdef	__cplusplus
+};
+#endif
+
+#endif /* __RES_MATCH_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
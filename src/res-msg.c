@@ -25,17 +25,40 @@ USA.
 #include <string.h>
 #include <stdint.h>
 #include <inttypes.h>
-#include <limits.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <fcntl.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "res-conn-private.h"
+#include "res-registry-private.h"
 
 #include "visibility.h"
 
-static char *flag_str(uint32_t);
-static char *mode_str(uint32_t);
+static struct {
+    pthread_mutex_t  lock;
+    pid_t            pid;       /* our own pid, 0 if not cached */
+    char            *id;        /* application id of pid */
+} appid_cache = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+static pthread_once_t appid_once = PTHREAD_ONCE_INIT;
+
+static char *read_app_id(int, pid_t, int);
+static void  appid_cache_init(void);
+static void  appid_cache_lock(void);
+static void  appid_cache_unlock(void);
+static void  appid_cache_reset(void);
+
+typedef const char *(*mask_name_t)(int, int *);
+
+static char       *format_mask(uint64_t, mask_name_t, const char *,
+                               const char *, char *, int);
+static const char *mode_name(int, int *);
+static char       *put_str(char *, char *, const char *, int);
+static char       *put_uint(char *, char *, uint32_t);
+static char       *put_hex(char *, char *, uint64_t);
 
 
 EXPORT char *resmsg_dump_message(resmsg_t *resmsg,
@@ -45,11 +68,15 @@ EXPORT char *resmsg_dump_message(resmsg_t *resmsg,
 {
 #define PRINT(fmt, args...)                                              \
     do {                                                                 \
-        if (len > 0) {                                                   \
-            p += (l = snprintf(p, len, "%s" fmt "\n", spaces, ##args));  \
+        if (len > 1) {                                                   \
+            l = snprintf(p, len, "%s" fmt "\n", spaces, ##args);         \
+            if (l < 0 || l >= len)  /* truncated */                      \
+                l = len - 1;                                             \
+            p += l;                                                      \
             len -= l;                                                    \
         }                                                                \
     } while(0)
+#define STR(s)  ((s) ? (s) : "<null>")
 
     char  spaces[256];
     int   l;
@@ -64,12 +91,17 @@ EXPORT char *resmsg_dump_message(resmsg_t *resmsg,
     resmsg_status_t   *status;
     resmsg_property_t *property;
     resmsg_match_t    *match;
+    uint32_t           i;
 
     if (!buf || len < 1 || indent < 0)
         return "";
 
     p = buf;
     *buf = '\0';
+
+    if (resmsg == NULL)
+        return buf;
+
     memset(spaces, ' ', sizeof(spaces));
     spaces[indent < sizeof(spaces) ? indent : sizeof(spaces)-1] = '\0';
 
@@ -98,19 +130,22 @@ EXPORT char *resmsg_dump_message(resmsg_t *resmsg,
     case RESMSG_ADVICE:
         notify = &resmsg->notify;
         PRINT("resrc      : %s", resmsg_res_str(notify->resrc, r, sizeof(r)));
+        PRINT("seqno      : %u", notify->seqno);
         break;
 
     case RESMSG_AUDIO:
         audio    = &resmsg->audio;
-        property = &audio->property;
-        match    = &property->match;
-        PRINT("group      : '%s'", audio->group);
-        PRINT("app_id     : '%s'", audio->app_id);
-        PRINT("property   :");
-        PRINT("  name     : '%s'", property->name);
-        PRINT("  match    :");
-        PRINT("    method : %s"  , resmsg_match_method_str(match->method));
-        PRINT("    pattern: '%s'", match->pattern);
+        PRINT("group      : '%s'", STR(audio->group));
+        PRINT("app_id     : '%s'", STR(audio->app_id));
+        for (i = 0;  i <= (audio->extra ? audio->nextra : 0);  i++) {
+            property = i ? audio->extra + (i-1) : &audio->property;
+            match    = &property->match;
+            PRINT("property   :");
+            PRINT("  name     : '%s'", STR(property->name));
+            PRINT("  match    :");
+            PRINT("    method : %s"  , resmsg_match_method_str(match->method));
+            PRINT("    pattern: '%s'", STR(match->pattern));
+        }
         break;
 
     case RESMSG_VIDEO:
@@ -121,7 +156,7 @@ EXPORT char *resmsg_dump_message(resmsg_t *resmsg,
     case RESMSG_STATUS:
         status = &resmsg->status;
         PRINT("errcod    : %d"  , status->errcod);
-        PRINT("errstr    : '%s'", status->errmsg);        
+        PRINT("errstr    : '%s'", STR(status->errmsg));
         break;
 
     default:
@@ -129,11 +164,12 @@ EXPORT char *resmsg_dump_message(resmsg_t *resmsg,
     }
 
     /* remove the last newline, if any */
-    if (--p > buf && *p == '\n')
-        *p = '\0';
+    if (p > buf && p[-1] == '\n')
+        p[-1] = '\0';
 
     return buf;
 
+#undef STR
 #undef PRINT
 }
 
@@ -161,79 +197,25 @@ EXPORT char *resmsg_type_str(resmsg_type_t type)
 
 EXPORT char *resmsg_mod_str(uint32_t mod, char *buf, int len)
 {
-    char    *p;
-    char    *s;
-    char    *mstr;
-    int      l = len;
-    uint32_t m;
-    uint32_t i;
-    char     hex[64];
-
-    if (!buf || len < 1)
-        return "";
+    return format_mask(mod, mode_name, NULL, "<no-mode>", buf, len);
+}
 
-    *buf = '\0';
-    
-    snprintf(hex, sizeof(hex), "0x%x", mod);
-    
-    for (p = buf, s = "", i = 0;   i < 32 && mod != 0 && len > 0;   i++) {
-        m = 1 << i;
-        
-        if ((mod & m) != 0) {
-            mod &= ~m;
-            
-            if ((mstr = mode_str(m)) != NULL) {
-                l = snprintf(p, len, "%s%s", s, mstr);
-                s = ",";
-                
-                p += l;
-                len -= l;
-            }
-        }
-    } /* for */
-    
-    if (len > 0)
-        snprintf(p, len, "%s(%s)", *s ? " ":"<no-mode> ", hex);
 
-    return buf;
+EXPORT char *resmsg_res_str(uint64_t res, char *buf, int len)
+{
+    return format_mask(res, resreg_name_len, "Resource", "<no-resource>",
+                       buf, len);
 }
 
-
-EXPORT char *resmsg_res_str(uint32_t res, char *buf, int len)
+EXPORT char *resmsg_res_hex(uint64_t res, char *buf, int len)
 {
-    char    *p;
-    char    *s;
-    char    *f;
-    int      l = len;
-    uint32_t m;
-    uint32_t i;
-    char     hex[64];
+    char *p;
 
     if (!buf || len < 1)
         return "";
 
-    *buf = '\0';
-    
-    snprintf(hex, sizeof(hex), "0x%x", res);
-    
-    for (p = buf, s = "", i = 0;   i < 32 && res != 0 && len > 0;   i++) {
-        m = 1 << i;
-        
-        if ((res & m) != 0) {
-            res &= ~m;
-            
-            if ((f = flag_str(m)) != NULL) {
-                l = snprintf(p, len, "%s%s", s, f);
-                s = ",";
-                
-                p += l;
-                len -= l;
-            }
-        }
-    } /* for */
-    
-    if (len > 0)
-        snprintf(p, len, "%s(%s)", *s ? " ":"<no-resource> ", hex);
+    p  = put_hex(buf, buf + len - 1, res);
+    *p = '\0';
 
     return buf;
 }
@@ -252,96 +234,289 @@ EXPORT char *resmsg_match_method_str(resmsg_match_method_t method)
     return str;
 }
 
+/*
+ * The application id is derived from the start time of the process,
+ * which never changes for a live pid. Our own id is asked for every
+ * resource set so it is read only once and cached; the cache is
+ * dropped in the child after fork(). Other pids can be recycled any
+ * time so they always go to /proc.
+ */
 EXPORT char *resmsg_generate_app_id(pid_t pid)
 {
-    char path[256];
-    char line[1024];
-    FILE *f;
-    char *id = NULL;
-
-    snprintf(path, sizeof(path), "/proc/%" PRIdMAX "/stat", (intmax_t) pid);
-    if (!(f = fopen(path, "r"))) {
-        fprintf(stderr, "generate_app_id: can't open %s\n", path);
-        return id;
-    }
+    char *id;
+    int   own;
+
+    pthread_once(&appid_once, appid_cache_init);
+
+    appid_cache_lock();
 
-    while (fgets(line, sizeof(line), f)) {
-        char *start = line;
-        int field = 1;
-        char *token;
-
-        while ((token = strsep(&start, " "))) {
-            if (field == 22) {
-                int64_t value = 0;
-                char *endptr = NULL;
-                size_t length;
-
-                value = strtoll(token, &endptr, 10);
-
-                if ((errno == ERANGE && (value == LLONG_MAX || value == LLONG_MIN))
-                        || (errno != 0 && value == 0)) {
-                    perror("generate_app_id: strtoll");
-                    goto done;
-                }
-
-                if (endptr == token) {
-                    fprintf(stderr, "generate_app_id: no digits were found in '%s'\n", token);
-                    goto done;
-                }
-
-                length = snprintf(NULL, 0, "%" PRIx64, value) + 1;
-                id = malloc(length);
-                snprintf(id, length, "%" PRIx64, value);
-                break;
-            }
-            field++;
+    if (appid_cache.pid != 0 && pid == appid_cache.pid) {
+        own = TRUE;
+        id  = strdup(appid_cache.id);
+    }
+    else if ((own = (pid == getpid()))) {
+        if ((id = read_app_id(AT_FDCWD, pid, TRUE)) != NULL) {
+            free(appid_cache.id);
+
+            if ((appid_cache.id = strdup(id)) != NULL)
+                appid_cache.pid = pid;
+            else
+                appid_cache.pid = 0;
         }
     }
 
-done:
-    fclose(f);
+    appid_cache_unlock();
+
+    if (!own)
+        id = read_app_id(AT_FDCWD, pid, TRUE);
 
     return id;
 }
 
+/*
+ * Batch variant for the manager side. ids[i] is set to the application
+ * id of pids[i], or NULL if it could not be determined (e.g. the process
+ * is gone). Returns the number of ids found or -1 if /proc is not
+ * accessible.
+ */
+EXPORT int resmsg_generate_app_ids(pid_t *pids, int n, char **ids)
+{
+    pid_t self = getpid();
+    int   dirfd;
+    int   found;
+    int   i;
+
+    if ((dirfd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+        return -1;
+
+    for (i = found = 0;  i < n;  i++) {
+        if (pids[i] == self)
+            ids[i] = resmsg_generate_app_id(self);
+        else
+            ids[i] = read_app_id(dirfd, pids[i], FALSE);
+
+        if (ids[i] != NULL)
+            found++;
+    }
+
+    close(dirfd);
 
-static char *flag_str(uint32_t flag)
+    return found;
+}
+
+static char *read_app_id(int dirfd, pid_t pid, int verbose)
 {
-    char *str;
+    char                path[64];
+    char                buf[1024];
+    char               *p;
+    char               *end;
+    char               *id;
+    int                 fd;
+    int                 field;
+    ssize_t             len;
+    unsigned long long  start;
+
+    snprintf(path, sizeof(path), "%s%" PRIdMAX "/stat",
+             dirfd == AT_FDCWD ? "/proc/" : "", (intmax_t) pid);
+
+    if ((fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC)) < 0) {
+        if (verbose)
+            fprintf(stderr, "generate_app_id: can't open %s\n", path);
+        return NULL;
+    }
 
-    switch (flag) {
-    case RESMSG_AUDIO_PLAYBACK:     str = "AudioPlayback";    break;
-    case RESMSG_VIDEO_PLAYBACK:     str = "VideoPlayback";    break;
-    case RESMSG_AUDIO_RECORDING:    str = "AudioRecording";   break;
-    case RESMSG_VIDEO_RECORDING:    str = "VideoRecording";   break;
-    case RESMSG_VIBRA:              str = "Vibra";            break;
-    case RESMSG_LEDS:               str = "Leds";             break;
-    case RESMSG_BACKLIGHT:          str = "Backlight";        break;
-    case RESMSG_SYSTEM_BUTTON:      str = "SystemButton";     break;
-    case RESMSG_LOCK_BUTTON:        str = "LockButton";       break;
-    case RESMSG_SCALE_BUTTON:       str = "ScaleButton";      break;
-    case RESMSG_SNAP_BUTTON:        str = "SnapButton";       break;
-    case RESMSG_LENS_COVER:         str = "LensCover";        break;
-    case RESMSG_HEADSET_BUTTONS:    str = "HeadsetButtons";   break;
-    case RESMSG_REAR_FLASHLIGHT:    str = "RearFlashlight";   break;
-    default:                        str = NULL;               break;
+    do {
+        len = read(fd, buf, sizeof(buf) - 1);
+    } while (len < 0 && errno == EINTR);
+
+    close(fd);
+
+    if (len <= 0)
+        return NULL;
+
+    buf[len] = '\0';
+
+    /*
+     * The command name in field 2 is in parenthesis and may contain
+     * spaces or even ')' so the fields are counted from the last ')'.
+     * The start time is field 22.
+     */
+    if ((p = strrchr(buf, ')')) == NULL)
+        goto malformed;
+
+    for (p++, field = 2;  field < 22;  field++) {
+        if ((p = strchr(p, ' ')) == NULL)
+            goto malformed;
+        p++;
     }
 
-    return str;
+    errno = 0;
+    start = strtoull(p, &end, 10);
+
+    if (end == p || (*end != ' ' && *end != '\n' && *end) || errno)
+        goto malformed;
+
+    if ((id = malloc(sizeof(start) * 2 + 1)) != NULL)
+        snprintf(id, sizeof(start) * 2 + 1, "%" PRIx64, (uint64_t)start);
+
+    return id;
+
+ malformed:
+    if (verbose)
+        fprintf(stderr, "generate_app_id: can't parse %s\n", path);
+
+    return NULL;
 }
 
+static void appid_cache_init(void)
+{
+    pthread_atfork(appid_cache_lock, appid_cache_unlock, appid_cache_reset);
+}
 
-static char *mode_str(uint32_t mode_bit)
+static void appid_cache_lock(void)
 {
-    char *str;
+    pthread_mutex_lock(&appid_cache.lock);
+}
 
-    switch (mode_bit) {
-    case RESMSG_MODE_AUTO_RELEASE:  str = "AutoRelease";   break;
-    case RESMSG_MODE_ALWAYS_REPLY:  str = "AlwaysReply";   break;
-    default:                        str = NULL;            break;
+static void appid_cache_unlock(void)
+{
+    pthread_mutex_unlock(&appid_cache.lock);
+}
+
+static void appid_cache_reset(void)
+{
+    pthread_mutex_init(&appid_cache.lock, NULL);
+
+    free(appid_cache.id);
+
+    appid_cache.pid = 0;
+    appid_cache.id  = NULL;
+}
+
+
+/*
+ * Formats the set bits of 'mask' as a comma separated list of their
+ * names followed by the mask in hex, eg. "AudioPlayback,Vibra (0x11)".
+ * Bits without a name are printed as 'unnamed' and the bit number, or
+ * left out if 'unnamed' is NULL. Only the set bits are visited and the
+ * names are copied with their precomputed lengths; a result that does
+ * not fit is truncated like snprintf would do.
+ */
+static char *format_mask(uint64_t     mask,
+                         mask_name_t  name_of,
+                         const char  *unnamed,
+                         const char  *none,
+                         char        *buf,
+                         int          len)
+{
+    char       *p;
+    char       *end;
+    const char *name;
+    uint64_t    bits;
+    int         bit;
+    int         l;
+    int         first;
+
+    if (!buf || len < 1)
+        return "";
+
+    p     = buf;
+    end   = buf + len - 1;
+    first = TRUE;
+
+    for (bits = mask;  bits != 0;  bits &= bits - 1) {
+        bit = __builtin_ctzll(bits);
+
+        if ((name = name_of(bit, &l)) == NULL && unnamed == NULL)
+            continue;
+
+        if (!first)
+            p = put_str(p, end, ",", 1);
+
+        if (name != NULL)
+            p = put_str(p, end, name, l);
+        else {
+            p = put_str(p, end, unnamed, strlen(unnamed));
+            p = put_uint(p, end, bit);
+        }
+
+        first = FALSE;
     }
 
-    return str;
+    if (first)
+        p = put_str(p, end, none, strlen(none));
+
+    p  = put_str(p, end, " (", 2);
+    p  = put_hex(p, end, mask);
+    p  = put_str(p, end, ")", 1);
+    *p = '\0';
+
+    return buf;
+}
+
+static const char *mode_name(int bit, int *len)
+{
+#define MODE_NAME(n)  { n, sizeof(n) - 1 }
+
+    static const struct {
+        const char *name;
+        int         len;
+    } names[32] = {
+        [resource_auto_release] = MODE_NAME("AutoRelease"),
+        [resource_always_reply] = MODE_NAME("AlwaysReply"),
+    };
+
+#undef MODE_NAME
+
+    if (bit < 0 || bit >= 32 || names[bit].name == NULL)
+        return NULL;
+
+    *len = names[bit].len;
+
+    return names[bit].name;
+}
+
+/* the put_* helpers append to p but never past end */
+
+static char *put_str(char *p, char *end, const char *str, int len)
+{
+    if (len > end - p)
+        len = end - p;
+
+    memcpy(p, str, len);
+
+    return p + len;
+}
+
+static char *put_uint(char *p, char *end, uint32_t value)
+{
+    char  digits[10];
+    char *d = digits + sizeof(digits);
+
+    do {
+        *--d = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    return put_str(p, end, d, digits + sizeof(digits) - d);
+}
+
+static char *put_hex(char *p, char *end, uint64_t value)
+{
+    static const char xdigit[] = "0123456789abcdef";
+
+    char  digits[2 + 16];
+    char *d = digits + sizeof(digits);
+
+    do {
+        *--d = xdigit[value & 0xf];
+        value >>= 4;
+    } while (value);
+
+    *--d = 'x';
+    *--d = '0';
+
+    return put_str(p, end, d, digits + sizeof(digits) - d);
 }
 
 
@@ -32,7 +32,7 @@ USA.
 extern "C" {
 #endif
 
-#define RESMSG_BIT(b) (((uint32_t)1) << (b))
+#define RESMSG_BIT(b) (((uint64_t)1) << (b))
 
 #define RESMSG_AUDIO_PLAYBACK      RESOURCE_AUDIO_PLAYBACK
 #define RESMSG_VIDEO_PLAYBACK      RESOURCE_VIDEO_PLAYBACK
@@ -72,17 +72,27 @@ typedef enum resmsg_type_e {
     RESMSG_TRANSPORT_START,
 } resmsg_type_t;
 
+/*
+ * Capabilities of a protocol peer. A D-Bus client announces its own in
+ * the register request and the manager its own in the reply; peers that
+ * predate the handshake send nothing and are taken as having none.
+ */
+#define RESMSG_CAP_WIDE_MASKS      (1U << 0) /* 64-bit masks on the wire */
+#define RESMSG_CAP_NOTIFY_ACK      (1U << 1) /* replies to GRANT and ADVICE */
+#define RESMSG_CAP_ALL             (RESMSG_CAP_WIDE_MASKS | \
+                                    RESMSG_CAP_NOTIFY_ACK)
+
 typedef struct {
-    uint32_t          all;       /* all the resources */
-    uint32_t          opt;       /* optional resources (subset of all) */
-    uint32_t          share;     /* shareable resource value */
-    uint32_t          mask;      /* shereable resource mask (subset of all) */
+    uint64_t          all;       /* all the resources */
+    uint64_t          opt;       /* optional resources (subset of all) */
+    uint64_t          share;     /* shareable resource value */
+    uint64_t          mask;      /* shereable resource mask (subset of all) */
 } resmsg_rset_t;
 
 typedef enum {
-    resmsg_method_equals = 0,
-    resmsg_method_startswith,
-    resmsg_method_matches
+    resmsg_method_equals     = resource_match_equals,
+    resmsg_method_startswith = resource_match_startswith,
+    resmsg_method_matches    = resource_match_matches
 } resmsg_match_method_t;
 
 typedef struct {
@@ -118,14 +128,24 @@ typedef struct {
 
 typedef struct {
     RESMSG_COMMON;               /* RESMG_[GRANT|ADVICE] */
-    uint32_t          resrc;     /* effected resources */
+    uint64_t          resrc;     /* effected resources */
+    uint32_t          seqno;     /* per set sequence, 0 if not known */
 } resmsg_notify_t;
 
+/*
+ * A stream belongs to the set if it matches 'property' and every one of
+ * the 'nextra' further properties. Managers predating them see only the
+ * first one.
+ */
+#define RESMSG_AUDIO_EXTRA_MAX     16
+
 typedef struct {
     RESMSG_COMMON;               /* RESMSG_AUDIO */
     char             *group;     /* group, if any ('' => registered class) */
     char             *app_id;    /* Application id of the streaming app, if any */
     resmsg_property_t property;  /* audio stream property */
+    uint32_t          nextra;    /* number of further properties */
+    resmsg_property_t *extra;    /* further properties, if any */
 } resmsg_audio_t;
 
 typedef struct {
@@ -154,11 +174,13 @@ typedef union resmsg_u {
 
 char *resmsg_dump_message(resmsg_t *, int, char *, int);
 char *resmsg_type_str(resmsg_type_t);
-char *resmsg_res_str(uint32_t, char *, int);
+char *resmsg_res_str(uint64_t, char *, int);
+char *resmsg_res_hex(uint64_t, char *, int);  /* just the hex, for traces */
 char *resmsg_mod_str(uint32_t, char *, int);
 char *resmsg_match_method_str(resmsg_match_method_t);
 
 char *resmsg_generate_app_id(pid_t pid);
+int   resmsg_generate_app_ids(pid_t *pids, int n, char **ids);
 
 #ifdef	__cplusplus
 };
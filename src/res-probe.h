@@ -0,0 +1,91 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __RES_PROBE_H__
+#define __RES_PROBE_H__
+
+/*
+ * Statically defined tracepoints of the 'libresource' provider.
+ *
+ * When configured with --enable-usdt they are sys/sdt.h probes: a single
+ * nop at the probe site plus an ELF note that perf, bpftrace or systemtap
+ * can attach to in a running process, e.g.
+ *
+ *     bpftrace -e 'usdt:/usr/lib/libresource.so:libresource:msg_send
+ *                  { printf("%d %u %u %u\n", arg0, arg1, arg2, arg3); }'
+ *
+ * Otherwise they expand to nothing, so the arguments must be free of side
+ * effects. With probes enabled the arguments are only loaded into operands
+ * of the nop; keep them cheap.
+ *
+ * Message related probes carry the message type, the resource set id,
+ * the request number and the transport serial (0 if there is none):
+ *
+ *   msg_compose     message is about to be composed for sending
+ *   msg_send        message was handed over to the transport
+ *   msg_receive     message arrived from the transport
+ *   dispatch_start  message is passed to the registered handler
+ *   dispatch_done   handler returned; the serial is always 0 as the
+ *                   handler may have released the message, the fifth
+ *                   argument is nonzero if there was a handler and the
+ *                   sixth is the elapsed nsec
+ *   reply_create    a reply is expected for a sent message
+ *   reply_complete  reply arrived or timed out; fifth argument is the
+ *                   error code, sixth is nonzero on timeout
+ *   queue_enqueue   internal transport deferred a message
+ *   queue_dequeue   internal transport picked up a deferred message
+ *
+ * Link probes carry the peer name and the role of the connection:
+ *
+ *   link_up         peer (the manager) appeared on the bus
+ *   link_down       peer disappeared
+ */
+
+#ifdef ENABLE_USDT
+
+#include <sys/sdt.h>
+
+#define RESPROBE(name, type, id, reqno, serial)                         \
+    STAP_PROBE4(libresource, name, type, id, reqno, serial)
+#define RESPROBE_EXT(name, type, id, reqno, serial, a5, a6)             \
+    STAP_PROBE6(libresource, name, type, id, reqno, serial, a5, a6)
+#define RESPROBE_LINK(name, peer, role)                                 \
+    STAP_PROBE2(libresource, name, peer, role)
+
+#else
+
+#define RESPROBE(name, type, id, reqno, serial)                do { } while(0)
+#define RESPROBE_EXT(name, type, id, reqno, serial, a5, a6)    do { } while(0)
+#define RESPROBE_LINK(name, peer, role)                        do { } while(0)
+
+#endif
+
+#endif /* __RES_PROBE_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -28,14 +28,20 @@ USA.
 #include <res-proto.h>
 #include "res-conn-private.h"
 #include "res-set-private.h"
+#include "res-coalesce-private.h"
 #include "dbus-msg.h"
 #include "dbus-proto.h"
 #include "internal-msg.h"
 #include "internal-proto.h"
+#include "res-probe.h"
 #include "visibility.h"
 
 
 static void message_receive(resmsg_t *, resset_t *, void *);
+static int  notify_is_stale(resset_t *, resmsg_t *);
+#ifdef ENABLE_USDT
+static uint32_t message_serial(resconn_t *, void *);
+#endif
 
 EXPORT resconn_t *resproto_init(resproto_role_t       role,
                                 resproto_transport_t  transp,
@@ -57,6 +63,12 @@ EXPORT resconn_t *resproto_init(resproto_role_t       role,
     return rcon;
 }
 
+EXPORT void resproto_destroy(resconn_t *rcon)
+{
+    if (rcon != NULL)
+        resconn_destroy(rcon);
+}
+
 
 EXPORT int resproto_set_handler(resconn_t           *rcon,
                                 resmsg_type_t        type,
@@ -84,7 +96,28 @@ EXPORT int resproto_send_message(resset_t          *rset,
         success = FALSE;
     else {
         resmsg->any.id = rset->id;
-        success = rcon->any.send(rset, resmsg, status);
+
+        if (rcon->any.role == RESPROTO_ROLE_MANAGER &&
+            (type == RESMSG_GRANT || type == RESMSG_ADVICE))
+        {
+            if (resmsg->notify.seqno) {
+                if ((int32_t)(resmsg->notify.seqno - rset->seqno.sent) > 0)
+                    rset->seqno.sent = resmsg->notify.seqno;
+            }
+            else {
+                if (++rset->seqno.sent == 0)
+                    rset->seqno.sent = 1;
+                resmsg->notify.seqno = rset->seqno.sent;
+            }
+
+            if (rcon->any.coalesce.enabled)
+                success = rescoal_send(rset, resmsg, status);
+            else
+                success = rcon->any.send(rset, resmsg, status);
+        }
+        else {
+            success = rcon->any.send(rset, resmsg, status);
+        }
 
         if (success && type == RESMSG_UPDATE) {
             flags = &resmsg->record.rset;
@@ -122,6 +155,11 @@ EXPORT int resproto_reply_message(resset_t   *rset,
             reply.status.errmsg = errmsg;
             
             success = rcon->any.error(rset, &reply, protodata);
+
+            if (success)
+                resconn_stats_sent(rcon, &reply, TRUE);
+
+            resconn_stats_status(rcon, resmsg->type, errcod, FALSE);
         }
     }
 
@@ -129,6 +167,37 @@ EXPORT int resproto_reply_message(resset_t   *rset,
 }
 
 
+/*
+ * The counters are maintained by the thread dispatching the connection
+ * and should be read from there, too.
+ */
+EXPORT int resproto_get_stats(resconn_t *rcon, resproto_stats_t *stats)
+{
+    if (rcon == NULL || stats == NULL)
+        return FALSE;
+
+    memcpy(stats, &rcon->any.stats, sizeof(resproto_stats_t));
+
+    return TRUE;
+}
+
+/*
+ * Offer (or stop offering) the statistics over the org.maemo.resource.stats
+ * interface. Only D-Bus manager connections have it.
+ */
+EXPORT int resproto_export_stats(resconn_t *rcon, int enable)
+{
+    if (rcon == NULL                              ||
+        rcon->any.role   != RESPROTO_ROLE_MANAGER ||
+        rcon->any.transp != RESPROTO_TRANSPORT_DBUS  )
+        return FALSE;
+
+    rcon->dbus.exported = enable ? TRUE : FALSE;
+
+    return TRUE;
+}
+
+
 static void message_receive(resmsg_t *resmsg,
                             resset_t *rset,
                             void     *protodata)
@@ -136,13 +205,78 @@ static void message_receive(resmsg_t *resmsg,
     resconn_t          *rcon = rset->resconn;
     resmsg_type_t       type = resmsg->type;
     resproto_handler_t  handler;
+    uint64_t            start;
+    uint64_t            elapsed;
+
+    if (type >= 0 && type < RESMSG_MAX) {
+        RESPROBE(dispatch_start, type, resmsg->any.id, resmsg->any.reqno,
+                 message_serial(rcon, protodata));
+
+        start = resconn_stats_clock();
+
+        if (notify_is_stale(rset, resmsg)) {
+            rcon->any.stats.stale++;
+            handler = NULL;
+        }
+        else if ((handler = rcon->any.handler[type]) != NULL)
+            handler(resmsg, rset, protodata);
+
+        elapsed = resconn_stats_clock() - start;
+
+        RESPROBE_EXT(dispatch_done, type, resmsg->any.id, resmsg->any.reqno,
+                     0, handler != NULL, elapsed);
+
+        resconn_stats_received(rcon, resmsg, elapsed);
+    }
+}
+
+/*
+ * A client drops a GRANT or ADVICE that is not newer than the last one
+ * of the same type; without a sequence number everything is accepted.
+ */
+static int notify_is_stale(resset_t *rset, resmsg_t *resmsg)
+{
+    uint32_t *last;
+    uint32_t  seqno;
+
+    if (rset->resconn->any.role != RESPROTO_ROLE_CLIENT)
+        return FALSE;
 
-    if (type >= 0 && type < RESMSG_MAX && (handler = rcon->any.handler[type])){
-        handler(resmsg, rset, protodata);
+    switch (resmsg->type) {
+    case RESMSG_GRANT:    last = &rset->seqno.grant;    break;
+    case RESMSG_ADVICE:   last = &rset->seqno.advice;   break;
+    default:              return FALSE;
     }
+
+    if ((seqno = resmsg->notify.seqno) == 0)
+        return FALSE;
+
+    if (*last && (int32_t)(seqno - *last) <= 0)
+        return TRUE;
+
+    *last = seqno;
+
+    return FALSE;
 }
 
 
+#ifdef ENABLE_USDT
+static uint32_t message_serial(resconn_t *rcon, void *protodata)
+{
+    if (protodata == NULL)
+        return 0;
+
+    switch (rcon->any.transp) {
+    case RESPROTO_TRANSPORT_DBUS:
+        return dbus_message_get_serial((DBusMessage *)protodata);
+    case RESPROTO_TRANSPORT_INTERNAL:
+        return (uint32_t)(uintptr_t)protodata;
+    default:
+        return 0;
+    }
+}
+#endif
+
 
 /* 
  * Local Variables:
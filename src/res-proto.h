@@ -53,14 +53,45 @@ typedef enum {
 typedef void   (*resproto_handler_t) (resmsg_t *, resset_t *, void *);
 typedef void   (*resproto_status_t)  (resset_t *, resmsg_t *);
 
+/*
+ * Per message type counters of a connection. Status replies are counted
+ * for the type of the message they reply to: as 'replied' if successful
+ * and as 'failed' if not. Failed sends are counted as 'failed' too.
+ */
+typedef struct {
+    uint32_t            sent;
+    uint32_t            received;
+    uint32_t            replied;
+    uint32_t            failed;
+    uint32_t            timedout;
+} resproto_msgstats_t;
+
+typedef struct {
+    resproto_msgstats_t msg[RESMSG_MAX];
+    uint64_t            bytes_sent;      /* marshalled message payload */
+    uint64_t            bytes_received;
+    uint32_t            pending;         /* replies being waited for */
+    uint32_t            pending_peak;
+    uint32_t            rsets;           /* resource sets */
+    uint32_t            rsets_peak;
+    uint64_t            dispatch_ns;     /* time spent in message handlers */
+    uint32_t            coalesced;       /* notifications superseded unsent */
+    uint32_t            stale;           /* out of date notifications dropped */
+} resproto_stats_t;
+
 
 union resconn_u * resproto_init(resproto_role_t, resproto_transport_t, ...);
 
+void resproto_destroy(union resconn_u *);
+
 int resproto_set_handler(union resconn_u *, resmsg_type_t, resproto_handler_t);
 
 int resproto_send_message(resset_t *, resmsg_t *, resproto_status_t);
 int resproto_reply_message(resset_t *,resmsg_t *,void *,int32_t,const char *);
 
+int resproto_get_stats(union resconn_u *, resproto_stats_t *);
+int resproto_export_stats(union resconn_u *, int);
+
 #ifdef	__cplusplus
 };
 #endif
@@ -0,0 +1,508 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "res-record-private.h"
+#include "res-conn-private.h"
+
+#include "visibility.h"
+
+#define CHUNK_SIZE   (1024 * 1024)      /* the log grows by this much */
+#define STRING_MAX   (5 + 2 * RESMSG_AUDIO_EXTRA_MAX)   /* peer + AUDIO */
+#define METHOD_BITS  4                  /* per extra AUDIO property */
+#define ALIGN(s)     (((s) + 7) & ~(size_t)7)
+
+struct resrecord_log_s {
+    char           *map;
+    size_t          size;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    int             active;
+    int             fd;
+    char           *map;
+    size_t          mapsize;
+    size_t          used;
+    uint64_t        start;
+} recorder = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .fd   = -1
+};
+
+static pthread_once_t record_once = PTHREAD_ONCE_INIT;
+
+static void record_init(void);
+static void record_child(void);
+static int  start_recording(const char *);
+static void close_log(int);
+static int  reserve_space(size_t);
+static int  message_strings(resmsg_t *, resrecord_t *, const char **);
+
+
+EXPORT int resrecord_start(const char *path)
+{
+    pthread_once(&record_once, record_init);
+
+    return start_recording(path);
+}
+
+EXPORT void resrecord_stop(void)
+{
+    pthread_mutex_lock(&recorder.lock);
+
+    if (recorder.active)
+        close_log(TRUE);
+
+    pthread_mutex_unlock(&recorder.lock);
+}
+
+/*
+ * Called from the transports for every message sent or received. It is
+ * a single load and a branch while recording is off.
+ */
+void resrecord_message(resrecord_dir_t dir, resset_t *rset, resmsg_t *msg)
+{
+    resrecord_t  rec;
+    const char  *str[STRING_MAX];
+    size_t       len[STRING_MAX];
+    size_t       size;
+    char        *p;
+    int          i;
+
+    pthread_once(&record_once, record_init);
+
+    if (!recorder.active || rset == NULL || msg == NULL)
+        return;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.dir    = dir;
+    rec.role   = rset->resconn->any.role;
+    rec.transp = rset->resconn->any.transp;
+    rec.type   = msg->type;
+    rec.id     = msg->any.id;
+    rec.reqno  = msg->any.reqno;
+
+    str[0]   = rset->peer;
+    rec.nstr = 1 + message_strings(msg, &rec, str + 1);
+
+    for (size = sizeof(rec), i = 0;   i < rec.nstr;   i++) {
+        if (str[i] == NULL)
+            str[i] = "";
+        size += (len[i] = strlen(str[i]) + 1);
+    }
+
+    rec.size = size = ALIGN(size);
+
+    pthread_mutex_lock(&recorder.lock);
+
+    if (recorder.active && reserve_space(size)) {
+        rec.stamp = resconn_stats_clock() - recorder.start;
+
+        p = recorder.map + recorder.used;
+
+        memcpy(p, &rec, sizeof(rec));
+        p += sizeof(rec);
+
+        for (i = 0;   i < rec.nstr;   i++) {
+            memcpy(p, str[i], len[i]);
+            p += len[i];
+        }
+
+        recorder.used += size;
+    }
+
+    pthread_mutex_unlock(&recorder.lock);
+}
+
+
+EXPORT resrecord_log_t *resrecord_open(const char *path)
+{
+    resrecord_log_t    *log;
+    resrecord_header_t *hdr;
+    struct stat         st;
+    int                 fd;
+
+    if (path == NULL || (fd = open(path, O_RDONLY)) < 0)
+        return NULL;
+
+    log = NULL;
+
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(*hdr) &&
+        (log = malloc(sizeof(*log))) != NULL)
+    {
+        log->size = st.st_size;
+        log->map  = mmap(NULL, log->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        hdr = (resrecord_header_t *)log->map;
+
+        if (log->map == MAP_FAILED) {
+            free(log);
+            log = NULL;
+        }
+        else if (hdr->magic   != RESRECORD_MAGIC   ||
+                 hdr->version != RESRECORD_VERSION   )
+        {
+            munmap(log->map, log->size);
+            free(log);
+            log = NULL;
+        }
+    }
+
+    close(fd);
+
+    return log;
+}
+
+EXPORT void resrecord_close(resrecord_log_t *log)
+{
+    if (log != NULL) {
+        munmap(log->map, log->size);
+        free(log);
+    }
+}
+
+EXPORT uint64_t resrecord_realtime(resrecord_log_t *log)
+{
+    return log ? ((resrecord_header_t *)log->map)->realtime : 0;
+}
+
+/*
+ * Returns the record following prev, or the first one if prev is NULL.
+ * NULL is returned at the end of the log or at a damaged record.
+ */
+EXPORT resrecord_t *resrecord_next(resrecord_log_t *log, resrecord_t *prev)
+{
+    resrecord_t *rec;
+    size_t       offs;
+
+    if (log == NULL)
+        return NULL;
+
+    if (prev == NULL)
+        offs = sizeof(resrecord_header_t);
+    else
+        offs = ((char *)prev - log->map) + prev->size;
+
+    if (offs + sizeof(resrecord_t) > log->size)
+        return NULL;
+
+    rec = (resrecord_t *)(log->map + offs);
+
+    if (rec->size < sizeof(resrecord_t) || (rec->size & 7) ||
+        rec->size > log->size - offs)
+        return NULL;
+
+    return rec;
+}
+
+/*
+ * Fills msg from rec and returns the peer name. The strings of msg point
+ * into the log so they are valid until the log is closed. The extra
+ * properties of an AUDIO message are kept in a buffer of the calling
+ * thread that is overwritten by its next call.
+ */
+EXPORT const char *resrecord_decode(resrecord_t *rec, resmsg_t *msg)
+{
+    static __thread resmsg_property_t extra[RESMSG_AUDIO_EXTRA_MAX];
+
+    char     *str[STRING_MAX];
+    char     *p;
+    char     *end;
+    uint32_t  nextra;
+    uint32_t  j;
+    int       i;
+
+    if (rec == NULL || msg == NULL || rec->nstr < 1 || rec->nstr > STRING_MAX)
+        return NULL;
+
+    p   = (char *)(rec + 1);
+    end = (char *)rec + rec->size;
+
+    for (i = 0;   i < rec->nstr;   i++) {
+        str[i] = p;
+
+        while (p < end && *p)
+            p++;
+
+        if (p++ >= end)
+            return NULL;
+    }
+
+    for ( ;  i < STRING_MAX;  i++)
+        str[i] = "";
+
+    memset(msg, 0, sizeof(resmsg_t));
+
+    msg->type      = rec->type;
+    msg->any.id    = rec->id;
+    msg->any.reqno = rec->reqno;
+
+    switch (rec->type) {
+
+    case RESMSG_REGISTER:
+    case RESMSG_UPDATE:
+        msg->record.rset.all   = rec->value[0];
+        msg->record.rset.opt   = rec->value[1];
+        msg->record.rset.share = rec->value[2];
+        msg->record.rset.mask  = rec->value[3];
+        msg->record.mode       = rec->value[4];
+        msg->record.app_id     = str[1];
+        msg->record.klass      = str[2];
+        break;
+
+    case RESMSG_GRANT:
+    case RESMSG_ADVICE:
+        msg->notify.resrc = rec->value[0];
+        msg->notify.seqno = rec->value[1];
+        break;
+
+    case RESMSG_AUDIO:
+        msg->audio.group                  = str[1];
+        msg->audio.app_id                 = str[2];
+        msg->audio.property.name          = str[3];
+        msg->audio.property.match.method  = rec->value[0];
+        msg->audio.property.match.pattern = str[4];
+
+        nextra = rec->value[1];
+
+        if (nextra > RESMSG_AUDIO_EXTRA_MAX || rec->nstr != 5 + 2 * nextra)
+            return NULL;
+
+        if (nextra > 0) {
+            for (j = 0;  j < nextra;  j++) {
+                extra[j].name          = str[5 + 2*j];
+                extra[j].match.method  = (rec->value[2] >> (j*METHOD_BITS)) &
+                                         ((1 << METHOD_BITS) - 1);
+                extra[j].match.pattern = str[6 + 2*j];
+            }
+
+            msg->audio.nextra = nextra;
+            msg->audio.extra  = extra;
+        }
+        break;
+
+    case RESMSG_VIDEO:
+        msg->video.pid = rec->value[0];
+        break;
+
+    default:
+        break;
+    }
+
+    return str[0];
+}
+
+
+static void record_init(void)
+{
+    const char *path;
+
+    pthread_atfork(NULL, NULL, record_child);
+
+    atexit(resrecord_stop);
+
+    if ((path = getenv("LIBRESOURCE_RECORD")) != NULL && *path)
+        start_recording(path);
+}
+
+/*
+ * A forked child must not append to the log of its parent.
+ */
+static void record_child(void)
+{
+    pthread_mutex_init(&recorder.lock, NULL);
+
+    if (recorder.active)
+        close_log(FALSE);
+}
+
+static int start_recording(const char *path)
+{
+    resrecord_header_t *hdr;
+    struct timespec     ts;
+    int                 fd;
+    int                 success;
+
+    if (path == NULL)
+        return FALSE;
+
+    pthread_mutex_lock(&recorder.lock);
+
+    if (recorder.active)
+        success = FALSE;
+    else if ((fd = open(path, O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC, 0644)) < 0)
+        success = FALSE;
+    else {
+        recorder.fd = fd;
+
+        if ((success = reserve_space(sizeof(resrecord_header_t)))) {
+            clock_gettime(CLOCK_REALTIME, &ts);
+
+            hdr = (resrecord_header_t *)recorder.map;
+            hdr->magic    = RESRECORD_MAGIC;
+            hdr->version  = RESRECORD_VERSION;
+            hdr->realtime = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+            recorder.used   = sizeof(resrecord_header_t);
+            recorder.start  = resconn_stats_clock();
+            recorder.active = TRUE;
+        }
+    }
+
+    pthread_mutex_unlock(&recorder.lock);
+
+    return success;
+}
+
+/*
+ * Makes sure there is room for size more bytes in the mapping, growing
+ * the file and remapping it if needed. Called with the lock held. If
+ * the log can't grow recording is silently stopped.
+ */
+static int reserve_space(size_t size)
+{
+    size_t  mapsize;
+    char   *map;
+
+    if (recorder.used + size <= recorder.mapsize)
+        return TRUE;
+
+    mapsize = recorder.mapsize + CHUNK_SIZE;
+
+    if (mapsize < recorder.used + size)
+        mapsize = ALIGN(recorder.used + size);
+
+    if (ftruncate(recorder.fd, mapsize) < 0 ||
+        (map = mmap(NULL, mapsize, PROT_READ|PROT_WRITE, MAP_SHARED,
+                    recorder.fd, 0)) == MAP_FAILED)
+    {
+        close_log(TRUE);
+        return FALSE;
+    }
+
+    if (recorder.map != NULL)
+        munmap(recorder.map, recorder.mapsize);
+
+    recorder.map     = map;
+    recorder.mapsize = mapsize;
+
+    return TRUE;
+}
+
+/*
+ * Unmaps and closes the log, cutting it to its used length if asked to.
+ * Called with the lock held.
+ */
+static void close_log(int truncate)
+{
+    if (recorder.map != NULL)
+        munmap(recorder.map, recorder.mapsize);
+
+    if (recorder.fd >= 0) {
+        /* if this fails the zeros at the end terminate the log as well */
+        if (truncate && ftruncate(recorder.fd, recorder.used) < 0)
+            recorder.used = 0;
+
+        close(recorder.fd);
+    }
+
+    recorder.active  = FALSE;
+    recorder.fd      = -1;
+    recorder.map     = NULL;
+    recorder.mapsize = 0;
+    recorder.used    = 0;
+}
+
+static int message_strings(resmsg_t *msg, resrecord_t *rec, const char **str)
+{
+    resmsg_property_t *extra;
+    uint32_t           nextra;
+    uint32_t           i;
+
+    switch (msg->type) {
+
+    case RESMSG_REGISTER:
+    case RESMSG_UPDATE:
+        rec->value[0] = msg->record.rset.all;
+        rec->value[1] = msg->record.rset.opt;
+        rec->value[2] = msg->record.rset.share;
+        rec->value[3] = msg->record.rset.mask;
+        rec->value[4] = msg->record.mode;
+        str[0] = msg->record.app_id;
+        str[1] = msg->record.klass;
+        return 2;
+
+    case RESMSG_GRANT:
+    case RESMSG_ADVICE:
+        rec->value[0] = msg->notify.resrc;
+        rec->value[1] = msg->notify.seqno;
+        return 0;
+
+    case RESMSG_AUDIO:
+        rec->value[0] = msg->audio.property.match.method;
+        str[0] = msg->audio.group;
+        str[1] = msg->audio.app_id;
+        str[2] = msg->audio.property.name;
+        str[3] = msg->audio.property.match.pattern;
+
+        nextra = msg->audio.extra ? msg->audio.nextra : 0;
+
+        if (nextra > RESMSG_AUDIO_EXTRA_MAX)
+            nextra = RESMSG_AUDIO_EXTRA_MAX;
+
+        for (i = 0;  i < nextra;  i++) {
+            extra = msg->audio.extra + i;
+            rec->value[2] |= (uint64_t)extra->match.method << (i*METHOD_BITS);
+            str[4 + 2*i] = extra->name;
+            str[5 + 2*i] = extra->match.pattern;
+        }
+
+        rec->value[1] = nextra;
+        return 4 + 2 * nextra;
+
+    case RESMSG_VIDEO:
+        rec->value[0] = msg->video.pid;
+        return 0;
+
+    default:
+        return 0;
+    }
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
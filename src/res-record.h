@@ -0,0 +1,111 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __RES_RECORD_H__
+#define __RES_RECORD_H__
+
+#include <stdint.h>
+
+#include <res-msg.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary log of the protocol messages a process sends and receives, for
+ * replaying real workloads with resource-replay. Recording is started by
+ * setting LIBRESOURCE_RECORD=<file> in the environment or by calling
+ * resrecord_start(). Status replies are not recorded.
+ *
+ * The file is written through a shared memory mapping and consists of a
+ * resrecord_header_t followed by records. A record is a resrecord_t and
+ * nstr NUL terminated strings, padded to a multiple of 8 bytes. The first
+ * string is the peer name, the rest depend on the message type:
+ *
+ *   type                 value[]                       strings
+ *   REGISTER, UPDATE     all, opt, share, mask, mode   app_id, klass
+ *   GRANT, ADVICE        resrc, seqno
+ *   AUDIO                match method, nextra,         group, app_id,
+ *                        extra methods                 property, pattern,
+ *                                                      nextra times
+ *                                                      property, pattern
+ *   VIDEO                pid
+ *
+ * The match methods of the extra AUDIO properties take 4 bits each,
+ * the first in the lowest bits. Missing strings are recorded as empty
+ * ones. Numbers are in host byte order and a record with zero size ends
+ * the log.
+ */
+
+#define RESRECORD_MAGIC     0x4c525352      /* "RSRL" */
+#define RESRECORD_VERSION   1
+
+typedef enum {
+    RESRECORD_SEND = 1,         /* message sent to the peer */
+    RESRECORD_RECEIVE,          /* message received from the peer */
+} resrecord_dir_t;
+
+typedef struct {
+    uint32_t       magic;
+    uint32_t       version;
+    uint64_t       realtime;    /* wall clock at the start in nanoseconds */
+} resrecord_header_t;
+
+typedef struct {
+    uint32_t       size;        /* with the strings and the padding */
+    uint8_t        dir;         /* resrecord_dir_t */
+    uint8_t        role;        /* resproto_role_t of the recording side */
+    uint8_t        transp;      /* resproto_transport_t */
+    uint8_t        nstr;        /* number of strings following */
+    uint64_t       stamp;       /* nanoseconds since the start */
+    int32_t        type;        /* resmsg_type_t */
+    uint32_t       id;          /* resource set id */
+    uint32_t       reqno;
+    uint64_t       value[5];    /* type specific, see above */
+} resrecord_t;
+
+typedef struct resrecord_log_s resrecord_log_t;
+
+int              resrecord_start(const char *);
+void             resrecord_stop(void);
+
+resrecord_log_t *resrecord_open(const char *);
+void             resrecord_close(resrecord_log_t *);
+uint64_t         resrecord_realtime(resrecord_log_t *);
+resrecord_t     *resrecord_next(resrecord_log_t *, resrecord_t *);
+const char      *resrecord_decode(resrecord_t *, resmsg_t *);
+
+#ifdef	__cplusplus
+};
+#endif
+
+#endif /* __RES_RECORD_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
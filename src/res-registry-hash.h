@@ -0,0 +1,25 @@
+/*
+ * Generated by gen-registry from res-registry-private.h, do not edit.
+ */
+
+#define RESREG_HASH_SEED  0x0000630cU
+#define RESREG_HASH_SIZE  16
+
+static const resreg_builtin_t builtin_hash[RESREG_HASH_SIZE] = {
+    [ 0] = { "AudioPlayback", resource_audio_playback },
+    [ 1] = { "LockButton", resource_lock_button },
+    [ 2] = { "VideoRecording", resource_video_recording },
+    [ 3] = { "RearFlashlight", resource_rear_flashlight },
+    [ 4] = { "LensCover", resource_lens_cover },
+    [ 5] = { "Vibra", resource_vibra },
+    [ 6] = { "Backlight", resource_backlight },
+    [ 7] = { "SnapButton", resource_snap_button },
+    [ 8] = { "ScaleButton", resource_scale_button },
+    [ 9] = { NULL, -1 },
+    [10] = { "LargeScreen", resource_large_screen },
+    [11] = { "VideoPlayback", resource_video_playback },
+    [12] = { "AudioRecording", resource_audio_recording },
+    [13] = { "Leds", resource_leds },
+    [14] = { "SystemButton", resource_system_button },
+    [15] = { "HeadsetButtons", resource_headset_buttons },
+};
@@ -0,0 +1,88 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __RES_REGISTRY_PRIVATE_H__
+#define __RES_REGISTRY_PRIVATE_H__
+
+#include <stdint.h>
+
+#include <res-registry.h>
+
+/*
+ * The built-in resources. res-registry-hash.h holds a perfect hash of
+ * these names; run 'make regen-registry' in src after changing them.
+ */
+#define RESREG_BUILTINS(X)                                      \
+    X( "AudioPlayback"  , resource_audio_playback  )            \
+    X( "VideoPlayback"  , resource_video_playback  )            \
+    X( "AudioRecording" , resource_audio_recording )            \
+    X( "VideoRecording" , resource_video_recording )            \
+    X( "Vibra"          , resource_vibra           )            \
+    X( "Leds"           , resource_leds            )            \
+    X( "Backlight"      , resource_backlight       )            \
+    X( "SystemButton"   , resource_system_button   )            \
+    X( "LockButton"     , resource_lock_button     )            \
+    X( "ScaleButton"    , resource_scale_button    )            \
+    X( "SnapButton"     , resource_snap_button     )            \
+    X( "LensCover"      , resource_lens_cover      )            \
+    X( "HeadsetButtons" , resource_headset_buttons )            \
+    X( "RearFlashlight" , resource_rear_flashlight )            \
+    X( "LargeScreen"    , resource_large_screen    )
+
+/* run time registrations start above the last built-in bit */
+#define RESREG_FIRST_FREE  (resource_large_screen + 1)
+
+typedef struct {
+    const char  *name;
+    int          bit;
+} resreg_builtin_t;
+
+/* resreg_name() with the length of the name, for the formatters */
+const char *resreg_name_len(int bit, int *len);
+
+/*
+ * FNV-1a mixed with a seed; shared by the library and gen-registry,
+ * which searches for a seed that makes the built-ins collision free
+ */
+static inline uint32_t resreg_hash(const char *name, uint32_t seed)
+{
+    const unsigned char *p;
+    uint32_t             h = 2166136261U ^ seed;
+
+    for (p = (const unsigned char *)name;  *p;  p++) {
+        h ^= *p;
+        h *= 16777619U;
+    }
+
+    return h ^ (h >> 16);
+}
+
+#endif /* __RES_REGISTRY_PRIVATE_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,252 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "res-registry-private.h"
+#include "res-alloc-private.h"
+#include "visibility.h"
+
+#include "res-registry-hash.h"
+
+#ifndef TRUE
+#define FALSE 0
+#define TRUE  1
+#endif
+
+/*
+ * Run time registrations. A name is published in dynamic_name[] before
+ * its hash slot, so lookups can go without the lock; registrations are
+ * serialized by it. Slots hold bit+1, zero is free. With at most
+ * RESOURCE_MASK_BITS names the table never gets more than half full.
+ */
+#define DYNAMIC_HASH_SIZE  (2 * RESOURCE_MASK_BITS)
+
+typedef struct {
+    uint32_t   hash;
+    int        bit;
+} dynamic_slot_t;
+
+#define BUILTIN_NAME(n, b)  [b] = n,
+#define BUILTIN_LEN(n, b)   [b] = sizeof(n) - 1,
+
+static const char *builtin_name[RESOURCE_MASK_BITS] = {
+    RESREG_BUILTINS(BUILTIN_NAME)
+};
+
+static const uint8_t builtin_len[RESOURCE_MASK_BITS] = {
+    RESREG_BUILTINS(BUILTIN_LEN)
+};
+
+static const char      *dynamic_name[RESOURCE_MASK_BITS];
+static uint8_t          dynamic_len[RESOURCE_MASK_BITS];
+static dynamic_slot_t   dynamic_hash[DYNAMIC_HASH_SIZE];
+static pthread_mutex_t  dynamic_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int  valid_name(const char *);
+static int  builtin_bit(const char *);
+static int  dynamic_bit(const char *, uint32_t);
+static void dynamic_add(const char *, uint32_t, int);
+
+
+EXPORT int resreg_register(const char *name, int bit)
+{
+    uint32_t  hash;
+    int       old;
+    char     *copy;
+
+    if (!valid_name(name) || bit >= RESOURCE_MASK_BITS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if ((old = builtin_bit(name)) >= 0) {
+        if (bit < 0 || bit == old)
+            return old;
+
+        errno = EEXIST;
+        return -1;
+    }
+
+    hash = resreg_hash(name, 0);
+
+    pthread_mutex_lock(&dynamic_lock);
+
+    if ((old = dynamic_bit(name, hash)) >= 0) {
+        if (bit >= 0 && bit != old) {
+            errno = EEXIST;
+            old = -1;
+        }
+
+        pthread_mutex_unlock(&dynamic_lock);
+        return old;
+    }
+
+    if (bit < 0) {
+        for (bit = RESREG_FIRST_FREE;  bit < RESOURCE_MASK_BITS;  bit++) {
+            if (!builtin_name[bit] && !dynamic_name[bit])
+                break;
+        }
+
+        if (bit >= RESOURCE_MASK_BITS) {
+            pthread_mutex_unlock(&dynamic_lock);
+            errno = ENOSPC;
+            return -1;
+        }
+    }
+    else if (builtin_name[bit] || dynamic_name[bit]) {
+        pthread_mutex_unlock(&dynamic_lock);
+        errno = EEXIST;
+        return -1;
+    }
+
+    if ((copy = RESALLOC_STRDUP(name)) == NULL) {
+        pthread_mutex_unlock(&dynamic_lock);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    dynamic_add(copy, hash, bit);
+
+    pthread_mutex_unlock(&dynamic_lock);
+
+    return bit;
+}
+
+EXPORT int resreg_bit(const char *name)
+{
+    int bit;
+
+    if (name == NULL)
+        return -1;
+
+    if ((bit = builtin_bit(name)) < 0)
+        bit = dynamic_bit(name, resreg_hash(name, 0));
+
+    return bit;
+}
+
+EXPORT const char *resreg_name(int bit)
+{
+    if (bit < 0 || bit >= RESOURCE_MASK_BITS)
+        return NULL;
+
+    if (builtin_name[bit])
+        return builtin_name[bit];
+
+    return __atomic_load_n(&dynamic_name[bit], __ATOMIC_ACQUIRE);
+}
+
+const char *resreg_name_len(int bit, int *len)
+{
+    const char *name;
+
+    if (bit < 0 || bit >= RESOURCE_MASK_BITS)
+        return NULL;
+
+    if ((name = builtin_name[bit]) != NULL)
+        *len = builtin_len[bit];
+    else if ((name = __atomic_load_n(&dynamic_name[bit], __ATOMIC_ACQUIRE)))
+        *len = dynamic_len[bit];
+
+    return name;
+}
+
+
+static int valid_name(const char *name)
+{
+    const char *p;
+
+    if (name == NULL || !*name)
+        return FALSE;
+
+    for (p = name;  *p;  p++) {
+        if (!isalnum((unsigned char)*p) || p - name >= RESREG_NAME_MAX)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static int builtin_bit(const char *name)
+{
+    const resreg_builtin_t *b;
+
+    b = builtin_hash + (resreg_hash(name, RESREG_HASH_SEED) &
+                        (RESREG_HASH_SIZE - 1));
+
+    if (b->name == NULL || strcmp(name, b->name))
+        return -1;
+
+    return b->bit;
+}
+
+static int dynamic_bit(const char *name, uint32_t hash)
+{
+    dynamic_slot_t *s;
+    uint32_t        i;
+    int             bit;
+
+    for (i = hash;  ;  i++) {
+        s = dynamic_hash + (i & (DYNAMIC_HASH_SIZE - 1));
+
+        if ((bit = __atomic_load_n(&s->bit, __ATOMIC_ACQUIRE)) == 0)
+            return -1;
+
+        bit--;
+
+        if (s->hash == hash && !strcmp(dynamic_name[bit], name))
+            return bit;
+    }
+}
+
+static void dynamic_add(const char *name, uint32_t hash, int bit)
+{
+    dynamic_slot_t *s;
+    uint32_t        i;
+
+    for (i = hash;  ;  i++) {
+        s = dynamic_hash + (i & (DYNAMIC_HASH_SIZE - 1));
+
+        if (!s->bit)
+            break;
+    }
+
+    dynamic_len[bit] = strlen(name);
+    __atomic_store_n(&dynamic_name[bit], name, __ATOMIC_RELEASE);
+
+    s->hash = hash;
+    __atomic_store_n(&s->bit, bit + 1, __ATOMIC_RELEASE);
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,74 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __RES_REGISTRY_H__
+#define __RES_REGISTRY_H__
+
+#include <res-types.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Registry of resource names. The resources of res-types.h are known
+ * from the start; more can be registered at run time. A name maps to
+ * exactly one bit of the resource masks and a bit has at most one
+ * name. Names are never unregistered. All functions are thread-safe.
+ *
+ * Names are alphanumeric and at most RESREG_NAME_MAX characters long.
+ * The run time names are local to the process: the client and the
+ * manager must agree on the bits, eg. by registering the names with
+ * explicit bits.
+ */
+
+#define RESREG_NAME_MAX   63
+
+/*
+ * Register 'name' at 'bit', or at the lowest free bit above the
+ * built-in resources if 'bit' is negative. Registering an existing
+ * name again at the same (or any, if negative) bit is not an error.
+ * Returns the bit or -1 with errno set to EINVAL (bad name or bit),
+ * EEXIST (the name or the bit is taken) or ENOSPC (no free bits).
+ */
+int         resreg_register(const char *name, int bit);
+
+/* the bit of 'name' or -1 if it is not registered */
+int         resreg_bit(const char *name);
+
+/* the name of 'bit' or NULL if it has none */
+const char *resreg_name(int bit);
+
+#ifdef	__cplusplus
+};
+#endif
+
+#endif /* __RES_REGISTRY_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
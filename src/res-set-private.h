@@ -27,12 +27,12 @@ USA.
 
 resset_t *resset_create(union resconn_u*, const char*, uint32_t,
                         resset_state_t, const char *, const char *, uint32_t,
-                        uint32_t, uint32_t, uint32_t, uint32_t);
+                        uint64_t, uint64_t, uint64_t, uint64_t);
 void      resset_destroy(resset_t *);
 void      resset_ref(resset_t *);
 void      resset_unref(resset_t *);
-void      resset_update_flags(resset_t *, uint32_t, uint32_t,
-                              uint32_t,uint32_t);
+void      resset_update_flags(resset_t *, uint64_t, uint64_t,
+                              uint64_t, uint64_t);
 resset_t *resset_find(union resconn_u *, const char *, uint32_t);
 
 #endif /* __RES_SET_PRIVATE_H__ */
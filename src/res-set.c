@@ -26,6 +26,9 @@ USA.
 
 #include "res-conn-private.h"
 #include "res-set-private.h"
+#include "res-trace-private.h"
+#include "res-alloc-private.h"
+#include "res-coalesce-private.h"
 
 
 resset_t *resset_create(resconn_t     *rcon,
@@ -35,24 +38,25 @@ resset_t *resset_create(resconn_t     *rcon,
                         const char    *app_id,
                         const char    *klass,
                         uint32_t       mode,
-                        uint32_t       all,
-                        uint32_t       opt,
-                        uint32_t       share,
-                        uint32_t       mask)
+                        uint64_t       all,
+                        uint64_t       opt,
+                        uint64_t       share,
+                        uint64_t       mask)
 {
     resset_t *rset;
 
-    if ((rset = malloc(sizeof(resset_t))) != NULL) {
+    if ((rset = RESALLOC_MALLOC(RSET, sizeof(resset_t))) != NULL) {
     
         memset(rset, 0, sizeof(resset_t));
         rset->next        = rcon->any.rsets;
         rset->refcnt      = 1;
         rset->resconn     = rcon;
-        rset->peer        = strdup(peer);
+        rset->peer        = RESALLOC_STRDUP(peer);
+        rset->peerix      = restrace_peer_ref(peer);
         rset->id          = id;
         rset->state       = state;
-        rset->app_id      = strdup(app_id);
-        rset->klass       = strdup(klass);
+        rset->app_id      = RESALLOC_STRDUP(app_id);
+        rset->klass       = RESALLOC_STRDUP(klass);
         rset->mode        = mode,
         rset->flags.all   = all;
         rset->flags.opt   = opt;
@@ -60,6 +64,9 @@ resset_t *resset_create(resconn_t     *rcon,
         rset->flags.mask  = mask;
 
         rcon->any.rsets  = rset;
+
+        if (++rcon->any.stats.rsets > rcon->any.stats.rsets_peak)
+            rcon->any.stats.rsets_peak = rcon->any.stats.rsets;
     }
 
     return rset;
@@ -90,11 +97,18 @@ void resset_unref(resset_t *rset)
         for (prev = (resset_t *)&rcon->rsets;  prev->next;  prev = prev->next){
             if (prev->next == rset) {
                 prev->next = rset->next;
+                rcon->stats.rsets--;
                 
-                free(rset->peer);
-                free(rset->app_id);
-                free(rset->klass);
-                free(rset);
+                rescoal_release(rset);
+                restrace_peer_unref(rset->peerix);
+
+                RESALLOC_FREE(STRING, rset->peer);
+                RESALLOC_FREE(STRING, rset->app_id);
+                RESALLOC_FREE(STRING, rset->klass);
+                RESALLOC_FREE(RSET, rset);
+
+                /* a killed connection goes with its last set */
+                resconn_release((resconn_t *)rcon);
                 
                 break;
             }
@@ -103,10 +117,10 @@ void resset_unref(resset_t *rset)
 }
 
 void resset_update_flags(resset_t *rset,
-                         uint32_t  all,
-                         uint32_t  opt,
-                         uint32_t  share,
-                         uint32_t  mask)
+                         uint64_t  all,
+                         uint64_t  opt,
+                         uint64_t  share,
+                         uint64_t  mask)
 {
     if (rset != NULL) {
         rset->flags.all   = all;
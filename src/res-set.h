@@ -50,12 +50,20 @@ typedef struct resset_s {
     char             *klass;
     uint32_t          mode;
     struct {
-        uint32_t all;
-        uint32_t opt;
-        uint32_t share;
-        uint32_t mask;
+        uint64_t all;
+        uint64_t opt;
+        uint64_t share;
+        uint64_t mask;
     }                 flags;
+    uint32_t          caps;      /* RESMSG_CAP_xxx of the peer, if known */
     void             *userdata;
+    uint32_t          peerix;    /* peer handle in the trace ring */
+    struct {
+        uint32_t sent;           /* last GRANT/ADVICE sequence sent */
+        uint32_t grant;          /* last GRANT sequence received */
+        uint32_t advice;         /* last ADVICE sequence received */
+    }                 seqno;
+    void             *coalesce;  /* notification coalescing, if any */
 } resset_t;
 
 
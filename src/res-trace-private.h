@@ -0,0 +1,43 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __RES_TRACE_PRIVATE_H__
+#define __RES_TRACE_PRIVATE_H__
+
+#include <res-trace.h>
+#include <res-set.h>
+
+void     restrace_record(restrace_type_t, resset_t *, uint32_t, uint32_t,
+                         uint32_t, int32_t);
+uint32_t restrace_peer_ref(const char *);
+void     restrace_peer_unref(uint32_t);
+
+#endif /* __RES_TRACE_PRIVATE_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,336 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "res-trace-private.h"
+#include "res-registry-private.h"
+
+#include "visibility.h"
+
+#define PEER_MAX    1024        /* index 0 is reserved for 'unknown' */
+#define PEER_HASH   256
+#define PEER_NONE   0
+
+/*
+ * A peer handle is the index of the peer in the table in the low and
+ * the generation of the entry in the high 16 bits. The entry of a peer
+ * without sets keeps its name, so that the events in the ring still
+ * can be resolved, until it is the oldest such entry and a new peer
+ * needs the room; the generation then changes and the old handles
+ * stop resolving.
+ */
+typedef struct {
+    char                *name;
+    uint16_t             gen;
+    uint16_t             chain;     /* next in the hash bucket */
+    uint16_t             prev;      /* idle list, while refcnt is 0 */
+    uint16_t             next;
+    int                  refcnt;
+} peer_t;
+
+static restrace_event_t  ring[RESTRACE_RING_SIZE];
+static uint64_t          head;  /* number of events recorded so far */
+
+static struct {
+    pthread_mutex_t      lock;
+    int                  count;
+    uint16_t             idle;          /* least recently released */
+    uint16_t             idle_tail;
+    uint16_t             hash[PEER_HASH];
+    peer_t               tbl[PEER_MAX];
+} peers = {
+    .lock  = PTHREAD_MUTEX_INITIALIZER,
+    .count = 1
+};
+
+static uint16_t  peer_lookup(const char *, uint16_t *);
+static void      idle_unlink(uint16_t);
+static void      hash_unlink(uint16_t);
+
+
+/*
+ * Writers claim a slot with an atomic increment and mark it with its
+ * position + 1 once it is complete; readers skip slots whose mark does
+ * not match or changes while they are being copied.
+ */
+void restrace_record(restrace_type_t  event,
+                     resset_t        *rset,
+                     uint32_t         type,
+                     uint32_t         id,
+                     uint32_t         reqno,
+                     int32_t          errcod)
+{
+    struct timespec   ts;
+    restrace_event_t *ev;
+    uint64_t          idx;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    idx = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+    ev  = ring + (idx & (RESTRACE_RING_SIZE - 1));
+
+    __atomic_store_n(&ev->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    ev->stamp  = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    ev->peer   = rset ? rset->peerix : 0;
+    ev->event  = event;
+    ev->type   = type;
+    ev->id     = id;
+    ev->reqno  = reqno;
+    ev->errcod = errcod;
+
+    __atomic_store_n(&ev->seq, (uint32_t)(idx + 1), __ATOMIC_RELEASE);
+}
+
+uint32_t restrace_peer_ref(const char *name)
+{
+    peer_t   *peer;
+    uint16_t  bucket;
+    uint16_t  idx;
+    char     *dup;
+
+    if (name == NULL)
+        return 0;
+
+    pthread_mutex_lock(&peers.lock);
+
+    if ((idx = peer_lookup(name, &bucket)) != PEER_NONE) {
+        if (peers.tbl[idx].refcnt++ == 0)
+            idle_unlink(idx);
+    }
+    else if ((dup = strdup(name)) != NULL) {
+        if (peers.count < PEER_MAX)
+            idx = peers.count++;
+        else if ((idx = peers.idle) != PEER_NONE) {
+            idle_unlink(idx);
+            hash_unlink(idx);
+            free(peers.tbl[idx].name);
+            peers.tbl[idx].gen++;
+        }
+
+        if (idx == PEER_NONE)
+            free(dup);
+        else {
+            peer = peers.tbl + idx;
+            peer->name   = dup;
+            peer->refcnt = 1;
+            peer->chain  = peers.hash[bucket];
+            peers.hash[bucket] = idx;
+        }
+    }
+
+    pthread_mutex_unlock(&peers.lock);
+
+    return idx ? ((uint32_t)peers.tbl[idx].gen << 16) | idx : 0;
+}
+
+void restrace_peer_unref(uint32_t handle)
+{
+    uint16_t  idx = handle & 0xffff;
+    peer_t   *peer;
+
+    if (idx == PEER_NONE || idx >= PEER_MAX)
+        return;
+
+    pthread_mutex_lock(&peers.lock);
+
+    peer = peers.tbl + idx;
+
+    if (peer->gen == (handle >> 16) && peer->refcnt > 0 &&
+        --peer->refcnt == 0)
+    {
+        peer->prev = peers.idle_tail;
+        peer->next = PEER_NONE;
+
+        if (peers.idle_tail != PEER_NONE)
+            peers.tbl[peers.idle_tail].next = idx;
+        else
+            peers.idle = idx;
+
+        peers.idle_tail = idx;
+    }
+
+    pthread_mutex_unlock(&peers.lock);
+}
+
+/*
+ * Copies the last (at most len) events to buf, oldest first.
+ * Returns the number of events copied.
+ */
+EXPORT int restrace_snapshot(restrace_event_t *buf, int len)
+{
+    restrace_event_t *ev;
+    uint64_t          end;
+    uint64_t          idx;
+    uint32_t          seq;
+    int               n;
+
+    if (buf == NULL || len <= 0)
+        return 0;
+
+    end = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    idx = end > RESTRACE_RING_SIZE ? end - RESTRACE_RING_SIZE : 0;
+
+    if (end - idx > (uint64_t)len)
+        idx = end - len;
+
+    for (n = 0;  idx < end;  idx++) {
+        ev  = ring + (idx & (RESTRACE_RING_SIZE - 1));
+        seq = __atomic_load_n(&ev->seq, __ATOMIC_ACQUIRE);
+
+        if (seq != (uint32_t)(idx + 1))
+            continue;
+
+        buf[n] = *ev;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&ev->seq, __ATOMIC_RELAXED) == seq)
+            n++;
+    }
+
+    return n;
+}
+
+/*
+ * Formats an event. If now is non-zero the time stamp is printed in
+ * seconds relative to it.
+ */
+EXPORT char *restrace_event_str(restrace_event_t *ev,
+                                uint64_t          now,
+                                char             *buf,
+                                int               len)
+{
+    char   peer[64];
+    double stamp;
+
+    if (!buf || len < 1)
+        return "";
+
+    if (now)
+        stamp = -((double)(now - ev->stamp) / 1000000000.0);
+    else
+        stamp = (double)ev->stamp / 1000000000.0;
+
+    snprintf(buf, len, "%12.6f %-7s %-10s id %u reqno %u errcod %d peer %s",
+             stamp, restrace_type_str(ev->event), resmsg_type_str(ev->type),
+             ev->id, ev->reqno, ev->errcod,
+             restrace_peer_name(ev->peer, peer, sizeof(peer)));
+
+    return buf;
+}
+
+EXPORT char *restrace_peer_name(uint32_t handle, char *buf, int len)
+{
+    uint16_t idx = handle & 0xffff;
+
+    if (!buf || len < 1)
+        return "";
+
+    pthread_mutex_lock(&peers.lock);
+
+    if (idx > 0 && idx < peers.count && peers.tbl[idx].gen == (handle >> 16))
+        snprintf(buf, len, "%s", peers.tbl[idx].name);
+    else
+        snprintf(buf, len, "<unknown>");
+
+    pthread_mutex_unlock(&peers.lock);
+
+    return buf;
+}
+
+EXPORT char *restrace_type_str(restrace_type_t type)
+{
+    char *str;
+
+    switch (type) {
+    case RESTRACE_SEND:        str = "send";             break;
+    case RESTRACE_RECEIVE:     str = "receive";          break;
+    case RESTRACE_STATUS:      str = "status";           break;
+    case RESTRACE_TIMEOUT:     str = "timeout";          break;
+    default:                   str = "<unknown event>";  break;
+    }
+
+    return str;
+}
+
+
+/* the caller holds the lock */
+static uint16_t peer_lookup(const char *name, uint16_t *bucket)
+{
+    uint16_t idx;
+
+    *bucket = resreg_hash(name, 0) & (PEER_HASH - 1);
+
+    for (idx = peers.hash[*bucket];  idx;  idx = peers.tbl[idx].chain) {
+        if (!strcmp(name, peers.tbl[idx].name))
+            break;
+    }
+
+    return idx;
+}
+
+static void idle_unlink(uint16_t idx)
+{
+    peer_t *peer = peers.tbl + idx;
+
+    if (peer->prev != PEER_NONE)
+        peers.tbl[peer->prev].next = peer->next;
+    else
+        peers.idle = peer->next;
+
+    if (peer->next != PEER_NONE)
+        peers.tbl[peer->next].prev = peer->prev;
+    else
+        peers.idle_tail = peer->prev;
+
+    peer->prev = peer->next = PEER_NONE;
+}
+
+static void hash_unlink(uint16_t idx)
+{
+    uint16_t *p;
+
+    p = &peers.hash[resreg_hash(peers.tbl[idx].name, 0) & (PEER_HASH - 1)];
+
+    for (;  *p != PEER_NONE;  p = &peers.tbl[*p].chain) {
+        if (*p == idx) {
+            *p = peers.tbl[idx].chain;
+            break;
+        }
+    }
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
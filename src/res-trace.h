@@ -0,0 +1,79 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __RES_TRACE_H__
+#define __RES_TRACE_H__
+
+#include <stdint.h>
+
+#include <res-msg.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Every process using libresource keeps the last RESTRACE_RING_SIZE
+ * protocol events in a fixed size ring. Recording is always on and
+ * costs a clock read and an atomic increment per event; the ring can
+ * be copied out at any time with restrace_snapshot().
+ */
+
+#define RESTRACE_RING_SIZE  4096
+
+typedef enum {
+    RESTRACE_SEND = 1,          /* message sent to the peer */
+    RESTRACE_RECEIVE,           /* message received from the peer */
+    RESTRACE_STATUS,            /* status reply to a sent message */
+    RESTRACE_TIMEOUT,           /* sent message was not replied in time */
+} restrace_type_t;
+
+typedef struct {
+    uint64_t       stamp;       /* CLOCK_MONOTONIC in nanoseconds */
+    uint32_t       seq;         /* internal, do not use */
+    uint32_t       peer;        /* see restrace_peer_name() */
+    uint8_t        event;       /* restrace_type_t */
+    uint8_t        type;        /* resmsg_type_t */
+    uint32_t       id;          /* resource set id */
+    uint32_t       reqno;
+    int32_t        errcod;
+} restrace_event_t;
+
+int   restrace_snapshot(restrace_event_t *, int);
+char *restrace_event_str(restrace_event_t *, uint64_t, char *, int);
+char *restrace_peer_name(uint32_t, char *, int);
+char *restrace_type_str(restrace_type_t);
+
+#ifdef	__cplusplus
+};
+#endif
+
+#endif /* __RES_TRACE_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
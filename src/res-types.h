@@ -23,7 +23,17 @@ USA.
 #ifndef __RES_TYPES_H__
 #define __RES_TYPES_H__
 
-#define RESOURCE_BIT(b)   (((uint32_t)1) << (b))
+#include <stdint.h>
+
+/*
+ * Resource masks are 64 bits wide. Peers that only know 32-bit masks
+ * keep working as long as the resources they deal with are below
+ * RESOURCE_NARROW_BITS; see RESMSG_CAP_WIDE_MASKS in res-msg.h.
+ */
+#define RESOURCE_MASK_BITS     64
+#define RESOURCE_NARROW_BITS   32
+
+#define RESOURCE_BIT(b)   (((uint64_t)1) << (b))
 
 #ifdef	__cplusplus
 extern "C" {
@@ -72,6 +82,13 @@ typedef enum {
 #define RESOURCE_AUTO_RELEASE     RESOURCE_BIT( resource_auto_release )
 #define RESOURCE_ALWAYS_REPLY     RESOURCE_BIT( resource_always_reply )
 
+/* how the pattern of an audio stream property is matched */
+typedef enum {
+    resource_match_equals = 0,
+    resource_match_startswith,
+    resource_match_matches      /* POSIX extended regular expression */
+} resource_match_method_t;
+
 
 #ifdef	__cplusplus
 };
@@ -0,0 +1,311 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "resource-glue.h"
+
+/*
+ * Hooks a D-Bus connection into a main loop that is described only by
+ * its resource_loop_ops_t. This is what the backends use which have no
+ * native D-Bus integration (dbus-gmain) of their own.
+ */
+
+typedef struct {
+    DBusConnection            *conn;
+    const resource_loop_ops_t *ops;
+    void                      *loop;
+    void                      *dispatch;  /* pending dispatch, if any */
+} glue_t;
+
+typedef struct {
+    glue_t       *glue;
+    DBusWatch    *watch;
+    void         *handle;
+} watch_t;
+
+typedef struct {
+    glue_t       *glue;
+    DBusTimeout  *timeout;
+    void         *handle;
+} timeout_t;
+
+static dbus_bool_t add_watch(DBusWatch *, void *);
+static void        remove_watch(DBusWatch *, void *);
+static void        toggle_watch(DBusWatch *, void *);
+static void        handle_watch(int, uint32_t, void *);
+static uint32_t    watch_events(DBusWatch *);
+
+static dbus_bool_t add_timeout(DBusTimeout *, void *);
+static void        remove_timeout(DBusTimeout *, void *);
+static void        toggle_timeout(DBusTimeout *, void *);
+static int         handle_timeout(void *);
+
+static void        dispatch_status(DBusConnection *,
+                                   DBusDispatchStatus, void *);
+static int         dispatch(void *);
+static void        glue_destroy(void *);
+
+
+int resource_dbus_setup_connection(DBusConnection            *conn,
+                                   const resource_loop_ops_t *ops,
+                                   void                      *loop)
+{
+    static dbus_int32_t slot = -1;
+
+    glue_t *glue;
+
+    if (!conn || !ops || !ops->watch_add || !ops->timer_add)
+        return FALSE;
+
+    if (!dbus_connection_allocate_data_slot(&slot))
+        return FALSE;
+
+    if (dbus_connection_get_data(conn, slot) != NULL)
+        return TRUE;            /* already set up */
+
+    if ((glue = malloc(sizeof(glue_t))) == NULL)
+        return FALSE;
+
+    memset(glue, 0, sizeof(glue_t));
+    glue->conn = conn;
+    glue->ops  = ops;
+    glue->loop = loop;
+
+    if (!dbus_connection_set_data(conn, slot, glue, glue_destroy)) {
+        free(glue);
+        return FALSE;
+    }
+
+    if (!dbus_connection_set_watch_functions(conn, add_watch, remove_watch,
+                                             toggle_watch, glue, NULL)     ||
+        !dbus_connection_set_timeout_functions(conn, add_timeout,
+                                               remove_timeout,
+                                               toggle_timeout, glue, NULL)  )
+    {
+        return FALSE;
+    }
+
+    dbus_connection_set_dispatch_status_function(conn, dispatch_status,
+                                                 glue, NULL);
+
+    /* a shared connection might have something queued up already */
+    dispatch_status(conn, dbus_connection_get_dispatch_status(conn), glue);
+
+    return TRUE;
+}
+
+
+static dbus_bool_t add_watch(DBusWatch *watch, void *data)
+{
+    glue_t  *glue = (glue_t *)data;
+    watch_t *w;
+    uint32_t events;
+
+    if ((w = malloc(sizeof(watch_t))) == NULL)
+        return FALSE;
+
+    events = dbus_watch_get_enabled(watch) ? watch_events(watch) : 0;
+
+    w->glue   = glue;
+    w->watch  = watch;
+    w->handle = glue->ops->watch_add(glue->loop,dbus_watch_get_unix_fd(watch),
+                                     events, handle_watch, w);
+
+    if (w->handle == NULL) {
+        free(w);
+        return FALSE;
+    }
+
+    dbus_watch_set_data(watch, w, NULL);
+
+    return TRUE;
+}
+
+static void remove_watch(DBusWatch *watch, void *data)
+{
+    glue_t  *glue = (glue_t *)data;
+    watch_t *w    = dbus_watch_get_data(watch);
+
+    if (w != NULL) {
+        glue->ops->watch_del(glue->loop, w->handle);
+        dbus_watch_set_data(watch, NULL, NULL);
+        free(w);
+    }
+}
+
+static void toggle_watch(DBusWatch *watch, void *data)
+{
+    glue_t  *glue = (glue_t *)data;
+    watch_t *w    = dbus_watch_get_data(watch);
+    uint32_t events;
+
+    if (w != NULL) {
+        events = dbus_watch_get_enabled(watch) ? watch_events(watch) : 0;
+        glue->ops->watch_update(glue->loop, w->handle, events);
+    }
+}
+
+static void handle_watch(int fd, uint32_t events, void *data)
+{
+    watch_t     *w = (watch_t *)data;
+    unsigned int flags = 0;
+
+    (void)fd;
+
+    if (events & RESOURCE_WATCH_READ)   flags |= DBUS_WATCH_READABLE;
+    if (events & RESOURCE_WATCH_WRITE)  flags |= DBUS_WATCH_WRITABLE;
+    if (events & RESOURCE_WATCH_HANGUP) flags |= DBUS_WATCH_HANGUP;
+    if (events & RESOURCE_WATCH_ERROR)  flags |= DBUS_WATCH_ERROR;
+
+    dbus_watch_handle(w->watch, flags);
+}
+
+static uint32_t watch_events(DBusWatch *watch)
+{
+    unsigned int flags  = dbus_watch_get_flags(watch);
+    uint32_t     events = RESOURCE_WATCH_HANGUP | RESOURCE_WATCH_ERROR;
+
+    if (flags & DBUS_WATCH_READABLE) events |= RESOURCE_WATCH_READ;
+    if (flags & DBUS_WATCH_WRITABLE) events |= RESOURCE_WATCH_WRITE;
+
+    return events;
+}
+
+
+static dbus_bool_t add_timeout(DBusTimeout *timeout, void *data)
+{
+    glue_t    *glue = (glue_t *)data;
+    timeout_t *t;
+
+    if ((t = malloc(sizeof(timeout_t))) == NULL)
+        return FALSE;
+
+    t->glue    = glue;
+    t->timeout = timeout;
+    t->handle  = NULL;
+
+    if (dbus_timeout_get_enabled(timeout)) {
+        t->handle = glue->ops->timer_add(glue->loop,
+                                         dbus_timeout_get_interval(timeout),
+                                         handle_timeout, t);
+        if (t->handle == NULL) {
+            free(t);
+            return FALSE;
+        }
+    }
+
+    dbus_timeout_set_data(timeout, t, NULL);
+
+    return TRUE;
+}
+
+static void remove_timeout(DBusTimeout *timeout, void *data)
+{
+    glue_t    *glue = (glue_t *)data;
+    timeout_t *t    = dbus_timeout_get_data(timeout);
+
+    if (t != NULL) {
+        if (t->handle != NULL)
+            glue->ops->timer_del(glue->loop, t->handle);
+        dbus_timeout_set_data(timeout, NULL, NULL);
+        free(t);
+    }
+}
+
+static void toggle_timeout(DBusTimeout *timeout, void *data)
+{
+    glue_t    *glue = (glue_t *)data;
+    timeout_t *t    = dbus_timeout_get_data(timeout);
+
+    if (t != NULL) {
+        if (t->handle != NULL) {
+            glue->ops->timer_del(glue->loop, t->handle);
+            t->handle = NULL;
+        }
+
+        if (dbus_timeout_get_enabled(timeout)) {
+            t->handle = glue->ops->timer_add(glue->loop,
+                                         dbus_timeout_get_interval(timeout),
+                                         handle_timeout, t);
+        }
+    }
+}
+
+static int handle_timeout(void *data)
+{
+    timeout_t *t = (timeout_t *)data;
+
+    dbus_timeout_handle(t->timeout);
+
+    return TRUE;                /* D-Bus removes it explicitly */
+}
+
+
+static void dispatch_status(DBusConnection     *conn,
+                            DBusDispatchStatus  status,
+                            void               *data)
+{
+    glue_t *glue = (glue_t *)data;
+
+    (void)conn;
+
+    if (status == DBUS_DISPATCH_DATA_REMAINS && glue->dispatch == NULL)
+        glue->dispatch = glue->ops->timer_add(glue->loop, 0, dispatch, glue);
+}
+
+static int dispatch(void *data)
+{
+    glue_t         *glue = (glue_t *)data;
+    DBusConnection *conn = glue->conn;
+
+    glue->dispatch = NULL;
+
+    dbus_connection_ref(conn);
+
+    while (dbus_connection_dispatch(conn) == DBUS_DISPATCH_DATA_REMAINS)
+        ;
+
+    dbus_connection_unref(conn);
+
+    return FALSE;
+}
+
+static void glue_destroy(void *data)
+{
+    glue_t *glue = (glue_t *)data;
+
+    if (glue->dispatch != NULL)
+        glue->ops->timer_del(glue->loop, glue->dispatch);
+
+    free(glue);
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,531 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
+#include "resource-epoll.h"
+#include "resource-glue.h"
+#include "visibility.h"
+
+#define MAX_EVENTS 16
+
+typedef enum {
+    source_watch = 0,
+    source_timer,
+    source_wakeup,
+} source_type_t;
+
+typedef struct source_s {
+    struct source_s     *next;
+    source_type_t        type;
+    int                  fd;
+    uint32_t             events;    /* RESOURCE_WATCH_xxx for watches */
+    uint32_t             delay;     /* in msecs for timers */
+    uint32_t             round;     /* of dispatch_fd() it was last seen in */
+    int                  dead;
+    union {
+        resource_watchcb_t  watch;
+        resconn_timercb_t   timer;
+    }                    cb;
+    void                *data;
+} source_t;
+
+typedef struct invoke_s {
+    struct invoke_s     *next;
+    resconn_timercb_t    cbfunc;
+    void                *cbdata;
+} invoke_t;
+
+typedef struct {
+    int                  epfd;
+    int                  dispatching;
+    source_t            *sources;
+    source_t            *graveyard;
+    uint32_t             buried;    /* number of sources buried so far */
+    uint32_t             round;     /* number of dispatch_fd() calls */
+    pthread_mutex_t      lock;      /* held while dispatching, recursive */
+    pthread_mutex_t      qlock;     /* protects invokes */
+    invoke_t            *invokes;
+    source_t             wakeup;    /* eventfd kicked by invoke() */
+} loop_t;
+
+static int       dbus_setup(void *, DBusConnection *);
+static void     *timer_add(void *, uint32_t, resconn_timercb_t, void *);
+static void      timer_del(void *, void *);
+static void     *watch_add(void *, int, uint32_t, resource_watchcb_t, void *);
+static void      watch_update(void *, void *, uint32_t);
+static void      watch_del(void *, void *);
+static int       acquire(void *);
+static void      release(void *);
+static void      invoke(void *, resconn_timercb_t, void *);
+
+static void      init_loop(void);
+static loop_t   *get_loop(void);
+static int       arm_timer(source_t *);
+static int       update_fd(loop_t *, int);
+static void      unlink_source(loop_t *, source_t *);
+static void      bury_source(loop_t *, source_t *);
+static void      dispatch_fd(loop_t *, int, uint32_t);
+static void      dispatch_timer(loop_t *, source_t *);
+static void      dispatch_invokes(loop_t *);
+
+static const resource_loop_ops_t epoll_ops = {
+    .name         = "epoll",
+    .dbus_setup   = dbus_setup,
+    .timer_add    = timer_add,
+    .timer_del    = timer_del,
+    .watch_add    = watch_add,
+    .watch_update = watch_update,
+    .watch_del    = watch_del,
+    .acquire      = acquire,
+    .release      = release,
+    .invoke       = invoke,
+};
+
+static loop_t          default_loop = { .epfd = -1 };
+static pthread_once_t  default_once = PTHREAD_ONCE_INIT;
+
+
+const resource_loop_ops_t *resource_loop_backend(void)
+{
+    return &epoll_ops;
+}
+
+void *resource_loop_default(void)
+{
+    return get_loop();
+}
+
+
+EXPORT int resource_epoll_get_fd(void)
+{
+    loop_t *loop = get_loop();
+
+    return loop ? loop->epfd : -1;
+}
+
+EXPORT int resource_epoll_dispatch(int timeout_ms)
+{
+    loop_t             *loop = get_loop();
+    struct epoll_event  evs[MAX_EVENTS];
+    source_t           *src;
+    int                 n, i;
+
+    if (loop == NULL)
+        return -1;
+
+    if ((n = epoll_wait(loop->epfd, evs, MAX_EVENTS, timeout_ms)) < 0)
+        return (errno == EINTR) ? 0 : -1;
+
+    pthread_mutex_lock(&loop->lock);
+
+    loop->dispatching++;
+
+    for (i = 0;  i < n;  i++) {
+        src = (source_t *)evs[i].data.ptr;
+
+        if (src->dead)
+            continue;
+
+        switch (src->type) {
+        case source_timer:   dispatch_timer(loop, src);                 break;
+        case source_wakeup:  dispatch_invokes(loop);                    break;
+        default:             dispatch_fd(loop, src->fd, evs[i].events); break;
+        }
+    }
+
+    if (--loop->dispatching == 0) {
+        while ((src = loop->graveyard) != NULL) {
+            loop->graveyard = src->next;
+            free(src);
+        }
+    }
+
+    pthread_mutex_unlock(&loop->lock);
+
+    return n;
+}
+
+
+static int dbus_setup(void *loop, DBusConnection *conn)
+{
+    return resource_dbus_setup_connection(conn, &epoll_ops, loop);
+}
+
+static void *timer_add(void              *data,
+                       uint32_t           delay,
+                       resconn_timercb_t  cbfunc,
+                       void              *cbdata)
+{
+    loop_t             *loop = (loop_t *)data;
+    source_t           *src;
+    struct epoll_event  ev;
+
+    if ((src = malloc(sizeof(source_t))) == NULL)
+        return NULL;
+
+    memset(src, 0, sizeof(source_t));
+    src->type     = source_timer;
+    src->delay    = delay;
+    src->cb.timer = cbfunc;
+    src->data     = cbdata;
+    src->fd       = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = EPOLLIN;
+    ev.data.ptr = src;
+
+    if (src->fd < 0 || !arm_timer(src) ||
+        epoll_ctl(loop->epfd, EPOLL_CTL_ADD, src->fd, &ev) < 0)
+    {
+        if (src->fd >= 0)
+            close(src->fd);
+        free(src);
+        return NULL;
+    }
+
+    src->next     = loop->sources;
+    loop->sources = src;
+
+    return src;
+}
+
+static void timer_del(void *data, void *timer)
+{
+    loop_t   *loop = (loop_t *)data;
+    source_t *src  = (source_t *)timer;
+
+    if (src != NULL && !src->dead) {
+        epoll_ctl(loop->epfd, EPOLL_CTL_DEL, src->fd, NULL);
+        close(src->fd);
+        unlink_source(loop, src);
+        bury_source(loop, src);
+    }
+}
+
+static void *watch_add(void               *data,
+                       int                 fd,
+                       uint32_t            events,
+                       resource_watchcb_t  cbfunc,
+                       void               *cbdata)
+{
+    loop_t   *loop = (loop_t *)data;
+    source_t *src;
+
+    if ((src = malloc(sizeof(source_t))) == NULL)
+        return NULL;
+
+    memset(src, 0, sizeof(source_t));
+    src->type     = source_watch;
+    src->fd       = fd;
+    src->events   = events;
+    src->cb.watch = cbfunc;
+    src->data     = cbdata;
+    src->round    = loop->round;  /* not called before the next event */
+
+    src->next     = loop->sources;
+    loop->sources = src;
+
+    if (!update_fd(loop, fd)) {
+        unlink_source(loop, src);
+        free(src);
+        return NULL;
+    }
+
+    return src;
+}
+
+static void watch_update(void *data, void *watch, uint32_t events)
+{
+    loop_t   *loop = (loop_t *)data;
+    source_t *src  = (source_t *)watch;
+
+    if (src != NULL && !src->dead) {
+        src->events = events;
+        update_fd(loop, src->fd);
+    }
+}
+
+static void watch_del(void *data, void *watch)
+{
+    loop_t   *loop = (loop_t *)data;
+    source_t *src  = (source_t *)watch;
+
+    if (src != NULL && !src->dead) {
+        unlink_source(loop, src);
+        update_fd(loop, src->fd);
+        bury_source(loop, src);
+    }
+}
+
+static int acquire(void *data)
+{
+    loop_t *loop = (loop_t *)data;
+
+    return pthread_mutex_trylock(&loop->lock) == 0;
+}
+
+static void release(void *data)
+{
+    loop_t *loop = (loop_t *)data;
+
+    pthread_mutex_unlock(&loop->lock);
+}
+
+static void invoke(void *data, resconn_timercb_t cbfunc, void *cbdata)
+{
+    loop_t   *loop = (loop_t *)data;
+    invoke_t *inv;
+    invoke_t *prev;
+    uint64_t  one  = 1;
+
+    if ((inv = malloc(sizeof(invoke_t))) == NULL)
+        return;
+
+    inv->next   = NULL;
+    inv->cbfunc = cbfunc;
+    inv->cbdata = cbdata;
+
+    pthread_mutex_lock(&loop->qlock);
+
+    for (prev = (invoke_t *)&loop->invokes;  prev->next;  prev = prev->next)
+        ;
+    prev->next = inv;
+
+    pthread_mutex_unlock(&loop->qlock);
+
+    /* EAGAIN means the counter is saturated, ie. a wakeup is pending */
+    while (write(loop->wakeup.fd, &one, sizeof(one)) < 0 && errno == EINTR)
+        ;
+}
+
+
+static void init_loop(void)
+{
+    loop_t              *loop = &default_loop;
+    pthread_mutexattr_t  attr;
+    struct epoll_event   ev;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&loop->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    pthread_mutex_init(&loop->qlock, NULL);
+
+    loop->wakeup.type = source_wakeup;
+    loop->wakeup.fd   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if ((loop->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+        return;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = EPOLLIN;
+    ev.data.ptr = &loop->wakeup;
+
+    if (loop->wakeup.fd < 0 ||
+        epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->wakeup.fd, &ev) < 0)
+    {
+        close(loop->epfd);
+        loop->epfd = -1;
+    }
+}
+
+static loop_t *get_loop(void)
+{
+    loop_t *loop = &default_loop;
+
+    pthread_once(&default_once, init_loop);
+
+    return (loop->epfd < 0) ? NULL : loop;
+}
+
+static int arm_timer(source_t *src)
+{
+    struct itimerspec its;
+
+    /* a zero it_value would disarm the timer, use 1 nsec instead */
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec  = src->delay / 1000;
+    its.it_value.tv_nsec = (src->delay % 1000) * 1000000 + 1;
+
+    return timerfd_settime(src->fd, 0, &its, NULL) == 0;
+}
+
+/*
+ * D-Bus might have separate read and write watches for the same fd
+ * but epoll can have each fd only once. So the watches are kept on our
+ * list and the epoll registration of the fd is recalculated on changes.
+ */
+static int update_fd(loop_t *loop, int fd)
+{
+    source_t           *src;
+    source_t           *first = NULL;
+    uint32_t            events = 0;
+    struct epoll_event  ev;
+    int                 registered = FALSE;
+
+    for (src = loop->sources;  src != NULL;  src = src->next) {
+        if (src->type == source_watch && src->fd == fd) {
+            if (first == NULL)
+                first = src;
+            if (src->events)
+                registered = TRUE;
+            events |= src->events;
+        }
+    }
+
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+
+    if (!registered)
+        return TRUE;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.data.ptr = first;
+
+    if (events & RESOURCE_WATCH_READ)   ev.events |= EPOLLIN;
+    if (events & RESOURCE_WATCH_WRITE)  ev.events |= EPOLLOUT;
+
+    return epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+static void unlink_source(loop_t *loop, source_t *src)
+{
+    source_t *prev;
+
+    for (prev = (source_t *)&loop->sources;  prev->next;  prev = prev->next) {
+        if (prev->next == src) {
+            prev->next = src->next;
+            src->next  = NULL;
+            break;
+        }
+    }
+}
+
+/*
+ * Sources are never freed right away: the loop might be dispatching, or
+ * another thread might have just picked the source up from epoll_wait()
+ * before acquiring the loop. The graveyard is emptied after dispatching.
+ */
+static void bury_source(loop_t *loop, source_t *src)
+{
+    src->dead       = TRUE;
+    src->next       = loop->graveyard;
+    loop->graveyard = src;
+
+    loop->buried++;
+}
+
+/*
+ * A callback might remove any of the sources, including the one after
+ * it, which then links to the graveyard. So the scan starts over when
+ * something got buried, and each source is called at most once a round.
+ */
+static void dispatch_fd(loop_t *loop, int fd, uint32_t epoll_events)
+{
+    source_t *src;
+    uint32_t  events = 0;
+    uint32_t  round;
+    uint32_t  buried;
+
+    if (epoll_events & EPOLLIN)   events |= RESOURCE_WATCH_READ;
+    if (epoll_events & EPOLLOUT)  events |= RESOURCE_WATCH_WRITE;
+    if (epoll_events & EPOLLHUP)  events |= RESOURCE_WATCH_HANGUP;
+    if (epoll_events & EPOLLERR)  events |= RESOURCE_WATCH_ERROR;
+
+    round = ++loop->round;
+    src   = loop->sources;
+
+    while (src != NULL) {
+        if (src->round != round) {
+            src->round = round;
+
+            if (src->type == source_watch && src->fd == fd &&
+                (src->events & events) && !src->dead)
+            {
+                buried = loop->buried;
+
+                src->cb.watch(fd, src->events & events, src->data);
+
+                if (loop->buried != buried) {
+                    src = loop->sources;
+                    continue;
+                }
+            }
+        }
+
+        src = src->next;
+    }
+}
+
+static void dispatch_timer(loop_t *loop, source_t *src)
+{
+    uint64_t expirations;
+
+    if (read(src->fd, &expirations, sizeof(expirations)) < 0)
+        return;
+
+    if (src->cb.timer(src->data)) {
+        if (!src->dead)
+            arm_timer(src);
+    }
+    else {
+        timer_del(loop, src);
+    }
+}
+
+static void dispatch_invokes(loop_t *loop)
+{
+    invoke_t *inv;
+    invoke_t *next;
+    uint64_t  count;
+
+    if (read(loop->wakeup.fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        return;
+
+    pthread_mutex_lock(&loop->qlock);
+    inv = loop->invokes;
+    loop->invokes = NULL;
+    pthread_mutex_unlock(&loop->qlock);
+
+    for (;  inv != NULL;  inv = next) {
+        next = inv->next;
+        inv->cbfunc(inv->cbdata);
+        free(inv);
+    }
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
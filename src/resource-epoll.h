@@ -0,0 +1,57 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __LIB_RESOURCE_EPOLL_H__
+#define __LIB_RESOURCE_EPOLL_H__
+
+#include <resource.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * libresource-epoll runs the resource sets on a private epoll(7) instance
+ * instead of a GLib main loop. Either poll the returned descriptor for
+ * readability in the application's own loop and call
+ * resource_epoll_dispatch(0) when it becomes readable, or simply call
+ * resource_epoll_dispatch(-1) in a loop. The thread calling
+ * resource_epoll_dispatch() is the one running the callbacks.
+ */
+
+int resource_epoll_get_fd(void);
+int resource_epoll_dispatch(int timeout_ms);
+
+#ifdef	__cplusplus
+};
+#endif
+
+#endif /* __LIB_RESOURCE_EPOLL_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
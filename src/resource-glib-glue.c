@@ -27,29 +27,147 @@ USA.
 #include <glib.h>
 #include <dbus-gmain/dbus-gmain.h>
 
+#include "resource-glib.h"
 #include "resource-glue.h"
 #include "visibility.h"
 
-DBusConnection *resource_get_dbus_bus(DBusBusType type, DBusError *err)
+typedef struct {
+    resconn_timercb_t  cbfunc;
+    void              *cbdata;
+    GSource           *source;
+} gtimer_t;
+
+static int       dbus_setup(void *, DBusConnection *);
+static void     *timer_add(void *, uint32_t, resconn_timercb_t, void *);
+static void      timer_del(void *, void *);
+static gboolean  timer_cb(gpointer);
+static void      context_unref(void *);
+static int       acquire(void *);
+static void      release(void *);
+static void      invoke(void *, resconn_timercb_t, void *);
+
+static const resource_loop_ops_t glib_ops = {
+    .name       = "glib",
+    .dbus_setup = dbus_setup,
+    .timer_add  = timer_add,
+    .timer_del  = timer_del,
+    .acquire    = acquire,
+    .release    = release,
+    .invoke     = invoke,
+    /* D-Bus watches are taken care of by dbus-gmain */
+};
+
+
+const resource_loop_ops_t *resource_loop_backend(void)
+{
+    return &glib_ops;
+}
+
+void *resource_loop_default(void)
+{
+    return NULL;                /* ie. g_main_context_default() */
+}
+
+
+EXPORT resource_context_t *resource_context_new(GMainContext *main_context)
+{
+    resource_context_t *ctx;
+
+    if (main_context == NULL)
+        main_context = g_main_context_default();
+
+    g_main_context_ref(main_context);
+
+    ctx = resource_context_create(&glib_ops, main_context, context_unref);
+
+    if (ctx == NULL)
+        g_main_context_unref(main_context);
+
+    return ctx;
+}
+
+
+static void context_unref(void *loop)
+{
+    g_main_context_unref((GMainContext *)loop);
+}
+
+static int dbus_setup(void *loop, DBusConnection *conn)
 {
-    DBusConnection *conn = NULL;
+    dbus_gmain_set_up_connection(conn, (GMainContext *)loop);
 
-    if ((conn = dbus_bus_get(type, err)) != NULL) {
-        dbus_gmain_set_up_connection(conn, NULL);
+    return TRUE;
+}
+
+static void *timer_add(void              *loop,
+                       uint32_t           delay,
+                       resconn_timercb_t  cbfunc,
+                       void              *cbdata)
+{
+    gtimer_t *timer;
+
+    if ((timer = malloc(sizeof(gtimer_t))) != NULL) {
+        timer->cbfunc = cbfunc;
+        timer->cbdata = cbdata;
+        timer->source = delay ? g_timeout_source_new(delay) :
+                                g_idle_source_new();
+
+        g_source_set_callback(timer->source, timer_cb, timer, free);
+        g_source_attach(timer->source, (GMainContext *)loop);
     }
 
-    return conn;
+    return timer;
 }
 
-void *resource_timer_add(uint32_t delay, resconn_timercb_t cbfunc,void *cbdata)
+static void timer_del(void *loop, void *data)
 {
-    return NULL;
+    gtimer_t *timer = (gtimer_t *)data;
+    GSource *source;
+
+    (void)loop;
+
+    if (timer != NULL) {
+        source = timer->source;
+        g_source_destroy(source);   /* frees the timer as well */
+        g_source_unref(source);
+    }
 }
 
-void resource_timer_del(void *timer)
+static gboolean timer_cb(gpointer data)
 {
+    gtimer_t *timer = (gtimer_t *)data;
+    GSource *source;
+
+    if (timer->cbfunc(timer->cbdata))
+        return TRUE;
+
+    source = timer->source;
+    g_source_unref(source);     /* drop our reference, GLib frees the rest */
+
+    return FALSE;
 }
 
+static int acquire(void *loop)
+{
+    GMainContext *ctx = loop ? (GMainContext *)loop : g_main_context_default();
+
+    return g_main_context_acquire(ctx);
+}
+
+static void release(void *loop)
+{
+    GMainContext *ctx = loop ? (GMainContext *)loop : g_main_context_default();
+
+    g_main_context_release(ctx);
+}
+
+static void invoke(void *loop, resconn_timercb_t cbfunc, void *cbdata)
+{
+    /* resconn_timercb_t and GSourceFunc are the very same type */
+    g_main_context_invoke((GMainContext *)loop, (GSourceFunc)cbfunc, cbdata);
+}
+
+
 /* 
  * Local Variables:
  * c-basic-offset: 4
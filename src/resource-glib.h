@@ -0,0 +1,56 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __LIB_RESOURCE_GLIB_H__
+#define __LIB_RESOURCE_GLIB_H__
+
+#include <glib.h>
+#include <resource.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Create a resource context bound to the given GMainContext (NULL means
+ * the default one). Resource sets created with
+ * resource_set_create_in_context() get a private D-Bus connection that
+ * is dispatched by main_context, so all their callbacks are invoked from
+ * the thread iterating main_context. The context holds a reference to
+ * main_context until it is freed by resource_context_destroy().
+ */
+resource_context_t *resource_context_new(GMainContext *main_context);
+
+#ifdef	__cplusplus
+};
+#endif
+
+#endif /* __LIB_RESOURCE_GLIB_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,67 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "resource-glue.h"
+#include "visibility.h"
+
+
+DBusConnection *resource_get_dbus_bus(DBusBusType type, DBusError *err)
+{
+    const resource_loop_ops_t *ops  = resource_loop_backend();
+    DBusConnection            *conn = NULL;
+
+    if ((conn = dbus_bus_get(type, err)) != NULL) {
+        if (!ops->dbus_setup(resource_loop_default(), conn)) {
+            dbus_connection_unref(conn);
+            conn = NULL;
+        }
+    }
+
+    return conn;
+}
+
+void *resource_timer_add(uint32_t delay, resconn_timercb_t cbfunc,void *cbdata)
+{
+    const resource_loop_ops_t *ops = resource_loop_backend();
+
+    return ops->timer_add(resource_loop_default(), delay, cbfunc, cbdata);
+}
+
+void resource_timer_del(void *timer)
+{
+    const resource_loop_ops_t *ops = resource_loop_backend();
+
+    if (timer != NULL)
+        ops->timer_del(resource_loop_default(), timer);
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
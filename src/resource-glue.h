@@ -27,10 +27,56 @@ USA.
 
 #include <res-conn.h>
 
+#include "resource.h"
+
+#define RESOURCE_WATCH_READ    (1 << 0)
+#define RESOURCE_WATCH_WRITE   (1 << 1)
+#define RESOURCE_WATCH_HANGUP  (1 << 2)
+#define RESOURCE_WATCH_ERROR   (1 << 3)
+
+typedef void (*resource_watchcb_t)(int, uint32_t, void *);
+
+/*
+ * Main loop abstraction. Every backend (GLib, epoll, ...) provides one
+ * of these. The first argument of each operation is the backend specific
+ * loop data. Timer callbacks follow the resconn_timercb_t convention,
+ * ie. returning TRUE rearms the timer and FALSE removes it.
+ *
+ * Only acquire and invoke may be called from any thread. A successful
+ * acquire makes the calling thread the one dispatching the loop until
+ * the matching release (it nests for the dispatching thread itself).
+ * invoke schedules a one-shot callback on the dispatching thread.
+ */
+typedef struct {
+    const char  *name;
+    int        (*dbus_setup)  (void *, DBusConnection *);
+    void      *(*timer_add)   (void *, uint32_t, resconn_timercb_t, void *);
+    void       (*timer_del)   (void *, void *);
+    void      *(*watch_add)   (void *, int, uint32_t,resource_watchcb_t,void*);
+    void       (*watch_update)(void *, void *, uint32_t);
+    void       (*watch_del)   (void *, void *);
+    int        (*acquire)     (void *);
+    void       (*release)     (void *);
+    void       (*invoke)      (void *, resconn_timercb_t, void *);
+} resource_loop_ops_t;
+
+/* provided by the main loop backend */
+const resource_loop_ops_t *resource_loop_backend(void);
+void                      *resource_loop_default(void);
+
+/* backend independent glue, see resource-glue.c */
 DBusConnection *resource_get_dbus_bus(DBusBusType, DBusError *);
 void           *resource_timer_add(uint32_t, resconn_timercb_t,void *);
 void            resource_timer_del(void *);
 
+/* contexts, see resource.c */
+resource_context_t *resource_context_create(const resource_loop_ops_t *,
+                                            void *, void (*)(void *));
+
+/* D-Bus integration for backends without a native one */
+int resource_dbus_setup_connection(DBusConnection *,
+                                   const resource_loop_ops_t *, void *);
+
 #endif /* __LIB_RESOURCE_GLUE_H__ */
 
 /* 
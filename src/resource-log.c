@@ -0,0 +1,365 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "resource-log.h"
+
+#ifndef TRUE
+#define FALSE 0
+#define TRUE  1
+#endif
+
+#define RING_SIZE      256      /* must be a power of two */
+#define LINE_MAX_LEN   256
+
+typedef struct {
+    unsigned int  seq;          /* slot sequence number */
+    int           len;
+    char          line[LINE_MAX_LEN];
+} slot_t;
+
+/*
+ * Bounded multi-producer single-consumer ring. A producer claims a slot
+ * by advancing head and publishes it by setting the sequence number of
+ * the slot to position + 1. The consumer frees the slot by setting it
+ * to position + RING_SIZE. When the ring is full messages are dropped
+ * and counted rather than blocking the caller.
+ */
+static struct {
+    slot_t           slots[RING_SIZE];
+    unsigned int     head;      /* next position to claim */
+    unsigned int     tail;      /* next position to consume */
+    unsigned int     dropped;
+    pthread_mutex_t  lock;      /* serializes consumers */
+    sem_t            sem;       /* posted for every message */
+    int              running;   /* the writer thread is up */
+} ring = {
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/* everything passes until the environment has been checked */
+int reslog_levels[RESLOG_CATEGORY_MAX] = {
+    [0 ... RESLOG_CATEGORY_MAX - 1] = RESLOG_DEBUG
+};
+
+static const char *level_names[] = {
+    [RESLOG_ERROR]   = "error",
+    [RESLOG_WARNING] = "warning",
+    [RESLOG_INFO]    = "info",
+    [RESLOG_DEBUG]   = "debug",
+};
+
+static const char *reslog_category_names[RESLOG_CATEGORY_MAX] = {
+    [RESLOG_CONTEXT] = "context",
+    [RESLOG_SET]     = "set",
+    [RESLOG_REQUEST] = "request",
+    [RESLOG_MESSAGE] = "message",
+};
+
+static pthread_once_t  init_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void  init_log(void);
+static int   parse_config(const char *);
+static int   level_by_name(const char *, int);
+static void  start_writer(void);
+static void *writer(void *);
+static void  drain(void);
+static void  reset_after_fork(void);
+
+
+void reslog_write(reslog_category_t  category,
+                  reslog_level_t     level,
+                  const char        *fmt,
+                  ...)
+{
+    va_list       ap;
+    slot_t       *slot;
+    unsigned int  pos;
+    unsigned int  seq;
+    int           len;
+    int           n;
+
+    pthread_once(&init_once, init_log);
+
+    if (!reslog_enabled(category, level))
+        return;
+
+    if (!__atomic_load_n(&ring.running, __ATOMIC_ACQUIRE))
+        start_writer();
+
+    pos = __atomic_load_n(&ring.head, __ATOMIC_RELAXED);
+
+    for (;;) {
+        slot = ring.slots + (pos & (RING_SIZE - 1));
+        seq  = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        if (seq == pos) {
+            if (__atomic_compare_exchange_n(&ring.head, &pos, pos + 1, TRUE,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+                break;
+        }
+        else if ((int)(seq - pos) < 0) {
+            __atomic_fetch_add(&ring.dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        else
+            pos = __atomic_load_n(&ring.head, __ATOMIC_RELAXED);
+    }
+
+    len = snprintf(slot->line, LINE_MAX_LEN, "resource: [%s] %s: ",
+                   level_names[level], reslog_category_names[category]);
+
+    va_start(ap, fmt);
+    n = vsnprintf(slot->line + len, LINE_MAX_LEN - len, fmt, ap);
+    va_end(ap);
+
+    if (n > 0)
+        len += n;
+
+    if (len > LINE_MAX_LEN - 2)     /* truncated */
+        len = LINE_MAX_LEN - 2;
+
+    slot->line[len++] = '\n';
+    slot->len = len;
+
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    sem_post(&ring.sem);
+}
+
+void reslog_flush(void)
+{
+    if (__atomic_load_n(&ring.running, __ATOMIC_ACQUIRE))
+        drain();
+}
+
+
+static void init_log(void)
+{
+    const char *envstr;
+    char       *end;
+    long        debug;
+    int         level;
+    int         i;
+
+    level = -1;
+
+    if ((envstr = getenv("LIBRESOURCE_DEBUG")) != NULL && envstr[0]) {
+        debug = strtol(envstr, &end, 10);
+
+        if (!*end && debug > 0)
+            level = RESLOG_DEBUG;
+    }
+
+    for (i = 0;  i < RESLOG_CATEGORY_MAX;  i++)
+        reslog_levels[i] = level;
+
+    if ((envstr = getenv("LIBRESOURCE_LOG")) != NULL && envstr[0]) {
+        if (!parse_config(envstr)) {
+            fprintf(stderr, "resource: invalid LIBRESOURCE_LOG '%s'\n",envstr);
+
+            for (i = 0;  i < RESLOG_CATEGORY_MAX;  i++)
+                reslog_levels[i] = -1;
+        }
+    }
+
+    sem_init(&ring.sem, 0, 0);
+
+    for (i = 0;  i < RING_SIZE;  i++)
+        ring.slots[i].seq = i;
+
+    pthread_atfork(NULL, NULL, reset_after_fork);
+}
+
+static int parse_config(const char *config)
+{
+    const char *colon;
+    const char *p;
+    const char *e;
+    int         level;
+    int         found;
+    int         i;
+
+    colon = strchr(config, ':');
+
+    if ((level = level_by_name(config, colon ? colon - config : -1)) < 0)
+        return FALSE;
+
+    if (colon == NULL) {
+        for (i = 0;  i < RESLOG_CATEGORY_MAX;  i++)
+            reslog_levels[i] = level;
+
+        return TRUE;
+    }
+
+    for (i = 0;  i < RESLOG_CATEGORY_MAX;  i++)
+        reslog_levels[i] = -1;
+
+    for (p = colon + 1;  *p;  p = *e ? e + 1 : e) {
+        if ((e = strchr(p, ',')) == NULL)
+            e = p + strlen(p);
+
+        for (i = 0, found = FALSE;  i < RESLOG_CATEGORY_MAX;  i++) {
+            if (!strncmp(p, reslog_category_names[i], e - p) &&
+                !reslog_category_names[i][e - p])
+            {
+                reslog_levels[i] = level;
+                found = TRUE;
+            }
+        }
+
+        if (!found)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static int level_by_name(const char *name, int len)
+{
+    int i;
+
+    if (len < 0)
+        len = strlen(name);
+
+    for (i = RESLOG_ERROR;  i <= RESLOG_DEBUG;  i++) {
+        if (!strncmp(name, level_names[i], len) && !level_names[i][len])
+            return i;
+    }
+
+    return -1;
+}
+
+static void start_writer(void)
+{
+    pthread_attr_t attr;
+    pthread_t      tid;
+
+    pthread_mutex_lock(&start_lock);
+
+    if (!ring.running) {
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+        if (pthread_create(&tid, &attr, writer, NULL) == 0) {
+            __atomic_store_n(&ring.running, TRUE, __ATOMIC_RELEASE);
+            atexit(reslog_flush);
+        }
+
+        pthread_attr_destroy(&attr);
+    }
+
+    pthread_mutex_unlock(&start_lock);
+}
+
+static void *writer(void *data)
+{
+    (void)data;
+
+    for (;;) {
+        while (sem_wait(&ring.sem) < 0 && errno == EINTR)
+            ;
+
+        drain();
+    }
+
+    return NULL;
+}
+
+static void drain(void)
+{
+    slot_t       *slot;
+    unsigned int  dropped;
+    char          buf[4096];
+    int           len;
+    int           n;
+
+    pthread_mutex_lock(&ring.lock);
+
+    for (len = 0;  ;  ring.tail++) {
+        slot = ring.slots + (ring.tail & (RING_SIZE - 1));
+
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ring.tail + 1)
+            break;
+
+        if (len + slot->len > (int)sizeof(buf)) {
+            fwrite(buf, 1, len, stdout);
+            len = 0;
+        }
+
+        memcpy(buf + len, slot->line, slot->len);
+        len += slot->len;
+
+        __atomic_store_n(&slot->seq, ring.tail + RING_SIZE, __ATOMIC_RELEASE);
+    }
+
+    if ((dropped = __atomic_exchange_n(&ring.dropped, 0, __ATOMIC_RELAXED))) {
+        n = snprintf(buf + len, sizeof(buf) - len, "resource: [warning] "
+                     "log: %u messages dropped\n", dropped);
+
+        if (n > 0 && n < (int)sizeof(buf) - len)
+            len += n;
+    }
+
+    if (len > 0)
+        fwrite(buf, 1, len, stdout);
+
+    pthread_mutex_unlock(&ring.lock);
+}
+
+static void reset_after_fork(void)
+{
+    int i;
+
+    /* the writer thread did not survive the fork */
+    pthread_mutex_init(&ring.lock, NULL);
+    pthread_mutex_init(&start_lock, NULL);
+
+    ring.running = FALSE;
+    ring.dropped = 0;
+    ring.head    = 0;
+    ring.tail    = 0;
+
+    for (i = 0;  i < RING_SIZE;  i++)
+        ring.slots[i].seq = i;
+
+    sem_destroy(&ring.sem);
+    sem_init(&ring.sem, 0, 0);
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,82 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __LIB_RESOURCE_LOG_H__
+#define __LIB_RESOURCE_LOG_H__
+
+/*
+ * Leveled logging of the resource libraries. Every message has a level
+ * and a category; the enabled level of each category comes from the
+ * environment:
+ *
+ *   LIBRESOURCE_LOG=level[:category[,category...]]
+ *
+ * where level is one of error, warning, info or debug and the categories
+ * are context, set, request and message (all of them by default). The
+ * old LIBRESOURCE_DEBUG=<positive number> turns on everything.
+ *
+ * resource_log() is a macro which does not evaluate its arguments when
+ * the message is filtered out, so formatting helpers can be used in the
+ * argument list for free. Enabled messages are formatted by the caller
+ * into a lock-free ring and written to stdout by a background thread.
+ */
+
+typedef enum {
+    RESLOG_ERROR = 0,
+    RESLOG_WARNING,
+    RESLOG_INFO,
+    RESLOG_DEBUG,
+} reslog_level_t;
+
+typedef enum {
+    RESLOG_CONTEXT = 0,         /* resource contexts and D-Bus setup */
+    RESLOG_SET,                 /* resource set life cycle */
+    RESLOG_REQUEST,             /* request queue */
+    RESLOG_MESSAGE,             /* messages to and from the manager */
+    RESLOG_CATEGORY_MAX
+} reslog_category_t;
+
+/* the highest enabled level per category, -1 if disabled */
+extern int reslog_levels[RESLOG_CATEGORY_MAX];
+
+#define reslog_enabled(cat, lvl) ((int)(lvl) <= reslog_levels[(cat)])
+
+#define resource_log(cat, lvl, fmt, args...)                    \
+    do {                                                        \
+        if (reslog_enabled(cat, lvl))                           \
+            reslog_write(cat, lvl, fmt, ##args);                \
+    } while (0)
+
+void reslog_write(reslog_category_t, reslog_level_t, const char *, ...)
+    __attribute__ ((format (printf, 3, 4)));
+void reslog_flush(void);
+
+#endif /* __LIB_RESOURCE_LOG_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
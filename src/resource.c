@@ -23,14 +23,19 @@ USA.
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
 
 #include <res-conn.h>
 #include <res-msg.h>
 
 #include "resource.h"
 #include "resource-glue.h"
+#include "resource-log.h"
+#include "res-alloc-private.h"
 #include "visibility.h"
 
 #include <res-conn.h>
@@ -42,11 +47,15 @@ typedef enum {
     client_ready
 } client_state_t;
 
+#define REQUEST_RING_SIZE  64        /* must be a power of two */
+
 typedef void (*request_complete_t)(resource_set_t *, uint32_t, void *,
                                    int32_t, const char *);
 
 typedef struct request_s {
     struct request_s        *next;
+    struct request_s        *prev;
+    struct resource_set_s   *rs;         /* owner of the request */
     resmsg_type_t            msgtyp;
     uint32_t                 reqno;
     int                      busy;
@@ -59,7 +68,7 @@ typedef struct request_s {
 
 #define RESOURCE_CONFIG_COMMON     \
     union resource_config_u *next; \
-    uint32_t                 mask
+    uint64_t                 mask
 
 typedef struct {
     RESOURCE_CONFIG_COMMON;
@@ -71,6 +80,8 @@ typedef struct {
     pid_t                    pid;        /* PID of the streaming component */
     char                    *app_id;     /* application id of the streaming component */
     char                   *stream;     /* pulseaudio stream name */
+    uint32_t                 nextra;     /* number of further properties */
+    resmsg_property_t       *extra;      /* further stream properties */
 } audio_config_t;
 
 typedef struct {
@@ -94,8 +105,66 @@ typedef struct {
     void                      *data;
 } error_callback_t;
 
+typedef enum {
+    command_create = 0,
+    command_destroy,
+    command_advice_callback,
+    command_error_callback,
+    command_configure_resources,
+    command_configure_audio,
+    command_audio_property,
+    command_configure_video,
+    command_acquire,
+    command_release,
+    command_context_destroy,
+} command_type_t;
+
+typedef struct command_s {
+    struct command_s        *next;
+    command_type_t           type;
+    struct resource_set_s   *rs;
+    union {
+        callback_t           advice;
+        error_callback_t     error;
+        struct {
+            uint64_t         mandatory;
+            uint64_t         optional;
+        }                    resources;
+        struct {
+            char            *group;
+            pid_t            pid;
+            char            *stream;
+        }                    audio;
+        struct {
+            char            *name;
+            resmsg_match_method_t method;
+            char            *pattern;
+        }                    property;
+        pid_t                pid;
+    }                        u;
+} command_t;
+
+struct resource_context_s {
+    struct resource_context_s *next;
+    const resource_loop_ops_t *ops;      /* NULL for the library defaults */
+    void                      *loop;     /* main loop of the context */
+    void                     (*loop_free)(void *);
+    DBusConnection            *dbus;     /* D-Bus connection */
+    resconn_t                 *manager;  /* resource manager connection */
+    struct resource_set_s     *rslist;   /* resource sets of the context */
+    uint32_t                   rsid;     /* next resource set id */
+    uint32_t                   reqno;    /* last request number */
+    struct request_s          *reqring[REQUEST_RING_SIZE]; /* by reqno */
+    int                        dead;     /* destroy when rslist is empty */
+    int                        freeing;  /* context_free() is scheduled */
+    pthread_mutex_t            cmdlock;  /* protects cmdq and pending */
+    command_t                 *cmdq;     /* commands from other threads */
+    int                        pending;  /* number of command dispatches */
+};
+
 struct resource_set_s {
     struct resource_set_s   *next;
+    resource_context_t      *ctx;        /* context of the resource set */
     DBusConnection          *dbus;       /* D-Bus connection */
     char                    *app_id;     /* resource application id */
     char                    *klass;      /* resource class */
@@ -103,27 +172,54 @@ struct resource_set_s {
     uint32_t                 mode;
     resconn_t               *resconn;
     struct {
-        uint32_t all;
-        uint32_t opt;
+        uint64_t all;
+        uint64_t opt;
     }                        resources;  /* libresource resources */
     client_state_t           client;     /* resource client state */
     int                      acquire;
+    int                      acquiring;  /* as last asked for, by cmdlock */
+    int                      calls;      /* acquire/release calls not run */
     callback_t               grantcb;
     callback_t               advicecb;
     error_callback_t         errorcb;
     resource_config_t       *configs;
     resset_t                *resset;
     request_t               *reqlist;
+    request_t               *reqtail;    /* last request of reqlist */
+    uint64_t                 acqstamp;   /* when acquire was sent, if any */
 };
 
-static resource_set_t *rslist;
-static uint32_t        rsid;
-static uint32_t        reqno;
-static DBusConnection *rsdbus;
-
-
-static DBusConnection *get_dbus(void);
-static resconn_t      *get_manager(DBusConnection *);
+static resource_context_t  default_context = {
+    .cmdlock = PTHREAD_MUTEX_INITIALIZER
+};
+static resource_context_t *ctxlist = &default_context;
+static pthread_mutex_t     ctxlock = PTHREAD_MUTEX_INITIALIZER;
+static reshist_t           grant_latency;
+static pthread_once_t      grant_latency_once = PTHREAD_ONCE_INIT;
+
+
+static int             execute_command(resource_context_t *, command_t *);
+static int             command_dispatch(void *);
+static void            run_queued_commands(resource_context_t *);
+static int             run_command(resource_context_t *, command_t *);
+static void            acquire_called(resource_set_t *, int);
+static void            acquire_done(resource_set_t *);
+static void            acquire_dropped(resource_set_t *);
+static int             set_create(resource_context_t *, resource_set_t *);
+static int             set_configure_resources(resource_set_t *,
+                                               uint64_t, uint64_t);
+static int             set_configure_audio(resource_set_t *, const char *,
+                                           pid_t, const char *);
+static int             set_audio_property(resource_set_t *, const char *,
+                                          resmsg_match_method_t,const char *);
+static int             set_configure_video(resource_set_t *, pid_t);
+static const resource_loop_ops_t *context_ops(resource_context_t *);
+static void           *context_loop(resource_context_t *);
+static void            context_check_free(resource_context_t *);
+static int             context_free_cb(void *);
+static void            context_free(resource_context_t *);
+static DBusConnection *get_dbus(resource_context_t *);
+static resconn_t      *get_manager(resource_context_t *);
 static void            manager_is_up(resconn_t *);
 static void            connect_to_manager(resconn_t *, resource_set_t *);
 static void            disconnect_from_manager(resmsg_t *, resset_t *,void *);
@@ -148,77 +244,143 @@ static int             audio_config_create(resource_set_t *, const char *,
                                            pid_t pid, const char *);
 static int             audio_config_update(resource_config_t *, const char *,
                                            pid_t, const char *);
+static int             audio_property_update(resource_config_t *,
+                                             const char *,
+                                             resmsg_match_method_t,
+                                             const char *);
 static int             video_config_create(resource_set_t *, pid_t pid);
 static int             video_config_update(resource_config_t *, pid_t);
 static uint32_t        push_request(resource_set_t *, resmsg_type_t,
                                     request_complete_t, void *);
 static request_t      *peek_request(resource_set_t *);
 static request_t      *pop_request(resource_set_t *, uint32_t);
+static void            forget_request(resource_context_t *, request_t *);
 static void            destroy_request(request_t *);
-static void            resource_log(const char *, ...);
+static void            grant_latency_init(void);
+static uint64_t        clock_ns(void);
 
 
 EXPORT int resource_set_use_dbus(DBusConnection *conn)
 {
-    if (rslist != NULL) {
-        resource_log("refusing D-Bus connection change, has resource sets");
+    resource_context_t *ctx = &default_context;
+
+    if (ctx->rslist != NULL) {
+        resource_log(RESLOG_CONTEXT, RESLOG_WARNING,
+                     "refusing D-Bus connection change, has resource sets");
         return FALSE;
     }
     
-    if (rsdbus != NULL) {
-        dbus_connection_unref(rsdbus);
-        rsdbus = NULL;
+    if (ctx->manager != NULL) {
+        resproto_destroy(ctx->manager);
+        ctx->manager = NULL;
+    }
+
+    if (ctx->dbus != NULL) {
+        dbus_connection_unref(ctx->dbus);
+        ctx->dbus = NULL;
     }
     
     if (conn != NULL)
-        rsdbus = conn;
+        ctx->dbus = conn;
 
     return TRUE;
 }
 
 
+resource_context_t *resource_context_create(const resource_loop_ops_t *ops,
+                                            void                      *loop,
+                                            void (*loop_free)(void *))
+{
+    resource_context_t *ctx;
+
+    if (ops == NULL || ops->dbus_setup == NULL)
+        return NULL;
+
+    if ((ctx = malloc(sizeof(resource_context_t))) != NULL) {
+        memset(ctx, 0, sizeof(resource_context_t));
+        ctx->ops       = ops;
+        ctx->loop      = loop;
+        ctx->loop_free = loop_free;
+
+        pthread_mutex_init(&ctx->cmdlock, NULL);
+
+        pthread_mutex_lock(&ctxlock);
+        ctx->next = ctxlist;
+        ctxlist   = ctx;
+        pthread_mutex_unlock(&ctxlock);
+
+        resource_log(RESLOG_CONTEXT, RESLOG_INFO,
+                     "created %s resource context %p", ops->name, ctx);
+    }
+
+    return ctx;
+}
+
+EXPORT resource_context_t *resource_context_default(void)
+{
+    return &default_context;
+}
+
+EXPORT void resource_context_destroy(resource_context_t *ctx)
+{
+    command_t cmd;
+
+    if (ctx == NULL || ctx == &default_context)
+        return;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = command_context_destroy;
+
+    execute_command(ctx, &cmd);
+}
+
+
 EXPORT resource_set_t *resource_set_create(const char          *klass,
-                                           uint32_t             mandatory,
-                                           uint32_t             optional,
+                                           uint64_t             mandatory,
+                                           uint64_t             optional,
+                                           uint32_t             mode,
+                                           resource_callback_t  grantcb,
+                                           void                *grantdata)
+{
+    return resource_set_create_in_context(&default_context, klass,
+                                          mandatory, optional, mode,
+                                          grantcb, grantdata);
+}
+
+EXPORT resource_set_t *resource_set_create_in_context(
+                                           resource_context_t  *ctx,
+                                           const char          *klass,
+                                           uint64_t             mandatory,
+                                           uint64_t             optional,
                                            uint32_t             mode,
                                            resource_callback_t  grantcb,
                                            void                *grantdata)
 {
-    DBusConnection *dbus    = get_dbus();
-    resconn_t      *resconn = get_manager(dbus);
-    resource_set_t *rs      = NULL;
-    char            mbuf[256];
-    char            obuf[256];
+    resource_set_t *rs = NULL;
+    command_t       cmd;
 
-    if (klass && (mandatory || optional) && grantcb) {
+    if (ctx != NULL && klass && (mandatory || optional) && grantcb) {
 
         optional = optional & ~mandatory;
 
-        if ((rs = malloc(sizeof(resource_set_t))) != NULL) {
+        if ((rs = RESALLOC_MALLOC(RSET, sizeof(resource_set_t))) != NULL) {
             
             memset(rs, 0, sizeof(resource_set_t));
-            rs->next    = rslist;
-            rs->dbus    = dbus;
+            rs->ctx     = ctx;
             rs->app_id  = resource_generate_app_id(getpid());
-            rs->klass   = strdup(klass);
-            rs->id      = rsid++;
+            rs->klass   = RESALLOC_STRDUP(klass);
             rs->mode    = mode;
-            rs->resconn = resconn;
             rs->client  = client_created;
             rs->resources.all    = mandatory | optional;
             rs->resources.opt    = optional;
             rs->grantcb.function = grantcb;
             rs->grantcb.data     = grantdata;
-            
-            rslist = rs;
 
-            resource_log("created resource set %u (app_id '%s', klass '%s', "
-                         "mandatory %s, optional %s)",
-                         rs->id, rs->app_id, rs->klass,
-                         resmsg_res_str(mandatory, mbuf, sizeof(mbuf)),
-                         resmsg_res_str(optional , obuf, sizeof(obuf)));
-            
-            connect_to_manager(resconn, rs);
+            memset(&cmd, 0, sizeof(cmd));
+            cmd.type = command_create;
+            cmd.rs   = rs;
+
+            execute_command(ctx, &cmd);
         }
     }
 
@@ -227,7 +389,15 @@ EXPORT resource_set_t *resource_set_create(const char          *klass,
 
 EXPORT void resource_set_destroy(resource_set_t *rs)
 {
-    push_request(rs, RESMSG_UNREGISTER, disconnect_complete_cb, NULL);
+    command_t cmd;
+
+    if (rs != NULL) {
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.type = command_destroy;
+        cmd.rs   = rs;
+
+        execute_command(rs->ctx, &cmd);
+    }
 }
 
 
@@ -235,10 +405,16 @@ EXPORT int resource_set_configure_advice_callback(resource_set_t      *rs,
                                                   resource_callback_t  advcb,
                                                   void                *advdata)
 {
+    command_t cmd;
+
     if (rs != NULL) {
-        rs->advicecb.function = advcb;
-        rs->advicecb.data = advdata;
-        return TRUE;
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.type = command_advice_callback;
+        cmd.rs   = rs;
+        cmd.u.advice.function = advcb;
+        cmd.u.advice.data     = advdata;
+
+        return execute_command(rs->ctx, &cmd);
     }
     return TRUE;
 }
@@ -247,10 +423,16 @@ EXPORT int resource_set_configure_error_callback(resource_set_t            *rs,
                                                  error_callback_function_t  errorcb,
                                                  void                      *errordata)
 {
+    command_t cmd;
+
     if (rs != NULL) {
-        rs->errorcb.function = errorcb;
-        rs->errorcb.data = errordata;
-        return TRUE;
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.type = command_error_callback;
+        cmd.rs   = rs;
+        cmd.u.error.function = errorcb;
+        cmd.u.error.data     = errordata;
+
+        return execute_command(rs->ctx, &cmd);
     }
     else
         return FALSE;
@@ -258,45 +440,409 @@ EXPORT int resource_set_configure_error_callback(resource_set_t            *rs,
 
 
 EXPORT int resource_set_configure_resources(resource_set_t *rs,
-                                            uint32_t        mandatory,
-                                            uint32_t        optional)
+                                            uint64_t        mandatory,
+                                            uint64_t        optional)
+{
+    command_t cmd;
+
+    if (rs == NULL)
+        return FALSE;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = command_configure_resources;
+    cmd.rs   = rs;
+    cmd.u.resources.mandatory = mandatory;
+    cmd.u.resources.optional  = optional;
+
+    return execute_command(rs->ctx, &cmd);
+}
+
+
+EXPORT int resource_set_configure_audio(resource_set_t *rs,
+                                        const char     *group,
+                                        pid_t           pid,
+                                        const char     *stream)
+{
+    command_t cmd;
+
+    if (rs == NULL)
+        return FALSE;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = command_configure_audio;
+    cmd.rs   = rs;
+    cmd.u.audio.group  = (char *)group;
+    cmd.u.audio.pid    = pid;
+    cmd.u.audio.stream = (char *)stream;
+
+    return execute_command(rs->ctx, &cmd);
+}
+
+EXPORT int resource_set_configure_audio_property(resource_set_t *rs,
+                                                 const char     *name,
+                                                 resource_match_method_t method,
+                                                 const char     *pattern)
+{
+    command_t cmd;
+
+    if (rs == NULL || name == NULL)
+        return FALSE;
+
+    if ((int)method < resource_match_equals ||
+        (int)method > resource_match_matches  )
+        return FALSE;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = command_audio_property;
+    cmd.rs   = rs;
+    cmd.u.property.name    = (char *)name;
+    cmd.u.property.method  = (resmsg_match_method_t)method;
+    cmd.u.property.pattern = (char *)pattern;
+
+    return execute_command(rs->ctx, &cmd);
+}
+
+EXPORT int resource_set_configure_video(resource_set_t *rs, pid_t pid)
+{
+    command_t cmd;
+
+    if (rs == NULL)
+        return FALSE;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.type = command_configure_video;
+    cmd.rs   = rs;
+    cmd.u.pid = pid;
+
+    return execute_command(rs->ctx, &cmd);
+}
+
+EXPORT int resource_set_acquire(resource_set_t *rs)
+{
+    command_t cmd;
+
+    if (rs != NULL) {
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.type = command_acquire;
+        cmd.rs   = rs;
+
+        acquire_called(rs, TRUE);
+        execute_command(rs->ctx, &cmd);
+    }
+
+    return TRUE;
+}
+
+EXPORT int resource_set_release(resource_set_t *rs)
+{
+    command_t cmd;
+
+    if (rs != NULL) {
+        memset(&cmd, 0, sizeof(cmd));
+        cmd.type = command_release;
+        cmd.rs   = rs;
+
+        acquire_called(rs, FALSE);
+        execute_command(rs->ctx, &cmd);
+    }
+
+    return TRUE;
+}
+
+
+/*
+ * Follows the calls as they are made, even while they are queued, so
+ * that a thread sees its own calls in order.
+ */
+EXPORT int resource_set_is_acquiring(resource_set_t *rs)
+{
+    int acquiring;
+
+    if (rs == NULL)
+        return FALSE;
+
+    pthread_mutex_lock(&rs->ctx->cmdlock);
+    acquiring = rs->acquiring;
+    pthread_mutex_unlock(&rs->ctx->cmdlock);
+
+    return acquiring ? TRUE : FALSE;
+}
+
+
+/*
+ * Every public entry point is turned into a command. If the calling
+ * thread can enter the main loop of the context the command runs right
+ * away. Otherwise it is copied and queued for the dispatching thread,
+ * which is woken up through the invoke operation of the loop backend.
+ * Queued commands of a context always run before any later one, so the
+ * calls of any single thread are executed in order.
+ */
+static int execute_command(resource_context_t *ctx, command_t *cmd)
+{
+    const resource_loop_ops_t *ops  = context_ops(ctx);
+    void                      *loop = context_loop(ctx);
+    command_t                 *copy;
+    command_t                 *prev;
+    int                        success;
+
+    if (ops->acquire == NULL || ops->acquire(loop)) {
+        run_queued_commands(ctx);
+
+        success = run_command(ctx, cmd);
+
+        if (ops->release != NULL)
+            ops->release(loop);
+    }
+    else {
+        if ((copy = RESALLOC_MALLOC(REQUEST, sizeof(command_t))) == NULL)
+            return FALSE;
+
+        memcpy(copy, cmd, sizeof(command_t));
+        copy->next = NULL;
+
+        if (cmd->type == command_configure_audio) {
+            copy->u.audio.group  = cmd->u.audio.group ?
+                                   RESALLOC_STRDUP(cmd->u.audio.group) : NULL;
+            copy->u.audio.stream = cmd->u.audio.stream ?
+                                   RESALLOC_STRDUP(cmd->u.audio.stream) : NULL;
+        }
+
+        if (cmd->type == command_audio_property) {
+            copy->u.property.name    = RESALLOC_STRDUP(cmd->u.property.name);
+            copy->u.property.pattern = cmd->u.property.pattern ?
+                              RESALLOC_STRDUP(cmd->u.property.pattern) : NULL;
+        }
+
+        pthread_mutex_lock(&ctx->cmdlock);
+
+        for (prev = (command_t *)&ctx->cmdq;  prev->next;  prev = prev->next)
+            ;
+        prev->next = copy;
+
+        ctx->pending++;
+
+        pthread_mutex_unlock(&ctx->cmdlock);
+
+        ops->invoke(loop, command_dispatch, ctx);
+
+        /*
+         * the real outcome is only known on the dispatching thread;
+         * creating and configuring a set can only fail on allocation
+         */
+        success = TRUE;
+    }
+
+    return success;
+}
+
+static int command_dispatch(void *data)
+{
+    resource_context_t *ctx = (resource_context_t *)data;
+    int                 pending;
+
+    run_queued_commands(ctx);
+
+    pthread_mutex_lock(&ctx->cmdlock);
+    pending = --ctx->pending;
+    pthread_mutex_unlock(&ctx->cmdlock);
+
+    if (!pending)
+        context_check_free(ctx);
+
+    return FALSE;
+}
+
+static void run_queued_commands(resource_context_t *ctx)
+{
+    command_t *cmd;
+    command_t *next;
+
+    pthread_mutex_lock(&ctx->cmdlock);
+    cmd = ctx->cmdq;
+    ctx->cmdq = NULL;
+    pthread_mutex_unlock(&ctx->cmdlock);
+
+    for (;  cmd != NULL;  cmd = next) {
+        next = cmd->next;
+
+        run_command(ctx, cmd);
+
+        if (cmd->type == command_configure_audio) {
+            RESALLOC_FREE(STRING, cmd->u.audio.group);
+            RESALLOC_FREE(STRING, cmd->u.audio.stream);
+        }
+
+        if (cmd->type == command_audio_property) {
+            RESALLOC_FREE(STRING, cmd->u.property.name);
+            RESALLOC_FREE(STRING, cmd->u.property.pattern);
+        }
+
+        RESALLOC_FREE(REQUEST, cmd);
+    }
+}
+
+static int run_command(resource_context_t *ctx, command_t *cmd)
+{
+    resource_set_t *rs = cmd->rs;
+    int             success = TRUE;
+
+    switch (cmd->type) {
+
+    case command_create:
+        success = set_create(ctx, rs);
+        break;
+
+    case command_destroy:
+        push_request(rs, RESMSG_UNREGISTER, disconnect_complete_cb, NULL);
+        break;
+
+    case command_advice_callback:
+        rs->advicecb = cmd->u.advice;
+        break;
+
+    case command_error_callback:
+        rs->errorcb = cmd->u.error;
+        break;
+
+    case command_configure_resources:
+        success = set_configure_resources(rs, cmd->u.resources.mandatory,
+                                          cmd->u.resources.optional);
+        break;
+
+    case command_configure_audio:
+        success = set_configure_audio(rs, cmd->u.audio.group,
+                                      cmd->u.audio.pid, cmd->u.audio.stream);
+        break;
+
+    case command_audio_property:
+        success = set_audio_property(rs, cmd->u.property.name,
+                                     cmd->u.property.method,
+                                     cmd->u.property.pattern);
+        break;
+
+    case command_configure_video:
+        success = set_configure_video(rs, cmd->u.pid);
+        break;
+
+    case command_acquire:
+        acquire_done(rs);
+        if (!rs->acquire) {
+            rs->acquire = TRUE;
+            push_request(rs, RESMSG_ACQUIRE, NULL,NULL);
+        }
+        break;
+
+    case command_release:
+        acquire_done(rs);
+        if (rs->acquire) {
+            rs->acquire = FALSE;
+            push_request(rs, RESMSG_RELEASE, NULL,NULL);
+        }
+        break;
+
+    case command_context_destroy:
+        ctx->dead = TRUE;
+        context_check_free(ctx);
+        break;
+
+    default:
+        success = FALSE;
+        break;
+    }
+
+    return success;
+}
+
+/* called by the thread making an acquire or release call */
+static void acquire_called(resource_set_t *rs, int acquire)
+{
+    pthread_mutex_lock(&rs->ctx->cmdlock);
+    rs->acquiring = acquire;
+    rs->calls++;
+    pthread_mutex_unlock(&rs->ctx->cmdlock);
+}
+
+static void acquire_done(resource_set_t *rs)
+{
+    pthread_mutex_lock(&rs->ctx->cmdlock);
+    rs->calls--;
+    pthread_mutex_unlock(&rs->ctx->cmdlock);
+}
+
+/* the request was dropped; a call not run yet is newer than that */
+static void acquire_dropped(resource_set_t *rs)
+{
+    pthread_mutex_lock(&rs->ctx->cmdlock);
+    if (rs->calls == 0)
+        rs->acquiring = FALSE;
+    pthread_mutex_unlock(&rs->ctx->cmdlock);
+}
+
+static int set_create(resource_context_t *ctx, resource_set_t *rs)
+{
+    resconn_t *resconn;
+    char       mbuf[256];
+    char       obuf[256];
+
+    resconn = get_manager(ctx);
+
+    rs->next    = ctx->rslist;
+    rs->dbus    = ctx->dbus;
+    rs->id      = ctx->rsid++;
+    rs->resconn = resconn;
+            
+    ctx->rslist = rs;
+
+    resource_log(RESLOG_SET, RESLOG_INFO,
+                 "created resource set %u (app_id '%s', klass '%s', "
+                 "mandatory %s, optional %s)",
+                 rs->id, rs->app_id, rs->klass,
+                 resmsg_res_str(rs->resources.all & ~rs->resources.opt,
+                                mbuf, sizeof(mbuf)),
+                 resmsg_res_str(rs->resources.opt, obuf, sizeof(obuf)));
+            
+    connect_to_manager(resconn, rs);
+
+    return TRUE;
+}
+
+static int set_configure_resources(resource_set_t *rs,
+                                   uint64_t        mandatory,
+                                   uint64_t        optional)
 {
     int success = FALSE;
-    uint32_t all;
+    uint64_t all;
     uint32_t rn;
     char mbuf[256];
     char obuf[256];
 
-    if (rs != NULL) {
+    optional = optional & ~mandatory;
+    all = mandatory | optional;
 
-        optional = optional & ~mandatory;
-        all = mandatory | optional;
+    resource_log(RESLOG_SET, RESLOG_DEBUG,
+                 "updating resource set %u (app_id '%s', klass '%s', "
+                 "mandatory %s, optional %s)",
+                 rs->id, rs->app_id, rs->klass,
+                 resmsg_res_str(mandatory, mbuf, sizeof(mbuf)),
+                 resmsg_res_str(optional , obuf, sizeof(obuf)));
 
-        resource_log("updating resource set %u (app_id '%s', klass '%s', "
-                     "mandatory %s, optional %s)",
-                     rs->id, rs->app_id, rs->klass,
-                     resmsg_res_str(mandatory, mbuf, sizeof(mbuf)),
-                     resmsg_res_str(optional , obuf, sizeof(obuf)));
+    if (rs->resources.all != all || rs->resources.opt != optional) {
 
-        if (rs->resources.all != all || rs->resources.opt != optional) {
-
-            rs->resources.all = mandatory | optional;
-            rs->resources.opt = optional;
+        rs->resources.all = mandatory | optional;
+        rs->resources.opt = optional;
     
-            rn = push_request(rs, RESMSG_UPDATE, NULL,NULL);
+        rn = push_request(rs, RESMSG_UPDATE, NULL,NULL);
 
-            success = rn ? TRUE : FALSE;
-        }
+        success = rn ? TRUE : FALSE;
     }
 
     return success;
 }
 
-
-EXPORT int resource_set_configure_audio(resource_set_t *rs,
-                                        const char     *group,
-                                        pid_t           pid,
-                                        const char     *stream)
+static int set_configure_audio(resource_set_t *rs,
+                               const char     *group,
+                               pid_t           pid,
+                               const char     *stream)
 {
     resource_config_t *prev;
     resource_config_t *cfg;
@@ -324,7 +870,39 @@ EXPORT int resource_set_configure_audio(resource_set_t *rs,
     return TRUE;
 }
 
-EXPORT int resource_set_configure_video(resource_set_t *rs, pid_t pid)
+static int set_audio_property(resource_set_t        *rs,
+                              const char            *name,
+                              resmsg_match_method_t  method,
+                              const char            *pattern)
+{
+    resource_config_t *cfg;
+    int                need_update;
+
+    if (!(rs->resources.all & RESOURCE_AUDIO_PLAYBACK) || name == NULL)
+        return FALSE;
+
+    for (cfg = rs->configs;  cfg != NULL;  cfg = cfg->any.next) {
+        if (cfg->any.mask == RESOURCE_AUDIO_PLAYBACK)
+            break;
+    }
+
+    if (cfg == NULL) {
+        if (pattern == NULL || !audio_config_create(rs, NULL, 0, NULL))
+            return pattern == NULL;
+
+        cfg = rs->configs;
+    }
+
+    if ((need_update = audio_property_update(cfg, name, method, pattern)) < 0)
+        return FALSE;
+
+    if (need_update)
+        push_request(rs, RESMSG_AUDIO, NULL,NULL);
+
+    return TRUE;
+}
+
+static int set_configure_video(resource_set_t *rs, pid_t pid)
 {
     resource_config_t *prev;
     resource_config_t *cfg;
@@ -352,48 +930,101 @@ EXPORT int resource_set_configure_video(resource_set_t *rs, pid_t pid)
     return TRUE;
 }
 
-EXPORT int resource_set_acquire(resource_set_t *rs)
+static const resource_loop_ops_t *context_ops(resource_context_t *ctx)
 {
-    if (rs && !rs->acquire) {
-        rs->acquire = TRUE;
-        push_request(rs, RESMSG_ACQUIRE, NULL,NULL);
-    }
+    return ctx->ops ? ctx->ops : resource_loop_backend();
+}
 
-    return TRUE;
+static void *context_loop(resource_context_t *ctx)
+{
+    return ctx->ops ? ctx->loop : resource_loop_default();
 }
 
-EXPORT int resource_set_release(resource_set_t *rs)
+/*
+ * The context is freed from a timer on its own loop rather than right
+ * away, since the caller might be in the middle of dispatching, or
+ * holding, the very main loop the context has a reference to.
+ */
+static void context_check_free(resource_context_t *ctx)
 {
-    if (rs && rs->acquire) {
-        rs->acquire = FALSE;
-        push_request(rs, RESMSG_RELEASE, NULL,NULL);
-    }
+    int pending;
 
-    return TRUE;
-}
+    pthread_mutex_lock(&ctx->cmdlock);
+    pending = ctx->pending;
+    pthread_mutex_unlock(&ctx->cmdlock);
 
+    if (ctx->dead && !ctx->freeing && ctx->rslist == NULL && !pending) {
+        ctx->freeing = TRUE;
+        ctx->ops->timer_add(ctx->loop, 0, context_free_cb, ctx);
+    }
+}
 
-EXPORT int resource_set_is_acquiring(resource_set_t *rs)
+static int context_free_cb(void *data)
 {
-    return (rs && rs->acquire) ? TRUE : FALSE;
-}
+    context_free((resource_context_t *)data);
 
+    return FALSE;
+}
 
-static DBusConnection *get_dbus(void)
+static void context_free(resource_context_t *ctx)
 {
-    static DBusConnection *dbus = NULL;
+    resource_context_t *prev;
 
-    DBusError err;
+    pthread_mutex_lock(&ctxlock);
 
-    if (dbus == NULL) {
-        if (rsdbus != NULL) {
-            dbus = rsdbus;
-            return dbus;
+    for (prev = (resource_context_t *)&ctxlist;  prev->next;  prev=prev->next){
+        if (prev->next == ctx) {
+            prev->next = ctx->next;
+            break;
         }
-        
+    }
+
+    pthread_mutex_unlock(&ctxlock);
+
+    resource_log(RESLOG_CONTEXT, RESLOG_INFO,
+                 "destroying resource context %p", ctx);
+
+    if (ctx->manager != NULL)
+        resproto_destroy(ctx->manager);
+
+    if (ctx->dbus != NULL) {
+        dbus_connection_close(ctx->dbus);
+        dbus_connection_unref(ctx->dbus);
+    }
+
+    if (ctx->loop_free != NULL)
+        ctx->loop_free(ctx->loop);
+
+    pthread_mutex_destroy(&ctx->cmdlock);
+
+    free(ctx);
+}
+
+static DBusConnection *get_dbus(resource_context_t *ctx)
+{
+    DBusConnection *dbus;
+    DBusError       err;
+
+    if (ctx->dbus == NULL) {
         dbus_error_init(&err);
 
-        dbus = resource_get_dbus_bus(DBUS_BUS_SYSTEM, &err);
+        if (ctx->ops == NULL)
+            dbus = resource_get_dbus_bus(DBUS_BUS_SYSTEM, &err);
+        else {
+            /*
+             * contexts have a private connection so that it can be
+             * dispatched from the main loop of the context
+             */
+            if ((dbus = dbus_bus_get_private(DBUS_BUS_SYSTEM, &err))) {
+                dbus_connection_set_exit_on_disconnect(dbus, FALSE);
+
+                if (!ctx->ops->dbus_setup(ctx->loop, dbus)) {
+                    dbus_connection_close(dbus);
+                    dbus_connection_unref(dbus);
+                    dbus = NULL;
+                }
+            }
+        }
 
         if (dbus_error_is_set(&err)) {
             /* TODO: some more distinctive errno setting would not harm :) */
@@ -401,36 +1032,54 @@ static DBusConnection *get_dbus(void)
             dbus_error_free(&err);
         }
         else
-            rsdbus = dbus;
+            ctx->dbus = dbus;
     }
 
-    return dbus;
+    return ctx->dbus;
 }
 
-static resconn_t *get_manager(DBusConnection *dbus)
+static resconn_t *get_manager(resource_context_t *ctx)
 {
-    static resconn_t  *mgr = NULL;
+    DBusConnection *dbus;
+    resconn_t      *mgr;
 
-    if (mgr == NULL && dbus != NULL) {
+    if (ctx->manager == NULL && (dbus = get_dbus(ctx)) != NULL) {
         mgr = resproto_init(RESPROTO_ROLE_CLIENT, RESPROTO_TRANSPORT_DBUS,
                             manager_is_up, dbus);
 
-        resproto_set_handler(mgr, RESMSG_UNREGISTER, disconnect_from_manager);
-        resproto_set_handler(mgr, RESMSG_GRANT     , receive_grant_message  );
-        resproto_set_handler(mgr, RESMSG_ADVICE    , receive_advice_message );
-        resproto_set_handler(mgr, RESMSG_RELEASE   , receive_release_message);
+        if (mgr != NULL) {
+            resproto_set_handler(mgr, RESMSG_UNREGISTER,
+                                 disconnect_from_manager);
+            resproto_set_handler(mgr, RESMSG_GRANT  , receive_grant_message  );
+            resproto_set_handler(mgr, RESMSG_ADVICE , receive_advice_message );
+            resproto_set_handler(mgr, RESMSG_RELEASE, receive_release_message);
+
+            ctx->manager = mgr;
+        }
     }
 
-    return mgr;
+    return ctx->manager;
 }
 
 static void manager_is_up(resconn_t *resconn)
 {
-    resource_set_t *rs;
+    resource_context_t *ctx;
+    resource_set_t     *rs;
+
+    pthread_mutex_lock(&ctxlock);
 
-    for (rs = rslist;  rs != NULL;  rs = rs->next) {
-        if (rs->resconn == resconn && rs->client == client_created)
-            connect_to_manager(resconn, rs);
+    for (ctx = ctxlist;  ctx != NULL;  ctx = ctx->next) {
+        if (ctx->manager == resconn)
+            break;
+    }
+
+    pthread_mutex_unlock(&ctxlock);
+
+    if (ctx != NULL) {
+        for (rs = ctx->rslist;  rs != NULL;  rs = rs->next) {
+            if (rs->resconn == resconn && rs->client == client_created)
+                connect_to_manager(resconn, rs);
+        }
     }
 }
 
@@ -478,15 +1127,24 @@ static void receive_grant_message(resmsg_t *msg, resset_t *resset, void *data)
 {
     resource_set_t *rs = resset->userdata;
     uint32_t        rn = msg->notify.reqno;
-    uint32_t        gr = msg->notify.resrc;
+    uint64_t        gr = msg->notify.resrc;
 
     (void)data;
 
     if (rs != NULL && resset == rs->resset) {
-        resource_log("recived grant %u (resources 0x%x)", rn, gr);
+        resource_log(RESLOG_MESSAGE, RESLOG_DEBUG,
+                     "received grant %u (resources 0x%" PRIx64 ")", rn, gr);
 
-        if (!gr && (resset->mode & RESOURCE_AUTO_RELEASE))
+        if (rs->acqstamp) {
+            pthread_once(&grant_latency_once, grant_latency_init);
+            reshist_add(&grant_latency, clock_ns() - rs->acqstamp);
+            rs->acqstamp = 0;
+        }
+
+        if (!gr && (resset->mode & RESOURCE_AUTO_RELEASE)) {
             rs->acquire = FALSE;
+            acquire_dropped(rs);
+        }
 
         rs->grantcb.function(rs, gr, rs->grantcb.data);
     }
@@ -495,7 +1153,7 @@ static void receive_grant_message(resmsg_t *msg, resset_t *resset, void *data)
 static void receive_advice_message(resmsg_t *msg, resset_t *resset, void *data)
 {
     resource_set_t *rs  = resset->userdata;
-    uint32_t        adv = msg->notify.resrc;
+    uint64_t        adv = msg->notify.resrc;
 
     (void)data;
 
@@ -514,6 +1172,7 @@ static void receive_release_message(resmsg_t *msg,resset_t *resset,void *data)
 
     if (rs != NULL && resset == rs->resset) {
         rs->acquire = FALSE;
+        acquire_dropped(rs);
         push_request(rs, RESMSG_RELEASE, NULL,NULL);
     }
 }
@@ -524,7 +1183,8 @@ static int send_register_message(resource_set_t *rs, uint32_t rn)
     resmsg_t  msg;
 
     if (rs->resconn != NULL) {
-        resource_log("sending register message");
+        resource_log(RESLOG_MESSAGE, RESLOG_DEBUG,
+                     "sending register message");
 
         memset(&msg, 0, sizeof(msg));
         msg.record.type     = RESMSG_REGISTER;
@@ -554,7 +1214,8 @@ static int send_unregister_message(resource_set_t *rs, uint32_t rn)
     resmsg_t  msg;
 
     if (resset != NULL && (void *)rs == resset->userdata) {
-        resource_log("sending unregister message");
+        resource_log(RESLOG_MESSAGE, RESLOG_DEBUG,
+                     "sending unregister message");
 
         memset(&msg, 0, sizeof(msg));
         msg.possess.type     = RESMSG_UNREGISTER;
@@ -574,7 +1235,8 @@ static int send_update_message(resource_set_t *rs, uint32_t rn)
     resmsg_t  msg;
 
     if (resset != NULL && (void *)rs == resset->userdata) {
-        resource_log("sending update message");
+        resource_log(RESLOG_MESSAGE, RESLOG_DEBUG,
+                     "sending update message");
 
         memset(&msg, 0, sizeof(msg));
         msg.record.type     = RESMSG_UPDATE;
@@ -606,7 +1268,8 @@ static int send_audio_message(resource_set_t *rs, uint32_t rn)
 
                 stream = cfg->audio.stream ? cfg->audio.stream : (char *)"";
 
-                resource_log("sending audio message");
+                resource_log(RESLOG_MESSAGE, RESLOG_DEBUG,
+                             "sending audio message");
 
                 memset(&msg, 0, sizeof(msg));
                 msg.audio.type  = RESMSG_AUDIO;
@@ -617,6 +1280,8 @@ static int send_audio_message(resource_set_t *rs, uint32_t rn)
                 msg.audio.property.name = (char*)"media.name";
                 msg.audio.property.match.method  = resmsg_method_equals;
                 msg.audio.property.match.pattern = stream;
+                msg.audio.nextra = cfg->audio.nextra;
+                msg.audio.extra  = cfg->audio.extra;
         
                 success = resproto_send_message(resset, &msg, status_cb);
 
@@ -640,7 +1305,8 @@ static int send_video_message(resource_set_t *rs, uint32_t rn)
         for (cfg = rs->configs;  cfg != NULL;   cfg = cfg->any.next) {
             if (cfg->any.mask == RESOURCE_VIDEO_PLAYBACK) {
 
-                resource_log("sending video message");
+                resource_log(RESLOG_MESSAGE, RESLOG_DEBUG,
+                             "sending video message");
 
                 memset(&msg, 0, sizeof(msg));
                 msg.video.type  = RESMSG_VIDEO;
@@ -666,7 +1332,8 @@ static int send_acquire_message(resource_set_t *rs, uint32_t rn)
     resmsg_t  msg;
 
     if (resset != NULL && (void *)rs == resset->userdata) {
-        resource_log("sending acquire message");
+        resource_log(RESLOG_MESSAGE, RESLOG_DEBUG,
+                     "sending acquire message");
 
         memset(&msg, 0, sizeof(msg));
         msg.possess.type  = RESMSG_ACQUIRE;
@@ -674,6 +1341,9 @@ static int send_acquire_message(resource_set_t *rs, uint32_t rn)
         msg.possess.reqno = rn;
         
         success = resproto_send_message(resset, &msg, status_cb);
+
+        if (success && !rs->acqstamp)
+            rs->acqstamp = clock_ns();
     }
 
     return success;
@@ -686,7 +1356,8 @@ static int send_release_message(resource_set_t *rs, uint32_t rn)
     resmsg_t  msg;
 
     if (resset != NULL && (void *)rs == resset->userdata) {
-        resource_log("sending release message");
+        resource_log(RESLOG_MESSAGE, RESLOG_DEBUG,
+                     "sending release message");
 
         memset(&msg, 0, sizeof(msg));
         msg.possess.type  = RESMSG_RELEASE;
@@ -703,7 +1374,8 @@ static void connect_complete_cb(resource_set_t *rs, uint32_t rn, void *data,
                                 int32_t errcod, const char *errmsg)
 {
     if (errcod != 0) {
-        resource_log("failed to connect resource manager: %d %s",
+        resource_log(RESLOG_SET, RESLOG_ERROR,
+                     "failed to connect resource manager: %d %s",
                      errcod, errmsg);
         rs->client = client_created;
 
@@ -712,7 +1384,8 @@ static void connect_complete_cb(resource_set_t *rs, uint32_t rn, void *data,
 
     }
     else {
-        resource_log("resource set %u is ready", rs->id);
+        resource_log(RESLOG_SET, RESLOG_INFO,
+                     "resource set %u is ready", rs->id);
         rs->client = client_ready;
     }
 }
@@ -720,25 +1393,27 @@ static void connect_complete_cb(resource_set_t *rs, uint32_t rn, void *data,
 static void disconnect_complete_cb(resource_set_t *rs, uint32_t no, void *data,
                                    int32_t errcod, const char *errmsg)
 {
-    resource_set_t    *prev;
-    resource_config_t *cfg;
-    resource_config_t *cn;
-    request_t         *rq;
-    request_t         *rn;
+    resource_context_t *ctx = rs->ctx;
+    resource_set_t     *prev;
+    resource_config_t  *cfg;
+    resource_config_t  *cn;
+    request_t          *rq;
+    request_t          *rn;
 
     (void)no;
     (void)data;
     (void)errcod;
     (void)errmsg;
 
-    for (prev = (resource_set_t *)&rslist;   prev->next;   prev = prev->next) {
+    for (prev = (resource_set_t *)&ctx->rslist; prev->next; prev = prev->next){
         if (rs == prev->next) {
-            resource_log("resource set %u is going to be destroyed", rs->id);
+            resource_log(RESLOG_SET, RESLOG_INFO,
+                         "resource set %u is going to be destroyed", rs->id);
 
             prev->next = rs->next;
 
             free(rs->app_id);
-            free(rs->klass);
+            RESALLOC_FREE(STRING, rs->klass);
 
             for (cfg = rs->configs;  cfg;   cfg = cn) {
                 cn = cfg->any.next;
@@ -747,10 +1422,13 @@ static void disconnect_complete_cb(resource_set_t *rs, uint32_t no, void *data,
     
             for (rq = rs->reqlist;  rq;  rq = rn) {
                 rn = rq->next;
+                forget_request(ctx, rq);
                 destroy_request(rq);
             }
 
-            free(rs);
+            RESALLOC_FREE(RSET, rs);
+
+            context_check_free(ctx);
 
             return;
         }
@@ -766,7 +1444,8 @@ static void status_cb(resset_t *resset, resmsg_t *msg)
 
     if (rs != NULL && rs->resset == resset) {
 
-        resource_log("%s(%u) status: %d '%s'", __FUNCTION__, 
+        resource_log(RESLOG_MESSAGE, RESLOG_DEBUG,
+                     "%s(%u) status: %d '%s'", __FUNCTION__, 
                      st->reqno, st->errcod, st->errmsg);
 
         if ((rq = pop_request(rs, msg->status.reqno)) != NULL) {
@@ -821,7 +1500,8 @@ static void send_request(resource_set_t *rs)
         if (rq->msgtyp == RESMSG_REGISTER)
             rs->client = client_created;
 
-        resource_log("failed to send %s message", resmsg_type_str(rq->msgtyp));
+        resource_log(RESLOG_MESSAGE, RESLOG_WARNING,
+                     "failed to send %s message", resmsg_type_str(rq->msgtyp));
 
         if (pop_request(rs, rn) == rq)
             destroy_request(rq);
@@ -831,9 +1511,18 @@ static void send_request(resource_set_t *rs)
 
 static void config_destroy(resource_config_t *cfg)
 {
+    uint32_t i;
+
     if (cfg->any.mask == RESOURCE_AUDIO_PLAYBACK) {
-        free(cfg->audio.group);
-        free(cfg->audio.stream);
+        RESALLOC_FREE(STRING, cfg->audio.group);
+        RESALLOC_FREE(STRING, cfg->audio.stream);
+
+        for (i = 0;  i < cfg->audio.nextra;  i++) {
+            RESALLOC_FREE(STRING, cfg->audio.extra[i].name);
+            RESALLOC_FREE(STRING, cfg->audio.extra[i].match.pattern);
+        }
+
+        free(cfg->audio.extra);
     }
 
     free(cfg);
@@ -844,6 +1533,32 @@ EXPORT char *resource_generate_app_id(pid_t pid)
     return resmsg_generate_app_id(pid);
 }
 
+EXPORT int resource_get_grant_latency(reshist_t *hist)
+{
+    if (hist == NULL)
+        return FALSE;
+
+    pthread_once(&grant_latency_once, grant_latency_init);
+
+    memcpy(hist, &grant_latency, sizeof(reshist_t));
+
+    return TRUE;
+}
+
+static void grant_latency_init(void)
+{
+    reshist_reset(&grant_latency);
+}
+
+static uint64_t clock_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 static int audio_config_create(resource_set_t *rs,
                                const char     *group,
                                pid_t           pid,
@@ -857,10 +1572,10 @@ static int audio_config_create(resource_set_t *rs,
             memset(cfg, 0, sizeof(resource_config_t));
             cfg->audio.next   = rs->configs;
             cfg->audio.mask   = RESOURCE_AUDIO_PLAYBACK;
-            cfg->audio.group  = group ? strdup(group) : NULL;
+            cfg->audio.group  = group ? RESALLOC_STRDUP(group) : NULL;
             cfg->audio.app_id = resource_generate_app_id(pid);
             cfg->audio.pid    = pid;
-            cfg->audio.stream = stream ? strdup(stream) : NULL;
+            cfg->audio.stream = stream ? RESALLOC_STRDUP(stream) : NULL;
 
             rs->configs = cfg;
 
@@ -886,8 +1601,8 @@ static int audio_config_update(resource_config_t *cfg,
 
         if (!oldstr || (oldstr  && strcmp(oldstr, group))) {
             need_update = TRUE;
-            free(oldstr);
-            cfg->audio.group = strdup(group);
+            RESALLOC_FREE(STRING, oldstr);
+            cfg->audio.group = RESALLOC_STRDUP(group);
         }
     }
 
@@ -907,8 +1622,8 @@ static int audio_config_update(resource_config_t *cfg,
         
         if (!oldstr || (oldstr  && strcmp(oldstr, stream))) {
             need_update = TRUE;
-            free(oldstr);
-            cfg->audio.stream = strdup(stream);
+            RESALLOC_FREE(STRING, oldstr);
+            cfg->audio.stream = RESALLOC_STRDUP(stream);
         }
     }
 
@@ -917,6 +1632,78 @@ static int audio_config_update(resource_config_t *cfg,
 
 
 
+/* TRUE if the property changed, FALSE if not and -1 on failure */
+static int audio_property_update(resource_config_t     *cfg,
+                                 const char            *name,
+                                 resmsg_match_method_t  method,
+                                 const char            *pattern)
+{
+    audio_config_t    *audio = &cfg->audio;
+    resmsg_property_t *prop;
+    resmsg_property_t *extra;
+    char              *copy;
+    uint32_t           i;
+
+    for (i = 0;  i < audio->nextra;  i++) {
+        if (!strcmp(audio->extra[i].name, name))
+            break;
+    }
+
+    prop = audio->extra + i;
+
+    if (pattern == NULL) {
+        if (i == audio->nextra)
+            return FALSE;
+
+        RESALLOC_FREE(STRING, prop->name);
+        RESALLOC_FREE(STRING, prop->match.pattern);
+
+        memmove(prop, prop + 1, (--audio->nextra - i) * sizeof(*prop));
+
+        return TRUE;
+    }
+
+    if (i < audio->nextra) {
+        if (prop->match.method == method && !strcmp(prop->match.pattern,
+                                                    pattern))
+            return FALSE;
+
+        if ((copy = RESALLOC_STRDUP(pattern)) == NULL)
+            return -1;
+
+        RESALLOC_FREE(STRING, prop->match.pattern);
+        prop->match.method  = method;
+        prop->match.pattern = copy;
+
+        return TRUE;
+    }
+
+    if (audio->nextra >= RESMSG_AUDIO_EXTRA_MAX)
+        return -1;
+
+    extra = realloc(audio->extra, (audio->nextra + 1) * sizeof(*extra));
+
+    if (extra == NULL)
+        return -1;
+
+    audio->extra = extra;
+    prop = extra + audio->nextra;
+
+    prop->name          = RESALLOC_STRDUP(name);
+    prop->match.method  = method;
+    prop->match.pattern = RESALLOC_STRDUP(pattern);
+
+    if (!prop->name || !prop->match.pattern) {
+        RESALLOC_FREE(STRING, prop->name);
+        RESALLOC_FREE(STRING, prop->match.pattern);
+        return -1;
+    }
+
+    audio->nextra++;
+
+    return TRUE;
+}
+
 static int video_config_create(resource_set_t *rs, pid_t pid)
 {
     resource_config_t *cfg;
@@ -963,31 +1750,41 @@ static uint32_t push_request(resource_set_t     *rs,
                              request_complete_t  callback,
                              void               *data)
 {
-    request_t *last;
-    request_t *rq;
-    uint32_t   rn;
+    resource_context_t *ctx = rs->ctx;
+    request_t          *rq;
+    uint32_t            rn;
 
     if (rs->client == client_created) 
         rn = 0;
     else {
-
-        for (last = (void*)&rs->reqlist;  last->next;  last = last->next)
-            ;
-    
-        if ((rq = malloc(sizeof(request_t))) == NULL)
+        if ((rq = RESALLOC_MALLOC(REQUEST, sizeof(request_t))) == NULL)
             rn = 0;
         else {
-            rn = ++reqno;
+            rn = ++ctx->reqno;
             
             memset(rq, 0, sizeof(request_t));
+            rq->prev        = rs->reqtail;
+            rq->rs          = rs;
             rq->msgtyp      = msgtyp;
             rq->reqno       = rn;
             rq->cb.function = callback;
             rq->cb.data     = data;
             
-            last->next = rq;
+            if (rs->reqtail != NULL)
+                rs->reqtail->next = rq;
+            else
+                rs->reqlist = rq;
+
+            rs->reqtail = rq;
+
+            /*
+             * if the slot is still taken by an older outstanding request
+             * that one just falls back to the slow lookup in pop_request()
+             */
+            ctx->reqring[rn & (REQUEST_RING_SIZE - 1)] = rq;
             
-            resource_log("pushed %u %s request", rq->reqno,
+            resource_log(RESLOG_REQUEST, RESLOG_DEBUG,
+                         "pushed %u %s request", rq->reqno,
                          resmsg_type_str(msgtyp));
             
             send_request(rs);
@@ -1006,67 +1803,63 @@ static request_t *peek_request(resource_set_t *rs)
 
 static request_t *pop_request(resource_set_t *rs, uint32_t rn)
 {
-    request_t *prev;
     request_t *rq;
 
-    for (prev = (void*)&rs->reqlist;  (rq = prev->next);  prev = prev->next) {
-        if (rq->reqno == rn) {
+    /*
+     * The manager replies in order, so normally this is the head of the
+     * queue. Otherwise try the reqno indexed ring of the context, and
+     * only if the request was pushed out of it walk the queue.
+     */
+    if ((rq = rs->reqlist) != NULL && rq->reqno != rn) {
+        rq = rs->ctx->reqring[rn & (REQUEST_RING_SIZE - 1)];
+
+        if (rq == NULL || rq->reqno != rn) {
+            for (rq = rs->reqlist;  rq;  rq = rq->next) {
+                if (rq->reqno == rn)
+                    break;
+            }
+        }
+        else if (rq->rs != rs)
+            rq = NULL;
+    }
 
-            resource_log("popping message %u (%s message)",
-                         rn, resmsg_type_str(rq->msgtyp));
+    if (rq != NULL) {
+        resource_log(RESLOG_REQUEST, RESLOG_DEBUG,
+                     "popping message %u (%s message)",
+                     rn, resmsg_type_str(rq->msgtyp));
 
-            prev->next = rq->next;
-            rq->next = NULL;
+        if (rq->prev != NULL)
+            rq->prev->next = rq->next;
+        else
+            rs->reqlist = rq->next;
 
-            break;
-        }
+        if (rq->next != NULL)
+            rq->next->prev = rq->prev;
+        else
+            rs->reqtail = rq->prev;
+
+        rq->next = rq->prev = NULL;
+
+        forget_request(rs->ctx, rq);
     }
 
     return rq;
 }
 
-static void destroy_request(request_t *rq)
+static void forget_request(resource_context_t *ctx, request_t *rq)
 {
-    free(rq);
+    request_t **slot = &ctx->reqring[rq->reqno & (REQUEST_RING_SIZE - 1)];
+
+    if (*slot == rq)
+        *slot = NULL;
 }
 
-static void resource_log(const char *fmt, ...)
+static void destroy_request(request_t *rq)
 {
-    static int got_env;
-    static int printit;
-
-    va_list  ap;
-    char    *envstr;
-    char    *end;
-    char     buf[1024];
-
-    if (!got_env) {
-        if ((envstr = getenv("LIBRESOURCE_DEBUG")) != NULL) {
-            printit = strtol(envstr, &end, 10);
-
-            if (printit < 0 || !envstr[0] || *end)
-                printit = 0;
-
-            got_env = TRUE;
-
-            if (printit)
-                printf("resource: logging turned on\n");
-        }
-    }
-
-    if (printit) {
-        snprintf(buf, sizeof(buf), "resource: %s\n", fmt);
-        
-        va_start(ap, fmt);
-        
-        vprintf(buf, ap);
-        
-        va_end(ap);
-    }
+    RESALLOC_FREE(REQUEST, rq);
 }
 
 
-
 /* 
  * Local Variables:
  * c-basic-offset: 4
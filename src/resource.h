@@ -26,6 +26,7 @@ USA.
 #include <stdint.h>
 #include <sys/types.h>
 #include <res-types.h>
+#include <res-hist.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -34,10 +35,11 @@ extern "C" {
 struct DBusConnection;
 
 typedef struct resource_set_s resource_set_t;
+typedef struct resource_context_s resource_context_t;
 
 
 typedef void (*resource_callback_t)(resource_set_t *resource_set,
-                                    uint32_t        resources,
+                                    uint64_t        resources,
                                     void           *userdata);
 
 
@@ -46,15 +48,64 @@ typedef void (*error_callback_function_t)(resource_set_t *resource_set,
                                           const char     *errmsg,
                                           void           *userdata);
 
+/*
+ * Threading
+ *
+ * The resource_set_* and resource_context_* functions can be called
+ * from any thread. A call runs in the calling thread when that thread
+ * can take the main loop of the context (nobody else is dispatching
+ * it); otherwise it is queued and executed by the dispatching thread.
+ * Calls made by one thread are executed in the order they were made.
+ * Queued calls return TRUE, as their real outcome is not known yet.
+ *
+ * All callbacks (grant, advice, error) of a resource set are invoked
+ * from the thread dispatching the main loop of its context, never from
+ * the thread making a call. Callbacks may call back to the API, but must
+ * not block waiting for other threads that call it.
+ *
+ * resource_set_is_acquiring() reflects the acquire and release calls
+ * made so far, whether or not they have been executed yet.
+ * resource_set_use_dbus() must be called before any resource set is
+ * created.
+ */
+
 int resource_set_use_dbus(struct DBusConnection *conn);
 
 resource_set_t *resource_set_create(const char          *klass,
-                                    uint32_t             mandatory,
-                                    uint32_t             optional,
+                                    uint64_t             mandatory,
+                                    uint64_t             optional,
                                     uint32_t             mode,
                                     resource_callback_t  grantcb,
                                     void                *grantdata);
 
+/*
+ * Like resource_set_create() but the resource set lives in the given
+ * context, i.e. it talks to the manager over the connection of the
+ * context and its callbacks are dispatched from the main loop of the
+ * context. Contexts are created by the main loop specific headers,
+ * e.g. resource_context_new() in resource-glib.h.
+ */
+resource_set_t *resource_set_create_in_context(resource_context_t  *context,
+                                               const char          *klass,
+                                               uint64_t             mandatory,
+                                               uint64_t             optional,
+                                               uint32_t             mode,
+                                               resource_callback_t  grantcb,
+                                               void                *grantdata);
+
+/*
+ * The context used by resource_set_create(). It dispatches on the default
+ * main loop of the library flavour and uses the shared system bus
+ * connection, or the one given to resource_set_use_dbus().
+ */
+resource_context_t *resource_context_default(void);
+
+/*
+ * The context is freed when its last resource set is gone. No new
+ * resource sets can be created in a context once it is destroyed.
+ */
+void resource_context_destroy(resource_context_t *context);
+
 void resource_set_destroy(resource_set_t *resource_set);
 
 int  resource_set_configure_advice_callback(resource_set_t      *resource_set,
@@ -66,14 +117,25 @@ int resource_set_configure_error_callback(resource_set_t            *rs,
                                           void                     *errordata);
 
 int  resource_set_configure_resources(resource_set_t *resource_set,
-                                      uint32_t        mandatory,
-                                      uint32_t        optional);
+                                      uint64_t        mandatory,
+                                      uint64_t        optional);
 
 int  resource_set_configure_audio(resource_set_t *resource_set,
                                   const char     *audio_group,
                                   pid_t           pid_of_renderer,
                                   const char     *pulseaudio_stream_name);
 
+/*
+ * Adds a property the audio streams of the set must have besides the
+ * stream name given to resource_set_configure_audio(), eg. "media.role"
+ * equals "music". Adding a property of the same name again replaces
+ * it and a NULL pattern removes it. A set can have 16 such properties.
+ */
+int  resource_set_configure_audio_property(resource_set_t *resource_set,
+                                           const char     *property_name,
+                                           resource_match_method_t method,
+                                           const char     *pattern);
+
 int  resource_set_configure_video(resource_set_t *resource_set,
                                   pid_t           pid_of_renderer);
 
@@ -84,6 +146,12 @@ int  resource_set_is_acquiring(resource_set_t *resource_set);
 
 char *resource_generate_app_id(pid_t pid);
 
+/*
+ * Copies the histogram of the times from sending an acquire request to
+ * receiving the resulting grant, over all resource sets of the process.
+ */
+int   resource_get_grant_latency(reshist_t *histogram);
+
 #ifdef	__cplusplus
 };
 #endif
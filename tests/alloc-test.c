@@ -0,0 +1,282 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Steady-state allocation test. A client and the reference manager
+ * talk over the internal transport; after a warm-up the sets are
+ * acquired and released ALLOC_CYCLES times and the allocation counters
+ * of libresource must show no net growth in any class and no more
+ * than ALLOC_MAX_PER_CYCLE allocations per acquire/release cycle.
+ * Needs a library configured with --enable-alloc-stats, otherwise the
+ * test is skipped.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <res-conn.h>
+#include <res-alloc.h>
+
+#include "ref-manager.h"
+#include "test-loop.h"
+
+#define ALLOC_SETS           4
+#define ALLOC_WARMUP         10
+#define ALLOC_CYCLES         100
+#define ALLOC_CLIENT         "alloc"
+
+/*
+ * upper limits of allocations per set for one acquire and one release,
+ * including the grants; raise them only knowingly
+ */
+static const uint64_t ALLOC_MAX_PER_CYCLE[RESALLOC_CLASS_MAX] = {
+    [RESALLOC_RSET   ] = 0,
+    [RESALLOC_REPLY  ] = 6,
+    [RESALLOC_REQUEST] = 2,
+    [RESALLOC_MESSAGE] = 2,
+    [RESALLOC_STRING ] = 2,
+};
+
+static void       manager_up(resconn_t *);
+static void       client_handler(resmsg_t *, resset_t *, void *);
+static void       status_cb(resset_t *, resmsg_t *);
+
+static int        send_all(resmsg_type_t);
+static void       cycle(int);
+static void       snapshot(resalloc_stats_t *);
+
+static resconn_t  *client;
+static resset_t   *sets[ALLOC_SETS];
+static uint32_t    reqno;
+static int         pending;
+static int         failed;
+
+
+int main(int argc, char **argv)
+{
+    resconn_t        *manager;
+    refmgr_conf_t     refmgr;
+    resalloc_stats_t  before[RESALLOC_CLASS_MAX];
+    resalloc_stats_t  after[RESALLOC_CLASS_MAX];
+    resalloc_stats_t *b, *a;
+    uint64_t          allocs;
+    int64_t           live;
+    int64_t           bytes;
+    int               verbose = (argc > 1 && !strcmp(argv[1], "-v"));
+    int               i;
+
+    if (!resalloc_enabled()) {
+        printf("allocation accounting is not enabled, skipping\n");
+        return 77;
+    }
+
+    manager = resproto_init(RESPROTO_ROLE_MANAGER,
+                            RESPROTO_TRANSPORT_INTERNAL,
+                            testloop_timer_add, testloop_timer_del);
+    client  = resproto_init(RESPROTO_ROLE_CLIENT,
+                            RESPROTO_TRANSPORT_INTERNAL,
+                            manager_up, ALLOC_CLIENT,
+                            testloop_timer_add, testloop_timer_del);
+
+    if (!manager || !client) {
+        fprintf(stderr, "can't initiate the internal transport\n");
+        return 1;
+    }
+
+    memset(&refmgr, 0, sizeof(refmgr));
+    refmgr.policy    = REFMGR_POLICY_ALWAYS;
+    refmgr.timer_add = testloop_timer_add;
+    refmgr.timer_del = testloop_timer_del;
+
+    if (!refmgr_init(manager, &refmgr)) {
+        fprintf(stderr, "can't set up the manager\n");
+        return 1;
+    }
+
+    resproto_set_handler(client, RESMSG_UNREGISTER, client_handler);
+    resproto_set_handler(client, RESMSG_GRANT     , client_handler);
+    resproto_set_handler(client, RESMSG_ADVICE    , client_handler);
+    resproto_set_handler(client, RESMSG_RELEASE   , client_handler);
+
+    testloop_run(NULL);
+
+    if (!send_all(RESMSG_REGISTER)) {
+        fprintf(stderr, "failed to register the sets\n");
+        return 1;
+    }
+
+    cycle(ALLOC_WARMUP);
+
+    snapshot(before);
+    cycle(ALLOC_CYCLES);
+    snapshot(after);
+
+    if (failed) {
+        fprintf(stderr, "%d requests failed\n", failed);
+        return 1;
+    }
+
+    for (i = 0;  i < RESALLOC_CLASS_MAX;  i++) {
+        b = before + i;
+        a = after  + i;
+
+        allocs = a->allocs - b->allocs;
+        live   = (int64_t)(a->allocs - a->frees) -
+                 (int64_t)(b->allocs - b->frees);
+        bytes  = (int64_t)(a->allocated - a->freed) -
+                 (int64_t)(b->allocated - b->freed);
+
+        if (verbose) {
+            printf("%-8s %.2f allocs/cycle, net %lld objects, %lld bytes\n",
+                   resalloc_class_str(i),
+                   (double)allocs / (ALLOC_CYCLES * ALLOC_SETS),
+                   (long long)live, (long long)bytes);
+        }
+
+        if (live || bytes) {
+            fprintf(stderr, "%s: net growth of %lld objects, %lld bytes "
+                    "in %d cycles\n", resalloc_class_str(i),
+                    (long long)live, (long long)bytes, ALLOC_CYCLES);
+            failed++;
+        }
+
+        if (allocs > ALLOC_MAX_PER_CYCLE[i] * ALLOC_CYCLES * ALLOC_SETS) {
+            fprintf(stderr, "%s: %llu allocations in %d cycles of %d sets, "
+                    "the limit is %llu per cycle\n", resalloc_class_str(i),
+                    (unsigned long long)allocs, ALLOC_CYCLES, ALLOC_SETS,
+                    (unsigned long long)ALLOC_MAX_PER_CYCLE[i]);
+            failed++;
+        }
+    }
+
+    send_all(RESMSG_UNREGISTER);
+
+    resproto_destroy(client);
+    resproto_destroy(manager);
+
+    return failed ? 1 : 0;
+}
+
+
+static void manager_up(resconn_t *rc)
+{
+    (void)rc;
+}
+
+static void client_handler(resmsg_t *msg, resset_t *rset, void *data)
+{
+    (void)rset;
+    (void)data;
+
+    if (msg->type == RESMSG_GRANT)
+        pending--;
+}
+
+static void status_cb(resset_t *rset, resmsg_t *msg)
+{
+    (void)rset;
+
+    if (msg->status.errcod)
+        failed++;
+
+    pending--;
+}
+
+
+static int send_all(resmsg_type_t type)
+{
+    resmsg_t msg;
+    int      success = TRUE;
+    int      i;
+
+    for (i = 0;  i < ALLOC_SETS;  i++) {
+        memset(&msg, 0, sizeof(msg));
+        msg.any.type  = type;
+        msg.any.id    = i + 1;
+        msg.any.reqno = ++reqno;
+
+        switch (type) {
+
+        case RESMSG_REGISTER:
+            msg.record.rset.all = RESMSG_AUDIO_PLAYBACK;
+            msg.record.app_id   = ALLOC_CLIENT;
+            msg.record.klass    = "player";
+
+            sets[i] = resconn_connect(client, &msg, status_cb);
+            success &= (sets[i] != NULL);
+            break;
+
+        case RESMSG_UNREGISTER:
+            success &= resconn_disconnect(sets[i], &msg, status_cb);
+            break;
+
+        default:
+            /* acquire and release are answered by a grant as well */
+            if (resproto_send_message(sets[i], &msg, status_cb))
+                pending++;
+            else
+                success = FALSE;
+            break;
+        }
+
+        pending++;
+    }
+
+    testloop_run(NULL);
+
+    if (pending) {
+        fprintf(stderr, "%d replies missing\n", pending);
+        success = FALSE;
+        pending = 0;
+    }
+
+    return success;
+}
+
+static void cycle(int count)
+{
+    int i;
+
+    for (i = 0;  i < count;  i++) {
+        if (!send_all(RESMSG_ACQUIRE) || !send_all(RESMSG_RELEASE))
+            failed++;
+    }
+}
+
+static void snapshot(resalloc_stats_t *st)
+{
+    int i;
+
+    for (i = 0;  i < RESALLOC_CLASS_MAX;  i++)
+        resalloc_get_stats(i, st + i);
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
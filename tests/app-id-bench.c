@@ -0,0 +1,130 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Benchmarks application id generation for many pids: one
+ * resmsg_generate_app_id() call per pid against a single
+ * resmsg_generate_app_ids() batch. The pids of the running processes
+ * are repeated until there are enough of them.
+ *
+ *   app-id-bench [count]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/types.h>
+
+#include <res-msg.h>
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000.0 + ts.tv_nsec;
+}
+
+static int collect_pids(pid_t *pids, int count)
+{
+    DIR           *dir;
+    struct dirent *de;
+    int            n = 0;
+    int            i;
+
+    if ((dir = opendir("/proc")) == NULL)
+        return 0;
+
+    while (n < count && (de = readdir(dir)) != NULL) {
+        if (isdigit(de->d_name[0]))
+            pids[n++] = atoi(de->d_name);
+    }
+
+    closedir(dir);
+
+    for (i = 0;  n > 0 && i + n < count;  i++)
+        pids[n + i] = pids[i];
+
+    return n > 0 ? count : 0;
+}
+
+static void free_ids(char **ids, int n)
+{
+    int i;
+
+    for (i = 0;  i < n;  i++)
+        free(ids[i]);
+}
+
+int main(int argc, char **argv)
+{
+    int     count = argc > 1 ? atoi(argv[1]) : 4000;
+    pid_t  *pids;
+    char  **ids;
+    double  t;
+    int     found;
+    int     i;
+
+    if (count < 1 ||
+        (pids = calloc(count, sizeof(pid_t))) == NULL ||
+        (ids  = calloc(count, sizeof(char *))) == NULL)
+        return 1;
+
+    if (!collect_pids(pids, count)) {
+        fprintf(stderr, "can't read /proc\n");
+        return 1;
+    }
+
+    t = now();
+    for (i = found = 0;  i < count;  i++) {
+        if ((ids[i] = resmsg_generate_app_id(pids[i])) != NULL)
+            found++;
+    }
+    t = now() - t;
+    free_ids(ids, count);
+
+    printf("single: %d pids, %d ids, %.0f ns/pid\n", count, found, t / count);
+
+    t = now();
+    found = resmsg_generate_app_ids(pids, count, ids);
+    t = now() - t;
+    free_ids(ids, count);
+
+    printf("batch:  %d pids, %d ids, %.0f ns/pid\n", count, found, t / count);
+
+    free(pids);
+    free(ids);
+
+    return 0;
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,284 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Coalescing of grants and their sequence numbers. A client and a
+ * manager talk over the internal transport driven by the virtual clock
+ * of test-loop.c; the manager sends bursts of grants and the test checks
+ * what the client gets to see and what the status callbacks of the
+ * manager are told.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include <res-conn.h>
+
+#include "test-loop.h"
+
+#define COAL_CLIENT   "coalesce"
+#define COAL_BURST    10
+#define COAL_WINDOW   50
+
+static void       manager_up(resconn_t *);
+static void       manager_handler(resmsg_t *, resset_t *, void *);
+static void       client_handler(resmsg_t *, resset_t *, void *);
+static void       status_cb(resset_t *, resmsg_t *);
+
+static void       burst(int, uint32_t);
+static void       send_grant(uint32_t, uint32_t);
+static void       expect(const char *, int, int);
+static void       reset_counts(void);
+
+static resconn_t  *manager;
+static resconn_t  *client;
+static resset_t   *mset;        /* the set as the manager sees it */
+static uint32_t    reqno;
+
+static int         granted;     /* grants the client got */
+static uint32_t    last_resrc;
+static uint32_t    last_seqno;
+static int         ordered;     /* seqnos the client saw increased */
+static int         acked;
+static int         canceled;
+static int         dropped;     /* queued when the set went away */
+static int         failed;
+
+
+int main(int argc, char **argv)
+{
+    resset_t         *cset;
+    resproto_stats_t  st;
+    resmsg_t          msg;
+
+    (void)argc;
+    (void)argv;
+
+    testloop_use_virtual_clock();
+
+    manager = resproto_init(RESPROTO_ROLE_MANAGER,
+                            RESPROTO_TRANSPORT_INTERNAL,
+                            testloop_timer_add, testloop_timer_del);
+    client  = resproto_init(RESPROTO_ROLE_CLIENT,
+                            RESPROTO_TRANSPORT_INTERNAL,
+                            manager_up, COAL_CLIENT,
+                            testloop_timer_add, testloop_timer_del);
+
+    if (!manager || !client) {
+        fprintf(stderr, "can't initiate the internal transport\n");
+        return 1;
+    }
+
+    resproto_set_handler(manager, RESMSG_REGISTER  , manager_handler);
+    resproto_set_handler(manager, RESMSG_UNREGISTER, manager_handler);
+    resproto_set_handler(client , RESMSG_GRANT     , client_handler);
+
+    testloop_run_for(0);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.record.type     = RESMSG_REGISTER;
+    msg.record.id       = 1;
+    msg.record.reqno    = ++reqno;
+    msg.record.rset.all = RESMSG_AUDIO_PLAYBACK;
+    msg.record.app_id   = COAL_CLIENT;
+    msg.record.klass    = "player";
+
+    cset = resconn_connect(client, &msg, NULL);
+    testloop_run_for(0);
+
+    if (!cset || !mset) {
+        fprintf(stderr, "failed to register the set\n");
+        return 1;
+    }
+
+    /* without coalescing every grant goes through */
+    burst(COAL_BURST, 0);
+    expect("plain grants", granted, COAL_BURST);
+    expect("plain acks", acked, COAL_BURST);
+
+    /* the ones sent while the first waits for its ack are folded */
+    resconn_set_coalescing(manager, TRUE, 0, NULL, NULL);
+    burst(COAL_BURST, 0);
+    expect("coalesced grants", granted, 2);
+    expect("coalesced resources", last_resrc, COAL_BURST);
+    expect("coalesced acks", acked, 2);
+    expect("superseded", canceled, COAL_BURST - 2);
+
+    /* with a window the latest waits for the window to pass */
+    resconn_set_coalescing(manager, TRUE, COAL_WINDOW, NULL, NULL);
+    burst(COAL_BURST, COAL_WINDOW / 2);
+    expect("grants within the window", granted, 1);
+    testloop_run_for(COAL_WINDOW);
+    expect("grants after the window", granted, 2);
+    expect("resources after the window", last_resrc, COAL_BURST);
+    testloop_run_for(COAL_WINDOW);
+
+    /* a grant older than the last one seen is dropped */
+    resconn_set_coalescing(manager, FALSE, 0, NULL, NULL);
+    reset_counts();
+    send_grant(1, 100);
+    send_grant(2, 99);
+    send_grant(3, 0);
+    testloop_run_for(0);
+    expect("grants with own seqnos", granted, 2);
+    expect("resources with own seqnos", last_resrc, 3);
+
+    resproto_get_stats(client, &st);
+    expect("stale", st.stale, 1);
+    resproto_get_stats(manager, &st);
+    expect("coalesced", st.coalesced, 2 * (COAL_BURST - 2));
+
+    /* a grant held back by the window is completed when the set goes */
+    resconn_set_coalescing(manager, TRUE, COAL_WINDOW, NULL, NULL);
+    burst(2, 0);
+    expect("grants before unregister", granted, 1);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.any.type  = RESMSG_UNREGISTER;
+    msg.any.id    = 1;
+    msg.any.reqno = ++reqno;
+
+    resconn_disconnect(cset, &msg, NULL);
+    testloop_run_for(0);
+
+    resproto_destroy(client);
+    resproto_destroy(manager);
+
+    expect("dropped with the set", dropped, 1);
+
+    return failed ? 1 : 0;
+}
+
+
+static void manager_up(resconn_t *rc)
+{
+    (void)rc;
+}
+
+static void manager_handler(resmsg_t *msg, resset_t *rset, void *data)
+{
+    if (msg->type == RESMSG_REGISTER)
+        mset = rset;
+    else
+        mset = NULL;
+
+    resproto_reply_message(rset, msg, data, 0, "OK");
+}
+
+static void client_handler(resmsg_t *msg, resset_t *rset, void *data)
+{
+    (void)rset;
+    (void)data;
+
+    if (msg->notify.seqno <= last_seqno)
+        ordered = FALSE;
+
+    granted++;
+    last_resrc = msg->notify.resrc;
+    last_seqno = msg->notify.seqno;
+}
+
+static void status_cb(resset_t *rset, resmsg_t *msg)
+{
+    (void)rset;
+
+    if (msg->status.errcod == 0)
+        acked++;
+    else if (msg->status.errcod == ECANCELED)
+        canceled++;
+    else if (msg->status.errcod == ECONNRESET)
+        dropped++;
+    else {
+        fprintf(stderr, "grant failed: %d %s\n", msg->status.errcod,
+                msg->status.errmsg);
+        failed++;
+    }
+}
+
+
+static void burst(int count, uint32_t run)
+{
+    resmsg_t msg;
+    uint32_t i;
+
+    reset_counts();
+
+    for (i = 1;  i <= (uint32_t)count;  i++) {
+        memset(&msg, 0, sizeof(msg));
+        msg.notify.type  = RESMSG_GRANT;
+        msg.notify.id    = mset->id;
+        msg.notify.reqno = ++reqno;
+        msg.notify.resrc = i;
+
+        if (!resproto_send_message(mset, &msg, status_cb))
+            failed++;
+    }
+
+    testloop_run_for(run);
+
+    expect("seqno order", ordered, TRUE);
+}
+
+static void send_grant(uint32_t resrc, uint32_t seqno)
+{
+    resmsg_t msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.notify.type  = RESMSG_GRANT;
+    msg.notify.id    = mset->id;
+    msg.notify.reqno = ++reqno;
+    msg.notify.resrc = resrc;
+    msg.notify.seqno = seqno;
+
+    if (!resproto_send_message(mset, &msg, NULL))
+        failed++;
+}
+
+static void expect(const char *what, int value, int expected)
+{
+    if (value != expected) {
+        fprintf(stderr, "%s: %d instead of %d\n", what, value, expected);
+        failed++;
+    }
+}
+
+static void reset_counts(void)
+{
+    granted    = 0;
+    last_resrc = 0;
+    last_seqno = 0;
+    ordered    = TRUE;
+    acked      = 0;
+    canceled   = 0;
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
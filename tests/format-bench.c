@@ -0,0 +1,174 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Benchmark of the mask formatters of res-msg.c, which the logging and
+ * dump paths call for every message. Each formatter is run on a few
+ * typical masks for at least BENCH_MIN_NSEC and the time per call is
+ * printed as JSON.
+ *
+ *   format-bench
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <res-msg.h>
+
+#define BENCH_MIN_NSEC  200000000ULL
+#define BENCH_BATCH     1000
+
+typedef enum {
+    FMT_RES_STR = 0,
+    FMT_RES_HEX,
+    FMT_MOD_STR,
+    FMT_DUMP,
+    FMT_MAX
+} fmt_t;
+
+typedef struct {
+    const char *name;
+    uint64_t    mask;
+} input_t;
+
+static uint64_t    now(void);
+static uint64_t    run(fmt_t, uint64_t, uint32_t *);
+static const char *call(fmt_t, uint64_t, char *, int);
+
+static const char *fmt_names[FMT_MAX] = {
+    [FMT_RES_STR] = "resmsg_res_str",
+    [FMT_RES_HEX] = "resmsg_res_hex",
+    [FMT_MOD_STR] = "resmsg_mod_str",
+    [FMT_DUMP   ] = "resmsg_dump_message",
+};
+
+static input_t inputs[] = {
+    { "none"   , 0                                                     },
+    { "single" , RESOURCE_AUDIO_PLAYBACK                               },
+    { "player" , RESOURCE_AUDIO_PLAYBACK | RESOURCE_VIDEO_PLAYBACK |
+                 RESOURCE_BACKLIGHT                                    },
+    { "builtin", RESOURCE_BIT(16) - 1                                  },
+    { "wide"   , RESOURCE_AUDIO_PLAYBACK | RESOURCE_BIT(40) |
+                 RESOURCE_BIT(63)                                      },
+};
+
+#define NINPUT  (int)(sizeof(inputs) / sizeof(inputs[0]))
+
+static volatile char sink;      /* keeps the calls from being optimized out */
+
+
+int main(int argc, char **argv)
+{
+    uint64_t  elapsed;
+    uint32_t  calls;
+    fmt_t     fmt;
+    int       i;
+
+    (void)argc;
+    (void)argv;
+
+    printf("{\"benchmark\":\"format\",\"results\":[");
+
+    for (fmt = 0;  fmt < FMT_MAX;  fmt++) {
+        for (i = 0;  i < NINPUT;  i++) {
+            elapsed = run(fmt, inputs[i].mask, &calls);
+
+            printf("%s\n {\"function\":\"%s\",\"input\":\"%s\","
+                   "\"calls\":%u,\"ns_per_call\":%.1f}",
+                   fmt || i ? "," : "", fmt_names[fmt], inputs[i].name,
+                   calls, (double)elapsed / calls);
+        }
+    }
+
+    printf("]}\n");
+
+    return 0;
+}
+
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t run(fmt_t fmt, uint64_t mask, uint32_t *calls)
+{
+    char      buf[1024];
+    uint64_t  start;
+    uint64_t  elapsed;
+    int       i;
+
+    *calls = 0;
+    start  = now();
+
+    do {
+        for (i = 0;  i < BENCH_BATCH;  i++)
+            sink = call(fmt, mask, buf, sizeof(buf))[0];
+
+        *calls += BENCH_BATCH;
+        elapsed = now() - start;
+    } while (elapsed < BENCH_MIN_NSEC);
+
+    return elapsed;
+}
+
+static const char *call(fmt_t fmt, uint64_t mask, char *buf, int len)
+{
+    resmsg_t msg;
+
+    switch (fmt) {
+    case FMT_RES_STR:
+        return resmsg_res_str(mask, buf, len);
+    case FMT_RES_HEX:
+        return resmsg_res_hex(mask, buf, len);
+    case FMT_MOD_STR:
+        return resmsg_mod_str((uint32_t)mask, buf, len);
+    case FMT_DUMP:
+        memset(&msg, 0, sizeof(msg));
+        msg.record.type      = RESMSG_REGISTER;
+        msg.record.rset.all  = mask;
+        msg.record.rset.opt  = mask & ~RESOURCE_AUDIO_PLAYBACK;
+        msg.record.rset.mask = mask;
+        msg.record.klass     = "player";
+        msg.record.app_id    = "bench";
+        msg.record.mode      = RESMSG_MODE_AUTO_RELEASE;
+        return resmsg_dump_message(&msg, 3, buf, len);
+    default:
+        return "";
+    }
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,325 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fuzz-common.h"
+
+typedef struct {
+    const uint8_t  *data;
+    size_t          size;
+} input_t;
+
+typedef struct {
+    uint8_t        *buf;
+    size_t          len;
+    size_t          used;
+} output_t;
+
+static uint32_t  get_uint32(input_t *);
+static uint64_t  get_uint64(input_t *);
+static char     *get_string(input_t *, fuzz_msg_t *);
+static void      put_uint32(output_t *, uint32_t);
+static void      put_uint64(output_t *, uint64_t);
+static void      put_string(output_t *, const char *);
+
+static resmsg_property_t sample_extra[] = {
+    { "application.process.binary", { resmsg_method_equals , "player" } },
+    { "media.role"                , { resmsg_method_matches, "^(music|video)$" } },
+};
+
+static resmsg_t  samples[] = {
+    { .record  = { RESMSG_REGISTER, 1, 1,
+                   { RESMSG_AUDIO_PLAYBACK | RESMSG_VIDEO_PLAYBACK,
+                     RESMSG_VIDEO_PLAYBACK, 0, 0 },
+                   "1a2b3c", "player", RESMSG_MODE_AUTO_RELEASE } },
+    { .record  = { RESMSG_UPDATE, 1, 2,
+                   { RESMSG_AUDIO_PLAYBACK, 0, RESMSG_AUDIO_PLAYBACK,
+                     RESMSG_AUDIO_PLAYBACK },
+                   "1a2b3c", "player", RESMSG_MODE_ALWAYS_REPLY } },
+    { .record  = { RESMSG_REGISTER, 2, 3, { RESMSG_VIBRA, 0, 0, 0 },
+                   NULL, NULL, 0 } },
+    { .record  = { RESMSG_REGISTER, 3, 10,
+                   { RESMSG_AUDIO_PLAYBACK | RESOURCE_BIT(40),
+                     RESOURCE_BIT(40), 0, 0 },
+                   "1a2b3c", "player", 0 } },
+    { .possess = { RESMSG_UNREGISTER, 1, 4 } },
+    { .possess = { RESMSG_ACQUIRE, 1, 5 } },
+    { .possess = { RESMSG_RELEASE, 1, 6 } },
+    { .notify  = { RESMSG_GRANT, 1, 5, RESMSG_AUDIO_PLAYBACK, 7 } },
+    { .notify  = { RESMSG_ADVICE, 1, 0, RESMSG_LEDS | RESMSG_BACKLIGHT, 8 } },
+    { .notify  = { RESMSG_GRANT, 3, 11, RESOURCE_BIT(63), 0xffffffff } },
+    { .audio   = { RESMSG_AUDIO, 1, 7, "player", "1a2b3c",
+                   { "media.name", { resmsg_method_equals, "music" } } } },
+    { .audio   = { RESMSG_AUDIO, 1, 8, NULL, NULL,
+                   { NULL, { resmsg_method_startswith, NULL } } } },
+    { .audio   = { RESMSG_AUDIO, 2, 12, "player", "1a2b3c",
+                   { "media.name", { resmsg_method_startswith, "Music" } },
+                   2, sample_extra } },
+    { .video   = { RESMSG_VIDEO, 1, 9, 1234 } },
+    { .status  = { RESMSG_STATUS, 1, 5, 0, "OK" } },
+    { .status  = { RESMSG_STATUS, 1, 6, 22, NULL } },
+};
+
+
+void fuzz_decode_message(const uint8_t *data, size_t size, fuzz_msg_t *fm)
+{
+    input_t            in  = { data, size };
+    resmsg_t          *msg = &fm->msg;
+    resmsg_property_t *property;
+    uint32_t           i;
+
+    memset(fm, 0, sizeof(fuzz_msg_t));
+
+    msg->any.type  = (int32_t)get_uint32(&in);
+    msg->any.id    = get_uint32(&in);
+    msg->any.reqno = get_uint32(&in);
+
+    switch (msg->type) {
+
+    case RESMSG_REGISTER:
+    case RESMSG_UPDATE:
+        msg->record.rset.all   = get_uint64(&in);
+        msg->record.rset.opt   = get_uint64(&in);
+        msg->record.rset.share = get_uint64(&in);
+        msg->record.rset.mask  = get_uint64(&in);
+        msg->record.app_id     = get_string(&in, fm);
+        msg->record.klass      = get_string(&in, fm);
+        msg->record.mode       = get_uint32(&in);
+        break;
+
+    case RESMSG_GRANT:
+    case RESMSG_ADVICE:
+        msg->notify.resrc = get_uint64(&in);
+        msg->notify.seqno = get_uint32(&in);
+        break;
+
+    case RESMSG_AUDIO:
+        property = &msg->audio.property;
+        msg->audio.group        = get_string(&in, fm);
+        msg->audio.app_id       = get_string(&in, fm);
+        property->name          = get_string(&in, fm);
+        property->match.method  = (int32_t)get_uint32(&in);
+        property->match.pattern = get_string(&in, fm);
+        msg->audio.nextra       = get_uint32(&in);
+        msg->audio.extra        = fm->extra;
+
+        if (msg->audio.nextra > FUZZ_MAX_EXTRA)
+            msg->audio.nextra = FUZZ_MAX_EXTRA;
+
+        for (i = 0;  i < msg->audio.nextra;  i++) {
+            property = fm->extra + i;
+            property->name          = get_string(&in, fm);
+            property->match.method  = (int32_t)get_uint32(&in);
+            property->match.pattern = get_string(&in, fm);
+        }
+        break;
+
+    case RESMSG_VIDEO:
+        msg->video.pid = get_uint32(&in);
+        break;
+
+    case RESMSG_STATUS:
+        msg->status.errcod = (int32_t)get_uint32(&in);
+        msg->status.errmsg = get_string(&in, fm);
+        break;
+
+    default:
+        break;
+    }
+}
+
+void fuzz_release_message(fuzz_msg_t *fm)
+{
+    int i;
+
+    for (i = 0;  i < fm->nstring;  i++)
+        free(fm->strings[i]);
+
+    fm->nstring = 0;
+}
+
+size_t fuzz_encode_message(resmsg_t *msg, uint8_t *buf, size_t len)
+{
+    output_t           out = { buf, len, 0 };
+    resmsg_property_t *property;
+    uint32_t           i;
+
+    put_uint32(&out, (uint32_t)msg->any.type);
+    put_uint32(&out, msg->any.id);
+    put_uint32(&out, msg->any.reqno);
+
+    switch (msg->type) {
+
+    case RESMSG_REGISTER:
+    case RESMSG_UPDATE:
+        put_uint64(&out, msg->record.rset.all);
+        put_uint64(&out, msg->record.rset.opt);
+        put_uint64(&out, msg->record.rset.share);
+        put_uint64(&out, msg->record.rset.mask);
+        put_string(&out, msg->record.app_id);
+        put_string(&out, msg->record.klass);
+        put_uint32(&out, msg->record.mode);
+        break;
+
+    case RESMSG_GRANT:
+    case RESMSG_ADVICE:
+        put_uint64(&out, msg->notify.resrc);
+        put_uint32(&out, msg->notify.seqno);
+        break;
+
+    case RESMSG_AUDIO:
+        property = &msg->audio.property;
+        put_string(&out, msg->audio.group);
+        put_string(&out, msg->audio.app_id);
+        put_string(&out, property->name);
+        put_uint32(&out, (uint32_t)property->match.method);
+        put_string(&out, property->match.pattern);
+        put_uint32(&out, msg->audio.nextra);
+
+        for (i = 0;  msg->audio.extra && i < msg->audio.nextra;  i++) {
+            property = msg->audio.extra + i;
+            put_string(&out, property->name);
+            put_uint32(&out, (uint32_t)property->match.method);
+            put_string(&out, property->match.pattern);
+        }
+        break;
+
+    case RESMSG_VIDEO:
+        put_uint32(&out, msg->video.pid);
+        break;
+
+    case RESMSG_STATUS:
+        put_uint32(&out, (uint32_t)msg->status.errcod);
+        put_string(&out, msg->status.errmsg);
+        break;
+
+    default:
+        break;
+    }
+
+    return out.used <= len ? out.used : 0;
+}
+
+int fuzz_sample_messages(resmsg_t **msgs)
+{
+    *msgs = samples;
+
+    return (int)(sizeof(samples) / sizeof(samples[0]));
+}
+
+
+static uint32_t get_uint32(input_t *in)
+{
+    uint32_t value = 0;
+    size_t   i;
+
+    for (i = 0;  i < 4 && i < in->size;  i++)
+        value |= (uint32_t)in->data[i] << (8 * i);
+
+    in->data += i;
+    in->size -= i;
+
+    return value;
+}
+
+static uint64_t get_uint64(input_t *in)
+{
+    uint64_t low = get_uint32(in);
+
+    return low | ((uint64_t)get_uint32(in) << 32);
+}
+
+static char *get_string(input_t *in, fuzz_msg_t *fm)
+{
+    size_t  len;
+    char   *str;
+
+    if (in->size < 2)
+        return NULL;
+
+    len = in->data[0] | (in->data[1] << 8);
+
+    in->data += 2;
+    in->size -= 2;
+
+    if (len == FUZZ_NULL_STRING || fm->nstring >= FUZZ_MAX_STRINGS)
+        return NULL;
+
+    if (len > in->size)
+        len = in->size;
+
+    if ((str = malloc(len + 1)) != NULL) {
+        memcpy(str, in->data, len);
+        str[len] = '\0';
+        fm->strings[fm->nstring++] = str;
+    }
+
+    in->data += len;
+    in->size -= len;
+
+    return str;
+}
+
+static void put_uint32(output_t *out, uint32_t value)
+{
+    int i;
+
+    for (i = 0;  i < 4;  i++, out->used++) {
+        if (out->used < out->len)
+            out->buf[out->used] = (value >> (8 * i)) & 0xff;
+    }
+}
+
+static void put_uint64(output_t *out, uint64_t value)
+{
+    put_uint32(out, (uint32_t)value);
+    put_uint32(out, (uint32_t)(value >> 32));
+}
+
+static void put_string(output_t *out, const char *str)
+{
+    size_t len = str ? strlen(str) : FUZZ_NULL_STRING;
+    size_t i;
+
+    for (i = 0;  i < 2;  i++, out->used++) {
+        if (out->used < out->len)
+            out->buf[out->used] = (len >> (8 * i)) & 0xff;
+    }
+
+    if (str != NULL) {
+        for (i = 0;  i < len;  i++, out->used++) {
+            if (out->used < out->len)
+                out->buf[out->used] = str[i];
+        }
+    }
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,70 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __RESOURCE_TESTS_FUZZ_COMMON_H__
+#define __RESOURCE_TESTS_FUZZ_COMMON_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <res-msg.h>
+
+/*
+ * The internal transport passes resmsg_t structures as they are, so
+ * those harnesses get their input in a compact binary form: the type,
+ * id and reqno followed by the fields of the type. Integers are 32-bit
+ * and resource masks 64-bit little endian numbers, strings a 16-bit
+ * length and the bytes, with FUZZ_NULL_STRING as the length of a NULL
+ * string. Fields missing at the end of the input are zero. An audio
+ * message ends with the number of further properties, at most
+ * FUZZ_MAX_EXTRA of them are decoded.
+ */
+
+#define FUZZ_NULL_STRING   0xffff
+#define FUZZ_MAX_EXTRA     4
+#define FUZZ_MAX_STRINGS   (8 + 2 * FUZZ_MAX_EXTRA)
+
+typedef struct {
+    resmsg_t           msg;
+    resmsg_property_t  extra[FUZZ_MAX_EXTRA];
+    char              *strings[FUZZ_MAX_STRINGS];
+    int                nstring;
+} fuzz_msg_t;
+
+void    fuzz_decode_message(const uint8_t *, size_t, fuzz_msg_t *);
+void    fuzz_release_message(fuzz_msg_t *);
+size_t  fuzz_encode_message(resmsg_t *, uint8_t *, size_t);
+int     fuzz_sample_messages(resmsg_t **);
+
+/* implemented by every harness */
+int     LLVMFuzzerTestOneInput(const uint8_t *, size_t);
+
+#endif /* __RESOURCE_TESTS_FUZZ_COMMON_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,188 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Fuzz target for the D-Bus codec. The input is a marshalled D-Bus
+ * message as a manager would receive it from a client. Whatever parses
+ * is composed again and the result must parse back to the same message.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <dbus/dbus.h>
+
+#include "fuzz-common.h"
+#include "dbus-msg.h"
+
+#define FUZZ_DEST       "org.maemo.resource.manager"
+#define FUZZ_PATH       "/org/maemo/resource/manager"
+#define FUZZ_INTERFACE  "org.maemo.resource.manager"
+
+static void  check_round_trip(DBusMessage *, resmsg_t *);
+static void  check_reply(DBusMessage *, resmsg_t *);
+static int   same_string(const char *, const char *);
+static int   same_extra(resmsg_audio_t *, resmsg_audio_t *);
+static int   same_message(resmsg_t *, resmsg_t *);
+
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    DBusMessage *dbusmsg;
+    resmsg_t     resmsg;
+    char         buf[2048];
+
+    if ((dbusmsg = dbus_message_demarshal((const char *)data, size,
+                                          NULL)) == NULL)
+        return 0;
+
+    if (resmsg_dbus_parse_message(dbusmsg, &resmsg) != NULL) {
+        resmsg_dump_message(&resmsg, 2, buf, sizeof(buf));
+
+        if (resmsg.type == RESMSG_STATUS)
+            check_reply(dbusmsg, &resmsg);
+        else
+            check_round_trip(dbusmsg, &resmsg);
+    }
+
+    dbus_message_unref(dbusmsg);
+
+    return 0;
+}
+
+
+static void check_round_trip(DBusMessage *dbusmsg, resmsg_t *resmsg)
+{
+    DBusMessage *copy;
+    resmsg_t     parsed;
+    const char  *method;
+
+    if ((method = dbus_message_get_member(dbusmsg)) == NULL)
+        method = resmsg_type_str(resmsg->type);
+
+    copy = resmsg_dbus_compose_message(FUZZ_DEST, FUZZ_PATH, FUZZ_INTERFACE,
+                                       method, resmsg);
+    if (copy == NULL)
+        return;
+
+    if (resmsg_dbus_parse_message(copy, &parsed) == NULL ||
+        !same_message(resmsg, &parsed))
+        abort();
+
+    dbus_message_unref(copy);
+}
+
+static void check_reply(DBusMessage *dbusmsg, resmsg_t *resmsg)
+{
+    DBusMessage *reply;
+    resmsg_t     parsed;
+
+    if (dbus_message_get_type(dbusmsg) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+        return;
+
+    if ((reply = resmsg_dbus_reply_message(dbusmsg, resmsg)) == NULL)
+        return;
+
+    if (resmsg_dbus_parse_message(reply, &parsed) == NULL ||
+        !same_message(resmsg, &parsed))
+        abort();
+
+    dbus_message_unref(reply);
+}
+
+static int same_string(const char *a, const char *b)
+{
+    /* NULL strings are composed as empty ones */
+    return !strcmp(a ? a : "", b ? b : "");
+}
+
+static int same_extra(resmsg_audio_t *a, resmsg_audio_t *b)
+{
+    resmsg_property_t *pa, *pb;
+    uint32_t           i;
+
+    if (a->nextra != b->nextra)
+        return FALSE;
+
+    for (i = 0;  i < a->nextra;  i++) {
+        pa = a->extra + i;
+        pb = b->extra + i;
+
+        if (!same_string(pa->name, pb->name)             ||
+            pa->match.method != pb->match.method         ||
+            !same_string(pa->match.pattern, pb->match.pattern))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static int same_message(resmsg_t *a, resmsg_t *b)
+{
+    if (a->any.type != b->any.type || a->any.id != b->any.id ||
+        a->any.reqno != b->any.reqno)
+        return FALSE;
+
+    switch (a->type) {
+
+    case RESMSG_REGISTER:
+    case RESMSG_UPDATE:
+        return !memcmp(&a->record.rset, &b->record.rset, sizeof(a->record.rset))
+            && same_string(a->record.app_id, b->record.app_id)
+            && same_string(a->record.klass , b->record.klass)
+            && a->record.mode == b->record.mode;
+
+    case RESMSG_GRANT:
+    case RESMSG_ADVICE:
+        return a->notify.resrc == b->notify.resrc &&
+               a->notify.seqno == b->notify.seqno;
+
+    case RESMSG_AUDIO:
+        return same_string(a->audio.group , b->audio.group)
+            && same_string(a->audio.app_id, b->audio.app_id)
+            && same_string(a->audio.property.name, b->audio.property.name)
+            && a->audio.property.match.method ==
+               b->audio.property.match.method
+            && same_string(a->audio.property.match.pattern,
+                           b->audio.property.match.pattern)
+            && same_extra(&a->audio, &b->audio);
+
+    case RESMSG_VIDEO:
+        return a->video.pid == b->video.pid;
+
+    case RESMSG_STATUS:
+        return a->status.errcod == b->status.errcod
+            && same_string(a->status.errmsg, b->status.errmsg);
+
+    default:
+        return TRUE;
+    }
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,72 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Fuzz target for resmsg_dump_message(). The input is decoded by
+ * fuzz-common.c; the first byte also selects the indentation and the
+ * size of the output buffer so that truncation is exercised.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fuzz-common.h"
+
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    fuzz_msg_t  fm;
+    char       *buf;
+    int         len;
+    int         indent;
+
+    if (size < 1)
+        return 0;
+
+    indent = data[0] & 0x3f;
+    len    = data[0] & 0x80 ? 4096 : 1 + (data[0] & 0x7f);
+
+    fuzz_decode_message(data + 1, size - 1, &fm);
+
+    /* exact size so that any overrun is caught by the sanitizers */
+    if ((buf = malloc(len)) != NULL) {
+        resmsg_dump_message(&fm.msg, indent, buf, len);
+
+        if (strlen(buf) >= (size_t)len)
+            abort();
+
+        free(buf);
+    }
+
+    fuzz_release_message(&fm);
+
+    return 0;
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
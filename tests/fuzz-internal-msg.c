@@ -0,0 +1,107 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Fuzz target for the message copies the internal transport makes of
+ * requests it has to queue. The input is decoded by fuzz-common.c.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fuzz-common.h"
+#include "internal-msg.h"
+
+static int  same_string(const char *, const char *);
+
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    fuzz_msg_t  fm;
+    resmsg_t   *src = &fm.msg;
+    resmsg_t   *dst;
+    char        buf[2048];
+
+    fuzz_decode_message(data, size, &fm);
+
+    if ((dst = resmsg_internal_copy_message(src)) != NULL) {
+        if (dst->any.type != src->any.type || dst->any.id != src->any.id ||
+            dst->any.reqno != src->any.reqno)
+            abort();
+
+        switch (src->type) {
+
+        case RESMSG_REGISTER:
+        case RESMSG_UPDATE:
+            if (!same_string(src->record.app_id, dst->record.app_id) ||
+                !same_string(src->record.klass , dst->record.klass))
+                abort();
+            break;
+
+        case RESMSG_AUDIO:
+            if (!same_string(src->audio.group , dst->audio.group)  ||
+                !same_string(src->audio.app_id, dst->audio.app_id) ||
+                !same_string(src->audio.property.name,
+                             dst->audio.property.name)             ||
+                !same_string(src->audio.property.match.pattern,
+                             dst->audio.property.match.pattern))
+                abort();
+            break;
+
+        case RESMSG_STATUS:
+            if (!same_string(src->status.errmsg, dst->status.errmsg))
+                abort();
+            break;
+
+        default:
+            break;
+        }
+
+        /* the copy must not refer to the original once that is gone */
+        fuzz_release_message(&fm);
+        resmsg_dump_message(dst, 0, buf, sizeof(buf));
+        resmsg_internal_destroy_message(dst);
+    }
+    else {
+        fuzz_release_message(&fm);
+    }
+
+    return 0;
+}
+
+
+static int same_string(const char *a, const char *b)
+{
+    if (!a || !b)
+        return a == b;
+
+    return !strcmp(a, b);
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
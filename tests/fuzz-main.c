@@ -0,0 +1,154 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Stand-alone driver for the fuzz targets, used when they are not
+ * linked with libFuzzer. Every argument is a file or a directory of
+ * files to run the target on once; without arguments the input is read
+ * from stdin, which is what AFL expects. The seed corpus is written by
+ * fuzz-seed:
+ *
+ *   CC=afl-clang-fast ./configure && make -C tests
+ *   tests/fuzz_seed corpus
+ *   afl-fuzz -i corpus/dbus -o findings -- tests/fuzz_dbus_msg
+ *
+ * With libFuzzer the driver is not needed:
+ *
+ *   CC=clang CFLAGS=-fsanitize=address ./configure --enable-fuzzing
+ *   tests/fuzz_dbus_msg -max_total_time=600 corpus/dbus
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "fuzz-common.h"
+
+#define FUZZ_MAX_INPUT  (1024 * 1024)
+
+static int  run_fd(FILE *, const char *);
+static int  run_path(const char *);
+static int  run_dir(const char *);
+
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+    int i;
+
+    if (argc < 2)
+        return run_fd(stdin, "<stdin>");
+
+    for (i = 1;  i < argc;  i++)
+        failed |= run_path(argv[i]);
+
+    return failed;
+}
+
+
+static int run_fd(FILE *fp, const char *name)
+{
+    uint8_t *data;
+    size_t   size;
+
+    if ((data = malloc(FUZZ_MAX_INPUT)) == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    size = fread(data, 1, FUZZ_MAX_INPUT, fp);
+
+    if (ferror(fp)) {
+        fprintf(stderr, "failed to read %s: %s\n", name, strerror(errno));
+        free(data);
+        return 1;
+    }
+
+    LLVMFuzzerTestOneInput(data, size);
+
+    free(data);
+
+    return 0;
+}
+
+static int run_path(const char *path)
+{
+    struct stat  st;
+    FILE        *fp;
+    int          failed;
+
+    if (stat(path, &st) < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    if (S_ISDIR(st.st_mode))
+        return run_dir(path);
+
+    if ((fp = fopen(path, "rb")) == NULL) {
+        fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    failed = run_fd(fp, path);
+
+    fclose(fp);
+
+    return failed;
+}
+
+static int run_dir(const char *path)
+{
+    DIR           *dir;
+    struct dirent *de;
+    char           file[1024];
+    int            failed = 0;
+
+    if ((dir = opendir(path)) == NULL) {
+        fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_name[0] == '.')
+            continue;
+
+        snprintf(file, sizeof(file), "%s/%s", path, de->d_name);
+        failed |= run_path(file);
+    }
+
+    closedir(dir);
+
+    return failed;
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
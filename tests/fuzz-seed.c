@@ -0,0 +1,187 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Writes the seed corpus of the fuzz targets: every sample message of
+ * fuzz-common.c marshalled as a D-Bus message to <dir>/dbus and in the
+ * binary form of the internal targets to <dir>/msg.
+ *
+ *   fuzz-seed <dir>
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <dbus/dbus.h>
+
+#include "fuzz-common.h"
+#include "dbus-msg.h"
+
+#define FUZZ_DEST       "org.maemo.resource.manager"
+#define FUZZ_PATH       "/org/maemo/resource/manager"
+#define FUZZ_INTERFACE  "org.maemo.resource.manager"
+
+static int          make_dir(const char *);
+static int          write_file(const char *, int, const char *,
+                               const void *, size_t);
+static DBusMessage *dbus_sample(resmsg_t *);
+
+
+int main(int argc, char **argv)
+{
+    char         dir[1024];
+    uint8_t      buf[4096];
+    resmsg_t    *msgs;
+    DBusMessage *dbusmsg;
+    char        *data;
+    int          size;
+    size_t       len;
+    int          n;
+    int          i;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <dir>\n", argv[0]);
+        return 1;
+    }
+
+    if (make_dir(argv[1]))
+        return 1;
+
+    n = fuzz_sample_messages(&msgs);
+
+    snprintf(dir, sizeof(dir), "%s/msg", argv[1]);
+
+    if (make_dir(dir))
+        return 1;
+
+    for (i = 0;  i < n;  i++) {
+        if ((len = fuzz_encode_message(msgs + i, buf, sizeof(buf))) == 0 ||
+            write_file(dir, i, resmsg_type_str(msgs[i].type), buf, len))
+            return 1;
+    }
+
+    snprintf(dir, sizeof(dir), "%s/dbus", argv[1]);
+
+    if (make_dir(dir))
+        return 1;
+
+    for (i = 0;  i < n;  i++) {
+        if ((dbusmsg = dbus_sample(msgs + i)) == NULL) {
+            fprintf(stderr, "failed to compose %s message\n",
+                    resmsg_type_str(msgs[i].type));
+            return 1;
+        }
+
+        if (!dbus_message_marshal(dbusmsg, &data, &size) ||
+            write_file(dir, i, resmsg_type_str(msgs[i].type), data, size))
+            return 1;
+
+        dbus_free(data);
+        dbus_message_unref(dbusmsg);
+    }
+
+    return 0;
+}
+
+
+static int make_dir(const char *path)
+{
+    if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+        fprintf(stderr, "can't create %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    return 0;
+}
+
+static int write_file(const char *dir, int idx, const char *name,
+                      const void *data, size_t size)
+{
+    char  path[1200];
+    FILE *fp;
+    int   failed;
+
+    snprintf(path, sizeof(path), "%s/%02d-%s", dir, idx, name);
+
+    if ((fp = fopen(path, "wb")) == NULL) {
+        fprintf(stderr, "can't create %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    failed = (fwrite(data, 1, size, fp) != size);
+    failed |= (fclose(fp) != 0);
+
+    if (failed)
+        fprintf(stderr, "failed to write %s\n", path);
+
+    return failed;
+}
+
+static DBusMessage *dbus_sample(resmsg_t *msg)
+{
+    DBusMessage *call;
+    DBusMessage *reply;
+    resmsg_t     acquire;
+
+    if (msg->type != RESMSG_STATUS) {
+        call = resmsg_dbus_compose_message(FUZZ_DEST, FUZZ_PATH,
+                                           FUZZ_INTERFACE,
+                                           resmsg_type_str(msg->type), msg);
+        if (call != NULL)
+            dbus_message_set_serial(call, msg->any.reqno);
+
+        return call;
+    }
+
+    /* a status is the reply to a request */
+    memset(&acquire, 0, sizeof(acquire));
+    acquire.possess.type  = RESMSG_ACQUIRE;
+    acquire.possess.id    = msg->any.id;
+    acquire.possess.reqno = msg->any.reqno;
+
+    call = resmsg_dbus_compose_message(FUZZ_DEST, FUZZ_PATH, FUZZ_INTERFACE,
+                                       "acquire", &acquire);
+    if (call == NULL)
+        return NULL;
+
+    dbus_message_set_serial(call, msg->any.reqno);
+
+    if ((reply = resmsg_dbus_reply_message(call, msg)) != NULL)
+        dbus_message_set_serial(reply, msg->any.reqno + 1);
+
+    dbus_message_unref(call);
+
+    return reply;
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,33 @@
+#!/bin/sh
+#
+# Runs the fuzz targets once over their seed corpus, so that the
+# harnesses and the codecs they cover stay in working order. Real
+# fuzzing is done by running the targets under libFuzzer or AFL.
+#
+
+corpus=${1:-fuzz-corpus}
+
+rm -rf "$corpus"
+
+./fuzz_seed "$corpus" || {
+    echo "failed to generate the seed corpus"
+    exit 1
+}
+
+failed=0
+
+for target in fuzz_dbus_msg:dbus fuzz_internal_msg:msg fuzz_dump_msg:msg; do
+    prog=${target%%:*}
+    dir=$corpus/${target##*:}
+
+    if ./$prog "$dir"/*; then
+        echo "$prog: OK"
+    else
+        echo "$prog: FAILED"
+        failed=1
+    fi
+done
+
+rm -rf "$corpus"
+
+exit $failed
@@ -0,0 +1,345 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * In-process benchmark of the protocol stack. A manager and a client
+ * talk to each other over the internal transport driven by the timer
+ * loop of test-loop.c, so neither a bus nor a main loop library is
+ * involved.
+ * The manager is the reference manager of ref-manager.c granting
+ * everything.
+ * For every number of resource sets the sets are registered, acquired,
+ * released and unregistered, each phase sending all requests before
+ * dispatching anything. Phases are repeated until every operation was
+ * done at least BENCH_MIN_OPS times. The results are printed as JSON.
+ *
+ *   internal-bench [sets ...]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <res-conn.h>
+#include <res-hist.h>
+
+#include "ref-manager.h"
+#include "test-loop.h"
+
+#define BENCH_MIN_OPS   10000
+#define BENCH_CLIENT    "bench"
+
+typedef enum {
+    OP_REGISTER = 0,
+    OP_ACQUIRE,
+    OP_GRANT,                   /* acquire until the grant arrives */
+    OP_RELEASE,
+    OP_UNREGISTER,
+    OP_MAX
+} op_t;
+
+typedef struct {
+    uint32_t           count;
+    uint32_t           failed;
+    uint64_t           elapsed;
+    reshist_t          hist;
+} opstat_t;
+
+typedef struct {
+    resset_t          *rset;
+    uint64_t           sent;
+} bset_t;
+
+static void       manager_up(resconn_t *);
+static void       client_handler(resmsg_t *, resset_t *, void *);
+static void       status_cb(resset_t *, resmsg_t *);
+
+static void       run_phase(op_t, int);
+static void       run_scale(int, int);
+static void       print_results(int, int, int);
+
+static const char *op_names[OP_MAX] = {
+    [OP_REGISTER  ] = "register",
+    [OP_ACQUIRE   ] = "acquire",
+    [OP_GRANT     ] = "grant",
+    [OP_RELEASE   ] = "release",
+    [OP_UNREGISTER] = "unregister",
+};
+
+static resconn_t  *manager;
+static resconn_t  *client;
+static bset_t     *sets;
+static int         pending;     /* replies and grants still to come */
+static uint32_t    reqno;
+static op_t        phase;
+static opstat_t    stats[OP_MAX];
+
+
+int main(int argc, char **argv)
+{
+    static int defsizes[] = { 1, 100, 1000, 10000 };
+
+    refmgr_conf_t  refmgr;
+    int            nsize;
+    int            size;
+    int            rounds;
+    int            i;
+
+    nsize = argc > 1 ? argc - 1 : (int)(sizeof(defsizes) / sizeof(int));
+
+    manager = resproto_init(RESPROTO_ROLE_MANAGER,
+                            RESPROTO_TRANSPORT_INTERNAL,
+                            testloop_timer_add, testloop_timer_del);
+    client  = resproto_init(RESPROTO_ROLE_CLIENT,
+                            RESPROTO_TRANSPORT_INTERNAL,
+                            manager_up, BENCH_CLIENT,
+                            testloop_timer_add, testloop_timer_del);
+
+    if (!manager || !client) {
+        fprintf(stderr, "can't initiate the internal transport\n");
+        return 1;
+    }
+
+    memset(&refmgr, 0, sizeof(refmgr));
+    refmgr.policy    = REFMGR_POLICY_ALWAYS;
+    refmgr.timer_add = testloop_timer_add;
+    refmgr.timer_del = testloop_timer_del;
+
+    if (!refmgr_init(manager, &refmgr)) {
+        fprintf(stderr, "can't set up the manager\n");
+        return 1;
+    }
+
+    resproto_set_handler(client, RESMSG_UNREGISTER, client_handler);
+    resproto_set_handler(client, RESMSG_GRANT     , client_handler);
+    resproto_set_handler(client, RESMSG_ADVICE    , client_handler);
+    resproto_set_handler(client, RESMSG_RELEASE   , client_handler);
+
+    testloop_run(&pending);     /* let the client know about the manager */
+
+    printf("{\"benchmark\":\"internal\",\"results\":[");
+
+    for (i = 0;  i < nsize;  i++) {
+        size = argc > 1 ? atoi(argv[i+1]) : defsizes[i];
+
+        if (size < 1) {
+            fprintf(stderr, "invalid number of sets '%s'\n", argv[i+1]);
+            return 1;
+        }
+
+        rounds = (BENCH_MIN_OPS + size - 1) / size;
+
+        run_scale(size, rounds);
+        print_results(size, rounds, i == 0);
+    }
+
+    printf("]}\n");
+
+    resproto_destroy(client);
+    resproto_destroy(manager);
+
+    for (i = 0;  i < OP_MAX;  i++) {
+        if (stats[i].failed)
+            return 1;
+    }
+
+    return 0;
+}
+
+
+static void manager_up(resconn_t *rc)
+{
+    (void)rc;
+}
+
+static void client_handler(resmsg_t *msg, resset_t *rset, void *data)
+{
+    bset_t   *set = sets + (rset->id - 1);
+    opstat_t *st  = stats + OP_GRANT;
+
+    (void)data;
+
+    if (msg->type != RESMSG_GRANT)
+        return;
+
+    if (phase == OP_ACQUIRE) {
+        if (!msg->notify.resrc)
+            st->failed++;
+        else {
+            st->count++;
+            reshist_add(&st->hist, testloop_now() - set->sent);
+        }
+    }
+
+    pending--;
+}
+
+static void status_cb(resset_t *rset, resmsg_t *msg)
+{
+    bset_t   *set = sets + (rset->id - 1);
+    opstat_t *st  = stats + phase;
+
+    if (msg->status.errcod)
+        st->failed++;
+    else {
+        st->count++;
+        reshist_add(&st->hist, testloop_now() - set->sent);
+    }
+
+    pending--;
+}
+
+
+static void run_phase(op_t op, int size)
+{
+    resmsg_t  msg;
+    bset_t   *set;
+    uint64_t  start;
+    int       success;
+    int       i;
+
+    phase = op;
+    start = testloop_now();
+
+    for (i = 0;  i < size;  i++) {
+        set = sets + i;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.any.id    = i + 1;
+        msg.any.reqno = ++reqno;
+
+        set->sent = testloop_now();
+
+        switch (op) {
+
+        case OP_REGISTER:
+            msg.record.type     = RESMSG_REGISTER;
+            msg.record.rset.all = RESMSG_AUDIO_PLAYBACK;
+            msg.record.app_id   = "bench";
+            msg.record.klass    = "player";
+
+            set->rset = resconn_connect(client, &msg, status_cb);
+            success   = (set->rset != NULL);
+            break;
+
+        case OP_UNREGISTER:
+            msg.possess.type = RESMSG_UNREGISTER;
+            success = resconn_disconnect(set->rset, &msg, status_cb);
+            break;
+
+        case OP_ACQUIRE:
+            msg.possess.type = RESMSG_ACQUIRE;
+            success = resproto_send_message(set->rset, &msg, status_cb);
+            pending += success;     /* the grant */
+            break;
+
+        case OP_RELEASE:
+            msg.possess.type = RESMSG_RELEASE;
+            success = resproto_send_message(set->rset, &msg, status_cb);
+            pending += success;     /* the grant */
+            break;
+
+        default:
+            success = FALSE;
+            break;
+        }
+
+        if (success)
+            pending++;
+        else
+            stats[op].failed++;
+    }
+
+    testloop_run(&pending);
+
+    stats[op].elapsed += testloop_now() - start;
+
+    if (op == OP_ACQUIRE)
+        stats[OP_GRANT].elapsed += testloop_now() - start;
+
+    if (pending) {
+        fprintf(stderr, "%d replies missing after %s\n", pending,
+                op_names[op]);
+        pending = 0;
+    }
+}
+
+static void run_scale(int size, int rounds)
+{
+    int i;
+
+    for (i = 0;  i < OP_MAX;  i++) {
+        memset(stats + i, 0, sizeof(opstat_t));
+        reshist_reset(&stats[i].hist);
+    }
+
+    if ((sets = calloc(size, sizeof(bset_t))) == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    for (i = 0;  i < rounds;  i++) {
+        run_phase(OP_REGISTER  , size);
+        run_phase(OP_ACQUIRE   , size);
+        run_phase(OP_RELEASE   , size);
+        run_phase(OP_UNREGISTER, size);
+    }
+
+    free(sets);
+    sets = NULL;
+}
+
+#define USEC(h, p)  ((double)reshist_percentile(h, p) / 1000.0)
+
+static void print_results(int size, int rounds, int first)
+{
+    opstat_t *st;
+    double    secs;
+    int       i;
+
+    for (i = 0;  i < OP_MAX;  i++) {
+        st   = stats + i;
+        secs = (double)st->elapsed / 1000000000.0;
+
+        printf("%s\n {\"sets\":%d,\"rounds\":%d,\"operation\":\"%s\","
+               "\"count\":%u,\"failed\":%u,\"seconds\":%.6f,"
+               "\"ops_per_sec\":%.1f,\"p50_usec\":%.2f,\"p90_usec\":%.2f,"
+               "\"p99_usec\":%.2f,\"max_usec\":%.2f}",
+               first && !i ? "" : ",", size, rounds, op_names[i],
+               st->count, st->failed, secs,
+               secs > 0.0 ? st->count / secs : 0.0,
+               USEC(&st->hist, 50.0), USEC(&st->hist, 90.0),
+               USEC(&st->hist, 99.0), st->hist.max / 1000.0);
+    }
+
+    fflush(stdout);
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
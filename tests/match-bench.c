@@ -0,0 +1,321 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Benchmark of matching new audio streams against the properties of
+ * all the resource sets. For every number of sets the sets get a mix
+ * of equals, startswith and matches properties, and streams are matched
+ * for at least BENCH_MIN_NSEC both with a compiled res-match matcher
+ * and by interpreting the patterns of every set for every stream. The
+ * time per stream is printed as JSON.
+ *
+ *   match-bench [sets ...]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <regex.h>
+
+#include <res-match.h>
+
+#define BENCH_MIN_NSEC  200000000ULL
+#define BENCH_APPS      50
+#define BENCH_ROLES     8
+#define BENCH_STRLEN    32
+
+typedef enum {
+    MATCH_COMPILED = 0,
+    MATCH_INTERPRETED,
+    MATCH_MAX
+} match_t;
+
+typedef struct {
+    resmsg_audio_t     audio;
+    resmsg_property_t  extra;
+    char               name[BENCH_STRLEN];
+    char               app[BENCH_STRLEN];
+} bset_t;
+
+static uint64_t    now(void);
+static void        setup(bset_t *, int);
+static void        make_stream(resmatch_prop_t *, int, int);
+static uint64_t    run(match_t, resmatch_t *, bset_t *, int,
+                       uint32_t *, uint32_t *);
+static uint32_t    interpret(bset_t *, int, resmatch_prop_t *, int);
+static int         match_property(resmsg_property_t *, resmatch_prop_t *,
+                                  int);
+
+static const char *match_names[MATCH_MAX] = {
+    [MATCH_COMPILED   ] = "compiled",
+    [MATCH_INTERPRETED] = "interpreted",
+};
+
+static char        roles[BENCH_ROLES][BENCH_STRLEN];
+static char        stream_name[BENCH_STRLEN];
+static char        stream_app[BENCH_STRLEN];
+
+
+int main(int argc, char **argv)
+{
+    static int defsizes[] = { 100, 1000, 10000 };
+
+    resmatch_t *rm;
+    bset_t     *sets;
+    uint64_t    elapsed;
+    uint32_t    streams;
+    uint32_t    found;
+    match_t     m;
+    int         nsize;
+    int         size;
+    int         i, j;
+
+    nsize = argc > 1 ? argc - 1 : (int)(sizeof(defsizes) / sizeof(int));
+
+    for (i = 0;  i < BENCH_ROLES;  i++)
+        snprintf(roles[i], BENCH_STRLEN, "^(music|video|game%d)$", i);
+
+    printf("{\"benchmark\":\"match\",\"results\":[");
+
+    for (i = 0;  i < nsize;  i++) {
+        size = argc > 1 ? atoi(argv[i+1]) : defsizes[i];
+
+        if (size < 1) {
+            fprintf(stderr, "invalid number of sets '%s'\n", argv[i+1]);
+            return 1;
+        }
+
+        if ((sets = calloc(size, sizeof(bset_t))) == NULL ||
+            (rm = resmatch_create()) == NULL)
+        {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+
+        for (j = 0;  j < size;  j++) {
+            setup(sets + j, j);
+
+            if (!resmatch_add(rm, &sets[j].audio, sets + j)) {
+                fprintf(stderr, "failed to compile set %d\n", j);
+                return 1;
+            }
+        }
+
+        for (m = 0;  m < MATCH_MAX;  m++) {
+            elapsed = run(m, rm, sets, size, &streams, &found);
+
+            printf("%s\n {\"sets\":%d,\"method\":\"%s\",\"streams\":%u,"
+                   "\"matches_per_stream\":%.2f,\"ns_per_stream\":%.1f}",
+                   i || m ? "," : "", size, match_names[m], streams,
+                   (double)found / streams, (double)elapsed / streams);
+        }
+
+        resmatch_destroy(rm);
+        free(sets);
+    }
+
+    printf("]}\n");
+
+    return 0;
+}
+
+
+static uint64_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Six sets out of ten want a stream name and an application, three a
+ * stream name prefix and one a stream name and a media role pattern.
+ */
+static void setup(bset_t *set, int idx)
+{
+    resmsg_property_t *prop  = &set->audio.property;
+    resmsg_property_t *extra = &set->extra;
+
+    snprintf(set->app, BENCH_STRLEN, "app%d", idx % BENCH_APPS);
+
+    switch (idx % 10) {
+
+    case 0: case 1: case 2: case 3: case 4: case 5:
+        snprintf(set->name, BENCH_STRLEN, "stream%d", idx);
+        prop->match.method   = resmsg_method_equals;
+        extra->name          = "application.name";
+        extra->match.method  = resmsg_method_equals;
+        extra->match.pattern = set->app;
+        break;
+
+    case 6: case 7: case 8:
+        snprintf(set->name, BENCH_STRLEN, "stream%d/", idx);
+        prop->match.method   = resmsg_method_startswith;
+        break;
+
+    default:
+        snprintf(set->name, BENCH_STRLEN, "stream%d", idx);
+        prop->match.method   = resmsg_method_equals;
+        extra->name          = "media.role";
+        extra->match.method  = resmsg_method_matches;
+        extra->match.pattern = roles[idx % BENCH_ROLES];
+        break;
+    }
+
+    prop->name          = "media.name";
+    prop->match.pattern = set->name;
+
+    set->audio.type   = RESMSG_AUDIO;
+    set->audio.nextra = extra->name ? 1 : 0;
+    set->audio.extra  = extra->name ? extra : NULL;
+}
+
+/* a stream for one of the sets, every other one for no set at all */
+static void make_stream(resmatch_prop_t *props, int idx, int size)
+{
+    int set = (idx / 2) % size;
+
+    if (idx & 1)
+        snprintf(stream_name, BENCH_STRLEN, "other%d", set);
+    else if (set % 10 >= 6 && set % 10 <= 8)
+        snprintf(stream_name, BENCH_STRLEN, "stream%d/%d", set, idx);
+    else
+        snprintf(stream_name, BENCH_STRLEN, "stream%d", set);
+
+    snprintf(stream_app, BENCH_STRLEN, "app%d", set % BENCH_APPS);
+
+    props[0].name  = "media.name";
+    props[0].value = stream_name;
+    props[1].name  = "application.name";
+    props[1].value = stream_app;
+    props[2].name  = "media.role";
+    props[2].value = "music";
+}
+
+static uint64_t run(match_t     m,
+                    resmatch_t *rm,
+                    bset_t     *sets,
+                    int         size,
+                    uint32_t   *streams,
+                    uint32_t   *found)
+{
+    resmatch_prop_t props[3];
+    uint64_t        start;
+    uint64_t        elapsed;
+
+    *streams = 0;
+    *found   = 0;
+    start    = now();
+
+    do {
+        make_stream(props, *streams, size);
+
+        if (m == MATCH_COMPILED)
+            *found += resmatch_stream(rm, props, 3, NULL, NULL);
+        else
+            *found += interpret(sets, size, props, 3);
+
+        (*streams)++;
+        elapsed = now() - start;
+    } while (elapsed < BENCH_MIN_NSEC);
+
+    return elapsed;
+}
+
+/* what a manager does without a matcher */
+static uint32_t interpret(bset_t          *sets,
+                          int              size,
+                          resmatch_prop_t *props,
+                          int              nprop)
+{
+    resmsg_audio_t *audio;
+    uint32_t        found = 0;
+    uint32_t        i;
+    int             j;
+
+    for (j = 0;  j < size;  j++) {
+        audio = &sets[j].audio;
+
+        if (!match_property(&audio->property, props, nprop))
+            continue;
+
+        for (i = 0;  i < audio->nextra;  i++) {
+            if (!match_property(audio->extra + i, props, nprop))
+                break;
+        }
+
+        if (i == audio->nextra)
+            found++;
+    }
+
+    return found;
+}
+
+static int match_property(resmsg_property_t *prop,
+                          resmatch_prop_t   *props,
+                          int                nprop)
+{
+    const char *pattern = prop->match.pattern;
+    regex_t     regex;
+    int         match;
+    int         i;
+
+    for (i = 0;  i < nprop;  i++) {
+        if (!strcmp(prop->name, props[i].name))
+            break;
+    }
+
+    if (i == nprop)
+        return 0;
+
+    switch (prop->match.method) {
+
+    case resmsg_method_equals:
+        return !strcmp(props[i].value, pattern);
+
+    case resmsg_method_startswith:
+        return !strncmp(props[i].value, pattern, strlen(pattern));
+
+    case resmsg_method_matches:
+        if (regcomp(&regex, pattern, REG_EXTENDED | REG_NOSUB))
+            return 0;
+        match = !regexec(&regex, props[i].value, 0, NULL, 0);
+        regfree(&regex);
+        return match;
+
+    default:
+        return 0;
+    }
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
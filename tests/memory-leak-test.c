@@ -14,7 +14,7 @@ static int iterations;
 static gboolean destructor (void *data);
 
 static void grant_callback (resource_set_t *resource_set,
-                            uint32_t        resources,
+                            uint64_t        resources,
                             void           *userdata)
 {
     char buf[512];
@@ -43,7 +43,7 @@ static void grant_callback (resource_set_t *resource_set,
 }
 
 static void advice_callback (resource_set_t *resource_set,
-                             uint32_t        resources,
+                             uint64_t        resources,
                              void           *userdata)
 {
     char buf[512];
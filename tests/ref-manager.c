@@ -0,0 +1,344 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * A reference resource manager for load tests. The policy is kept as
+ * simple as possible so that the cost measured is that of libresource
+ * and the transport. Status replies are sent right away; grants can be
+ * delayed by a configurable latency.
+ *
+ * Exclusive policy: an acquire is granted if none of the mandatory
+ * resources is owned by another set, together with the free optional
+ * ones. Otherwise it is denied. Denied sets are not queued, they are
+ * expected to retry.
+ *
+ * The audio stream properties of the sets are compiled into a matcher,
+ * as a real manager would do, so that bad patterns are refused.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <res-match.h>
+
+#include "ref-manager.h"
+
+#define MAX_RESOURCES  RESOURCE_MASK_BITS
+
+typedef struct {
+    resset_t         *rset;
+    uint64_t          owned;    /* resource bits in exclusive use */
+    uint64_t          grant;    /* delayed grant */
+    uint32_t          reqno;
+    void             *timer;
+    resmatch_rule_t  *streams;  /* audio stream properties */
+} refset_t;
+
+static void      request_handler(resmsg_t *, resset_t *, void *);
+static refset_t *create_set(resset_t *);
+static void      destroy_set(resset_t *);
+static uint64_t  decide(refset_t *, resmsg_type_t);
+static void      release_owned(refset_t *);
+static void      send_grant(refset_t *, uint64_t, uint32_t);
+static int       grant_cb(void *);
+
+static const char *policy_names[] = {
+    [REFMGR_POLICY_ALWAYS   ] = "always",
+    [REFMGR_POLICY_EXCLUSIVE] = "exclusive",
+    [REFMGR_POLICY_RANDOM   ] = "random",
+};
+
+static refmgr_conf_t   conf;
+static refmgr_stats_t  stats;
+static refset_t       *owner[MAX_RESOURCES];
+static resmatch_t     *matcher;
+
+
+int refmgr_init(resconn_t *rcon, refmgr_conf_t *cfg)
+{
+    resmsg_type_t type;
+
+    if (!rcon || !cfg || (cfg->latency && !cfg->timer_add))
+        return FALSE;
+
+    if (cfg->coalesce && !resconn_set_coalescing(rcon, TRUE, cfg->window,
+                                                 cfg->timer_add,
+                                                 cfg->timer_del))
+        return FALSE;
+
+    conf = *cfg;
+
+    memset(&stats, 0, sizeof(stats));
+    memset(owner, 0, sizeof(owner));
+
+    if (matcher == NULL && (matcher = resmatch_create()) == NULL)
+        return FALSE;
+
+    for (type = RESMSG_REGISTER;  type <= RESMSG_VIDEO;  type++) {
+        if (type == RESMSG_GRANT || type == RESMSG_ADVICE)
+            continue;
+
+        if (!resproto_set_handler(rcon, type, request_handler))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+int refmgr_parse_policy(const char *str, refmgr_policy_t *policy)
+{
+    int i;
+
+    for (i = 0;  i < (int)(sizeof(policy_names)/sizeof(char *));  i++) {
+        if (!strcmp(str, policy_names[i])) {
+            *policy = i;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+void refmgr_get_stats(refmgr_stats_t *st)
+{
+    *st = stats;
+}
+
+
+static void request_handler(resmsg_t *msg, resset_t *rset, void *protodata)
+{
+    refset_t        *set = rset->userdata;
+    resmatch_rule_t *streams;
+    uint64_t         grant;
+    char             all[24];
+    char             opt[24];
+
+    if (conf.verbose) {
+        printf("%s %s/%u reqno %u", resmsg_type_str(msg->type),
+               rset->peer, rset->id, msg->any.reqno);
+
+        if (msg->type == RESMSG_REGISTER || msg->type == RESMSG_UPDATE) {
+            printf(" all %s opt %s",
+                   resmsg_res_hex(msg->record.rset.all, all, sizeof(all)),
+                   resmsg_res_hex(msg->record.rset.opt, opt, sizeof(opt)));
+        }
+
+        if (msg->type == RESMSG_AUDIO)
+            printf(" properties %u", 1 + msg->audio.nextra);
+
+        printf("\n");
+    }
+
+    stats.requests++;
+
+    switch (msg->type) {
+
+    case RESMSG_REGISTER:
+        if (set == NULL && (set = create_set(rset)) == NULL) {
+            resproto_reply_message(rset, msg, protodata, ENOMEM,
+                                   "out of memory");
+            return;
+        }
+        break;
+
+    case RESMSG_UNREGISTER:
+        /* protodata is NULL if the client went away */
+        resproto_reply_message(rset, msg, protodata, 0, "OK");
+        destroy_set(rset);
+        return;
+
+    case RESMSG_UPDATE:
+        if (set != NULL) {
+            rset->flags.all   = msg->record.rset.all;
+            rset->flags.opt   = msg->record.rset.opt;
+            rset->flags.share = msg->record.rset.share;
+            rset->flags.mask  = msg->record.rset.mask;
+        }
+        break;
+
+    case RESMSG_AUDIO:
+        if (set != NULL) {
+            if ((streams = resmatch_add(matcher, &msg->audio, set)) == NULL) {
+                resproto_reply_message(rset, msg, protodata, errno,
+                                       "invalid audio property");
+                return;
+            }
+
+            resmatch_remove(matcher, set->streams);
+            set->streams = streams;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    resproto_reply_message(rset, msg, protodata, 0, "OK");
+
+    if (set != NULL &&
+        (msg->type == RESMSG_ACQUIRE || msg->type == RESMSG_RELEASE))
+    {
+        grant = decide(set, msg->type);
+
+        if (msg->type == RESMSG_ACQUIRE) {
+            if (grant)
+                stats.granted++;
+            else
+                stats.denied++;
+        }
+
+        send_grant(set, grant, msg->any.reqno);
+    }
+}
+
+static refset_t *create_set(resset_t *rset)
+{
+    refset_t *set;
+
+    if ((set = calloc(1, sizeof(refset_t))) != NULL) {
+        set->rset = rset;
+        rset->userdata = set;
+        stats.sets++;
+    }
+
+    return set;
+}
+
+static void destroy_set(resset_t *rset)
+{
+    refset_t *set = rset->userdata;
+
+    if (set != NULL) {
+        if (set->timer != NULL)
+            conf.timer_del(set->timer);
+
+        release_owned(set);
+        resmatch_remove(matcher, set->streams);
+
+        rset->userdata = NULL;
+        stats.sets--;
+
+        free(set);
+    }
+}
+
+static uint64_t decide(refset_t *set, resmsg_type_t type)
+{
+    resset_t *rset = set->rset;
+    uint64_t  want;
+    uint64_t  busy;
+    int       i;
+
+    if (type == RESMSG_RELEASE) {
+        release_owned(set);
+        return 0;
+    }
+
+    switch (conf.policy) {
+
+    case REFMGR_POLICY_EXCLUSIVE:
+        want = rset->flags.all;
+
+        for (i = 0, busy = 0;  i < MAX_RESOURCES;  i++) {
+            if ((want & RESOURCE_BIT(i)) && owner[i] && owner[i] != set)
+                busy |= RESOURCE_BIT(i);
+        }
+
+        if (busy & (rset->flags.all & ~rset->flags.opt))
+            return 0;
+
+        set->owned |= want & ~busy;
+
+        for (i = 0;  i < MAX_RESOURCES;  i++) {
+            if (set->owned & RESOURCE_BIT(i))
+                owner[i] = set;
+        }
+
+        return set->owned;
+
+    case REFMGR_POLICY_RANDOM:
+        if ((uint32_t)(rand_r(&conf.seed) % 100) < conf.deny)
+            return 0;
+        return rset->flags.all;
+
+    default:
+        return rset->flags.all;
+    }
+}
+
+static void release_owned(refset_t *set)
+{
+    int i;
+
+    for (i = 0;  set->owned && i < MAX_RESOURCES;  i++) {
+        if (owner[i] == set)
+            owner[i] = NULL;
+    }
+
+    set->owned = 0;
+}
+
+static void send_grant(refset_t *set, uint64_t grant, uint32_t reqno)
+{
+    set->grant = grant;
+    set->reqno = reqno;
+
+    if (conf.latency) {
+        /* a newer decision supersedes the pending one */
+        if (set->timer != NULL)
+            conf.timer_del(set->timer);
+
+        if ((set->timer = conf.timer_add(conf.latency, grant_cb, set)))
+            return;
+    }
+
+    grant_cb(set);
+}
+
+static int grant_cb(void *data)
+{
+    refset_t *set = data;
+    resmsg_t  msg;
+
+    set->timer = NULL;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.notify.type  = RESMSG_GRANT;
+    msg.notify.id    = set->rset->id;
+    msg.notify.reqno = set->reqno;
+    msg.notify.resrc = set->grant;
+
+    resproto_send_message(set->rset, &msg, NULL);
+
+    return FALSE;
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
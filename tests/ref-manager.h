@@ -0,0 +1,68 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __RESOURCE_TESTS_REF_MANAGER_H__
+#define __RESOURCE_TESTS_REF_MANAGER_H__
+
+#include <stdint.h>
+
+#include <res-conn.h>
+
+typedef enum {
+    REFMGR_POLICY_ALWAYS = 0,   /* grant whatever is acquired */
+    REFMGR_POLICY_EXCLUSIVE,    /* a resource bit has at most one owner */
+    REFMGR_POLICY_RANDOM,       /* grant or deny at random */
+} refmgr_policy_t;
+
+typedef struct {
+    refmgr_policy_t      policy;
+    uint32_t             latency;   /* grant delay in msec */
+    uint32_t             deny;      /* deny percentage for the random policy */
+    unsigned int         seed;
+    int                  verbose;
+    int                  coalesce;  /* coalesce grants, see res-conn.h */
+    uint32_t             window;    /* coalescing window in msec */
+    resconn_timer_add_t  timer_add;
+    resconn_timer_del_t  timer_del;
+} refmgr_conf_t;
+
+typedef struct {
+    uint32_t             sets;      /* currently registered */
+    uint32_t             requests;
+    uint32_t             granted;
+    uint32_t             denied;
+} refmgr_stats_t;
+
+int  refmgr_init(resconn_t *, refmgr_conf_t *);
+int  refmgr_parse_policy(const char *, refmgr_policy_t *);
+void refmgr_get_stats(refmgr_stats_t *);
+
+#endif /* __RESOURCE_TESTS_REF_MANAGER_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,279 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Reference resource manager for load tests, a C replacement of
+ * tests/dbus/dummy-policy-manager.py. It claims the manager name on
+ * the given bus and applies one of the trivial policies implemented
+ * in ref-manager.c.
+ */
+
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+
+#include <glib.h>
+#include <dbus/dbus.h>
+#include <dbus-gmain/dbus-gmain.h>
+
+#include <res-conn.h>
+
+#include "ref-manager.h"
+
+typedef struct {
+    DBusBusType     bustype;
+    int             verbose;
+    int             stats;
+    refmgr_conf_t   refmgr;
+} conf_t;
+
+static void         install_signal_handlers(void);
+static void         signal_handler(int);
+static void        *timer_add(uint32_t, resconn_timercb_t, void *);
+static void         timer_del(void *);
+
+static void         print_error(char *, ...);
+static void         print_message(char *, ...);
+static void         usage(int);
+static void         parse_options(int, char **);
+static uint32_t     parse_number(char *, uint32_t);
+static DBusBusType  parse_bustype(char *);
+
+static char            *exe_name = "";
+static conf_t           config;
+static GMainLoop       *main_loop;
+
+
+int main(int argc, char **argv)
+{
+    DBusConnection *dcon;
+    DBusError       err;
+    resconn_t      *rcon;
+    refmgr_stats_t  st;
+
+    parse_options(argc, argv);
+
+    if ((main_loop = g_main_loop_new(NULL, FALSE)) == NULL)
+        print_error("Can't create G-MainLoop");
+
+    install_signal_handlers();
+
+    dbus_error_init(&err);
+
+    if ((dcon = dbus_bus_get(config.bustype, &err)) == NULL) {
+        print_error("Can't get D-Bus: %s",
+                    dbus_error_is_set(&err) ? err.message : "unknown error");
+    }
+
+    dbus_gmain_set_up_connection(dcon, NULL);
+
+    rcon = resproto_init(RESPROTO_ROLE_MANAGER, RESPROTO_TRANSPORT_DBUS, dcon);
+
+    if (rcon == NULL)
+        print_error("Can't initiate resproto");
+
+    if (config.stats)
+        resproto_export_stats(rcon, TRUE);
+
+    config.refmgr.verbose   = config.verbose;
+    config.refmgr.timer_add = timer_add;
+    config.refmgr.timer_del = timer_del;
+
+    if (!refmgr_init(rcon, &config.refmgr))
+        print_error("Can't set up the manager");
+
+    print_message("running");
+
+    g_main_loop_run(main_loop);
+
+    refmgr_get_stats(&st);
+
+    printf("%u requests, %u granted, %u denied, %u sets left\n",
+           st.requests, st.granted, st.denied, st.sets);
+
+    resproto_destroy(rcon);
+    dbus_connection_unref(dcon);
+    g_main_loop_unref(main_loop);
+
+    return 0;
+}
+
+
+static void install_signal_handlers(void)
+{
+    signal(SIGHUP , signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGINT , signal_handler);
+}
+
+static void signal_handler(int signo)
+{
+    (void)signo;
+
+    g_main_loop_quit(main_loop);
+}
+
+static void *timer_add(uint32_t delay, resconn_timercb_t cb, void *data)
+{
+    return GUINT_TO_POINTER(g_timeout_add(delay, cb, data));
+}
+
+static void timer_del(void *timer)
+{
+    g_source_remove(GPOINTER_TO_UINT(timer));
+}
+
+
+static void print_error(char *fmt, ...)
+{
+    va_list  ap;
+    char     fmtbuf[512];
+
+    snprintf(fmtbuf, sizeof(fmtbuf), "%s: %s\n", exe_name, fmt);
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmtbuf, ap);
+    va_end(ap);
+
+    exit(errno ? errno : EINVAL);
+}
+
+static void print_message(char *fmt, ...)
+{
+    va_list  ap;
+    char     fmtbuf[512];
+
+    if (!config.verbose)
+        return;
+
+    snprintf(fmtbuf, sizeof(fmtbuf), "%s: %s\n", exe_name, fmt);
+
+    va_start(ap, fmt);
+    vprintf(fmtbuf, ap);
+    va_end(ap);
+}
+
+static void usage(int exit_code)
+{
+    printf("usage: %s [-h] [-v] [-S] [-d bus-type] [-p policy] "
+           "[-l latency] [-r deny-percent] [-s seed] [-c window]\n", exe_name);
+    printf("\toptions:\n");
+    printf("\t  h\tprint this help message and exit\n");
+    printf("\t  v\tprint every request\n");
+    printf("\t  S\toffer statistics on the org.maemo.resource.stats "
+           "interface\n");
+    printf("\t  d\tbus-type. Either 'system' or 'session'\n");
+    printf("\t  p\tgrant policy. One of\n");
+    printf("\t\talways    - grant whatever is acquired (default)\n");
+    printf("\t\texclusive - a resource has at most one owner\n");
+    printf("\t\trandom    - deny the given percentage of acquires\n");
+    printf("\t  l\tdelay grants by this many milliseconds\n");
+    printf("\t  r\tdeny percentage of the random policy (default 10)\n");
+    printf("\t  s\tseed of the random policy\n");
+    printf("\t  c\tcoalesce grants; a later one of a set waits for the "
+           "ack of\n\t\tthe previous one and this many milliseconds\n");
+
+    exit(exit_code);
+}
+
+static void parse_options(int argc, char **argv)
+{
+    int option;
+
+    exe_name = strdup(basename(argv[0]));
+
+    config.bustype     = DBUS_BUS_SYSTEM;
+    config.refmgr.deny = 10;
+    config.refmgr.seed = time(NULL);
+
+    while ((option = getopt(argc, argv, "hvSd:p:l:r:s:c:")) != -1) {
+
+        switch (option) {
+
+        case 'h': usage(0);                                              break;
+        case 'v': config.verbose        = TRUE;                          break;
+        case 'S': config.stats          = TRUE;                          break;
+        case 'd': config.bustype        = parse_bustype(optarg);         break;
+        case 'l': config.refmgr.latency = parse_number(optarg, 600000);  break;
+        case 'r': config.refmgr.deny    = parse_number(optarg, 100);     break;
+        case 's': config.refmgr.seed    = parse_number(optarg, ~0U);     break;
+        case 'c': config.refmgr.coalesce = TRUE;
+                  config.refmgr.window   = parse_number(optarg, 600000); break;
+        case 'p':
+            if (!refmgr_parse_policy(optarg, &config.refmgr.policy)) {
+                errno = EINVAL;
+                print_error("invalid policy '%s'", optarg);
+            }
+            break;
+        default:  usage(EINVAL);                                         break;
+
+        }
+    }
+
+    if (optind != argc)
+        usage(EINVAL);
+}
+
+static uint32_t parse_number(char *str, uint32_t max)
+{
+    char          *e;
+    unsigned long  n;
+
+    n = strtoul(str, &e, 10);
+
+    if (e == str || *e || n > max) {
+        errno = EINVAL;
+        print_error("invalid number '%s'", str);
+    }
+
+    return (uint32_t)n;
+}
+
+static DBusBusType parse_bustype(char *bustype_str)
+{
+    DBusBusType bustype = DBUS_BUS_SYSTEM;
+
+    if (!strcmp(bustype_str, "session"))
+        bustype = DBUS_BUS_SESSION;
+    else if (strcmp(bustype_str, "system")) {
+        errno = EINVAL;
+        print_error("invalid D-Bus type '%s'", bustype_str);
+    }
+
+    return bustype;
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
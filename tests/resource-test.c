@@ -24,15 +24,21 @@ USA.
 #include <check.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <string.h>
 #include <res-conn.h>
+#include <res-registry.h>
+#include <res-match.h>
 
 #include "resource.h"
+#include "resource-glue.h"
 
 static void advice_callback (resource_set_t *resource_set,
-                             uint32_t        resources,
+                             uint64_t        resources,
                              void           *userdata);
 static void grant_callback (resource_set_t *resource_set,
-                            uint32_t        resources,
+                            uint64_t        resources,
                             void           *userdata);
 static void simulate_server_response();
 
@@ -92,9 +98,12 @@ START_TEST (test_resource_set_acquire_and_release)
 	rs = resource_set_create("player", RESOURCE_AUDIO_PLAYBACK, 0, 0, grant_callback, 0);
 	simulate_server_response();
 	advice();
+	fail_if( resource_set_is_acquiring(rs) );
 	resource_set_acquire(rs);
+	fail_unless( resource_set_is_acquiring(rs) );
 	simulate_server_response();
 	resource_set_release(rs);
+	fail_if( resource_set_is_acquiring(rs) );
 	simulate_server_response();
 	disconnect();
 	resource_set_destroy(rs);
@@ -135,6 +144,161 @@ START_TEST (test_resource_set_configure_audio)
 }
 END_TEST
 
+START_TEST (test_resource_set_configure_audio_property)
+{
+	resource_set_t *rs;
+	char name[16];
+	int  i;
+
+	// 1.1. should return false when passed not an audio resource
+	rs = resource_set_create("player", RESOURCE_VIDEO_PLAYBACK, 0, 0, grant_callback, 0);
+	fail_if( resource_set_configure_audio_property(rs, "media.role", resource_match_equals, "music") );
+	simulate_server_response();
+	resource_set_destroy(rs);
+	simulate_server_response();
+
+	// 2.1. properties are added, replaced and removed
+	rs = resource_set_create("player", RESOURCE_AUDIO_PLAYBACK, 0, 0, grant_callback, 0);
+	simulate_server_response();
+	fail_unless( resource_set_configure_audio_property(rs, "media.role", resource_match_equals, "music") );
+	fail_unless( resource_set_configure_audio_property(rs, "media.role", resource_match_startswith, "mus") );
+	fail_unless( resource_set_configure_audio_property(rs, "media.role", resource_match_equals, NULL) );
+	fail_unless( resource_set_configure_audio_property(rs, "media.role", resource_match_equals, NULL) );
+	fail_if( resource_set_configure_audio_property(rs, NULL, resource_match_equals, "music") );
+	fail_if( resource_set_configure_audio_property(rs, "media.role", (resource_match_method_t)(resource_match_matches + 1), "music") );
+	fail_if( resource_set_configure_audio_property(rs, "media.role", (resource_match_method_t)-1, "music") );
+	simulate_server_response();
+
+	// 2.2. up to 16 of them
+	for (i = 0;  i < 16;  i++) {
+		sprintf(name, "prop%d", i);
+		fail_unless( resource_set_configure_audio_property(rs, name, resource_match_matches, "^a") );
+	}
+	fail_if( resource_set_configure_audio_property(rs, "prop16", resource_match_matches, "^a") );
+	fail_unless( resource_set_configure_audio_property(rs, "prop3", resource_match_matches, NULL) );
+	fail_unless( resource_set_configure_audio_property(rs, "prop16", resource_match_matches, "^a") );
+	simulate_server_response();
+	resource_set_destroy(rs);
+	simulate_server_response();
+}
+END_TEST
+
+static void match_found(void *data, void *user_data)
+{
+	*(uint32_t *)user_data |= 1U << (intptr_t)data;
+}
+
+START_TEST (test_match)
+{
+	resmsg_property_t extra[] = {
+		{ "media.role", { resmsg_method_matches, "^(music|video)$" } },
+	};
+	resmsg_audio_t audio[] = {
+		{ .property = { "media.name", { resmsg_method_equals, "song" } } },
+		{ .property = { "media.name", { resmsg_method_startswith, "so" } } },
+		{ .property = { "media.name", { resmsg_method_startswith, "" } },
+		  .nextra = 1, .extra = extra },
+		{ .property = { "media.name", { resmsg_method_matches, "^(music|video)$" } } },
+	};
+	resmatch_prop_t song[]  = { { "media.name", "song" }, { "media.role", "music" } };
+	resmatch_prop_t sound[] = { { "media.name", "sound" }, { "media.role", "game" } };
+	resmatch_prop_t video[] = { { "media.name", "video" } };
+	resmatch_rule_t *rule[4];
+	resmatch_t *rm;
+	uint32_t    found;
+	int         i;
+
+	rm = resmatch_create();
+	fail_unless( rm != NULL );
+
+	for (i = 0;  i < 4;  i++)
+		fail_unless(( rule[i] = resmatch_add(rm, audio + i, (void *)(intptr_t)i) ) != NULL );
+
+	// 1.1. every property of a rule must match
+	found = 0;
+	fail_unless( resmatch_stream(rm, song, 2, match_found, &found) == 3 );
+	fail_unless( found == 0x7 );
+	found = 0;
+	fail_unless( resmatch_stream(rm, sound, 2, match_found, &found) == 1 );
+	fail_unless( found == 0x2 );
+	found = 0;
+	fail_unless( resmatch_stream(rm, video, 1, match_found, &found) == 1 );
+	fail_unless( found == 0x8 );
+
+	// 1.2. removed rules do not match
+	resmatch_remove(rm, rule[1]);
+	resmatch_remove(rm, rule[3]);
+	found = 0;
+	fail_unless( resmatch_stream(rm, song, 2, match_found, &found) == 2 );
+	fail_unless( found == 0x5 );
+	fail_unless( resmatch_stream(rm, video, 1, NULL, NULL) == 0 );
+
+	// 1.3. bad patterns are refused
+	audio[0].property.match.pattern = "(";
+	audio[0].property.match.method  = resmsg_method_matches;
+	fail_unless( resmatch_add(rm, audio, NULL) == NULL && errno == EINVAL );
+	audio[0].property.match.method  = 7;
+	fail_unless( resmatch_add(rm, audio, NULL) == NULL && errno == EINVAL );
+
+	resmatch_destroy(rm);
+}
+END_TEST
+
+START_TEST (test_registry_builtin)
+{
+	// 1.1. built-in names map to their bits and back
+	fail_unless( resreg_bit("AudioPlayback") == resource_audio_playback );
+	fail_unless( resreg_bit("LargeScreen") == resource_large_screen );
+	fail_unless( !strcmp(resreg_name(resource_rear_flashlight), "RearFlashlight") );
+
+	// 1.2. unknown names and bits have no mapping
+	fail_unless( resreg_bit("audioplayback") < 0 );
+	fail_unless( resreg_bit("") < 0 );
+	fail_unless( resreg_name(7) == NULL );
+	fail_unless( resreg_name(RESOURCE_MASK_BITS) == NULL );
+
+	// 1.3. a built-in name can be registered only at its own bit
+	fail_unless( resreg_register("Vibra", -1) == resource_vibra );
+	fail_unless( resreg_register("Vibra", 20) < 0 && errno == EEXIST );
+	fail_unless( resreg_register("Torch", resource_leds) < 0 && errno == EEXIST );
+}
+END_TEST
+
+START_TEST (test_registry_dynamic)
+{
+	char name[16];
+	int  bit;
+	int  i;
+
+	// 1.1. a new name gets the lowest free bit above the built-ins
+	fail_unless(( bit = resreg_register("Torch", -1) ) > resource_large_screen );
+	fail_unless( resreg_bit("Torch") == bit );
+	fail_unless( !strcmp(resreg_name(bit), "Torch") );
+	fail_unless( resreg_register("Torch", -1) == bit );
+
+	// 1.2. explicit bits
+	fail_unless( resreg_register("Camera", bit) < 0 && errno == EEXIST );
+	fail_unless( resreg_register("Camera", 40) == 40 );
+	fail_unless( resreg_register("Camera", 41) < 0 && errno == EEXIST );
+	fail_unless( resreg_bit("Camera") == 40 );
+
+	// 1.3. invalid arguments
+	fail_unless( resreg_register("Two,Names", -1) < 0 && errno == EINVAL );
+	fail_unless( resreg_register(NULL, -1) < 0 && errno == EINVAL );
+	fail_unless( resreg_register("Modem", RESOURCE_MASK_BITS) < 0 && errno == EINVAL );
+
+	// 1.4. the bits run out
+	for (i = 0;  ;  i++) {
+		sprintf(name, "Extra%d", i);
+		if (( bit = resreg_register(name, -1) ) < 0)
+			break;
+		fail_unless( resreg_bit(name) == bit );
+	}
+	fail_unless( errno == ENOSPC );
+	fail_unless( resreg_register("Extra0", -1) >= 0 );
+}
+END_TEST
+
 
 
 TCase *
@@ -150,6 +314,10 @@ libresource_case (int desired_step_id)
     PREPARE_TEST (tc_libresource, test_resource_set_configure_advice_callback);
     PREPARE_TEST (tc_libresource, test_resource_set_acquire_and_release);
     PREPARE_TEST (tc_libresource, test_resource_set_configure_audio);
+    PREPARE_TEST (tc_libresource, test_resource_set_configure_audio_property);
+    PREPARE_TEST (tc_libresource, test_registry_builtin);
+    PREPARE_TEST (tc_libresource, test_registry_dynamic);
+    PREPARE_TEST (tc_libresource, test_match);
 
     return tc_libresource;
 }
@@ -175,7 +343,7 @@ main(int argc, char* argv[]) {
 
 
 static void grant_callback (resource_set_t *resource_set,
-                            uint32_t        resources,
+                            uint64_t        resources,
                             void           *userdata)
 {
     char buf[512];
@@ -188,7 +356,7 @@ static void grant_callback (resource_set_t *resource_set,
 }
 
 static void advice_callback (resource_set_t *resource_set,
-                             uint32_t        resources,
+                             uint64_t        resources,
                              void           *userdata)
 {
     char buf[512];
@@ -237,7 +405,7 @@ typedef struct request_s {
 
 #define RESOURCE_CONFIG_COMMON     \
     union resource_config_u *next; \
-    uint32_t                 mask
+    uint64_t                 mask
 
 typedef struct {
     RESOURCE_CONFIG_COMMON;
@@ -263,6 +431,7 @@ typedef struct {
 
 struct resource_set_s {
     struct resource_set_s   *next;
+    resource_context_t      *ctx;        /* context of the resource set */
     DBusConnection          *dbus;       /* D-Bus connection */
     char                    *app_id;     /* application id */
     char                    *klass;      /* resource class */
@@ -270,16 +439,20 @@ struct resource_set_s {
     uint32_t                 mode;
     resconn_t               *resconn;
     struct {
-        uint32_t all;
-        uint32_t opt;
+        uint64_t all;
+        uint64_t opt;
     }                        resources;  /* libresource resources */
     client_state_t           client;     /* resource client state */
     int                      acquire;
+    int                      acquiring;
+    int                      calls;
     callback_t               grantcb;
     callback_t               advicecb;
     resource_config_t       *configs;
     resset_t                *resset;
     request_t               *reqlist;
+    request_t               *reqtail;    /* last request of reqlist */
+    uint64_t                 acqstamp;   /* when acquire was sent, if any */
 };
 
 static resproto_status_t status_cb_fun;
@@ -330,9 +503,9 @@ int resconn_disconnect(resset_t          *rset,
 }
 
 
-char *resmsg_res_str(uint32_t res, char *buf, int len)
+char *resmsg_res_str(uint64_t res, char *buf, int len)
 {
-    snprintf(buf, len, "0x%04x", res);
+    snprintf(buf, len, "0x%04" PRIx64, res);
 
     return buf;
 }
@@ -380,6 +553,21 @@ DBusConnection *resource_get_dbus_bus(DBusBusType type, DBusError *err)
 #endif
 }
 
+/* no main loop, every call runs in the calling thread */
+static const resource_loop_ops_t test_loop_ops = {
+    .name = "test",
+};
+
+const resource_loop_ops_t *resource_loop_backend(void)
+{
+    return &test_loop_ops;
+}
+
+void *resource_loop_default(void)
+{
+    return NULL;
+}
+
 resproto_handler_t handlers[3];
 int resproto_set_handler(union resconn_u *r, resmsg_type_t type, resproto_handler_t h)
 {
@@ -0,0 +1,838 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Scalability test of the manager side with many client processes.
+ * Starts a private dbus-daemon using tests/dbus/policy.conf and the
+ * reference manager on it, then forks N client processes with M sets
+ * each. The clients acquire and release their sets as fast as the
+ * manager lets them, while every few hundred milliseconds a random
+ * client is killed and replaced to exercise the manager's teardown of
+ * vanished peers. At the end the clients unregister and report their
+ * round trip times, and the manager's CPU time, memory use and number
+ * of sets left behind are printed.
+ *
+ *   scale-test [options] [-- manager-options]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <pwd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <dbus/dbus.h>
+
+#include <res-conn.h>
+#include <res-hist.h>
+
+#define MANAGER_NAME  "org.maemo.resource.manager"
+
+typedef struct {
+    int             clients;
+    int             sets;
+    int             duration;   /* sec */
+    int             interval;   /* msec between kills, 0 = no kills */
+    const char     *manager;
+    const char     *policy;
+    const char     *daemon;
+    int             verbose;
+    char          **margv;      /* extra manager options */
+    int             margc;
+} conf_t;
+
+typedef struct {
+    pid_t           pid;
+    int             fd;         /* result pipe */
+} child_t;
+
+typedef struct {
+    uint32_t        sent;
+    uint32_t        failed;
+    uint32_t        granted;
+    reshist_t       latency[RESMSG_MAX];
+} result_t;
+
+typedef struct {
+    resset_t       *rset;
+    int             busy;
+    int             acquired;
+    resmsg_type_t   type;
+    uint64_t        sent;
+} cset_t;
+
+typedef struct {
+    unsigned long   utime;      /* clock ticks */
+    unsigned long   stime;
+    unsigned long   rss;        /* kB */
+    unsigned long   hwm;        /* kB */
+} procstat_t;
+
+static void      start_bus(void);
+static void      stop_bus(void);
+static void      start_manager(void);
+static int       stop_manager(void);
+static int       wait_for_manager(void);
+static void      start_client(child_t *);
+static void      stop_client(child_t *, int);
+static void      proc_stat(pid_t, procstat_t *);
+
+static void      client_main(int);
+static void      client_send(resconn_t *, cset_t *, int, resmsg_type_t);
+static void      client_status(resset_t *, resmsg_t *);
+static void      client_notify(resmsg_t *, resset_t *, void *);
+static void      client_manager_up(resconn_t *);
+static void      client_stop(int);
+
+static void      merge_result(result_t *, result_t *);
+static uint64_t  now_ns(void);
+static void      sleep_ms(int);
+static void      fail(const char *, ...);
+static void      usage(int);
+static void      parse_options(int, char **);
+
+static conf_t          conf;
+static char            tmpdir[] = "/tmp/scale-test.XXXXXX";
+static pid_t           bus_pid;
+static pid_t           manager_pid;
+static int             manager_fd = -1;
+static unsigned int    seed = 1;
+
+static volatile sig_atomic_t  stopping;
+static result_t        client_result;
+static uint32_t        client_reqno;
+static int             client_busy;
+
+
+int main(int argc, char **argv)
+{
+    child_t     *clients;
+    result_t     total;
+    result_t     res;
+    procstat_t   start, end, after;
+    uint64_t     t0, t1, tkill;
+    int          killed = 0;
+    int          lost   = 0;
+    int          left;
+    int          status;
+    int          i;
+    long         ticks  = sysconf(_SC_CLK_TCK);
+    double       cpu, secs;
+    char         buf[256];
+    pid_t        pid;
+
+    parse_options(argc, argv);
+
+    signal(SIGPIPE, SIG_IGN);
+
+    if (mkdtemp(tmpdir) == NULL)
+        fail("can't create temporary directory: %s", strerror(errno));
+
+    start_bus();
+    start_manager();
+
+    if (!wait_for_manager())
+        fail("the manager did not show up on the bus");
+
+    if ((clients = calloc(conf.clients, sizeof(child_t))) == NULL)
+        fail("out of memory");
+
+    memset(&total, 0, sizeof(total));
+    for (i = 0;  i < RESMSG_MAX;  i++)
+        reshist_reset(&total.latency[i]);
+
+    for (i = 0;  i < conf.clients;  i++)
+        start_client(clients + i);
+
+    proc_stat(manager_pid, &start);
+
+    t0    = now_ns();
+    t1    = t0 + (uint64_t)conf.duration * 1000000000ULL;
+    tkill = t0 + (uint64_t)conf.interval * 1000000ULL;
+
+    while (now_ns() < t1) {
+        sleep_ms(10);
+
+        /* clients should not exit on their own */
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            for (i = 0;  i < conf.clients;  i++) {
+                if (clients[i].pid == pid) {
+                    fprintf(stderr, "client %d exited unexpectedly\n", pid);
+                    close(clients[i].fd);
+                    start_client(clients + i);
+                    lost++;
+                }
+            }
+        }
+
+        if (conf.interval && now_ns() >= tkill) {
+            i = rand_r(&seed) % conf.clients;
+
+            stop_client(clients + i, TRUE);
+            close(clients[i].fd);
+
+            start_client(clients + i);
+
+            killed++;
+            tkill += (uint64_t)conf.interval * 1000000ULL;
+        }
+    }
+
+    proc_stat(manager_pid, &end);
+    secs = (double)(now_ns() - t0) / 1000000000.0;
+
+    for (i = 0;  i < conf.clients;  i++)
+        kill(clients[i].pid, SIGTERM);
+
+    for (i = 0;  i < conf.clients;  i++) {
+        stop_client(clients + i, FALSE);
+
+        if (read(clients[i].fd, &res, sizeof(res)) == sizeof(res))
+            merge_result(&total, &res);
+        else
+            lost++;
+
+        close(clients[i].fd);
+    }
+
+    sleep_ms(500);              /* let the manager see the peers go */
+    proc_stat(manager_pid, &after);
+
+    left = stop_manager();
+    stop_bus();
+
+    cpu = (double)((end.utime + end.stime) - (start.utime + start.stime)) /
+          (double)ticks;
+
+    printf("%d clients with %d sets, %.1f s, %d clients killed, "
+           "%d lost\n", conf.clients, conf.sets, secs, killed, lost);
+    printf("requests: %u sent, %u failed, %u granted, %.1f requests/s\n",
+           total.sent, total.failed, total.granted,
+           secs > 0.0 ? total.sent / secs : 0.0);
+    printf("manager: cpu %.2f s (%.1f %%), rss %lu kB at start, "
+           "%lu kB peak, %lu kB at end (%+ld kB)\n", cpu,
+           secs > 0.0 ? 100.0 * cpu / secs : 0.0,
+           start.rss, after.hwm, after.rss,
+           (long)after.rss - (long)start.rss);
+    printf("manager: %d sets left after the clients are gone\n", left);
+    printf("request round trip times (usec):\n");
+
+    for (i = 0;  i < RESMSG_MAX;  i++) {
+        if (total.latency[i].count > 0) {
+            printf("   %s\n", reshist_dump(&total.latency[i],
+                                           resmsg_type_str(i),
+                                           buf, sizeof(buf)));
+        }
+    }
+
+    rmdir(tmpdir);
+    free(clients);
+
+    return (left || total.failed) ? 1 : 0;
+}
+
+
+static void start_bus(void)
+{
+    struct passwd *pw = getpwuid(getuid());
+    char           path[256];
+    char           addr[512];
+    FILE          *fp;
+    int            pfd[2];
+    ssize_t        len;
+
+    /*
+     * Deny by default like the system bus does, take the rules of the
+     * resource manager from policy.conf and give the console user's
+     * rights to whoever runs the test.
+     */
+    snprintf(path, sizeof(path), "%s/bus.conf", tmpdir);
+
+    if ((fp = fopen(path, "w")) == NULL)
+        fail("can't write %s: %s", path, strerror(errno));
+
+    fprintf(fp,
+      "<!DOCTYPE busconfig PUBLIC "
+      "\"-//freedesktop//DTD D-BUS Bus Configuration 1.0//EN\"\n"
+      " \"http://www.freedesktop.org/standards/dbus/1.0/busconfig.dtd\">\n"
+      "<busconfig>\n"
+      "  <listen>unix:tmpdir=%s</listen>\n"
+      "  <auth>EXTERNAL</auth>\n"
+      "  <policy context=\"default\">\n"
+      "    <deny own=\"*\"/>\n"
+      "    <deny send_type=\"method_call\"/>\n"
+      "    <allow send_type=\"signal\"/>\n"
+      "    <allow send_requested_reply=\"true\" send_type=\"method_return\"/>\n"
+      "    <allow send_requested_reply=\"true\" send_type=\"error\"/>\n"
+      "    <allow receive_type=\"method_call\"/>\n"
+      "    <allow receive_type=\"method_return\"/>\n"
+      "    <allow receive_type=\"error\"/>\n"
+      "    <allow receive_type=\"signal\"/>\n"
+      "    <allow send_destination=\"org.freedesktop.DBus\"/>\n"
+      "  </policy>\n"
+      "  <policy user=\"%s\">\n"
+      "    <allow own=\"org.maemo.resource.manager\"/>\n"
+      "    <allow send_interface=\"org.maemo.resource.manager\"/>\n"
+      "    <allow send_interface=\"org.maemo.resource.client\"/>\n"
+      "  </policy>\n"
+      "  <include>%s</include>\n"
+      "</busconfig>\n",
+      tmpdir, pw ? pw->pw_name : "root", conf.policy);
+
+    fclose(fp);
+
+    if (access(conf.policy, R_OK) < 0)
+        fail("can't read %s: %s", conf.policy, strerror(errno));
+
+    if (pipe(pfd) < 0)
+        fail("can't create pipe: %s", strerror(errno));
+
+    if ((bus_pid = fork()) < 0)
+        fail("can't fork: %s", strerror(errno));
+
+    if (bus_pid == 0) {
+        char cfgopt[300], addropt[32];
+        int  fd;
+
+        close(pfd[0]);
+
+        if (!conf.verbose && (fd = open("/dev/null", O_WRONLY)) >= 0) {
+            dup2(fd, 2);        /* policy rejections of late replies */
+            close(fd);
+        }
+
+        snprintf(cfgopt , sizeof(cfgopt) , "--config-file=%s", path);
+        snprintf(addropt, sizeof(addropt), "--print-address=%d", pfd[1]);
+        execlp(conf.daemon, conf.daemon, "--nofork", cfgopt, addropt,
+               (char *)NULL);
+        fprintf(stderr, "can't execute %s: %s\n", conf.daemon,
+                strerror(errno));
+        _exit(127);
+    }
+
+    close(pfd[1]);
+
+    len = read(pfd[0], addr, sizeof(addr) - 1);
+    close(pfd[0]);
+
+    if (len <= 0)
+        fail("dbus-daemon did not start");
+
+    addr[len] = '\0';
+    addr[strcspn(addr, "\n")] = '\0';
+
+    setenv("DBUS_SESSION_BUS_ADDRESS", addr, TRUE);
+    setenv("DBUS_SYSTEM_BUS_ADDRESS" , addr, TRUE);
+
+    unlink(path);
+}
+
+static void stop_bus(void)
+{
+    if (bus_pid > 0) {
+        kill(bus_pid, SIGTERM);
+        waitpid(bus_pid, NULL, 0);
+        bus_pid = 0;
+    }
+}
+
+static void start_manager(void)
+{
+    char **argv;
+    int    pfd[2];
+    int    i;
+
+    if ((argv = calloc(conf.margc + 4, sizeof(char *))) == NULL)
+        fail("out of memory");
+
+    argv[0] = (char *)conf.manager;
+    argv[1] = "-d";
+    argv[2] = "session";
+
+    for (i = 0;  i < conf.margc;  i++)
+        argv[3 + i] = conf.margv[i];
+
+    if (pipe(pfd) < 0)
+        fail("can't create pipe: %s", strerror(errno));
+
+    if ((manager_pid = fork()) < 0)
+        fail("can't fork: %s", strerror(errno));
+
+    if (manager_pid == 0) {
+        close(pfd[0]);
+        dup2(pfd[1], 1);
+        close(pfd[1]);
+        execv(conf.manager, argv);
+        fprintf(stderr, "can't execute %s: %s\n", conf.manager,
+                strerror(errno));
+        _exit(127);
+    }
+
+    close(pfd[1]);
+    manager_fd = pfd[0];
+
+    free(argv);
+}
+
+/*
+ * Returns the number of sets the manager had left when it exited.
+ */
+static int stop_manager(void)
+{
+    FILE     *fp;
+    char      line[256];
+    unsigned  requests, granted, denied, left = ~0U;
+
+    kill(manager_pid, SIGINT);
+
+    if ((fp = fdopen(manager_fd, "r")) != NULL) {
+        while (fgets(line, sizeof(line), fp) != NULL) {
+            sscanf(line, "%u requests, %u granted, %u denied, %u sets left",
+                   &requests, &granted, &denied, &left);
+        }
+        fclose(fp);
+    }
+
+    waitpid(manager_pid, NULL, 0);
+
+    if (left == ~0U)
+        fail("the manager did not report its sets");
+
+    return (int)left;
+}
+
+/*
+ * Polls the bus in a child process so that this process never opens
+ * a D-Bus connection that the clients would inherit.
+ */
+static int wait_for_manager(void)
+{
+    DBusConnection *dcon;
+    pid_t           pid;
+    int             status;
+    int             i;
+
+    if ((pid = fork()) < 0)
+        fail("can't fork: %s", strerror(errno));
+
+    if (pid == 0) {
+        if ((dcon = dbus_bus_get(DBUS_BUS_SESSION, NULL)) == NULL)
+            _exit(1);
+
+        for (i = 0;  i < 500;  i++) {
+            if (dbus_bus_name_has_owner(dcon, MANAGER_NAME, NULL))
+                _exit(0);
+            sleep_ms(10);
+        }
+
+        _exit(1);
+    }
+
+    if (waitpid(pid, &status, 0) < 0)
+        return FALSE;
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static void start_client(child_t *child)
+{
+    sigset_t term, old;
+    int      pfd[2];
+
+    if (pipe(pfd) < 0)
+        fail("can't create pipe: %s", strerror(errno));
+
+    /* a SIGTERM must not kill the child before it has its handler */
+    sigemptyset(&term);
+    sigaddset(&term, SIGTERM);
+    sigprocmask(SIG_BLOCK, &term, &old);
+
+    if ((child->pid = fork()) < 0)
+        fail("can't fork: %s", strerror(errno));
+
+    if (child->pid == 0) {
+        close(pfd[0]);
+        if (manager_fd >= 0)
+            close(manager_fd);
+        signal(SIGTERM, client_stop);
+        sigprocmask(SIG_SETMASK, &old, NULL);
+        client_main(pfd[1]);
+        _exit(0);
+    }
+
+    sigprocmask(SIG_SETMASK, &old, NULL);
+
+    close(pfd[1]);
+    child->fd = pfd[0];
+}
+
+static void stop_client(child_t *child, int forced)
+{
+    if (forced)
+        kill(child->pid, SIGKILL);
+
+    waitpid(child->pid, NULL, 0);
+}
+
+static void proc_stat(pid_t pid, procstat_t *st)
+{
+    char   path[64];
+    char   buf[1024];
+    char  *p;
+    FILE  *fp;
+
+    memset(st, 0, sizeof(*st));
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+    if ((fp = fopen(path, "r")) != NULL) {
+        if (fgets(buf, sizeof(buf), fp) && (p = strrchr(buf, ')')) != NULL) {
+            sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+                   "%lu %lu", &st->utime, &st->stime);
+        }
+        fclose(fp);
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+
+    if ((fp = fopen(path, "r")) != NULL) {
+        while (fgets(buf, sizeof(buf), fp) != NULL) {
+            if (!strncmp(buf, "VmRSS:", 6))
+                st->rss = strtoul(buf + 6, NULL, 10);
+            else if (!strncmp(buf, "VmHWM:", 6))
+                st->hwm = strtoul(buf + 6, NULL, 10);
+        }
+        fclose(fp);
+    }
+}
+
+
+/*
+ * A client process: registers its sets, then acquires and releases
+ * each of them in turn, with one request in flight per set, until
+ * SIGTERM. Then unregisters and writes its results to fd.
+ */
+static void client_main(int fd)
+{
+    DBusConnection *dcon;
+    resconn_t      *rcon;
+    cset_t         *sets;
+    uint64_t        deadline;
+    int             i;
+
+    memset(&client_result, 0, sizeof(client_result));
+    for (i = 0;  i < RESMSG_MAX;  i++)
+        reshist_reset(&client_result.latency[i]);
+
+    if ((dcon = dbus_bus_get(DBUS_BUS_SESSION, NULL)) == NULL ||
+        (sets = calloc(conf.sets, sizeof(cset_t))) == NULL)
+        _exit(1);
+
+    rcon = resproto_init(RESPROTO_ROLE_CLIENT, RESPROTO_TRANSPORT_DBUS,
+                         client_manager_up, dcon);
+
+    if (rcon == NULL)
+        _exit(1);
+
+    resproto_set_handler(rcon, RESMSG_UNREGISTER, client_notify);
+    resproto_set_handler(rcon, RESMSG_GRANT     , client_notify);
+    resproto_set_handler(rcon, RESMSG_ADVICE    , client_notify);
+    resproto_set_handler(rcon, RESMSG_RELEASE   , client_notify);
+
+    for (i = 0;  i < conf.sets;  i++)
+        client_send(rcon, sets + i, i + 1, RESMSG_REGISTER);
+
+    while (!stopping) {
+        if (!dbus_connection_read_write_dispatch(dcon, 10))
+            _exit(1);
+
+        for (i = 0;  i < conf.sets && !stopping;  i++) {
+            if (!sets[i].busy && sets[i].rset != NULL) {
+                client_send(rcon, sets + i, i + 1, sets[i].acquired ?
+                            RESMSG_RELEASE : RESMSG_ACQUIRE);
+            }
+        }
+    }
+
+    /* let the requests in flight complete, then unregister */
+    deadline = now_ns() + 5000000000ULL;
+
+    while (client_busy > 0 && now_ns() < deadline)
+        dbus_connection_read_write_dispatch(dcon, 10);
+
+    for (i = 0;  i < conf.sets;  i++) {
+        if (sets[i].rset != NULL && !sets[i].busy)
+            client_send(rcon, sets + i, i + 1, RESMSG_UNREGISTER);
+    }
+
+    while (client_busy > 0 && now_ns() < deadline)
+        dbus_connection_read_write_dispatch(dcon, 10);
+
+    if (write(fd, &client_result, sizeof(client_result)) < 0)
+        _exit(1);
+
+    _exit(0);
+}
+
+static void client_send(resconn_t     *rcon,
+                        cset_t        *set,
+                        int            id,
+                        resmsg_type_t  type)
+{
+    resmsg_t msg;
+    int      success;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.any.type  = type;
+    msg.any.id    = id;
+    msg.any.reqno = ++client_reqno;
+
+    set->type = type;
+    set->sent = now_ns();
+
+    switch (type) {
+
+    case RESMSG_REGISTER:
+        msg.record.rset.all = RESMSG_AUDIO_PLAYBACK;
+        msg.record.app_id   = "scale-test";
+        msg.record.klass    = "player";
+
+        if ((set->rset = resconn_connect(rcon, &msg, client_status)))
+            set->rset->userdata = set;
+        success = (set->rset != NULL);
+        break;
+
+    case RESMSG_UNREGISTER:
+        success = resconn_disconnect(set->rset, &msg, client_status);
+        break;
+
+    default:
+        success = resproto_send_message(set->rset, &msg, client_status);
+        break;
+    }
+
+    client_result.sent++;
+
+    if (!success)
+        client_result.failed++;
+    else {
+        set->busy = TRUE;
+        client_busy++;
+    }
+}
+
+static void client_status(resset_t *rset, resmsg_t *msg)
+{
+    cset_t *set = rset->userdata;
+
+    if (set == NULL || !set->busy)
+        return;
+
+    set->busy = FALSE;
+    client_busy--;
+
+    reshist_add(&client_result.latency[set->type], now_ns() - set->sent);
+
+    if (msg->status.errcod)
+        client_result.failed++;
+
+    switch (set->type) {
+    case RESMSG_ACQUIRE:    set->acquired = TRUE;                     break;
+    case RESMSG_RELEASE:    set->acquired = FALSE;                    break;
+    case RESMSG_REGISTER:
+        if (msg->status.errcod) {
+            rset->userdata = NULL;
+            set->rset = NULL;
+        }
+        break;
+    case RESMSG_UNREGISTER:
+        rset->userdata = NULL;
+        set->rset = NULL;
+        break;
+    default:
+        break;
+    }
+}
+
+static void client_notify(resmsg_t *msg, resset_t *rset, void *data)
+{
+    (void)rset;
+    (void)data;
+
+    if (msg->type == RESMSG_GRANT && msg->notify.resrc)
+        client_result.granted++;
+}
+
+static void client_manager_up(resconn_t *rcon)
+{
+    (void)rcon;
+}
+
+static void client_stop(int signo)
+{
+    (void)signo;
+
+    stopping = TRUE;
+}
+
+
+static void merge_result(result_t *total, result_t *res)
+{
+    reshist_t *to, *from;
+    int        i, j;
+
+    total->sent    += res->sent;
+    total->failed  += res->failed;
+    total->granted += res->granted;
+
+    for (i = 0;  i < RESMSG_MAX;  i++) {
+        to   = total->latency + i;
+        from = res->latency + i;
+
+        if (from->count == 0)
+            continue;
+
+        if (to->count == 0 || from->min < to->min)
+            to->min = from->min;
+        if (from->max > to->max)
+            to->max = from->max;
+
+        to->count += from->count;
+        to->sum   += from->sum;
+
+        for (j = 0;  j < RESHIST_BUCKETS;  j++)
+            to->bucket[j] += from->bucket[j];
+    }
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_ms(int msec)
+{
+    struct timespec ts;
+
+    ts.tv_sec  = msec / 1000;
+    ts.tv_nsec = (msec % 1000) * 1000000L;
+
+    nanosleep(&ts, NULL);
+}
+
+static void fail(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    fprintf(stderr, "scale-test: ");
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+
+    if (manager_pid > 0)
+        kill(manager_pid, SIGKILL);
+
+    stop_bus();
+
+    exit(1);
+}
+
+static void usage(int exit_code)
+{
+    printf("usage: scale-test [-h] [-n clients] [-m sets] [-t seconds] "
+           "[-k msec] [-c policy.conf]\n"
+           "                  [-M manager] [-D dbus-daemon] [-v] "
+           "[-- manager-options]\n");
+    printf("\toptions:\n");
+    printf("\t  h\tprint this help message and exit\n");
+    printf("\t  n\tnumber of client processes (default 100)\n");
+    printf("\t  m\tnumber of resource sets per client (default 4)\n");
+    printf("\t  t\tduration of the test in seconds (default 10)\n");
+    printf("\t  k\tkill a random client every <msec> milliseconds, 0 "
+           "disables\n\t\tkilling (default 200)\n");
+    printf("\t  c\tpolicy of the private bus (default dbus/policy.conf)\n");
+    printf("\t  M\tmanager executable (default ./reference_manager)\n");
+    printf("\t  D\tdbus-daemon executable (default dbus-daemon)\n");
+    printf("\t  v\tshow the messages of dbus-daemon\n");
+
+    exit(exit_code);
+}
+
+static void parse_options(int argc, char **argv)
+{
+    int option;
+
+    conf.clients  = 100;
+    conf.sets     = 4;
+    conf.duration = 10;
+    conf.interval = 200;
+    conf.policy   = "dbus/policy.conf";
+    conf.manager  = "./reference_manager";
+    conf.daemon   = "dbus-daemon";
+
+    while ((option = getopt(argc, argv, "hvn:m:t:k:c:M:D:")) != -1) {
+
+        switch (option) {
+
+        case 'h': usage(0);                                   break;
+        case 'n': conf.clients  = atoi(optarg);               break;
+        case 'm': conf.sets     = atoi(optarg);               break;
+        case 't': conf.duration = atoi(optarg);               break;
+        case 'k': conf.interval = atoi(optarg);               break;
+        case 'c': conf.policy   = optarg;                     break;
+        case 'M': conf.manager  = optarg;                     break;
+        case 'D': conf.daemon   = optarg;                     break;
+        case 'v': conf.verbose  = TRUE;                       break;
+        default:  usage(EINVAL);                              break;
+
+        }
+    }
+
+    if (conf.clients < 1 || conf.sets < 1 || conf.duration < 1 ||
+        conf.interval < 0)
+        usage(EINVAL);
+
+    conf.margc = argc - optind;
+    conf.margv = argv + optind;
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -27,7 +27,7 @@ USA.
 #include "../src/resource.h"
 
 static void grant_callback (resource_set_t *resource_set,
-                            uint32_t        resources,
+                            uint64_t        resources,
                             void           *userdata)
 {
     char buf[512];
@@ -42,7 +42,7 @@ static void grant_callback (resource_set_t *resource_set,
 }
 
 static void advice_callback (resource_set_t *resource_set,
-                             uint32_t        resources,
+                             uint64_t        resources,
                              void           *userdata)
 {
     char buf[512];
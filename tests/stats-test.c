@@ -0,0 +1,294 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Checks the org.maemo.resource.stats interface of a manager started
+ * with statistics enabled, like 'reference_manager -S'. Registers and
+ * acquires a set on the session bus, then calls get_stats and checks
+ * the signature of the reply and the counters this client accounts
+ * for. Run by stats-test.sh on a private bus.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <dbus/dbus.h>
+
+#include <res-conn.h>
+
+
+#define MANAGER_NAME       "org.maemo.resource.manager"
+#define MANAGER_PATH       "/org/maemo/resource/manager"
+#define STATS_INTERFACE    "org.maemo.resource.stats"
+#define STATS_SIGNATURE    "a(suuuuu)(ttuuuut)a{su}a(stttta(qu))"
+
+static int       wait_for_manager(DBusConnection *);
+static void      wait_for_status(DBusConnection *);
+static void      manager_up(resconn_t *);
+static void      status(resset_t *, resmsg_t *);
+static int       check_stats(DBusConnection *, DBusMessage *);
+static int       check_message_stats(DBusMessageIter *);
+static int       check_totals(DBusMessageIter *);
+static int       check_peers(DBusMessageIter *, const char *);
+static int       check(int, const char *);
+
+static int       statuses;
+static int       errors;
+
+
+int main(int argc, char **argv)
+{
+    DBusConnection *dcon;
+    DBusMessage    *call;
+    DBusMessage    *reply;
+    resconn_t      *rcon;
+    resset_t       *rset;
+    resmsg_t        msg;
+    int             failed;
+
+    (void)argc;
+    (void)argv;
+
+    if ((dcon = dbus_bus_get(DBUS_BUS_SESSION, NULL)) == NULL) {
+        printf("can't connect to the session bus\n");
+        return 1;
+    }
+
+    if (!wait_for_manager(dcon)) {
+        printf("the manager did not show up on the bus\n");
+        return 1;
+    }
+
+    rcon = resproto_init(RESPROTO_ROLE_CLIENT, RESPROTO_TRANSPORT_DBUS,
+                         manager_up, dcon);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.record.type     = RESMSG_REGISTER;
+    msg.record.id       = 1;
+    msg.record.reqno    = 1;
+    msg.record.rset.all = RESMSG_AUDIO_PLAYBACK;
+    msg.record.klass    = "player";
+    msg.record.app_id   = "stats-test";
+
+    if (rcon == NULL || (rset = resconn_connect(rcon, &msg, status)) == NULL) {
+        printf("can't register to the manager\n");
+        return 1;
+    }
+
+    wait_for_status(dcon);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.any.type  = RESMSG_ACQUIRE;
+    msg.any.id    = 1;
+    msg.any.reqno = 2;
+
+    if (!resproto_send_message(rset, &msg, status)) {
+        printf("can't send the acquire request\n");
+        return 1;
+    }
+
+    wait_for_status(dcon);
+
+    call = dbus_message_new_method_call(MANAGER_NAME, MANAGER_PATH,
+                                        STATS_INTERFACE, "get_stats");
+    reply = call ? dbus_connection_send_with_reply_and_block(dcon, call,
+                                                             5000, NULL)
+                 : NULL;
+
+    if (reply == NULL) {
+        printf("no reply to get_stats\n");
+        return 1;
+    }
+
+    failed = !check_stats(dcon, reply) || errors;
+
+    dbus_message_unref(reply);
+    dbus_message_unref(call);
+
+    return failed;
+}
+
+static int wait_for_manager(DBusConnection *dcon)
+{
+    int i;
+
+    for (i = 0;  i < 500;  i++) {
+        if (dbus_bus_name_has_owner(dcon, MANAGER_NAME, NULL))
+            return TRUE;
+        usleep(10000);
+    }
+
+    return FALSE;
+}
+
+static void wait_for_status(DBusConnection *dcon)
+{
+    int expected = statuses + 1;
+    int i;
+
+    for (i = 0;  i < 50 && statuses < expected;  i++)
+        dbus_connection_read_write_dispatch(dcon, 100);
+
+    if (statuses < expected)
+        errors++;
+}
+
+static void manager_up(resconn_t *rcon)
+{
+    (void)rcon;
+}
+
+static void status(resset_t *rset, resmsg_t *msg)
+{
+    (void)rset;
+
+    if (msg->status.errcod)
+        errors++;
+
+    statuses++;
+}
+
+static int check_stats(DBusConnection *dcon, DBusMessage *reply)
+{
+    DBusMessageIter  iter;
+    const char      *signature = dbus_message_get_signature(reply);
+
+    if (!check(dbus_message_get_type(reply) ==
+               DBUS_MESSAGE_TYPE_METHOD_RETURN, "get_stats returned") ||
+        !check(!strcmp(signature, STATS_SIGNATURE), "reply signature")  )
+    {
+        printf("got '%s'\n", signature);
+        return FALSE;
+    }
+
+    dbus_message_iter_init(reply, &iter);
+
+    if (!check_message_stats(&iter) || !dbus_message_iter_next(&iter) ||
+        !check_totals(&iter)        || !dbus_message_iter_next(&iter) ||
+        !check_peers(&iter, dbus_bus_get_unique_name(dcon))             )
+        return FALSE;
+
+    return TRUE;
+}
+
+/*
+ * The manager has received exactly one register and one acquire
+ * request and replied to both of them.
+ */
+static int check_message_stats(DBusMessageIter *iter)
+{
+    DBusMessageIter  array;
+    DBusMessageIter  entry;
+    const char      *name;
+    dbus_uint32_t    sent, received, replied;
+    int              registers = FALSE;
+    int              acquires  = FALSE;
+
+    dbus_message_iter_recurse(iter, &array);
+
+    while (dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_STRUCT) {
+        dbus_message_iter_recurse(&array, &entry);
+        dbus_message_iter_get_basic(&entry, &name);
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_get_basic(&entry, &sent);
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_get_basic(&entry, &received);
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_get_basic(&entry, &replied);
+
+        if (!strcmp(name, "register"))
+            registers = received == 1 && replied == 1;
+        else if (!strcmp(name, "acquire"))
+            acquires = received == 1 && replied == 1;
+
+        dbus_message_iter_next(&array);
+    }
+
+    return check(registers, "register counters") &
+           check(acquires,  "acquire counters");
+}
+
+static int check_totals(DBusMessageIter *iter)
+{
+    DBusMessageIter  totals;
+    dbus_uint64_t    bytes_sent, bytes_received;
+    dbus_uint32_t    pending, pending_peak, rsets, rsets_peak;
+
+    dbus_message_iter_recurse(iter, &totals);
+    dbus_message_iter_get_basic(&totals, &bytes_sent);
+    dbus_message_iter_next(&totals);
+    dbus_message_iter_get_basic(&totals, &bytes_received);
+    dbus_message_iter_next(&totals);
+    dbus_message_iter_get_basic(&totals, &pending);
+    dbus_message_iter_next(&totals);
+    dbus_message_iter_get_basic(&totals, &pending_peak);
+    dbus_message_iter_next(&totals);
+    dbus_message_iter_get_basic(&totals, &rsets);
+    dbus_message_iter_next(&totals);
+    dbus_message_iter_get_basic(&totals, &rsets_peak);
+
+    return check(bytes_received > 0,         "bytes received") &
+           check(rsets == 1 && rsets_peak == 1, "resource sets");
+}
+
+static int check_peers(DBusMessageIter *iter, const char *self)
+{
+    DBusMessageIter  array;
+    DBusMessageIter  entry;
+    const char      *peer;
+    dbus_uint32_t    count;
+    int              found = FALSE;
+
+    dbus_message_iter_recurse(iter, &array);
+
+    while (dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_DICT_ENTRY) {
+        dbus_message_iter_recurse(&array, &entry);
+        dbus_message_iter_get_basic(&entry, &peer);
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_get_basic(&entry, &count);
+
+        if (!strcmp(peer, self))
+            found = count == 1;
+
+        dbus_message_iter_next(&array);
+    }
+
+    return check(found, "sets of this peer");
+}
+
+static int check(int success, const char *what)
+{
+    printf("%s: %s\n", success ? "ok" : "failed", what);
+
+    return success;
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
@@ -0,0 +1,27 @@
+#!/bin/sh
+#
+# Runs stats_test against the reference manager with statistics
+# enabled, both on a private session bus of their own.
+#
+
+if [ -z "$STATS_TEST_BUS" ]; then
+    runner=${DBUS_RUN_SESSION:-dbus-run-session}
+
+    if ! command -v "$runner" > /dev/null 2>&1; then
+        echo "$runner not found, skipping"
+        exit 77
+    fi
+
+    STATS_TEST_BUS=1 exec "$runner" -- sh "$0" "$@"
+fi
+
+./reference_manager -S -d session > /dev/null 2>&1 &
+manager=$!
+
+./stats_test
+result=$?
+
+kill -INT $manager
+wait $manager
+
+exit $result
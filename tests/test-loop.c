@@ -0,0 +1,231 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "test-loop.h"
+
+#ifndef TRUE
+#define FALSE 0
+#define TRUE  1
+#endif
+
+typedef struct ltimer_s {
+    struct ltimer_s   *next;
+    struct ltimer_s   *prev;
+    uint64_t           due;
+    uint32_t           delay;
+    resconn_timercb_t  cb;
+    void              *data;
+    int                deleted;
+} ltimer_t;
+
+static void  timer_link(ltimer_t *, ltimer_t *);
+static void  timer_unlink(ltimer_t *);
+static void  timer_arm(ltimer_t *);
+static void  wait_until(uint64_t);
+static void  fire(ltimer_t *);
+
+static ltimer_t   immediate = { &immediate, &immediate };
+static ltimer_t   delayed   = { &delayed  , &delayed   };
+static ltimer_t  *firing;
+
+static int        virtual_clock;
+static uint64_t   virtual_now;
+
+
+void testloop_use_virtual_clock(void)
+{
+    virtual_clock = TRUE;
+}
+
+/* nanoseconds */
+uint64_t testloop_now(void)
+{
+    struct timespec ts;
+
+    if (virtual_clock)
+        return virtual_now;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void *testloop_timer_add(uint32_t delay, resconn_timercb_t cb, void *data)
+{
+    ltimer_t *t;
+
+    if ((t = calloc(1, sizeof(ltimer_t))) == NULL)
+        return NULL;
+
+    t->delay = delay;
+    t->cb    = cb;
+    t->data  = data;
+
+    timer_arm(t);
+
+    return t;
+}
+
+void testloop_timer_del(void *timer)
+{
+    ltimer_t *t = timer;
+
+    if (t == NULL)
+        return;
+
+    if (t == firing)
+        t->deleted = TRUE;
+    else {
+        timer_unlink(t);
+        free(t);
+    }
+}
+
+/*
+ * Runs the timers until nothing is due immediately. While pending
+ * points to a positive number the delayed timers are waited for as
+ * well; with the real clock this sleeps.
+ */
+void testloop_run(int *pending)
+{
+    ltimer_t *t;
+
+    for (;;) {
+        if (immediate.next != &immediate)
+            t = immediate.next;
+        else if (pending && *pending > 0 && delayed.next != &delayed) {
+            t = delayed.next;
+            wait_until(t->due);
+        }
+        else
+            break;
+
+        fire(t);
+    }
+}
+
+/*
+ * Moves the virtual clock msec milliseconds ahead, running every timer
+ * that gets due meanwhile.
+ */
+void testloop_run_for(uint32_t msec)
+{
+    uint64_t  end = virtual_now + (uint64_t)msec * 1000000ULL;
+    ltimer_t *t;
+
+    for (;;) {
+        if (immediate.next != &immediate)
+            t = immediate.next;
+        else if (delayed.next != &delayed && delayed.next->due <= end) {
+            t = delayed.next;
+            virtual_now = t->due;
+        }
+        else
+            break;
+
+        fire(t);
+    }
+
+    virtual_now = end;
+}
+
+
+static void timer_link(ltimer_t *after, ltimer_t *t)
+{
+    t->prev = after;
+    t->next = after->next;
+    after->next->prev = t;
+    after->next = t;
+}
+
+static void timer_unlink(ltimer_t *t)
+{
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = t->prev = t;
+}
+
+static void timer_arm(ltimer_t *t)
+{
+    ltimer_t *p;
+
+    if (!t->delay)
+        timer_link(immediate.prev, t);
+    else {
+        t->due = testloop_now() + (uint64_t)t->delay * 1000000ULL;
+
+        /* timers are mostly added with the same delay */
+        for (p = delayed.prev;  p != &delayed && p->due > t->due;  p = p->prev)
+            ;
+
+        timer_link(p, t);
+    }
+}
+
+static void wait_until(uint64_t due)
+{
+    struct timespec ts;
+    uint64_t        now = testloop_now();
+    uint64_t        wait;
+
+    if (due <= now)
+        return;
+
+    if (virtual_clock)
+        virtual_now = due;
+    else {
+        wait = due - now;
+        ts.tv_sec  = wait / 1000000000ULL;
+        ts.tv_nsec = wait % 1000000000ULL;
+
+        while (nanosleep(&ts, &ts) < 0)
+            ;
+    }
+}
+
+static void fire(ltimer_t *t)
+{
+    timer_unlink(t);
+
+    firing = t;
+
+    if (t->cb(t->data) && !t->deleted) {
+        firing = NULL;
+        timer_arm(t);
+    }
+    else {
+        firing = NULL;
+        free(t);
+    }
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
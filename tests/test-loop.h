@@ -0,0 +1,58 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+#ifndef __RESOURCE_TESTS_TEST_LOOP_H__
+#define __RESOURCE_TESTS_TEST_LOOP_H__
+
+#include <stdint.h>
+
+#include <res-conn.h>
+
+/*
+ * A timer loop for the tests that run a manager and its clients in one
+ * process over the internal transport, so that neither a bus nor a main
+ * loop library is involved. testloop_timer_add() and testloop_timer_del()
+ * are given to resproto_init(). Timers without delay run in the order
+ * they were added; the delayed ones by their due time, which is taken
+ * from CLOCK_MONOTONIC or, after testloop_use_virtual_clock(), from a
+ * clock that only moves when the loop is told to.
+ */
+
+void      testloop_use_virtual_clock(void);
+uint64_t  testloop_now(void);
+
+void     *testloop_timer_add(uint32_t, resconn_timercb_t, void *);
+void      testloop_timer_del(void *);
+
+void      testloop_run(int *);
+void      testloop_run_for(uint32_t);
+
+#endif /* __RESOURCE_TESTS_TEST_LOOP_H__ */
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
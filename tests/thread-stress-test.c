@@ -0,0 +1,169 @@
+/*************************************************************************
+This file is part of libresource
+
+Copyright (C) 2010 Nokia Corporation.
+
+This library is free software; you can redistribute
+it and/or modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation
+version 2.1 of the License.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301
+USA.
+*************************************************************************/
+
+
+/*
+ * Hammers resource_set_acquire()/release() from many threads while the
+ * main thread runs the GLib main loop, and checks that every callback
+ * is delivered on the main loop thread. Needs a running resource manager.
+ *
+ *   thread-stress-test [threads] [iterations]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <glib.h>
+
+#include <resource.h>
+#include <res-msg.h>
+
+typedef struct {
+    pthread_t        tid;
+    int              index;
+    resource_set_t  *rs;
+    volatile int     grants;
+} worker_t;
+
+static GMainLoop       *main_loop;
+static pthread_t        main_thread;
+static int              iterations = 1000;
+static volatile int     wrong_thread;
+static volatile int     running;
+
+static void grant_callback(resource_set_t *rs, uint64_t resources, void *data)
+{
+    worker_t *w = (worker_t *)data;
+
+    (void)rs;
+    (void)resources;
+
+    if (!pthread_equal(pthread_self(), main_thread))
+        __sync_fetch_and_add(&wrong_thread, 1);
+
+    __sync_fetch_and_add(&w->grants, 1);
+}
+
+static void *worker(void *data)
+{
+    worker_t *w = (worker_t *)data;
+    int       i;
+
+    w->rs = resource_set_create("player", RESOURCE_AUDIO_PLAYBACK, 0, 0,
+                                grant_callback, w);
+
+    resource_set_configure_audio(w->rs, "player", getpid(), NULL);
+
+    for (i = 0;  i < iterations;  i++) {
+        resource_set_acquire(w->rs);
+
+        if (!(i % 16))
+            usleep((i * 31 + w->index * 17) % 500);
+
+        resource_set_release(w->rs);
+    }
+
+    resource_set_destroy(w->rs);
+
+    __sync_sub_and_fetch(&running, 1);
+
+    return NULL;
+}
+
+static gboolean check_done(gpointer data)
+{
+    (void)data;
+
+    if (running > 0)
+        return TRUE;
+
+    g_main_loop_quit(main_loop);
+
+    return FALSE;
+}
+
+static gboolean linger(gpointer data)
+{
+    (void)data;
+
+    g_main_loop_quit(main_loop);
+
+    return FALSE;
+}
+
+int main(int argc, char *argv[])
+{
+    worker_t *workers;
+    int       nthread = 16;
+    int       grants  = 0;
+    int       i;
+
+    if (argc > 1)  nthread    = atoi(argv[1]);
+    if (argc > 2)  iterations = atoi(argv[2]);
+
+    if (nthread <= 0 || iterations <= 0) {
+        printf("usage: %s [threads] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    main_thread = pthread_self();
+    main_loop   = g_main_loop_new(NULL, FALSE);
+    workers     = calloc(nthread, sizeof(worker_t));
+    running     = nthread;
+
+    for (i = 0;  i < nthread;  i++) {
+        workers[i].index = i;
+        pthread_create(&workers[i].tid, NULL, worker, workers + i);
+    }
+
+    g_timeout_add(100, check_done, NULL);
+    g_main_loop_run(main_loop);
+
+    for (i = 0;  i < nthread;  i++)
+        pthread_join(workers[i].tid, NULL);
+
+    /* let the last replies and unregisters through */
+    g_timeout_add(1000, linger, NULL);
+    g_main_loop_run(main_loop);
+
+    for (i = 0;  i < nthread;  i++)
+        grants += workers[i].grants;
+
+    printf("%d threads x %d iterations: %d grant callbacks, "
+           "%d on a wrong thread\n", nthread, iterations, grants,
+           wrong_thread);
+
+    g_main_loop_unref(main_loop);
+    free(workers);
+
+    return wrong_thread ? 1 : 0;
+}
+
+
+/* 
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ * vim:set expandtab shiftwidth=4:
+ */
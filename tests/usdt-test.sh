@@ -0,0 +1,38 @@
+#!/bin/sh
+#
+# Checks that the USDT probes of the libresource provider made it into the
+# built library. Only run when configured with --enable-usdt.
+#
+
+lib=${1:-$top_builddir/src/.libs/libresource.so}
+readelf=${READELF:-readelf}
+
+probes="msg_compose msg_send msg_receive dispatch_start dispatch_done
+        reply_create reply_complete queue_enqueue queue_dequeue
+        link_up link_down"
+
+if [ ! -f "$lib" ]; then
+    echo "$lib: no such file"
+    exit 1
+fi
+
+notes=`$readelf -n "$lib" 2>/dev/null` || {
+    echo "failed to read the notes of $lib"
+    exit 1
+}
+
+names=`echo "$notes" |
+       awk '/Provider:/ { p = ($2 == "libresource") } /Name:/ && p { print $2 }'`
+
+failed=0
+
+for probe in $probes; do
+    if echo "$names" | grep -qx "$probe"; then
+        echo "ok: $probe"
+    else
+        echo "missing: $probe"
+        failed=1
+    fi
+done
+
+exit $failed